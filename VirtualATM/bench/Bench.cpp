@@ -0,0 +1,161 @@
+#include "Bench.h"
+#include "Account.h"
+#include "AllocCounter.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+std::vector<std::pair<std::string, BenchSuite::Group>>& BenchSuite::groups() {
+    static std::vector<std::pair<std::string, Group>> registered;
+    return registered;
+}
+
+void BenchSuite::registerGroup(const std::string& name, Group group) {
+    groups().emplace_back(name, group);
+}
+
+BenchSuite::BenchSuite(const std::string& filter, double minSeconds, const std::string& scratchDir)
+    : filter(filter), minSeconds(minSeconds), scratchDir(scratchDir), repetitions(1) {}
+
+void BenchSuite::setRepetitions(int count) {
+    repetitions = std::max(1, count);
+}
+
+// Groups run in name order so output is stable across link orders
+void BenchSuite::runGroups(size_t accounts) {
+    auto& all = groups();
+    std::sort(all.begin(), all.end(),
+              [](const std::pair<std::string, Group>& a, const std::pair<std::string, Group>& b) {
+                  return a.first < b.first;
+              });
+    for (auto& group : all) {
+        group.second(*this, accounts);
+    }
+}
+
+bool BenchSuite::enabled(const std::string& name) const {
+    return filter.empty() || name.find(filter) != std::string::npos;
+}
+
+const std::string& BenchSuite::getScratchDir() const {
+    return scratchDir;
+}
+
+const std::vector<BenchResult>& BenchSuite::getResults() const {
+    return results;
+}
+
+// Grow the iteration count until one run lasts at least minSeconds, then
+// repeat that run and keep the fastest
+BenchResult* BenchSuite::measure(const std::string& name, size_t accounts, const Body& body) {
+    if (!enabled(name)) {
+        return nullptr;
+    }
+
+    uint64_t iterations = 1;
+    double seconds = 0;
+    AllocStats allocated{0, 0};
+    while (true) {
+        AllocScope allocations;
+        auto start = std::chrono::steady_clock::now();
+        body(iterations);
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        allocated = allocations.elapsed();
+        if (seconds >= minSeconds || iterations >= (uint64_t(1) << 34)) {
+            break;
+        }
+        double scale = seconds > 0 ? (minSeconds * 1.2) / seconds : 100.0;
+        scale = std::min(100.0, std::max(2.0, scale));
+        iterations = static_cast<uint64_t>(static_cast<double>(iterations) * scale);
+    }
+
+    // Extra runs at the final iteration count; the fastest one counts
+    for (int run = 1; run < repetitions; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        body(iterations);
+        seconds = std::min(seconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    BenchResult result{name, accounts, iterations, seconds * 1e9 / static_cast<double>(iterations), {}};
+    std::printf("%-28s %10zu accounts %14.1f ns/op %12llu iterations", name.c_str(), accounts,
+                result.nsPerOp, static_cast<unsigned long long>(iterations));
+    if (AllocCounter::isCounting()) {
+        // Counted on the measuring thread, over the final run
+        result.counters["allocs_per_op"] = static_cast<double>(allocated.allocations) / static_cast<double>(iterations);
+        result.counters["bytes_per_op"] = static_cast<double>(allocated.bytes) / static_cast<double>(iterations);
+        std::printf(" %10.2f allocs/op %12.1f B/op", result.counters["allocs_per_op"], result.counters["bytes_per_op"]);
+    }
+    std::printf("\n");
+    std::fflush(stdout);
+    results.push_back(result);
+    return &results.back();
+}
+
+std::string BenchSuite::toJson() const {
+    std::string json = "{\n  \"benchmarks\": [\n";
+    char line[512];
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        std::snprintf(line, sizeof(line),
+                      "    {\"name\": \"%s\", \"accounts\": %zu, \"iterations\": %llu, \"ns_per_op\": %.3f, \"counters\": {",
+                      r.name.c_str(), r.accounts, static_cast<unsigned long long>(r.iterations), r.nsPerOp);
+        json += line;
+        bool first = true;
+        for (const auto& counter : r.counters) {
+            std::snprintf(line, sizeof(line), "%s\"%s\": %.6g", first ? "" : ", ", counter.first.c_str(),
+                          counter.second);
+            json += line;
+            first = false;
+        }
+        json += (i + 1 < results.size()) ? "}},\n" : "}}\n";
+    }
+    json += "  ]\n}\n";
+    return json;
+}
+
+namespace {
+    bool extractNumber(const std::string& line, const std::string& key, double& value) {
+        size_t pos = line.find("\"" + key + "\":");
+        if (pos == std::string::npos) {
+            return false;
+        }
+        value = std::strtod(line.c_str() + pos + key.size() + 3, nullptr);
+        return true;
+    }
+}
+
+// Reads the line-per-benchmark layout produced by toJson
+bool BenchSuite::loadJson(const std::string& path, std::vector<BenchResult>& loaded) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t pos = line.find("\"name\": \"");
+        if (pos == std::string::npos) {
+            continue;
+        }
+        pos += 9;
+        size_t end = line.find('"', pos);
+        double accounts = 0, iterations = 0, nsPerOp = 0;
+        if (end == std::string::npos || !extractNumber(line, "accounts", accounts) ||
+            !extractNumber(line, "ns_per_op", nsPerOp)) {
+            return false;
+        }
+        extractNumber(line, "iterations", iterations);
+        loaded.push_back(BenchResult{line.substr(pos, end - pos), static_cast<size_t>(accounts),
+                                     static_cast<uint64_t>(iterations), nsPerOp, {}});
+    }
+    return true;
+}
+
+std::vector<Account> makeAccounts(size_t count, double balance) {
+    std::vector<Account> accounts;
+    accounts.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        accounts.emplace_back(std::to_string(1000000000ULL + i), "1234", balance);
+    }
+    return accounts;
+}
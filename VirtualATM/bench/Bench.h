@@ -0,0 +1,98 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+class Account;
+
+// Minimal benchmark harness for atm_bench.
+//
+// Benchmark groups register themselves with BENCH_GROUP and are called once
+// per account count. Each measurement runs its body with a growing iteration
+// count until it takes at least the minimum measuring time, and records the
+// time per operation together with any extra per-operation counters.
+struct BenchResult {
+    std::string name;
+    size_t accounts;
+    uint64_t iterations;
+    double nsPerOp;
+    std::map<std::string, double> counters;
+};
+
+class BenchSuite {
+public:
+    // Body runs the operation `iterations` times
+    using Body = std::function<void(uint64_t iterations)>;
+    using Group = std::function<void(BenchSuite& suite, size_t accounts)>;
+
+    static void registerGroup(const std::string& name, Group group);
+
+    BenchSuite(const std::string& filter, double minSeconds, const std::string& scratchDir);
+
+    // Time each measurement this many times and keep the fastest run
+    void setRepetitions(int count);
+
+    // Run every registered group at the given account count
+    void runGroups(size_t accounts);
+
+    // Time one operation; returns the stored result or nullptr if filtered out
+    BenchResult* measure(const std::string& name, size_t accounts, const Body& body);
+
+    // Whether a measurement would run (lets groups skip expensive setup)
+    bool enabled(const std::string& name) const;
+
+    // Scratch directory for file-based benchmarks
+    const std::string& getScratchDir() const;
+
+    const std::vector<BenchResult>& getResults() const;
+
+    // Serialize results, one benchmark per line
+    std::string toJson() const;
+
+    // Parse results written by toJson
+    static bool loadJson(const std::string& path, std::vector<BenchResult>& results);
+
+private:
+    std::string filter;
+    double minSeconds;
+    std::string scratchDir;
+    int repetitions;
+    std::vector<BenchResult> results;
+
+    static std::vector<std::pair<std::string, Group>>& groups();
+};
+
+// Static registration helper
+struct BenchRegistrar {
+    BenchRegistrar(const std::string& name, BenchSuite::Group group) {
+        BenchSuite::registerGroup(name, group);
+    }
+};
+
+#define BENCH_GROUP(name, function) static BenchRegistrar benchRegistrar_##function(name, function)
+
+// Keep the optimizer from discarding a computed value
+template <typename T>
+inline void doNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+// Accounts 1000000000, 1000000001, ... with PIN 1234 and the same balance,
+// the table most groups adopt into an AccountStore
+std::vector<Account> makeAccounts(size_t count, double balance);
+
+// Steady-state zero-allocation check for session postings; 0 when it
+// passes (SessionBench.cpp)
+int runAllocationCheck();
+
+#endif // BENCH_H
@@ -0,0 +1,150 @@
+/*
+ * ATM Simulator - Microbenchmark Suite
+ *
+ * Runs every registered benchmark group at account counts 10^min-exp ..
+ * 10^max-exp, optionally writes the results as JSON and compares them with
+ * a saved baseline. Exits with status 3 when any benchmark is slower than
+ * the baseline by more than the threshold. With --check-allocs it only
+ * verifies that steady-state session postings make no heap allocations
+ * (exit status 4 if they do).
+ */
+
+#include "Bench.h"
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace {
+    struct BenchOptions {
+        int minExp = 3;
+        int maxExp = 7;
+        double minSeconds = 0.2;
+        int repetitions = 1;
+        double thresholdPercent = 10.0;
+        std::string filter;
+        std::string jsonPath;
+        std::string baselinePath;
+        std::string scratchDir = "bench_data";
+        bool checkAllocs = false;
+    };
+
+    void printUsage(const char* program) {
+        std::cerr << "Usage: " << program << " [--min-exp N] [--max-exp N] [--filter NAME] [--min-time SEC]\n"
+                  << "       [--repetitions N] [--json out.json] [--compare baseline.json] [--threshold PERCENT]\n"
+                  << "       [--scratch DIR]\n"
+                  << "       " << program << " --check-allocs" << std::endl;
+    }
+
+    bool parseOptions(int argc, char* argv[], BenchOptions& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--check-allocs") {
+                options.checkAllocs = true;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                return false;
+            }
+            if (arg == "--min-exp") {
+                options.minExp = std::stoi(argv[++i]);
+            } else if (arg == "--max-exp") {
+                options.maxExp = std::stoi(argv[++i]);
+            } else if (arg == "--filter") {
+                options.filter = argv[++i];
+            } else if (arg == "--min-time") {
+                options.minSeconds = std::stod(argv[++i]);
+            } else if (arg == "--repetitions") {
+                options.repetitions = std::stoi(argv[++i]);
+            } else if (arg == "--json") {
+                options.jsonPath = argv[++i];
+            } else if (arg == "--compare") {
+                options.baselinePath = argv[++i];
+            } else if (arg == "--threshold") {
+                options.thresholdPercent = std::stod(argv[++i]);
+            } else if (arg == "--scratch") {
+                options.scratchDir = argv[++i];
+            } else {
+                return false;
+            }
+        }
+        return options.minExp >= 0 && options.minExp <= options.maxExp && options.maxExp <= 9;
+    }
+
+    // Print a side-by-side table; returns the number of regressions
+    int compareWithBaseline(const std::vector<BenchResult>& current, const std::vector<BenchResult>& baseline,
+                            double thresholdPercent) {
+        int regressions = 0;
+        int compared = 0;
+        double logRatioSum = 0;
+        std::printf("\n%-28s %10s %14s %14s %9s\n", "Benchmark", "Accounts", "Baseline ns", "Current ns", "Change");
+        for (const auto& result : current) {
+            for (const auto& base : baseline) {
+                if (base.name != result.name || base.accounts != result.accounts || base.nsPerOp <= 0) {
+                    continue;
+                }
+                double change = (result.nsPerOp - base.nsPerOp) / base.nsPerOp * 100.0;
+                bool regressed = change > thresholdPercent;
+                regressions += regressed ? 1 : 0;
+                if (result.nsPerOp > 0) {
+                    logRatioSum += std::log(base.nsPerOp / result.nsPerOp);
+                    ++compared;
+                }
+                std::printf("%-28s %10zu %14.1f %14.1f %+8.1f%%%s\n", result.name.c_str(), result.accounts,
+                            base.nsPerOp, result.nsPerOp, change, regressed ? "  REGRESSION" : "");
+                break;
+            }
+        }
+        if (compared > 0) {
+            std::printf("\nGeometric mean speedup over %d benchmarks: %.3fx\n", compared,
+                        std::exp(logRatioSum / compared));
+        }
+        return regressions;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    try {
+        if (!parseOptions(argc, argv, options)) {
+            printUsage(argv[0]);
+            return 1;
+        }
+    } catch (const std::exception&) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::filesystem::create_directories(options.scratchDir);
+    if (options.checkAllocs) {
+        return runAllocationCheck();
+    }
+
+    BenchSuite suite(options.filter, options.minSeconds, options.scratchDir);
+    suite.setRepetitions(options.repetitions);
+    for (int exp = options.minExp; exp <= options.maxExp; ++exp) {
+        suite.runGroups(static_cast<size_t>(std::llround(std::pow(10.0, exp))));
+    }
+
+    if (!options.jsonPath.empty()) {
+        std::ofstream json(options.jsonPath);
+        json << suite.toJson();
+        std::cout << "Results written to " << options.jsonPath << std::endl;
+    }
+
+    if (!options.baselinePath.empty()) {
+        std::vector<BenchResult> baseline;
+        if (!BenchSuite::loadJson(options.baselinePath, baseline)) {
+            std::cerr << "Error: Could not read baseline " << options.baselinePath << std::endl;
+            return 1;
+        }
+        int regressions = compareWithBaseline(suite.getResults(), baseline, options.thresholdPercent);
+        if (regressions > 0) {
+            std::printf("\n%d benchmark(s) regressed by more than %.1f%%\n", regressions, options.thresholdPercent);
+            return 3;
+        }
+    }
+    return 0;
+}
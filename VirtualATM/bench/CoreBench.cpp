@@ -0,0 +1,133 @@
+// Hot paths of the account model, file storage and transactions
+#include "Bench.h"
+#include "Account.h"
+#include "FileManager.h"
+#include "Transaction.h"
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    const size_t PROBE_COUNT = 4096;
+
+    // Scattered numbers, varied PINs and balances
+    std::vector<Account> makeVariedAccounts(size_t count) {
+        std::mt19937_64 rng(count);
+        std::uniform_real_distribution<double> balance(0.0, 50000.0);
+        std::vector<Account> accounts;
+        accounts.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            accounts.emplace_back(std::to_string(1000000000ULL + i * 7919ULL % 1000000000ULL),
+                                  std::to_string(1000 + i % 9000), balance(rng));
+        }
+        return accounts;
+    }
+
+    // Random account positions, precomputed so the RNG stays out of the loop
+    std::vector<size_t> makeProbes(size_t count) {
+        std::mt19937_64 rng(count * 31);
+        std::uniform_int_distribution<size_t> pick(0, count - 1);
+        std::vector<size_t> probes(PROBE_COUNT);
+        for (auto& probe : probes) {
+            probe = pick(rng);
+        }
+        return probes;
+    }
+
+    void runCoreBenchmarks(BenchSuite& suite, size_t n) {
+        std::vector<Account> accounts = makeVariedAccounts(n);
+        std::vector<size_t> probes = makeProbes(n);
+        const std::string path = suite.getScratchDir() + "/accounts-" + std::to_string(n) + ".txt";
+
+        std::vector<std::string> lines;
+        if (suite.enabled("account_from_string")) {
+            lines.reserve(n);
+            for (const auto& account : accounts) {
+                lines.push_back(account.toString());
+            }
+        }
+
+        suite.measure("account_from_string", n, [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                Account parsed = Account::fromString(lines[i % n]);
+                doNotOptimize(parsed);
+            }
+        });
+        lines.clear();
+        lines.shrink_to_fit();
+
+        suite.measure("account_to_string", n, [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                std::string line = accounts[i % n].toString();
+                doNotOptimize(line);
+            }
+        });
+
+        std::vector<std::string> keys;
+        if (suite.enabled("find_account")) {
+            keys.reserve(PROBE_COUNT);
+            for (size_t probe : probes) {
+                keys.push_back(accounts[probe].getAccountNumber());
+            }
+        }
+        suite.measure("find_account", n, [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                Account* found = FileManager::findAccount(accounts, keys[i % PROBE_COUNT]);
+                doNotOptimize(found);
+            }
+        });
+
+        if (suite.enabled("save_accounts") || suite.enabled("load_accounts") || suite.enabled("update_account")) {
+            FileManager::saveAccounts(accounts, path);
+        }
+
+        if (BenchResult* result = suite.measure("save_accounts", n, [&](uint64_t iterations) {
+                for (uint64_t i = 0; i < iterations; ++i) {
+                    FileManager::saveAccounts(accounts, path);
+                }
+            })) {
+            result->counters["ns_per_account"] = result->nsPerOp / static_cast<double>(n);
+        }
+
+        if (BenchResult* result = suite.measure("load_accounts", n, [&](uint64_t iterations) {
+                for (uint64_t i = 0; i < iterations; ++i) {
+                    std::vector<Account> loaded = FileManager::loadAccounts(path);
+                    doNotOptimize(loaded);
+                }
+            })) {
+            result->counters["ns_per_account"] = result->nsPerOp / static_cast<double>(n);
+        }
+
+        suite.measure("update_account", n, [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                FileManager::updateAccount(accounts[probes[i % PROBE_COUNT]], path);
+            }
+        });
+        std::remove(path.c_str());
+
+        suite.measure("withdrawal_process", n, [&](uint64_t iterations) {
+            Withdrawal withdrawal(0.01);
+            for (uint64_t i = 0; i < iterations; ++i) {
+                bool ok = withdrawal.process(accounts[probes[i % PROBE_COUNT]]);
+                doNotOptimize(ok);
+            }
+        });
+
+        suite.measure("deposit_process", n, [&](uint64_t iterations) {
+            Deposit deposit(0.01);
+            for (uint64_t i = 0; i < iterations; ++i) {
+                bool ok = deposit.process(accounts[probes[i % PROBE_COUNT]]);
+                doNotOptimize(ok);
+            }
+        });
+
+        suite.measure("transaction_construct", n, [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                Withdrawal withdrawal(20.0);
+                doNotOptimize(withdrawal);
+            }
+        });
+    }
+}
+
+BENCH_GROUP("core", runCoreBenchmarks);
@@ -0,0 +1,62 @@
+// Cost of planning note mixes across cassette configurations
+#include "Bench.h"
+#include "CashDispenser.h"
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    const size_t AMOUNT_COUNT = 4096;
+
+    struct Configuration {
+        const char* name;
+        const char* cassettes;
+    };
+
+    const Configuration CONFIGURATIONS[] = {
+        {"dispense_plan_full", "5:500,10:500,20:2000,50:1000,100:500"},
+        {"dispense_plan_scarce_100s", "5:500,10:500,20:2000,50:1000,100:20:500"},
+        {"dispense_plan_short_20s", "5:500,10:500,20:3:2000,50:1000,100:500"},
+        {"dispense_plan_20s_only", "20:2000"},
+    };
+
+    void runDispenseBenchmarks(BenchSuite& suite, size_t n) {
+        // Whole dollars a customer might key in: mostly round, some not
+        std::mt19937_64 rng(41);
+        std::uniform_int_distribution<int> dollars(1, 100);
+        std::vector<int64_t> amounts(AMOUNT_COUNT);
+        for (auto& amount : amounts) {
+            amount = static_cast<int64_t>(dollars(rng)) * (rng() % 4 == 0 ? 5 : 20) * 100;
+        }
+
+        for (const Configuration& configuration : CONFIGURATIONS) {
+            if (!suite.enabled(configuration.name)) {
+                continue;
+            }
+            std::vector<Cassette> cassettes;
+            std::string error;
+            CashDispenser dispenser;
+            if (!CashDispenser::parse(configuration.cassettes, cassettes, error) ||
+                !dispenser.configure(cassettes, error)) {
+                std::fprintf(stderr, "dispense: %s\n", error.c_str());
+                return;
+            }
+            uint64_t planned = 0, total = 0;
+            BenchResult* result = suite.measure(configuration.name, n, [&](uint64_t iterations) {
+                for (uint64_t i = 0; i < iterations; ++i) {
+                    DispensePlan plan = {};
+                    bool ok = dispenser.plan(amounts[i % AMOUNT_COUNT], plan);
+                    planned += ok;
+                    doNotOptimize(plan.noteCount);
+                }
+                total += iterations;
+            });
+            if (result && total > 0) {
+                result->counters["payable_fraction"] = static_cast<double>(planned) / static_cast<double>(total);
+            }
+        }
+    }
+}
+
+BENCH_GROUP("dispense", runDispenseBenchmarks);
@@ -0,0 +1,62 @@
+// Account lookups for numbers that do not exist (card testing) against
+// the Bloom filter alone and through AccountStore::find
+#include "Bench.h"
+#include "AccountFilter.h"
+#include "AccountStore.h"
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    const size_t PROBE_COUNT = 4096;
+    const size_t FALSE_POSITIVE_PROBES = 1000000;
+
+    void runFilterBenchmarks(BenchSuite& suite, size_t n) {
+        if (!suite.enabled("filter_probe_miss") && !suite.enabled("store_find_miss") &&
+            !suite.enabled("store_find_hit")) {
+            return;
+        }
+        AccountStore store;
+        store.adopt(makeAccounts(n, 100.0), "");
+        const AccountFilter& filter = store.getFilter();
+
+        // Unknown numbers have the same length as real ones
+        std::mt19937_64 rng(n);
+        std::uniform_int_distribution<uint64_t> unknown(2000000000ULL, 9999999999ULL);
+        std::uniform_int_distribution<size_t> known(0, n - 1);
+        std::vector<std::string> misses(PROBE_COUNT);
+        std::vector<std::string> hits(PROBE_COUNT);
+        for (size_t i = 0; i < PROBE_COUNT; ++i) {
+            misses[i] = std::to_string(unknown(rng));
+            hits[i] = std::to_string(1000000000ULL + known(rng));
+        }
+
+        BenchResult* probe = suite.measure("filter_probe_miss", n, [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                doNotOptimize(filter.mayContain(misses[i % PROBE_COUNT]));
+            }
+        });
+        if (probe) {
+            size_t passed = 0;
+            for (size_t i = 0; i < FALSE_POSITIVE_PROBES; ++i) {
+                passed += filter.mayContain(std::to_string(unknown(rng))) ? 1 : 0;
+            }
+            probe->counters["false_positive_rate"] = static_cast<double>(passed) / FALSE_POSITIVE_PROBES;
+            probe->counters["bits_per_account"] = 8.0 * filter.getBytes() / n;
+        }
+
+        suite.measure("store_find_miss", n, [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                doNotOptimize(store.find(misses[i % PROBE_COUNT]));
+            }
+        });
+
+        suite.measure("store_find_hit", n, [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                doNotOptimize(store.find(hits[i % PROBE_COUNT]));
+            }
+        });
+    }
+}
+
+BENCH_GROUP("filter", runFilterBenchmarks);
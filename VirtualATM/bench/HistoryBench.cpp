@@ -0,0 +1,122 @@
+// Filtered history queries on an account with 100k entries
+#include "Bench.h"
+#include "AccountKey.h"
+#include "HistoryStore.h"
+#include "Ledger.h"
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    const size_t HOT_ENTRIES = 100000;
+    const size_t BACKGROUND_ENTRIES = 4;
+    const int64_t DAY_US = 86400LL * 1000000LL;
+    const int64_t START_US = 1735689600LL * 1000000LL; // 2025-01-01
+    const int64_t SPAN_US = 365 * DAY_US;
+
+    // n background accounts plus one busy account spread over a year
+    bool writeLedger(const std::string& path, size_t n, uint64_t hotKey) {
+        LedgerWriter writer;
+        if (!writer.open(path, true)) {
+            return false;
+        }
+        std::mt19937_64 rng(n);
+        std::uniform_int_distribution<int> type(1, 5);
+        std::uniform_int_distribution<int64_t> cents(100, 100000);
+        std::uniform_int_distribution<int64_t> time(0, SPAN_US - 1);
+        LedgerEntry entry = {};
+        for (size_t i = 0; i < n; ++i) {
+            entry.accountKey = AccountKey::encode(std::to_string(1000000000ULL + i));
+            for (size_t j = 0; j < BACKGROUND_ENTRIES; ++j) {
+                entry.timestampUs = START_US + time(rng);
+                entry.type = static_cast<uint8_t>(type(rng));
+                entry.amountCents = cents(rng);
+                writer.append(entry);
+            }
+        }
+        entry.accountKey = hotKey;
+        for (size_t j = 0; j < HOT_ENTRIES; ++j) {
+            entry.timestampUs = START_US + SPAN_US / HOT_ENTRIES * j;
+            entry.type = static_cast<uint8_t>(type(rng));
+            entry.amountCents = cents(rng);
+            writer.append(entry);
+        }
+        return writer.flush();
+    }
+
+    void measureQuery(BenchSuite& suite, const std::string& name, size_t n, const HistoryStore& store,
+                      uint64_t key, const HistoryFilter& filter) {
+        std::vector<LedgerEntry> out;
+        out.reserve(HOT_ENTRIES);
+        HistoryQueryStats stats;
+        BenchResult* result = suite.measure(name, n, [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                out.clear();
+                doNotOptimize(store.query(key, filter, out));
+            }
+        });
+        if (result) {
+            store.query(key, filter, out, &stats);
+            result->counters["entries_per_op"] = static_cast<double>(out.size());
+            result->counters["blocks_read"] = static_cast<double>(stats.blocksScanned);
+        }
+    }
+
+    void runHistoryBenchmarks(BenchSuite& suite, size_t n) {
+        const char* names[] = {"history_week_withdrawals_over_500", "history_month_deposits", "history_last_10",
+                               "history_year_over_990", "history_all_entries"};
+        bool any = false;
+        for (const char* name : names) {
+            any = any || suite.enabled(name);
+        }
+        if (n > 1000000 || !any) {
+            return;
+        }
+        const std::string dir = suite.getScratchDir() + "/history-" + std::to_string(n);
+        const std::string ledgerPath = dir + ".ledger";
+        const uint64_t hotKey = AccountKey::encode("9999999999");
+        HistoryBuildConfig config;
+        config.ledgerPath = ledgerPath;
+        config.outputDir = dir;
+        HistoryBuildStats built;
+        HistoryStore store;
+        if (!writeLedger(ledgerPath, n, hotKey) || !HistoryStore::build(config, built) || !store.open(dir)) {
+            std::fprintf(stderr, "history: could not build %s\n", dir.c_str());
+            return;
+        }
+
+        // The last week of the year
+        HistoryFilter week;
+        week.typeMask = HistoryFilter::typeMaskFor("WITHDRAWAL");
+        week.minCents = 50000;
+        week.fromUs = START_US + SPAN_US - 7 * DAY_US;
+        measureQuery(suite, "history_week_withdrawals_over_500", n, store, hotKey, week);
+
+        HistoryFilter month;
+        month.typeMask = HistoryFilter::typeMaskFor("DEPOSIT");
+        month.fromUs = START_US + 59 * DAY_US; // March
+        month.toUs = START_US + 90 * DAY_US;
+        measureQuery(suite, "history_month_deposits", n, store, hotKey, month);
+
+        HistoryFilter recent;
+        recent.newestFirst = true;
+        recent.limit = 10;
+        measureQuery(suite, "history_last_10", n, store, hotKey, recent);
+
+        HistoryFilter large;
+        large.minCents = 99000;
+        measureQuery(suite, "history_year_over_990", n, store, hotKey, large);
+
+        HistoryFilter all;
+        measureQuery(suite, "history_all_entries", n, store, hotKey, all);
+
+        store.close();
+        std::error_code error;
+        std::filesystem::remove_all(dir, error);
+        std::filesystem::remove(ledgerPath, error);
+    }
+}
+
+BENCH_GROUP("history", runHistoryBenchmarks);
@@ -0,0 +1,86 @@
+// Cost of the metrics registry on the posting path
+#include "Bench.h"
+#include "AccountStore.h"
+#include "Metrics.h"
+#include "Transaction.h"
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    const size_t PROBE_COUNT = 4096;
+
+    // A full posting as a session performs it: build the transaction, then
+    // apply it under the account lock
+    void postMix(AccountStore& store, const std::vector<size_t>& probes, uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Account& account = store.at(probes[i % PROBE_COUNT]);
+            bool ok;
+            switch (i % 3) {
+                case 0: { Withdrawal withdrawal(0.01); ok = store.apply(withdrawal, account); break; }
+                case 1: { Deposit deposit(0.01); ok = store.apply(deposit, account); break; }
+                default: { BalanceInquiry inquiry; ok = store.apply(inquiry, account); break; }
+            }
+            doNotOptimize(ok);
+        }
+    }
+
+    void runMetricsBenchmarks(BenchSuite& suite, size_t n) {
+        if (!suite.enabled("posting_metrics_off") && !suite.enabled("posting_metrics_on")) {
+            return;
+        }
+
+        AccountStore store;
+        store.adopt(makeAccounts(n, 1000.0), suite.getScratchDir() + "/metrics-unused.txt");
+
+        std::mt19937_64 rng(n);
+        std::uniform_int_distribution<size_t> pick(0, n - 1);
+        std::vector<size_t> probes(PROBE_COUNT);
+        for (auto& probe : probes) {
+            probe = pick(rng);
+        }
+
+        MetricsRegistry& registry = MetricsRegistry::instance();
+        AtmMetrics::get();
+        bool wasEnabled = registry.isEnabled();
+
+        // Warm the accounts and the allocator before either side is timed
+        postMix(store, probes, 20000);
+
+        registry.setEnabled(false);
+        BenchResult* off = suite.measure("posting_metrics_off", n, [&](uint64_t iterations) {
+            postMix(store, probes, iterations);
+        });
+        double offNs = off ? off->nsPerOp : 0.0;
+
+        registry.setEnabled(true);
+        BenchResult* on = suite.measure("posting_metrics_on", n, [&](uint64_t iterations) {
+            postMix(store, probes, iterations);
+        });
+        // Whole-posting runs drift by more than the effect being measured,
+        // so time the instrumentation on its own and relate it to a posting
+        const AtmMetrics& metrics = AtmMetrics::get();
+        BenchResult* record = suite.measure("metrics_record", n, [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                int kind = static_cast<int>(i % 3);
+                {
+                    ScopedTimer timer(metrics.transactionDuration[kind], AtmMetrics::TRANSACTION_SAMPLE_INTERVAL);
+                }
+                registry.add(metrics.transactionsSucceeded[kind]);
+            }
+        });
+        if (record && offNs > 0.0) {
+            double overhead = record->nsPerOp / offNs * 100.0;
+            record->counters["overhead_percent"] = overhead;
+            if (on) {
+                on->counters["overhead_percent"] = (on->nsPerOp - offNs) / offNs * 100.0;
+            }
+            std::printf("  metrics overhead per posting: %.2f%% (%.1f ns of %.1f ns)\n", overhead, record->nsPerOp,
+                        offNs);
+        }
+        registry.setEnabled(wasEnabled);
+    }
+}
+
+BENCH_GROUP("metrics", runMetricsBenchmarks);
@@ -0,0 +1,94 @@
+// Posting and saving with the journal and accounts file written in place
+// (blocking) or through the background I/O backend; times are what the
+// posting or saving thread spends
+#include "Bench.h"
+#include "AccountStore.h"
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+    enum class Persistence { Blocking, Background, Durable };
+
+    std::unique_ptr<AccountStore> makeStore(const std::string& dataPath, size_t n, Persistence persistence) {
+        std::unique_ptr<AccountStore> store(new AccountStore());
+        store->adopt(makeAccounts(n, 100.0), dataPath);
+        std::string error;
+        if (persistence != Persistence::Blocking &&
+            !store->persistAsync("auto", persistence == Persistence::Durable ? JournalAck::Durable : JournalAck::Async,
+                                 error)) {
+            std::fprintf(stderr, "persist: %s\n", error.c_str());
+            return nullptr;
+        }
+        std::remove((dataPath + ".ledger").c_str());
+        if (!store->openJournal(dataPath + ".ledger")) {
+            std::fprintf(stderr, "persist: could not open %s.ledger\n", dataPath.c_str());
+            return nullptr;
+        }
+        return store;
+    }
+
+    void measurePosting(BenchSuite& suite, const std::string& name, const std::string& dataPath, size_t n,
+                        Persistence persistence) {
+        if (!suite.enabled(name)) {
+            return;
+        }
+        std::unique_ptr<AccountStore> store = makeStore(dataPath, n, persistence);
+        if (!store) {
+            return;
+        }
+        BenchResult* result = suite.measure(name, n, [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                Deposit deposit(1.0);
+                doNotOptimize(store->apply(deposit, store->at(i % n)));
+            }
+        });
+        if (result && store->getAsyncJournal()) {
+            AsyncJournal* journal = store->getAsyncJournal();
+            journal->flush();
+            result->counters["entries_per_batch"] =
+                journal->getBatches() ? static_cast<double>(journal->getDurable()) / journal->getBatches() : 0.0;
+        }
+    }
+
+    void measureSaving(BenchSuite& suite, const std::string& name, const std::string& dataPath, size_t n,
+                       Persistence persistence) {
+        if (!suite.enabled(name)) {
+            return;
+        }
+        std::unique_ptr<AccountStore> store = makeStore(dataPath, n, persistence);
+        if (!store) {
+            return;
+        }
+        BenchResult* result = suite.measure(name, n, [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                doNotOptimize(store->save());
+            }
+        });
+        if (result && store->getSaver()) {
+            AsyncSaver* saver = store->getSaver();
+            saver->wait();
+            uint64_t total = saver->getSaved() + saver->getSuperseded();
+            result->counters["superseded_fraction"] =
+                total ? static_cast<double>(saver->getSuperseded()) / total : 0.0;
+        }
+    }
+
+    void runPersistBenchmarks(BenchSuite& suite, size_t n) {
+        const std::string dataPath = suite.getScratchDir() + "/persist-" + std::to_string(n) + ".txt";
+        measurePosting(suite, "persist_post_blocking", dataPath, n, Persistence::Blocking);
+        measurePosting(suite, "persist_post_background", dataPath, n, Persistence::Background);
+        measurePosting(suite, "persist_post_durable", dataPath, n, Persistence::Durable);
+        measureSaving(suite, "persist_save_blocking", dataPath, n, Persistence::Blocking);
+        measureSaving(suite, "persist_save_background", dataPath, n, Persistence::Background);
+
+        std::error_code error;
+        for (const char* suffix : {"", ".ledger", ".bloom", ".tmp"}) {
+            std::filesystem::remove(dataPath + suffix, error);
+        }
+    }
+}
+
+BENCH_GROUP("persist", runPersistBenchmarks);
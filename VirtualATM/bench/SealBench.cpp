@@ -0,0 +1,101 @@
+// Sealed ledger segments: decoding a block, and one account's entries
+// read back through the block index
+#include "Bench.h"
+#include "AccountKey.h"
+#include "Ledger.h"
+#include "SealedSegment.h"
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    const size_t ENTRIES_PER_ACCOUNT = 4;
+    const size_t PROBE_COUNT = 4096;
+    const int64_t DAY_US = 86400LL * 1000000LL;
+    const int64_t START_US = 1735689600LL * 1000000LL; // 2025-01-01
+
+    // A month of postings with ATM-like amounts and a few dozen terminals
+    bool writeLedger(const std::string& path, size_t n) {
+        LedgerWriter writer;
+        if (!writer.open(path, true)) {
+            return false;
+        }
+        std::mt19937_64 rng(n);
+        std::uniform_int_distribution<int> type(1, 5);
+        std::uniform_int_distribution<int64_t> notes(1, 50);
+        std::uniform_int_distribution<int64_t> time(0, 30 * DAY_US - 1);
+        std::uniform_int_distribution<uint32_t> terminal(1, 48);
+        LedgerEntry entry = {};
+        for (size_t i = 0; i < n; ++i) {
+            entry.accountKey = AccountKey::encode(std::to_string(1000000000ULL + i));
+            for (size_t j = 0; j < ENTRIES_PER_ACCOUNT; ++j) {
+                entry.timestampUs = START_US + time(rng);
+                entry.type = static_cast<uint8_t>(type(rng));
+                entry.amountCents = notes(rng) * 2000;
+                entry.terminal = terminal(rng);
+                writer.append(entry);
+            }
+        }
+        return writer.flush();
+    }
+
+    void runSealBenchmarks(BenchSuite& suite, size_t n) {
+        if (n > 1000000 || (!suite.enabled("seal_decode_block") && !suite.enabled("seal_query_account"))) {
+            return;
+        }
+        const std::string segmentPath = suite.getScratchDir() + "/sealed-" + std::to_string(n) + ".seg";
+        const std::string ledgerPath = segmentPath + ".ledger";
+        SealConfig config;
+        config.ledgerPath = ledgerPath;
+        config.outputPath = segmentPath;
+        SealStats sealed;
+        SealedSegment segment;
+        if (!writeLedger(ledgerPath, n) || !SealedSegment::seal(config, sealed) || !segment.open(segmentPath)) {
+            std::fprintf(stderr, "seal: could not seal %s\n", segmentPath.c_str());
+            return;
+        }
+        double ratio = static_cast<double>(sealed.entries * sizeof(LedgerEntry)) / sealed.sealedBytes;
+
+        std::vector<LedgerEntry> out;
+        out.reserve(SealedSegment::BLOCK_ENTRIES);
+        BenchResult* decode = suite.measure("seal_decode_block", n, [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                doNotOptimize(segment.decodeBlock(i % segment.getBlocks(), out));
+            }
+        });
+        if (decode) {
+            decode->counters["entries_per_op"] = static_cast<double>(sealed.entries) / sealed.blocks;
+            decode->counters["compression_ratio"] = ratio;
+        }
+
+        std::mt19937_64 rng(n);
+        std::uniform_int_distribution<size_t> pick(0, n - 1);
+        std::vector<uint64_t> probes(PROBE_COUNT);
+        for (uint64_t& probe : probes) {
+            probe = AccountKey::encode(std::to_string(1000000000ULL + pick(rng)));
+        }
+        BenchResult* query = suite.measure("seal_query_account", n, [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                out.clear();
+                doNotOptimize(segment.query(probes[i % PROBE_COUNT], INT64_MIN, INT64_MAX, out));
+            }
+        });
+        if (query) {
+            SegmentReadStats stats;
+            for (uint64_t probe : probes) {
+                segment.query(probe, INT64_MIN, INT64_MAX, out, &stats);
+            }
+            query->counters["blocks_per_op"] = static_cast<double>(stats.blocksDecoded) / PROBE_COUNT;
+        }
+
+        segment.close();
+        std::error_code error;
+        std::filesystem::remove(segmentPath, error);
+        std::filesystem::remove(ledgerPath, error);
+    }
+}
+
+BENCH_GROUP("seal", runSealBenchmarks);
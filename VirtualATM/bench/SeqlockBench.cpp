@@ -0,0 +1,130 @@
+// Balance reads against hot accounts under a heavy posting load: lock-free
+// seqlock snapshots next to reads that take the account's lock
+#include "Bench.h"
+#include "AccountStore.h"
+#include "Transaction.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    const size_t HOT_ACCOUNTS = 16;
+    const unsigned WRITERS = 2;
+
+    // Withdraw and deposit on the hot accounts until stopped; with `locks`
+    // the writers also hold the account's reader lock while posting
+    class PostingLoad {
+    public:
+        PostingLoad(AccountStore& store, std::mutex* locks) : stopping(false), postings(0) {
+            for (unsigned id = 0; id < WRITERS; ++id) {
+                writers.emplace_back([this, &store, locks, id] {
+                    uint64_t count = 0;
+                    for (size_t i = id; !stopping.load(std::memory_order_relaxed); ++i, ++count) {
+                        size_t hot = i % HOT_ACCOUNTS;
+                        Account& account = store.at(hot);
+                        std::unique_lock<std::mutex> lock;
+                        if (locks) {
+                            lock = std::unique_lock<std::mutex>(locks[hot]);
+                        }
+                        if (count % 2 == 0) {
+                            Withdrawal withdrawal(20.0);
+                            store.apply(withdrawal, account);
+                        } else {
+                            Deposit deposit(20.0);
+                            store.apply(deposit, account);
+                        }
+                    }
+                    postings.fetch_add(count);
+                });
+            }
+        }
+
+        uint64_t stop() {
+            stopping.store(true);
+            for (auto& writer : writers) {
+                writer.join();
+            }
+            return postings.load();
+        }
+
+    private:
+        std::atomic<bool> stopping;
+        std::atomic<uint64_t> postings;
+        std::vector<std::thread> writers;
+    };
+
+    // iterations reads split over `readers` threads; read(hot) returns a balance
+    template <typename Read>
+    void readInParallel(unsigned readers, uint64_t iterations, Read read) {
+        std::vector<std::thread> threads;
+        for (unsigned id = 0; id < readers; ++id) {
+            uint64_t share = iterations / readers + (id < iterations % readers ? 1 : 0);
+            threads.emplace_back([share, id, &read] {
+                double sum = 0.0;
+                for (uint64_t i = 0; i < share; ++i) {
+                    sum += read((i + id) % HOT_ACCOUNTS);
+                }
+                doNotOptimize(sum);
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    void runSeqlockBenchmarks(BenchSuite& suite, size_t n) {
+        std::vector<unsigned> readerCounts;
+        unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned readers = 1; readers < cores; readers *= 2) {
+            readerCounts.push_back(readers);
+        }
+        readerCounts.push_back(cores);
+
+        bool any = false;
+        for (unsigned readers : readerCounts) {
+            any = any || suite.enabled("balance_read_seqlock_r" + std::to_string(readers)) ||
+                  suite.enabled("balance_read_locked_r" + std::to_string(readers));
+        }
+        if (!any || n < HOT_ACCOUNTS) {
+            return;
+        }
+        AccountStore store;
+        store.adopt(makeAccounts(n, 1.0e9), "");
+
+        for (int locked = 0; locked < 2; ++locked) {
+            std::unique_ptr<std::mutex[]> locks(locked ? new std::mutex[HOT_ACCOUNTS] : nullptr);
+            for (unsigned readers : readerCounts) {
+                std::string name = std::string(locked ? "balance_read_locked_r" : "balance_read_seqlock_r") +
+                                   std::to_string(readers);
+                if (!suite.enabled(name)) {
+                    continue;
+                }
+                PostingLoad load(store, locks.get());
+                uint64_t reads = 0;
+                BenchResult* result = suite.measure(name, n, [&](uint64_t iterations) {
+                    if (locked) {
+                        readInParallel(readers, iterations, [&](size_t hot) {
+                            std::lock_guard<std::mutex> lock(locks[hot]);
+                            return store.at(hot).getBalance();
+                        });
+                    } else {
+                        readInParallel(readers, iterations, [&](size_t hot) {
+                            return store.at(hot).snapshot().balance;
+                        });
+                    }
+                    reads += iterations;
+                });
+                uint64_t postings = load.stop();
+                if (result && reads > 0) {
+                    result->counters["postings_per_read"] = static_cast<double>(postings) / static_cast<double>(reads);
+                }
+            }
+        }
+    }
+}
+
+BENCH_GROUP("seqlock", runSeqlockBenchmarks);
@@ -0,0 +1,93 @@
+// Postings as an ATM session performs them, and the zero-allocation check
+#include "Bench.h"
+#include "AccountStore.h"
+#include "AllocCounter.h"
+#include "Metrics.h"
+#include "SessionHistory.h"
+#include "Transaction.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+    const size_t PROBE_STRIDE = 7919;
+
+    enum Posting { WITHDRAWAL = 0, DEPOSIT, INQUIRY, POSTING_COUNT };
+    const char* const POSTING_NAMES[POSTING_COUNT] = {"session_withdrawal", "session_deposit", "session_inquiry"};
+
+    void fillStore(AccountStore& store, size_t count, const std::string& path) {
+        store.adopt(makeAccounts(count, 1000000.0), path);
+    }
+
+    // The same steps as ATM::performWithdrawal/Deposit/BalanceInquiry minus
+    // the screen: record the transaction in the session history, then post it.
+    // A full history is cleared the way logout does.
+    bool post(Posting posting, AccountStore& store, SessionHistory& history, Account& account) {
+        if (history.size() == SessionHistory::RESERVED_ENTRIES) {
+            history.clear();
+        }
+        switch (posting) {
+            case WITHDRAWAL: return store.apply(history.record<Withdrawal>(0.01), account);
+            case DEPOSIT: return store.apply(history.record<Deposit>(0.01), account);
+            default: return store.apply(history.record<BalanceInquiry>(), account);
+        }
+    }
+
+    void runSessionBenchmarks(BenchSuite& suite, size_t n) {
+        AccountStore store;
+        fillStore(store, n, suite.getScratchDir() + "/session-unused.txt");
+        SessionHistory history;
+
+        for (int posting = 0; posting < POSTING_COUNT; ++posting) {
+            suite.measure(POSTING_NAMES[posting], n, [&](uint64_t iterations) {
+                for (uint64_t i = 0; i < iterations; ++i) {
+                    bool ok = post(static_cast<Posting>(posting), store, history, store.at(i * PROBE_STRIDE % n));
+                    doNotOptimize(ok);
+                }
+            });
+        }
+    }
+}
+
+BENCH_GROUP("session", runSessionBenchmarks);
+
+// After a warm-up, withdraw/deposit/inquiry postings must not allocate.
+// Registered with CTest as session_allocations. It covers what a session
+// does per posting from the history record through AccountStore::apply
+// (locking, seqlock, metrics); it does not cover the console around it:
+// login, menu and amount input, the Renderer frame, and the accounts file
+// save ATM::saveAccountData makes after each withdrawal and deposit, which
+// formats the whole table and allocates by design.
+int runAllocationCheck() {
+    if (!AllocCounter::isCounting()) {
+        std::printf("Allocation counting is not compiled in (configure with -DATM_COUNT_ALLOCS=ON)\n");
+        return 2;
+    }
+
+    const size_t accounts = 1000;
+    const uint64_t postings = 10000;
+    AccountStore store;
+    fillStore(store, accounts, "bench_data/session-unused.txt");
+    SessionHistory history;
+
+    int failures = 0;
+    for (int posting = 0; posting < POSTING_COUNT; ++posting) {
+        Posting kind = static_cast<Posting>(posting);
+        // Warm-up: metric shards, RNG and other first-use state
+        for (uint64_t i = 0; i < 100; ++i) {
+            post(kind, store, history, store.at(i % accounts));
+        }
+
+        AllocScope scope;
+        for (uint64_t i = 0; i < postings; ++i) {
+            post(kind, store, history, store.at(i * PROBE_STRIDE % accounts));
+        }
+        AllocStats used = scope.elapsed();
+        bool ok = used.allocations == 0;
+        failures += ok ? 0 : 1;
+        std::printf("%-28s %8llu postings %8llu allocations %10llu bytes  %s\n", POSTING_NAMES[posting],
+                    static_cast<unsigned long long>(postings), static_cast<unsigned long long>(used.allocations),
+                    static_cast<unsigned long long>(used.bytes), ok ? "ok" : "FAILED");
+    }
+    return failures == 0 ? 0 : 4;
+}
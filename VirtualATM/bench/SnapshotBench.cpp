@@ -0,0 +1,127 @@
+// Point-in-time snapshots: the cost of opening one, and of postings while
+// snapshots are pinned or a scan is running
+#include "Bench.h"
+#include "AccountStore.h"
+#include "Ledger.h"
+#include "Transaction.h"
+#include <atomic>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    const size_t PROBE_COUNT = 4096;
+    const uint64_t POSTINGS_PER_SNAPSHOT = 4096;
+
+    // Total of every balance as of the snapshot, in cents
+    int64_t totalCents(const StoreSnapshot& snapshot) {
+        int64_t total = 0;
+        for (size_t i = 0; i < snapshot.size(); ++i) {
+            total += Ledger::toCents(snapshot.read(i).balance);
+        }
+        return total;
+    }
+
+    // Opens snapshots back to back and checks each one's total against the
+    // total transfers preserve
+    class Scanner {
+    public:
+        Scanner(AccountStore& store, int64_t expected) : stopping(false), scans(0), inconsistent(0) {
+            thread = std::thread([this, &store, expected] {
+                while (!stopping.load(std::memory_order_relaxed)) {
+                    StoreSnapshot snapshot = store.openSnapshot();
+                    if (totalCents(snapshot) != expected) {
+                        inconsistent.fetch_add(1);
+                    }
+                    scans.fetch_add(1);
+                }
+            });
+        }
+
+        void stop() {
+            stopping.store(true);
+            thread.join();
+        }
+
+        std::atomic<bool> stopping;
+        std::atomic<uint64_t> scans;
+        std::atomic<uint64_t> inconsistent;
+
+    private:
+        std::thread thread;
+    };
+
+    void runSnapshotBenchmarks(BenchSuite& suite, size_t n) {
+        if (!suite.enabled("snapshot_open") && !suite.enabled("transfer_snapshot_pinned") &&
+            !suite.enabled("transfer_no_snapshot") && !suite.enabled("transfer_during_scan")) {
+            return;
+        }
+        AccountStore store;
+        store.adopt(makeAccounts(n, 1.0e6), "");
+
+        std::mt19937_64 rng(n);
+        std::uniform_int_distribution<size_t> pick(0, n - 1);
+        std::vector<std::pair<size_t, size_t>> probes(PROBE_COUNT);
+        for (auto& probe : probes) {
+            probe = std::make_pair(pick(rng), pick(rng));
+        }
+        auto transfer = [&](uint64_t i) {
+            Account& from = store.at(probes[i % PROBE_COUNT].first);
+            Transfer transfer(20.0, store.at(probes[i % PROBE_COUNT].second));
+            doNotOptimize(store.transfer(transfer, from));
+        };
+
+        // Constant in the account count: an epoch bump and a pass over the stripes
+        suite.measure("snapshot_open", n, [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                StoreSnapshot snapshot = store.openSnapshot();
+                doNotOptimize(snapshot.getEpoch());
+            }
+        });
+
+        suite.measure("transfer_no_snapshot", n, [&](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                transfer(i);
+            }
+        });
+
+        // A new snapshot every few thousand postings, so most postings keep a
+        // version and trim an older one
+        BenchResult* pinned = suite.measure("transfer_snapshot_pinned", n, [&](uint64_t iterations) {
+            StoreSnapshot snapshot = store.openSnapshot();
+            for (uint64_t i = 0; i < iterations; ++i) {
+                if (i % POSTINGS_PER_SNAPSHOT == 0) {
+                    snapshot = store.openSnapshot();
+                }
+                transfer(i);
+            }
+        });
+        if (pinned) {
+            pinned->counters["live_versions"] = static_cast<double>(store.getLiveVersions());
+        }
+
+        if (suite.enabled("transfer_during_scan")) {
+            int64_t expected = totalCents(store.openSnapshot());
+            Scanner scanner(store, expected);
+            BenchResult* result = suite.measure("transfer_during_scan", n, [&](uint64_t iterations) {
+                for (uint64_t i = 0; i < iterations; ++i) {
+                    transfer(i);
+                }
+            });
+            scanner.stop();
+            if (result) {
+                result->counters["scans"] = static_cast<double>(scanner.scans.load());
+                result->counters["inconsistent_scans"] = static_cast<double>(scanner.inconsistent.load());
+            }
+            if (scanner.inconsistent.load() != 0) {
+                std::fprintf(stderr, "snapshot: %llu of %llu scans saw a torn total\n",
+                             static_cast<unsigned long long>(scanner.inconsistent.load()),
+                             static_cast<unsigned long long>(scanner.scans.load()));
+            }
+        }
+    }
+}
+
+BENCH_GROUP("snapshot", runSnapshotBenchmarks);
@@ -0,0 +1,99 @@
+// Deposits through the tiered store with a memory tier of a tenth of the
+// table: Zipf-popular accounts (mostly hits) and a sequential scan (every
+// access a fault plus an eviction)
+#include "Bench.h"
+#include "AccountStore.h"
+#include "FastRandom.h"
+#include "TieredStore.h"
+#include "ZipfDistribution.h"
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace {
+    bool writeImage(const std::string& dataPath, size_t n) {
+        AccountStore store;
+        store.adopt(makeAccounts(n, 100.0), dataPath);
+        return store.checkpoint();
+    }
+
+    void deposit(TieredStore& store, size_t position) {
+        TieredStore::Handle handle = store.acquireAt(position);
+        if (handle) {
+            Deposit deposit(1.0);
+            doNotOptimize(store.apply(deposit, handle));
+            store.release(handle);
+        }
+    }
+
+    // Records are rewritten in place; the checkpoint reseals the image for
+    // the next measurement
+    void finish(BenchResult* result, TieredStore& store) {
+        if (result) {
+            TieredStore::Stats stats = store.getStats();
+            result->counters["hit_rate"] = stats.hitRate();
+            result->counters["fault_p99_us"] = stats.faultLatency.percentile(99) / 1000.0;
+            if (stats.writebackRuns > 0) {
+                result->counters["records_per_write"] =
+                    static_cast<double>(stats.writtenBack) / static_cast<double>(stats.writebackRuns);
+            }
+        }
+        if (!store.checkpoint()) {
+            std::fprintf(stderr, "tier: checkpoint failed\n");
+        }
+    }
+
+    void runTierBenchmarks(BenchSuite& suite, size_t n) {
+        if (!suite.enabled("tier_zipf") && !suite.enabled("tier_scan")) {
+            return;
+        }
+        const std::string dataPath = suite.getScratchDir() + "/tier-" + std::to_string(n) + ".txt";
+        if (!writeImage(dataPath, n)) {
+            std::fprintf(stderr, "tier: could not write the image for %s\n", dataPath.c_str());
+            return;
+        }
+        size_t budget = TieredStore::bytesPerAccount() * (n / 10);
+        std::string error;
+
+        if (suite.enabled("tier_zipf")) {
+            TieredStore store;
+            if (store.open(dataPath, budget, error)) {
+                ZipfDistribution popularity(n, 0.99);
+                FastRandom random(42);
+                BenchResult* result = suite.measure("tier_zipf", n, [&](uint64_t iterations) {
+                    for (uint64_t i = 0; i < iterations; ++i) {
+                        uint64_t rank = popularity.sample(random) - 1;
+                        deposit(store, static_cast<size_t>((rank * 0x9E3779B97F4A7C15ULL) % n));
+                    }
+                });
+                finish(result, store);
+            } else {
+                std::fprintf(stderr, "tier: %s\n", error.c_str());
+            }
+        }
+
+        if (suite.enabled("tier_scan")) {
+            TieredStore store;
+            if (store.open(dataPath, budget, error)) {
+                size_t position = 0;
+                BenchResult* result = suite.measure("tier_scan", n, [&](uint64_t iterations) {
+                    for (uint64_t i = 0; i < iterations; ++i) {
+                        deposit(store, position);
+                        position = position + 1 < n ? position + 1 : 0;
+                    }
+                });
+                finish(result, store);
+            } else {
+                std::fprintf(stderr, "tier: %s\n", error.c_str());
+            }
+        }
+
+        std::error_code removeError;
+        for (const char* suffix : {"", ".image", ".bloom", ".tmp"}) {
+            std::filesystem::remove(dataPath + suffix, removeError);
+        }
+    }
+}
+
+BENCH_GROUP("tier", runTierBenchmarks);
@@ -0,0 +1,33 @@
+// Cost of a tracing span when tracing is off and on
+#include "Bench.h"
+#include "Trace.h"
+
+namespace {
+    void runTraceBenchmarks(BenchSuite& suite, size_t n) {
+        // Independent of the account count
+        if (n != 1000) {
+            return;
+        }
+        bool wasEnabled = Tracer::isEnabled();
+
+        Tracer::setEnabled(false);
+        suite.measure("trace_span_disabled", n, [](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                TraceSpan span("bench");
+                doNotOptimize(i);
+            }
+        });
+
+        Tracer::setEnabled(true);
+        suite.measure("trace_span_enabled", n, [](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                TraceSpan span("bench");
+                doNotOptimize(i);
+            }
+        });
+        Tracer::clear();
+        Tracer::setEnabled(wasEnabled);
+    }
+}
+
+BENCH_GROUP("trace", runTraceBenchmarks);
@@ -0,0 +1,96 @@
+// Cost of velocity rule evaluation on the withdrawal path
+#include "Bench.h"
+#include "AccountStore.h"
+#include "Transaction.h"
+#include "VelocityRules.h"
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    const size_t PROBE_COUNT = 4096;
+    const int64_t START_SECONDS = 1735689600; // 2025-01-01
+
+    // Three windows, limits high enough that nothing is declined
+    const char* const RULES =
+        "1 count 10m 1000000\n"
+        "2 amount 24h 100000000.00\n"
+        "3 spike 30d 1000x 4\n";
+
+    std::unique_ptr<VelocityEngine> compileRules() {
+        std::vector<VelocityRule> rules;
+        std::string error;
+        std::unique_ptr<VelocityEngine> engine(new VelocityEngine());
+        if (!VelocityEngine::parseRules(RULES, rules, error) || !engine->compile(rules, error)) {
+            std::fprintf(stderr, "velocity: %s\n", error.c_str());
+            return nullptr;
+        }
+        return engine;
+    }
+
+    void withdrawMix(AccountStore& store, const std::vector<size_t>& probes, uint64_t iterations) {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            Withdrawal withdrawal(0.01);
+            doNotOptimize(store.apply(withdrawal, store.at(probes[i % PROBE_COUNT])));
+        }
+    }
+
+    void runVelocityBenchmarks(BenchSuite& suite, size_t n) {
+        std::mt19937_64 rng(n);
+        std::uniform_int_distribution<size_t> pick(0, n - 1);
+        std::vector<size_t> probes(PROBE_COUNT);
+        for (auto& probe : probes) {
+            probe = pick(rng);
+        }
+
+        // The engine alone: check plus record, the clock advancing a second
+        // every 1000 withdrawals
+        if (suite.enabled("velocity_check_record")) {
+            std::unique_ptr<VelocityEngine> engine = compileRules();
+            if (!engine) {
+                return;
+            }
+            engine->attach(n);
+            uint64_t clock = 0;
+            auto withdrawals = [&](uint64_t iterations) {
+                for (uint64_t i = 0; i < iterations; ++i, ++clock) {
+                    size_t account = probes[clock % PROBE_COUNT];
+                    int64_t now = START_SECONDS + static_cast<int64_t>(clock / 1000);
+                    uint16_t rule = engine->check(account, 2000, now);
+                    if (rule == 0) {
+                        engine->record(account, 2000);
+                    }
+                    doNotOptimize(rule);
+                }
+            };
+            // Fault the probed accounts' state in before timing
+            withdrawals(PROBE_COUNT);
+            suite.measure("velocity_check_record", n, withdrawals);
+        }
+
+        if (!suite.enabled("withdrawal_velocity_off") && !suite.enabled("withdrawal_velocity_on")) {
+            return;
+        }
+        AccountStore store;
+        store.adopt(makeAccounts(n, 1.0e9), suite.getScratchDir() + "/velocity-unused.txt");
+        withdrawMix(store, probes, 20000);
+
+        BenchResult* off = suite.measure("withdrawal_velocity_off", n, [&](uint64_t iterations) {
+            withdrawMix(store, probes, iterations);
+        });
+        store.setVelocityRules(compileRules());
+        withdrawMix(store, probes, PROBE_COUNT);
+        BenchResult* on = suite.measure("withdrawal_velocity_on", n, [&](uint64_t iterations) {
+            withdrawMix(store, probes, iterations);
+        });
+        if (off && on) {
+            on->counters["overhead_ns"] = on->nsPerOp - off->nsPerOp;
+            std::printf("%-34s %10zu accounts %+13.1f ns per withdrawal\n", "velocity_overhead", n,
+                        on->nsPerOp - off->nsPerOp);
+        }
+    }
+}
+
+BENCH_GROUP("velocity", runVelocityBenchmarks);
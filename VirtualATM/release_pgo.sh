@@ -0,0 +1,65 @@
+#!/bin/bash
+# One-command release build.
+#
+#   1. baseline Release build (no PGO, no LTO)
+#   2. instrumented build (ATM_PGO=GENERATE)
+#   3. training workload: scripted sessions, replay, load generator, benchmarks
+#   4. release build with the profile, LTO and -fno-semantic-interposition
+#   5. benchmark suite on both builds, compared against the baseline
+#
+# Usage: ./release_pgo.sh [output dir]    (default _release)
+# Environment: JOBS, PGO_ACCOUNTS (training dataset size), BENCH_ARGS
+
+set -euo pipefail
+cd "$(dirname "$0")"
+
+OUT="$(mkdir -p "${1:-_release}" && cd "${1:-_release}" && pwd)"
+JOBS="${JOBS:-$(nproc 2>/dev/null || echo 2)}"
+BENCH_ARGS="${BENCH_ARGS:---min-exp 3 --max-exp 5 --min-time 0.1 --repetitions 5}"
+PROFILE_DIR="$OUT/profile"
+
+build() {
+    local dir="$1"
+    shift
+    cmake -S . -B "$dir" -DCMAKE_BUILD_TYPE=Release "$@" > "$dir.configure.log"
+    cmake --build "$dir" -j"$JOBS" > "$dir.build.log"
+}
+
+echo "[1/5] Baseline build"
+mkdir -p "$OUT/baseline"
+build "$OUT/baseline" -DATM_PGO= -DATM_LTO=OFF
+
+echo "[2/5] Instrumented build"
+rm -rf "$PROFILE_DIR"
+mkdir -p "$OUT/instrumented"
+build "$OUT/instrumented" -DATM_PGO=GENERATE -DATM_PGO_DIR="$PROFILE_DIR" -DATM_LTO=OFF
+
+echo "[3/5] Training workload"
+./tools/pgo_workload.sh "$OUT/instrumented" "$OUT/workload"
+if ls "$PROFILE_DIR"/*.profraw > /dev/null 2>&1; then
+    # Clang writes raw profiles that must be merged before use
+    llvm-profdata merge -output="$PROFILE_DIR/merged.profdata" "$PROFILE_DIR"/*.profraw
+fi
+
+echo "[4/5] Release build (PGO + LTO)"
+mkdir -p "$OUT/release"
+build "$OUT/release" -DATM_PGO=USE -DATM_PGO_DIR="$PROFILE_DIR" -DATM_LTO=ON
+
+echo "[5/5] Benchmarks"
+mkdir -p "$OUT/bench"
+cd "$OUT/bench"
+# shellcheck disable=SC2086
+"$OUT/baseline/atm_bench" $BENCH_ARGS --scratch bench_data --json baseline.json > baseline.txt
+status=0
+# shellcheck disable=SC2086
+"$OUT/release/atm_bench" $BENCH_ARGS --scratch bench_data --json release.json \
+    --compare baseline.json > release.txt || status=$?
+if [ "$status" -ne 0 ] && [ "$status" -ne 3 ]; then
+    cat release.txt
+    exit "$status"
+fi
+sed -n '/^Benchmark/,$p' release.txt
+
+echo ""
+echo "Release binaries: $OUT/release"
+echo "Benchmark results: $OUT/bench/baseline.json, $OUT/bench/release.json"
@@ -1,14 +1,18 @@
 #include "ATM.h"
+#include "LoginThrottle.h"
+#include "Metrics.h"
+#include "SessionTrace.h"
+#include "Sharding.h"
+#include "Trace.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
-#include <iomanip>
 #include <limits>
 #include <algorithm>
 
-// Platform-specific screen clear
-#ifdef _WIN32
-    const char* CLEAR_SCREEN = "cls";
-#else
-    const char* CLEAR_SCREEN = "clear";
+#ifndef _WIN32
+#include <unistd.h>
 #endif
 
 // ANSI color codes for console formatting
@@ -20,32 +24,105 @@ const std::string ATM::ANSI_BLUE = "\033[34m";
 const std::string ATM::ANSI_YELLOW = "\033[33m";
 const std::string ATM::ANSI_CYAN = "\033[36m";
 
+namespace {
+    uint64_t microsecondsSince(std::chrono::steady_clock::time_point start) {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+    }
+
+    // Counts a session as active for the lifetime of ATM::start
+    struct SessionGauge {
+        SessionGauge() {
+            const AtmMetrics& metrics = AtmMetrics::get();
+            MetricsRegistry::instance().add(metrics.sessionsStarted);
+            MetricsRegistry::instance().adjust(metrics.sessionsActive, 1);
+        }
+        ~SessionGauge() {
+            MetricsRegistry::instance().adjust(AtmMetrics::get().sessionsActive, -1);
+        }
+    };
+
+    // FNV-1a; 0 is reserved for "unknown terminal" in the ledger
+    uint32_t terminalCodeOf(const std::string& terminalId) {
+        uint32_t hash = 2166136261u;
+        for (unsigned char c : terminalId) {
+            hash = (hash ^ c) * 16777619u;
+        }
+        return hash ? hash : 1;
+    }
+}
+
 // Constructor
-ATM::ATM() : currentAccount(nullptr), isAuthenticated(false) {
-    FileManager::initializeDataFile();
-    accounts = FileManager::loadAccounts();
+ATM::ATM() : ATM(SessionConfig()) {}
+
+ATM::ATM(const SessionConfig& config)
+    : store(config.store), router(config.router), routedAccount("", "", 0.0), shardUnreachable(false),
+      tier(config.tier),
+      currentAccount(nullptr),
+      isAuthenticated(false),
+      terminalId(config.terminalId.empty() ? resolveTerminalId() : config.terminalId),
+      terminalCode(terminalCodeOf(terminalId)),
+      dataFilePath(config.dataFilePath.empty() ? FileManager::defaultDataFilePath() : config.dataFilePath),
+      throttle(config.throttle ? config.throttle : &LoginThrottle::instance()),
+      recorder(config.recorder), replay(config.replay),
+      screen(config.replay ? Renderer::Mode::Capture : Renderer::detectMode()) {
+    if (!store && !router && !tier) {
+        ownedStore.reset(new AccountStore());
+        ownedStore->load(dataFilePath);
+        std::string error;
+        if (!config.ioBackend.empty() && !ownedStore->persistAsync(config.ioBackend, config.journalAck, error)) {
+            std::cerr << "Warning: Writing synchronously: " << error << std::endl;
+        }
+        if (!config.ledgerPath.empty() && !ownedStore->openJournal(config.ledgerPath)) {
+            std::cerr << "Warning: Could not open ledger " << config.ledgerPath << std::endl;
+        }
+        ownedStore->setDailyLimit(Ledger::toCents(config.dailyLimit));
+        if (!config.velocityRulesPath.empty() && !ownedStore->loadVelocityRules(config.velocityRulesPath, error)) {
+            std::cerr << "Warning: Velocity rules not loaded: " << error << std::endl;
+        }
+        if (!config.replicaSocket.empty() && !ownedStore->replicateTo(config.replicaSocket, config.replicaAck, error)) {
+            std::cerr << "Warning: Not replicating: " << error << std::endl;
+        }
+        store = ownedStore.get();
+    }
+    if (!config.cassettes.empty()) {
+        std::vector<Cassette> cassettes;
+        std::string error;
+        dispenser.reset(new CashDispenser());
+        if (!CashDispenser::parse(config.cassettes, cassettes, error) || !dispenser->configure(cassettes, error)) {
+            std::cerr << "Warning: Cassettes not loaded: " << error << std::endl;
+            dispenser.reset();
+        }
+    }
+}
+
+uint64_t ATM::getOutputDigest() const {
+    return screen.getDigest();
+}
+
+// Routed sessions leave saving to the shards
+bool ATM::checkpoint() {
+    if (tier) {
+        return tier->checkpoint();
+    }
+    return store ? store->checkpoint() : true;
 }
 
+// Start a new frame; the clear is an ANSI sequence written with the frame
 void ATM::clearScreen() {
-    int result = system(CLEAR_SCREEN);
-    (void)result; // Suppress unused variable warning
-    (void)result; // Suppress unused variable warning
-    (void)result; // Suppress unused variable warning
-    (void)result; // Suppress unused variable warning
-    (void)result; // Suppress unused variable warning
-    (void)result; // Suppress unused variable warning
-    (void)result; // Suppress unused variable warning
-    (void)result; // Suppress unused variable warning
+    screen.beginFrame();
 }
 
 // Main ATM operation loop
 void ATM::start() {
+    SessionGauge session;
     displayWelcome();
     
     while (true) {
         if (!isAuthenticated) {
             if (!authenticate()) {
                 printError("Authentication failed. Goodbye!");
+                screen.flush();
                 break;
             }
         }
@@ -72,6 +149,7 @@ void ATM::start() {
             case 0:
                 logout();
                 printInfo("Thank you for using our ATM service!");
+                screen.flush();
                 return;
             default:
                 printError("Invalid option. Please try again.");
@@ -93,13 +171,47 @@ bool ATM::authenticate() {
         std::string accountNumber = getStringInput("Enter Account Number: ");
         std::string pin = getStringInput("Enter PIN: ");
         
-        Account* account = FileManager::findAccount(accounts, accountNumber);
+        // Throttled attempts are rejected before any lookup or PIN check
+        const AtmMetrics& metrics = AtmMetrics::get();
+        if (!throttle->allowAttempt(accountNumber, terminalId)) {
+            MetricsRegistry::instance().add(metrics.loginThrottled);
+            attempts++;
+            printError("Too many failed attempts. Please try again later.");
+            if (attempts < maxAttempts) {
+                screen.newline();
+            }
+            continue;
+        }
+        
+        bool valid;
+        Account* account;
+        {
+            ScopedTimer timer(metrics.loginDuration);
+            if (router) {
+                routedAccount = Account(accountNumber, pin, 0.0);
+                BalanceInquiry inquiry;
+                account = &routedAccount;
+                valid = router->login(accountNumber, pin) && postRouted(inquiry);
+            } else if (tier) {
+                tierHandle = tier->acquire(accountNumber);
+                account = tierHandle.account;
+                valid = account && account->validatePin(pin);
+                if (tierHandle && !valid) {
+                    tier->release(tierHandle);
+                }
+            } else {
+                account = store->find(accountNumber);
+                valid = account && account->validatePin(pin);
+            }
+        }
+        MetricsRegistry::instance().add(valid ? metrics.loginSucceeded : metrics.loginFailed);
         
-        if (account && account->validatePin(pin)) {
+        if (valid) {
+            throttle->recordSuccess(accountNumber);
             currentAccount = account;
             isAuthenticated = true;
             printSuccess("Authentication successful!");
-            std::cout << std::endl;
+            screen.newline();
             return true;
         }
         
@@ -108,7 +220,7 @@ bool ATM::authenticate() {
                   std::to_string(maxAttempts - attempts));
         
         if (attempts < maxAttempts) {
-            std::cout << std::endl;
+            screen.newline();
         }
     }
     
@@ -116,16 +228,29 @@ bool ATM::authenticate() {
     return false;
 }
 
+// Identify this terminal for login throttling
+std::string ATM::resolveTerminalId() {
+    if (const char* configured = std::getenv("ATM_TERMINAL_ID")) {
+        return configured;
+    }
+#ifndef _WIN32
+    if (const char* tty = ttyname(STDIN_FILENO)) {
+        return tty;
+    }
+#endif
+    return "console";
+}
+
 // Display welcome screen
 void ATM::displayWelcome() {
     clearScreen();
     printSeparator('=', 70);
-    std::cout << ANSI_BOLD << ANSI_BLUE;
-    std::cout << "                        WELCOME TO ATM SIMULATOR" << std::endl;
-    std::cout << "                     Developed by: Sandesh & Shasank & Sugam" << std::endl;
-    std::cout << ANSI_RESET;
+    screen.style(ANSI_BOLD).style(ANSI_BLUE)
+          .text("                        WELCOME TO ATM SIMULATOR").newline()
+          .text("                     Developed by: Sandesh & Shasank & Sugam").newline()
+          .style(ANSI_RESET);
     printSeparator('=', 70);
-    std::cout << std::endl;
+    screen.newline();
 }
 
 // Display main menu
@@ -133,41 +258,120 @@ void ATM::displayMainMenu() {
     clearScreen();
     printHeader("MAIN MENU");
     
-    std::cout << ANSI_GREEN << "Account: " << ANSI_BOLD << currentAccount->getAccountNumber() 
-              << ANSI_RESET << std::endl;
-    std::cout << ANSI_GREEN << "Current Balance: " << ANSI_BOLD << "$" 
-              << std::fixed << std::setprecision(2) << currentAccount->getBalance() 
-              << ANSI_RESET << std::endl << std::endl;
+    screen.style(ANSI_GREEN).text("Account: ").style(ANSI_BOLD)
+          .text(currentAccount->getAccountNumber()).style(ANSI_RESET).newline();
+    screen.style(ANSI_GREEN).text("Current Balance: ").style(ANSI_BOLD).text("$")
+          .money(currentAccount->getBalance()).style(ANSI_RESET).newline().newline();
     
-    std::cout << ANSI_CYAN << "Please select an option:" << ANSI_RESET << std::endl;
-    std::cout << "  [1] Balance Inquiry" << std::endl;
-    std::cout << "  [2] Cash Withdrawal" << std::endl;
-    std::cout << "  [3] Cash Deposit" << std::endl;
-    std::cout << "  [4] Transaction History" << std::endl;
-    std::cout << "  [5] Logout" << std::endl;
-    std::cout << "  [0] Exit ATM" << std::endl;
+    screen.style(ANSI_CYAN).text("Please select an option:").style(ANSI_RESET).newline();
+    screen.text("  [1] Balance Inquiry\n"
+                "  [2] Cash Withdrawal\n"
+                "  [3] Cash Deposit\n"
+                "  [4] Transaction History\n"
+                "  [5] Logout\n"
+                "  [0] Exit ATM\n");
     printSeparator();
 }
 
-// Get user menu choice with validation
+// Get user menu choice with validation; end of input means exit
 int ATM::getMenuChoice() {
     int choice;
     while (true) {
-        std::cout << ANSI_YELLOW << "Enter your choice: " << ANSI_RESET;
-        std::cin >> choice;
+        screen.style(ANSI_YELLOW).text("Enter your choice: ").style(ANSI_RESET);
+        screen.flush();
         
-        if (std::cin.fail() || choice < 0 || choice > 5) {
-            std::cin.clear();
+        bool parsed;
+        if (replay) {
+            const SessionTrace::Event& event = replay->next(SessionTrace::EventKind::Menu);
+            if (event.kind == SessionTrace::EventKind::End) {
+                return 0;
+            }
+            parsed = event.kind == SessionTrace::EventKind::Menu;
+            choice = static_cast<int>(event.number);
+        } else {
+            auto waitStart = std::chrono::steady_clock::now();
+            std::cin >> choice;
+            if (std::cin.eof()) {
+                return 0;
+            }
+            parsed = !std::cin.fail();
+            if (recorder) {
+                parsed ? recorder->recordMenu(choice, microsecondsSince(waitStart))
+                       : recorder->recordInvalid(microsecondsSince(waitStart));
+            }
+            if (!parsed) {
+                std::cin.clear();
+            }
             std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        }
+        
+        if (!parsed || choice < 0 || choice > 5) {
             printError("Invalid input. Please enter a number between 0-5.");
             continue;
         }
         
-        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
         return choice;
     }
 }
 
+// Post to the session's account, wherever it lives
+bool ATM::post(Transaction& transaction) {
+    if (router) {
+        return postRouted(transaction);
+    }
+    if (tier) {
+        return tier->apply(transaction, tierHandle);
+    }
+    return store->apply(transaction, *currentAccount, terminalCode);
+}
+
+// The shard posts; the transaction is then replayed on routedAccount from
+// the balance before it, so it records the outcome the shard reached and
+// routedAccount ends on the shard's balance. A withdrawal the shard
+// declined over a limit or a rule is declined the same way here.
+bool ATM::postRouted(Transaction& transaction) {
+    ShardOp op = ShardOp::Inquiry;
+    if (transaction.getKind() == TransactionKind::Withdrawal) {
+        op = ShardOp::Withdraw;
+    } else if (transaction.getKind() == TransactionKind::Deposit) {
+        op = ShardOp::Deposit;
+    }
+    int64_t cents = op == ShardOp::Inquiry ? 0 : Ledger::toCents(transaction.getAmount());
+    ShardOutcome outcome;
+    ShardStatus status = router->post(op, routedAccount.getAccountNumber(), cents, outcome, terminalCode);
+    shardUnreachable = status != ShardStatus::Ok && status != ShardStatus::Declined;
+    if (shardUnreachable) {
+        printError("The account's shard could not be reached.");
+        return false;
+    }
+    int64_t balanceCents = outcome.balanceCents;
+    bool posted = status == ShardStatus::Ok;
+    int64_t beforeCents = balanceCents;
+    if (posted && op == ShardOp::Withdraw) {
+        beforeCents += cents;
+    } else if (posted && op == ShardOp::Deposit) {
+        beforeCents -= cents;
+    }
+    AccountSnapshot state = routedAccount.getState();
+    state.balance = static_cast<double>(beforeCents) / 100.0;
+    routedAccount.restore(state);
+    if (outcome.decline == ShardDecline::DailyLimit) {
+        static_cast<Withdrawal&>(transaction).declineOverDailyLimit();
+    } else if (outcome.decline == ShardDecline::Rule) {
+        static_cast<Withdrawal&>(transaction).decline(outcome.rule);
+    } else {
+        transaction.process(routedAccount);
+    }
+    state.balance = static_cast<double>(balanceCents) / 100.0;
+    routedAccount.restore(state);
+    return posted;
+}
+
+// -1 when there is no daily limit (or the shards keep it)
+int64_t ATM::remainingToday() {
+    return store ? store->remainingToday(*currentAccount) : -1;
+}
+
 // Execute transaction (called from main menu)
 void ATM::executeTransaction() {
     // This method can be used for additional transaction processing if needed
@@ -179,24 +383,31 @@ void ATM::performBalanceInquiry() {
     clearScreen();
     printHeader("BALANCE INQUIRY");
     
-    auto transaction = std::make_unique<BalanceInquiry>();
-    transaction->process(*currentAccount);
+    BalanceInquiry& transaction = sessionHistory.record<BalanceInquiry>();
+    if (!post(transaction)) {
+        sessionHistory.discardLast();
+        printError("Balance inquiry failed. Please try again later.");
+        return;
+    }
     
-    std::cout << ANSI_GREEN << "Current Balance: " << ANSI_BOLD << "$" 
-              << std::fixed << std::setprecision(2) << currentAccount->getBalance() 
-              << ANSI_RESET << std::endl;
+    screen.style(ANSI_GREEN).text("Current Balance: ").style(ANSI_BOLD).text("$")
+          .money(transaction.getBalance()).style(ANSI_RESET).newline();
     
-    sessionHistory.push_back(std::move(transaction));
     printSuccess("Transaction completed successfully.");
 }
 
 // Cash withdrawal transaction
 void ATM::performWithdrawal() {
+    ATM_TRACE_SPAN("ATM::performWithdrawal");
     clearScreen();
     printHeader("CASH WITHDRAWAL");
     
-    std::cout << "Current Balance: $" << std::fixed << std::setprecision(2) 
-              << currentAccount->getBalance() << std::endl << std::endl;
+    screen.text("Current Balance: $").money(currentAccount->getBalance()).newline();
+    int64_t remaining = remainingToday();
+    if (remaining >= 0) {
+        screen.text("Daily limit remaining: $").money(static_cast<double>(remaining) / 100.0).newline();
+    }
+    screen.newline();
     
     double amount = getAmountInput("Enter withdrawal amount: $");
     
@@ -205,29 +416,65 @@ void ATM::performWithdrawal() {
         return;
     }
     
-    auto transaction = std::make_unique<Withdrawal>(amount);
-    bool success = transaction->process(*currentAccount);
+    // The notes are chosen before the account is touched
+    DispensePlan plan;
+    if (dispenser && !dispenser->plan(Ledger::toCents(amount), plan)) {
+        MetricsRegistry::instance().add(AtmMetrics::get().dispenseRejected);
+        printError("This amount cannot be dispensed. Please choose a multiple of the notes available.");
+        return;
+    }
+    
+    Withdrawal& transaction = sessionHistory.record<Withdrawal>(amount);
+    bool success = post(transaction);
     
-    if (success) {
+    if (!success && router && shardUnreachable) {
+        sessionHistory.discardLast();
+        printError("Withdrawal failed. Please try again later.");
+    } else if (success) {
         printSuccess("Withdrawal successful!");
-        std::cout << "Amount withdrawn: $" << std::fixed << std::setprecision(2) << amount << std::endl;
-        std::cout << "New balance: $" << std::fixed << std::setprecision(2) 
-                  << currentAccount->getBalance() << std::endl;
+        screen.text("Amount withdrawn: $").money(amount).newline();
+        if (dispenser) {
+            dispenser->dispense(plan);
+            displayNotes(plan);
+        }
+        screen.text("New balance: $").money(currentAccount->getBalance()).newline();
         saveAccountData();
+    } else if (transaction.wasOverDailyLimit()) {
+        printError("Withdrawal declined. It would exceed your daily limit.");
+        if (remainingToday() >= 0) {
+            screen.text("Remaining today: $").money(static_cast<double>(remainingToday()) / 100.0).newline();
+        }
+    } else if (transaction.getDeclinedRule() != 0) {
+        char message[64];
+        std::snprintf(message, sizeof(message), "Withdrawal declined (rule %u). Please contact your bank.",
+                      static_cast<unsigned>(transaction.getDeclinedRule()));
+        printError(message);
     } else {
         printError("Withdrawal failed. Insufficient funds.");
     }
-    
-    sessionHistory.push_back(std::move(transaction));
+}
+
+// Notes paid out, largest first, e.g. "Notes: 2 x $50, 1 x $20"
+void ATM::displayNotes(const DispensePlan& plan) {
+    screen.text("Notes:");
+    const char* separator = " ";
+    for (size_t i = dispenser->getCassetteCount(); i-- > 0;) {
+        if (plan.notes[i] == 0) {
+            continue;
+        }
+        screen.text(separator).number(plan.notes[i]).text(" x $").number(dispenser->getCassette(i).denomination);
+        separator = ", ";
+    }
+    screen.newline();
 }
 
 // Cash deposit transaction
 void ATM::performDeposit() {
+    ATM_TRACE_SPAN("ATM::performDeposit");
     clearScreen();
     printHeader("CASH DEPOSIT");
     
-    std::cout << "Current Balance: $" << std::fixed << std::setprecision(2) 
-              << currentAccount->getBalance() << std::endl << std::endl;
+    screen.text("Current Balance: $").money(currentAccount->getBalance()).newline().newline();
     
     double amount = getAmountInput("Enter deposit amount: $");
     
@@ -236,15 +483,17 @@ void ATM::performDeposit() {
         return;
     }
     
-    auto transaction = std::make_unique<Deposit>(amount);
-    transaction->process(*currentAccount);
+    Deposit& transaction = sessionHistory.record<Deposit>(amount);
+    if (!post(transaction)) {
+        sessionHistory.discardLast();
+        printError("Deposit failed. Please try again later.");
+        return;
+    }
     
     printSuccess("Deposit successful!");
-    std::cout << "Amount deposited: $" << std::fixed << std::setprecision(2) << amount << std::endl;
-    std::cout << "New balance: $" << std::fixed << std::setprecision(2) 
-              << currentAccount->getBalance() << std::endl;
+    screen.text("Amount deposited: $").money(amount).newline();
+    screen.text("New balance: $").money(currentAccount->getBalance()).newline();
     
-    sessionHistory.push_back(std::move(transaction));
     saveAccountData();
 }
 
@@ -256,23 +505,24 @@ void ATM::displayTransactionHistory() {
         printInfo("No transactions performed in this session.");
         return;
     }
-    std::cout << ANSI_CYAN << std::left
-              << std::setw(20) << "Type"
-              << std::setw(40) << "Remarks" << ANSI_RESET << std::endl;
+    screen.style(ANSI_CYAN).padded("Type", 20).padded("Remarks", 40).style(ANSI_RESET).newline();
     printSeparator();
-    for (const auto& transaction : sessionHistory) {
-        std::cout << std::left
-                  << std::setw(20) << transaction->getTransactionType()
-                  << std::setw(40) << transaction->getDescription() << std::endl;
+    for (size_t i = 0; i < sessionHistory.size(); ++i) {
+        const Transaction& transaction = sessionHistory[i];
+        screen.padded(transaction.getTransactionType(), 20)
+              .padded(transaction.getDescription(), 40).newline();
     }
     printSeparator();
-    std::cout << "Total transactions: " << sessionHistory.size() << std::endl;
+    screen.text("Total transactions: ").number(static_cast<long long>(sessionHistory.size())).newline();
 }
 
 // Logout and clear session
 void ATM::logout() {
     if (isAuthenticated) {
         saveAccountData();
+        if (tierHandle) {
+            tier->release(tierHandle);
+        }
         sessionHistory.clear();
         currentAccount = nullptr;
         isAuthenticated = false;
@@ -280,26 +530,54 @@ void ATM::logout() {
     }
 }
 
-// Save account data to file
+// Save account data to file; a tier writes the session's record in place
 void ATM::saveAccountData() {
-    FileManager::saveAccounts(accounts);
+    ATM_TRACE_SPAN("ATM::saveAccountData");
+    if (tierHandle) {
+        tier->persist(tierHandle);
+    } else if (store) {
+        store->save();
+    }
 }
 
-// Utility function to get amount input with validation
+// Utility function to get amount input with validation; end of input gives 0
 double ATM::getAmountInput(const std::string& prompt) {
+    ATM_TRACE_SPAN("ATM::getAmountInput");
     double amount;
     while (true) {
-        std::cout << ANSI_YELLOW << prompt << ANSI_RESET;
-        std::cin >> amount;
+        screen.style(ANSI_YELLOW).text(prompt).style(ANSI_RESET);
+        screen.flush();
         
-        if (std::cin.fail()) {
-            std::cin.clear();
+        bool parsed;
+        if (replay) {
+            const SessionTrace::Event& event = replay->next(SessionTrace::EventKind::Amount);
+            if (event.kind == SessionTrace::EventKind::End) {
+                return 0.0;
+            }
+            parsed = event.kind == SessionTrace::EventKind::Amount;
+            amount = event.amount;
+        } else {
+            auto waitStart = std::chrono::steady_clock::now();
+            std::cin >> amount;
+            if (std::cin.eof()) {
+                return 0.0;
+            }
+            parsed = !std::cin.fail();
+            if (recorder) {
+                parsed ? recorder->recordAmount(amount, microsecondsSince(waitStart))
+                       : recorder->recordInvalid(microsecondsSince(waitStart));
+            }
+            if (!parsed) {
+                std::cin.clear();
+            }
             std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        }
+        
+        if (!parsed) {
             printError("Invalid input. Please enter a valid amount.");
             continue;
         }
         
-        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
         return amount;
     }
 }
@@ -307,42 +585,65 @@ double ATM::getAmountInput(const std::string& prompt) {
 // Utility function to get string input
 std::string ATM::getStringInput(const std::string& prompt) {
     std::string input;
-    std::cout << ANSI_YELLOW << prompt << ANSI_RESET;
-    std::getline(std::cin, input);
+    screen.style(ANSI_YELLOW).text(prompt).style(ANSI_RESET);
+    screen.flush();
+    
+    if (replay) {
+        const SessionTrace::Event& event = replay->next(SessionTrace::EventKind::Text);
+        if (event.kind == SessionTrace::EventKind::Text) {
+            input = event.text;
+        }
+        return input;
+    }
+    
+    auto waitStart = std::chrono::steady_clock::now();
+    if (std::getline(std::cin, input) && recorder) {
+        recorder->recordText(input, microsecondsSince(waitStart));
+    }
     return input;
 }
 
 // Pause screen and wait for user input
 void ATM::pauseScreen() {
-    std::cout << std::endl;
+    screen.newline();
     printInfo("Press Enter to continue...");
-    std::cin.get();
+    screen.flush();
+    
+    if (replay) {
+        replay->next(SessionTrace::EventKind::Pause);
+        return;
+    }
+    
+    auto waitStart = std::chrono::steady_clock::now();
+    if (std::cin.get() != std::char_traits<char>::eof() && recorder) {
+        recorder->recordPause(microsecondsSince(waitStart));
+    }
 }
 
 // Print separator line
 void ATM::printSeparator(char ch, int length) {
-    std::cout << std::string(length, ch) << std::endl;
+    screen.repeat(ch, length).newline();
 }
 
 // Print formatted header
 void ATM::printHeader(const std::string& title) {
     printSeparator('=', 60);
-    std::cout << ANSI_BOLD << ANSI_BLUE << "    " << title << ANSI_RESET << std::endl;
+    screen.style(ANSI_BOLD).style(ANSI_BLUE).text("    ").text(title).style(ANSI_RESET).newline();
     printSeparator('=', 60);
-    std::cout << std::endl;
+    screen.newline();
 }
 
 // Print success message
 void ATM::printSuccess(const std::string& message) {
-    std::cout << ANSI_GREEN << ANSI_BOLD << "✓ " << message << ANSI_RESET << std::endl;
+    screen.style(ANSI_GREEN).style(ANSI_BOLD).text("✓ ").text(message).style(ANSI_RESET).newline();
 }
 
 // Print error message
 void ATM::printError(const std::string& message) {
-    std::cout << ANSI_RED << ANSI_BOLD << "✗ " << message << ANSI_RESET << std::endl;
+    screen.style(ANSI_RED).style(ANSI_BOLD).text("✗ ").text(message).style(ANSI_RESET).newline();
 }
 
 // Print info message
 void ATM::printInfo(const std::string& message) {
-    std::cout << ANSI_CYAN << "ℹ " << message << ANSI_RESET << std::endl;
+    screen.style(ANSI_CYAN).text("ℹ ").text(message).style(ANSI_RESET).newline();
 }
\ No newline at end of file
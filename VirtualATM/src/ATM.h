@@ -2,18 +2,64 @@
 #define ATM_H
 
 #include "Account.h"
+#include "AccountStore.h"
+#include "CashDispenser.h"
 #include "Transaction.h"
 #include "FileManager.h"
+#include "Renderer.h"
+#include "SessionHistory.h"
+#include "TieredStore.h"
 #include <vector>
 #include <memory>
 #include <string>
 
+class LoginThrottle;
+class SessionRecorder;
+class ShardRouter;
+class TraceReplay;
+
+// Per-session wiring; the defaults give the interactive console ATM
+struct SessionConfig {
+    std::string dataFilePath;          // empty: FileManager's default file
+    AccountStore* store = nullptr;     // shared account table; nullptr: load a private one
+    std::string terminalId;            // empty: resolved from the environment
+    LoginThrottle* throttle = nullptr; // nullptr: the shared host-wide throttle
+    SessionRecorder* recorder = nullptr; // records every console input value
+    TraceReplay* replay = nullptr;     // reads input from a trace instead of the console
+    std::string ledgerPath;            // journal postings of a private store here; empty: none
+    std::string velocityRulesPath;     // withdrawal velocity rules for a private store; empty: none
+    double dailyLimit = 0.0;           // daily withdrawal limit of a private store; 0: none
+    std::string replicaSocket;         // ship a private store's postings to this standby; empty: none
+    ReplicaAck replicaAck = ReplicaAck::Async;
+    std::string ioBackend;             // write a private store's journal and saves in the background
+                                       // ("uring", "threads", "auto"); empty: blocking writes
+    JournalAck journalAck = JournalAck::Async;
+    std::string cassettes;             // "denomination:count[:capacity],..."; empty: any amount is paid
+    ShardRouter* router = nullptr;     // post to account shards instead of a store; they save their accounts
+    TieredStore* tier = nullptr;       // post to a memory-bounded tier over the accounts image instead;
+                                       // it saves at checkpoint() only
+};
+
 class ATM {
 private:
-    std::vector<Account> accounts;
+    std::unique_ptr<AccountStore> ownedStore;
+    AccountStore* store;               // nullptr when routed to shards or tiered
+    ShardRouter* router;
+    Account routedAccount;             // a routed session's account as its shard last reported it
+    bool shardUnreachable;             // the last routed posting never reached its shard
+    TieredStore* tier;
+    TieredStore::Handle tierHandle;    // the session's account, pinned in the tier while logged in
     Account* currentAccount;
-    std::vector<std::unique_ptr<Transaction>> sessionHistory;
+    SessionHistory sessionHistory;
     bool isAuthenticated;
+    std::string terminalId;
+    uint32_t terminalCode;             // terminalId hashed for the journal
+    std::string dataFilePath;
+    LoginThrottle* throttle;
+    SessionRecorder* recorder;
+    TraceReplay* replay;
+    std::unique_ptr<CashDispenser> dispenser; // nullptr: no cassettes configured
+    Renderer screen;
     
     // Console formatting constants
     static const std::string ANSI_RESET;
@@ -27,14 +73,22 @@ private:
 public:
     // Constructor and Destructor
     ATM();
+    explicit ATM(const SessionConfig& config);
     ~ATM() = default;
 
+    // Digest of everything rendered (replayed sessions only)
+    uint64_t getOutputDigest() const;
+
+    // Save the store with its warm-start image (clean shutdown)
+    bool checkpoint();
+
     // Main ATM operations
     void start();
     
 private:
     // Authentication
     bool authenticate();
+    static std::string resolveTerminalId();
     
     // Menu display and navigation
     void displayWelcome();
@@ -42,9 +96,13 @@ private:
     int getMenuChoice();
     
     // Transaction operations
+    bool post(Transaction& transaction);
+    bool postRouted(Transaction& transaction);
+    int64_t remainingToday();
     void executeTransaction();
     void performBalanceInquiry();
     void performWithdrawal();
+    void displayNotes(const DispensePlan& plan);
     void performDeposit();
     void displayTransactionHistory();
     
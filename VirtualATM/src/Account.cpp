@@ -1,29 +1,57 @@
 #include "Account.h"
+#include "FastText.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <sstream>
-#include <iomanip>
+#include <thread>
 
 Account::Account(const std::string& accNum, const std::string& pinCode, double bal)
-    : accountNumber(accNum), pin(pinCode), balance(bal) {}
+    : accountNumber(accNum), pin(pinCode), sequence(0), balance(bal), usageDay(0), withdrawnTodayCents(0),
+      writeEpoch(0), versions(nullptr) {}
+
+// Copies are taken of accounts no posting is writing (or under their lock)
+Account::Account(const Account& other)
+    : accountNumber(other.accountNumber), pin(other.pin), sequence(0),
+      balance(other.balance.load(std::memory_order_relaxed)),
+      usageDay(other.usageDay.load(std::memory_order_relaxed)),
+      withdrawnTodayCents(other.withdrawnTodayCents.load(std::memory_order_relaxed)), writeEpoch(0),
+      versions(nullptr) {}
+
+Account& Account::operator=(const Account& other) {
+    if (this != &other) {
+        accountNumber = other.accountNumber;
+        pin = other.pin;
+        balance.store(other.balance.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        usageDay.store(other.usageDay.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        withdrawnTodayCents.store(other.withdrawnTodayCents.load(std::memory_order_relaxed),
+                                  std::memory_order_relaxed);
+    }
+    return *this;
+}
 
 bool Account::validatePin(const std::string& inputPin) const {
     return pin == inputPin;
 }
 
 double Account::getBalance() const {
-    return balance;
+    return balance.load(std::memory_order_relaxed);
 }
 
+// Read-modify-writes are plain loads and stores: only the lock holder writes
 bool Account::updateBalance(double amount) {
-    if (balance + amount >= 0) {
-        balance += amount;
+    double current = balance.load(std::memory_order_relaxed);
+    if (current + amount >= 0) {
+        balance.store(current + amount, std::memory_order_relaxed);
         return true;
     }
     return false;
 }
 
 bool Account::withdraw(double amount) {
-    if (amount > 0 && balance >= amount) {
-        balance -= amount;
+    double current = balance.load(std::memory_order_relaxed);
+    if (amount > 0 && current >= amount) {
+        balance.store(current - amount, std::memory_order_relaxed);
         return true;
     }
     return false;
@@ -31,7 +59,7 @@ bool Account::withdraw(double amount) {
 
 bool Account::deposit(double amount) {
     if (amount > 0) {
-        balance += amount;
+        balance.store(balance.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
         return true;
     }
     return false;
@@ -41,10 +69,121 @@ std::string Account::getAccountNumber() const {
     return accountNumber;
 }
 
+const std::string& Account::getPin() const {
+    return pin;
+}
+
+int64_t Account::getWithdrawnOn(int32_t day) const {
+    return usageDay.load(std::memory_order_relaxed) == day ? withdrawnTodayCents.load(std::memory_order_relaxed) : 0;
+}
+
+void Account::addWithdrawn(int32_t day, int64_t cents) {
+    int64_t total = withdrawnTodayCents.load(std::memory_order_relaxed);
+    if (usageDay.load(std::memory_order_relaxed) != day) {
+        usageDay.store(day, std::memory_order_relaxed);
+        total = 0;
+    }
+    withdrawnTodayCents.store(total + cents, std::memory_order_relaxed);
+}
+
+// Retry while a write section is open or one closed during the reads; the
+// acquire fence keeps the field loads ahead of the second sequence load.
+// A writer descheduled mid-section gets the core back after a few spins.
+AccountSnapshot Account::snapshot() const {
+    AccountSnapshot current;
+    for (unsigned attempt = 1;; ++attempt) {
+        if (attempt % 64 == 0) {
+            std::this_thread::yield();
+        }
+        uint32_t before = sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        current.balance = balance.load(std::memory_order_relaxed);
+        current.usageDay = usageDay.load(std::memory_order_relaxed);
+        current.withdrawnTodayCents = withdrawnTodayCents.load(std::memory_order_relaxed);
+        current.epoch = writeEpoch.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) == before) {
+            return current;
+        }
+    }
+}
+
+// The release fence keeps the odd sequence ahead of the field stores
+void Account::beginWrite() {
+    sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void Account::endWrite() {
+    sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+AccountSnapshot Account::getState() const {
+    AccountSnapshot current;
+    current.balance = balance.load(std::memory_order_relaxed);
+    current.usageDay = usageDay.load(std::memory_order_relaxed);
+    current.withdrawnTodayCents = withdrawnTodayCents.load(std::memory_order_relaxed);
+    current.epoch = writeEpoch.load(std::memory_order_relaxed);
+    return current;
+}
+
+void Account::restore(const AccountSnapshot& state) {
+    balance.store(state.balance, std::memory_order_relaxed);
+    usageDay.store(state.usageDay, std::memory_order_relaxed);
+    withdrawnTodayCents.store(state.withdrawnTodayCents, std::memory_order_relaxed);
+}
+
+void Account::setWriteEpoch(uint64_t epoch) {
+    writeEpoch.store(epoch, std::memory_order_relaxed);
+}
+
+AccountVersion* Account::getVersions() const {
+    return versions.load(std::memory_order_acquire);
+}
+
+void Account::setVersions(AccountVersion* chain) {
+    versions.store(chain, std::memory_order_release);
+}
+
 std::string Account::toString() const {
-    std::ostringstream oss;
-    oss << accountNumber << "," << pin << "," << std::fixed << std::setprecision(2) << balance;
-    return oss.str();
+    char buffer[128];
+    size_t length = formatTo(buffer, sizeof(buffer));
+    if (length > 0) {
+        return std::string(buffer, length);
+    }
+    // Only an unusually long number or PIN gets here; "%.2f" of any double
+    // fits in 320 characters
+    std::string line(accountNumber.size() + pin.size() + 320 + 2 * FastText::MAX_FIELD, '\0');
+    line.resize(formatTo(&line[0], line.size()));
+    return line;
+}
+
+size_t Account::formatTo(char* out, size_t capacity) const {
+    AccountSnapshot current = snapshot();
+    int written = std::snprintf(out, capacity, "%s,%s,%.2f", accountNumber.c_str(), pin.c_str(), current.balance);
+    if (written < 0 || static_cast<size_t>(written) >= capacity) {
+        return 0;
+    }
+    size_t length = static_cast<size_t>(written);
+    if (current.withdrawnTodayCents != 0) {
+        char suffix[2 * FastText::MAX_FIELD + 2];
+        char* end = suffix;
+        *end++ = ',';
+        end = FastText::writeDate(end, static_cast<int64_t>(current.usageDay) * 86400LL * 1000000LL);
+        *end++ = ',';
+        end = FastText::writeCents(end, current.withdrawnTodayCents);
+        size_t suffixLength = static_cast<size_t>(end - suffix);
+        // Dropping the daily total would reset the limit on the next load
+        if (length + suffixLength >= capacity) {
+            return 0;
+        }
+        std::memcpy(out + length, suffix, suffixLength);
+        length += suffixLength;
+        out[length] = '\0';
+    }
+    return length;
 }
 
 Account Account::fromString(const std::string& data) {
@@ -53,8 +192,20 @@ Account Account::fromString(const std::string& data) {
     
     std::getline(iss, accNum, ',');
     std::getline(iss, pinCode, ',');
-    std::getline(iss, balStr);
+    std::getline(iss, balStr, ',');
     
     double balance = std::stod(balStr);
-    return Account(accNum, pinCode, balance);
+    Account account(accNum, pinCode, balance);
+    
+    // Optional daily withdrawal total
+    std::string dayStr, withdrawnStr;
+    int year = 0, month = 0, day = 0;
+    int64_t cents = 0;
+    if (std::getline(iss, dayStr, ',') && std::getline(iss, withdrawnStr) &&
+        std::sscanf(dayStr.c_str(), "%d-%d-%d", &year, &month, &day) == 3 && month >= 1 && month <= 12 &&
+        FastText::parseCents(withdrawnStr.data(), withdrawnStr.data() + withdrawnStr.size(), cents)) {
+        account.addWithdrawn(static_cast<int32_t>(FastText::daysFromCivil(year, static_cast<unsigned>(month),
+                                                                          static_cast<unsigned>(day))), cents);
+    }
+    return account;
 }
\ No newline at end of file
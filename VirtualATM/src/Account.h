@@ -1,16 +1,46 @@
 #ifndef ACCOUNT_H
 #define ACCOUNT_H
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
+struct AccountVersion;
+
+// Balance and daily total as of one moment
+struct AccountSnapshot {
+    double balance;
+    int32_t usageDay;
+    int64_t withdrawnTodayCents;
+    uint64_t epoch; // snapshot epoch of the posting that wrote them
+};
+
+// A bank account.
+//
+// Postings write it under the AccountStore's lock for the account; readers
+// need no lock. The balance and daily total are atomics, and a sequence
+// counter (a seqlock) is odd while a posting is writing, so snapshot()
+// returns the fields as one posting left them, retrying only if a posting
+// ran while it was reading. Writers bracket a posting with beginWrite and
+// endWrite; single-field writes outside one are still atomic. Older
+// versions for point-in-time snapshots hang off the account (see
+// SnapshotManager); copies start without them.
 class Account {
 private:
     std::string accountNumber;
     std::string pin;
-    double balance;
+    std::atomic<uint32_t> sequence;
+    std::atomic<double> balance;
+    std::atomic<int32_t> usageDay;            // UTC day (days since the epoch) of withdrawnTodayCents
+    std::atomic<int64_t> withdrawnTodayCents; // rolls over lazily on the first touch of a new day
+    std::atomic<uint64_t> writeEpoch;
+    std::atomic<AccountVersion*> versions;    // newest first
     
 public:
     Account(const std::string& accNum, const std::string& pinCode, double bal);
+    Account(const Account& other);
+    Account& operator=(const Account& other);
     
     // Core methods as per PDF requirements
     bool validatePin(const std::string& inputPin) const;
@@ -21,9 +51,39 @@ public:
     
     // Getters
     std::string getAccountNumber() const;
+    const std::string& getPin() const; // for persistence only
     
-    // File operations
+    // Daily withdrawal totals; a total from an earlier day reads as 0.
+    // Consistent for the lock holder; other readers use snapshot()
+    int64_t getWithdrawnOn(int32_t day) const;
+    void addWithdrawn(int32_t day, int64_t cents);
+
+    // Consistent balance and daily total without taking a lock (not from
+    // inside a write section, which it would wait on forever)
+    AccountSnapshot snapshot() const;
+
+    // Seqlock write section; only one writer at a time (the lock holder)
+    void beginWrite();
+    void endWrite();
+
+    // The fields as they stand, for the lock holder
+    AccountSnapshot getState() const;
+
+    // Overwrite balance and daily total (copies, not live accounts)
+    void restore(const AccountSnapshot& state);
+
+    // Version chain, maintained in write sections by SnapshotManager
+    void setWriteEpoch(uint64_t epoch);
+    AccountVersion* getVersions() const;
+    void setVersions(AccountVersion* chain);
+
+    // File operations: "number,pin,balance", followed by ",YYYY-MM-DD,amount"
+    // while a daily withdrawal total is being tracked
     std::string toString() const;
+    
+    // Write the toString() line into out without allocating; returns its
+    // length, or 0 if the whole line does not fit
+    size_t formatTo(char* out, size_t capacity) const;
     static Account fromString(const std::string& data);
 };
 
@@ -0,0 +1,181 @@
+#include "AccountFilter.h"
+#include "FileManager.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+const char AccountFilter::MAGIC[8] = {'A', 'T', 'M', 'B', 'L', 'O', 'O', 'M'};
+const size_t AccountFilter::DEFAULT_BITS_PER_KEY;
+const size_t AccountFilter::WORDS;
+
+namespace {
+    struct FileHeader {
+        char magic[8];
+        uint64_t blocks;
+        uint64_t keys;
+        uint64_t sourceBytes;    // size of the accounts file it was saved with
+        int64_t sourceModified;  // and its modification time
+        uint64_t reserved[3];
+    };
+
+    static_assert(sizeof(FileHeader) == 64, "FileHeader is a fixed 64-byte record");
+
+    uint64_t mix(uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return key;
+    }
+
+    uint64_t load64(const char* p) {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    uint32_t load32(const char* p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+}
+
+AccountFilter::AccountFilter(size_t expectedKeys, size_t bitsPerKey) : keys(0) {
+    size_t bits = std::max<size_t>(expectedKeys, 1) * std::max<size_t>(bitsPerKey, 1);
+    blockCount = (bits + 511) / 512;
+    blocks.reset(new Block[blockCount]());
+}
+
+// Account numbers are short, so up to 16 bytes are read as two (possibly
+// overlapping) fixed-size loads and mixed once with the MurmurHash3
+// finalizer; longer ones go through FNV-1a first
+uint64_t AccountFilter::hashOf(const std::string& accountNumber) {
+    const char* p = accountNumber.data();
+    uint64_t length = accountNumber.size();
+    uint64_t a = 0;
+    uint64_t b = 0;
+    if (length > 16) {
+        a = 0xcbf29ce484222325ULL;
+        for (uint64_t i = 0; i < length; ++i) {
+            a = (a ^ static_cast<unsigned char>(p[i])) * 0x100000001b3ULL;
+        }
+    } else if (length >= 8) {
+        a = load64(p);
+        b = load64(p + length - 8);
+    } else if (length >= 4) {
+        a = load32(p);
+        b = load32(p + length - 4);
+    } else {
+        for (uint64_t i = 0; i < length; ++i) {
+            a = a << 8 | static_cast<unsigned char>(p[i]);
+        }
+    }
+    return mix(a ^ (b * 0x9e3779b97f4a7c15ULL) ^ (length << 56));
+}
+
+void AccountFilter::insert(const std::string& accountNumber) {
+    uint64_t hash = hashOf(accountNumber);
+    Block& block = blocks[blockOf(hash)];
+    uint32_t low = static_cast<uint32_t>(hash);
+    for (size_t i = 0; i < WORDS; ++i) {
+        block.words[i].fetch_or(bitOf(low, i), std::memory_order_relaxed);
+    }
+    keys.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t AccountFilter::getKeys() const {
+    return static_cast<size_t>(keys.load(std::memory_order_relaxed));
+}
+
+size_t AccountFilter::getBytes() const {
+    return blockCount * sizeof(Block);
+}
+
+size_t AccountFilter::getBlocks() const {
+    return blockCount;
+}
+
+void AccountFilter::exportWords(uint64_t* out) const {
+    for (size_t b = 0; b < blockCount; ++b) {
+        for (size_t i = 0; i < WORDS; ++i) {
+            *out++ = blocks[b].words[i].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+std::unique_ptr<AccountFilter> AccountFilter::importWords(const uint64_t* words, size_t blocks, uint64_t keys) {
+    std::unique_ptr<AccountFilter> filter(new AccountFilter(blocks * 512, 1));
+    for (size_t b = 0; b < blocks; ++b) {
+        for (size_t i = 0; i < WORDS; ++i) {
+            filter->blocks[b].words[i].store(*words++, std::memory_order_relaxed);
+        }
+    }
+    filter->keys.store(keys, std::memory_order_relaxed);
+    return filter;
+}
+
+std::string AccountFilter::pathFor(const std::string& accountsPath) {
+    return accountsPath + ".bloom";
+}
+
+bool AccountFilter::encodeFor(const std::string& accountsPath, std::string& bytes) const {
+    FileHeader header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+    header.blocks = blockCount;
+    header.keys = keys.load(std::memory_order_relaxed);
+    if (!FileManager::stampOf(accountsPath, header.sourceBytes, header.sourceModified)) {
+        return false;
+    }
+    bytes.resize(sizeof(header) + blockCount * WORDS * sizeof(uint64_t));
+    std::memcpy(&bytes[0], &header, sizeof(header));
+    std::vector<uint64_t> words(blockCount * WORDS);
+    exportWords(words.data());
+    std::memcpy(&bytes[sizeof(header)], words.data(), words.size() * sizeof(uint64_t));
+    return true;
+}
+
+bool AccountFilter::saveFor(const std::string& accountsPath) const {
+    std::string bytes;
+    if (!encodeFor(accountsPath, bytes)) {
+        return false;
+    }
+    std::string path = pathFor(accountsPath);
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) {
+        std::remove(path.c_str());
+    }
+    return ok;
+}
+
+std::unique_ptr<AccountFilter> AccountFilter::loadFor(const std::string& accountsPath) {
+    uint64_t bytes;
+    int64_t modified;
+    if (!FileManager::stampOf(accountsPath, bytes, modified)) {
+        return nullptr;
+    }
+    std::string path = pathFor(accountsPath);
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return nullptr;
+    }
+    FileHeader header;
+    std::unique_ptr<AccountFilter> filter;
+    if (std::fread(&header, sizeof(header), 1, file) == 1 &&
+        std::memcmp(header.magic, MAGIC, sizeof(header.magic)) == 0 && header.blocks > 0 &&
+        header.blocks < (uint64_t(1) << 32) && header.sourceBytes == bytes && header.sourceModified == modified) {
+        std::vector<uint64_t> words(static_cast<size_t>(header.blocks) * WORDS);
+        if (std::fread(words.data(), sizeof(uint64_t), words.size(), file) == words.size()) {
+            filter = importWords(words.data(), static_cast<size_t>(header.blocks), header.keys);
+        }
+    }
+    std::fclose(file);
+    return filter;
+}
@@ -0,0 +1,98 @@
+#ifndef ACCOUNTFILTER_H
+#define ACCOUNTFILTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Blocked Bloom filter over account numbers, in front of the account index.
+//
+// Each key maps to one 64-byte block (one cache line) and sets one bit in
+// each of its eight words, so a lookup touches a single line and a miss
+// usually fails on one of the first words it checks. No false negatives: an
+// account number the filter rejects is certainly not in the store. Inserts
+// set bits with fetch_or, so accounts can be added while sessions look
+// others up.
+//
+// The filter is saved next to the accounts file (<path>.bloom) together
+// with that file's size and modification time; loadFor() only accepts it for
+// the exact file it was built from.
+class AccountFilter {
+public:
+    static const char MAGIC[8];
+    static const size_t DEFAULT_BITS_PER_KEY = 12;
+
+    explicit AccountFilter(size_t expectedKeys, size_t bitsPerKey = DEFAULT_BITS_PER_KEY);
+
+    AccountFilter(const AccountFilter&) = delete;
+    AccountFilter& operator=(const AccountFilter&) = delete;
+
+    void insert(const std::string& accountNumber);
+
+    // false: the account does not exist; true: it probably does
+    bool mayContain(const std::string& accountNumber) const {
+        uint64_t hash = hashOf(accountNumber);
+        const Block& block = blocks[blockOf(hash)];
+        uint32_t low = static_cast<uint32_t>(hash);
+        for (size_t i = 0; i < WORDS; ++i) {
+            if (!(block.words[i].load(std::memory_order_relaxed) & bitOf(low, i))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t getKeys() const;
+    size_t getBytes() const;
+
+    // Bloom filter file for an accounts file
+    static std::string pathFor(const std::string& accountsPath);
+
+    // Write the filter for accountsPath, as that file is now
+    bool saveFor(const std::string& accountsPath) const;
+
+    // The contents saveFor() would write, for writing them elsewhere
+    bool encodeFor(const std::string& accountsPath, std::string& bytes) const;
+
+    // The saved filter for accountsPath; nullptr if there is none or the
+    // accounts file has changed since it was saved
+    static std::unique_ptr<AccountFilter> loadFor(const std::string& accountsPath);
+
+    // The bit array as getBlocks() * 8 words, to store it elsewhere (a
+    // warm-start image) and rebuild the filter from it
+    size_t getBlocks() const;
+    void exportWords(uint64_t* out) const;
+    static std::unique_ptr<AccountFilter> importWords(const uint64_t* words, size_t blocks, uint64_t keys);
+
+    // Stable across runs and builds, since filters are saved
+    static uint64_t hashOf(const std::string& accountNumber);
+
+private:
+    static const size_t WORDS = 8;
+
+    struct alignas(64) Block {
+        std::atomic<uint64_t> words[WORDS];
+    };
+
+    static_assert(sizeof(Block) == 64, "a filter block is one cache line");
+
+    std::unique_ptr<Block[]> blocks;
+    size_t blockCount;
+    std::atomic<uint64_t> keys;
+
+    // High half of the hash picks the block (multiply-shift, no modulo)
+    size_t blockOf(uint64_t hash) const {
+        return static_cast<size_t>(((hash >> 32) * blockCount) >> 32);
+    }
+
+    // Low half picks one bit per word through a per-word odd multiplier
+    static uint64_t bitOf(uint32_t low, size_t word) {
+        static const uint32_t SALT[WORDS] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+                                             0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+        return uint64_t(1) << ((low * SALT[word]) >> 26);
+    }
+};
+
+#endif // ACCOUNTFILTER_H
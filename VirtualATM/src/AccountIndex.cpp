@@ -0,0 +1,60 @@
+#include "AccountIndex.h"
+#include <cstring>
+
+const uint32_t AccountIndex::NOT_FOUND;
+const size_t AccountIndex::BUCKET_BYTES;
+
+AccountIndex::AccountIndex(size_t expectedKeys) {
+    size_t capacity = 16;
+    while (capacity * 7 < expectedKeys * 10) {
+        capacity <<= 1;
+    }
+    mask = capacity - 1;
+    buckets.reset(capacity);
+}
+
+// The capacity must be the power of two the table was built with
+AccountIndex::AccountIndex(const void* table, size_t capacity) {
+    mask = capacity - 1;
+    buckets.reset(capacity);
+    std::memcpy(static_cast<void*>(buckets.data()), table, capacity * sizeof(Bucket));
+}
+
+uint32_t AccountIndex::findIn(const void* table, size_t capacity, uint64_t key) {
+    const char* bytes = static_cast<const char*>(table);
+    size_t tableMask = capacity - 1;
+    for (size_t i = hash(key) & tableMask;; i = (i + 1) & tableMask) {
+        uint64_t current;
+        std::memcpy(&current, bytes + i * BUCKET_BYTES, sizeof(current));
+        if (current == key) {
+            uint32_t slot;
+            std::memcpy(&slot, bytes + i * BUCKET_BYTES + sizeof(uint64_t), sizeof(slot));
+            return slot;
+        }
+        if (current == 0) {
+            return NOT_FOUND;
+        }
+    }
+}
+
+// Key 0 marks an empty slot; AccountKey never produces it
+bool AccountIndex::insert(uint64_t key, uint32_t slot) {
+    for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+        uint64_t current = buckets[i].key.load(std::memory_order_acquire);
+        if (current == 0 && buckets[i].key.compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+            buckets[i].slot = slot;
+            return true;
+        }
+        if (current == key) {
+            return false;
+        }
+    }
+}
+
+size_t AccountIndex::getCapacity() const {
+    return mask + 1;
+}
+
+const void* AccountIndex::getTable() const {
+    return buckets.data();
+}
@@ -0,0 +1,81 @@
+#ifndef ACCOUNTINDEX_H
+#define ACCOUNTINDEX_H
+
+#include "LargeArray.h"
+#include <atomic>
+#include <cstdint>
+
+// Fixed-capacity hash index from AccountKey to a dense account slot.
+//
+// Open addressing with linear probing over a power-of-two table sized for
+// at most 70% load. Key and slot share a 16-byte bucket, so a lookup costs
+// one cache miss. Inserts claim a slot with compare-and-swap, so several
+// threads can build the index at once; lookups are lock-free but must not
+// overlap the build.
+class AccountIndex {
+public:
+    static const uint32_t NOT_FOUND = UINT32_MAX;
+
+    explicit AccountIndex(size_t expectedKeys);
+
+    // Copy of a table saved from getTable(), e.g. in a warm-start image
+    AccountIndex(const void* table, size_t capacity);
+
+    // false if the key is already present (the existing slot is kept)
+    bool insert(uint64_t key, uint32_t slot);
+
+    uint32_t find(uint64_t key) const {
+        for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+            uint64_t current = buckets[i].key.load(std::memory_order_acquire);
+            if (current == key) {
+                return buckets[i].slot;
+            }
+            if (current == 0) {
+                return NOT_FOUND;
+            }
+        }
+    }
+
+    // find() on a saved table in place (e.g. mapped from a warm-start
+    // image), without copying it
+    static uint32_t findIn(const void* table, size_t capacity, uint64_t key);
+
+    // Hint that find(key) is coming, so batch scans can overlap the misses
+    void prefetch(uint64_t key) const {
+#if defined(__GNUC__)
+        __builtin_prefetch(&buckets[hash(key) & mask]);
+#else
+        (void)key;
+#endif
+    }
+
+    size_t getCapacity() const;
+
+    // The buckets as stored: getCapacity() records of BUCKET_BYTES, with no
+    // pointers, so the table can be written out and read back as is
+    const void* getTable() const;
+    static const size_t BUCKET_BYTES = 16;
+
+private:
+    struct Bucket {
+        std::atomic<uint64_t> key;
+        uint32_t slot;
+    };
+
+    static_assert(sizeof(Bucket) == BUCKET_BYTES, "a bucket is a fixed 16-byte record");
+
+    size_t mask;
+    LargeArray<Bucket> buckets; // zeroed: every key starts empty
+
+    // 64-bit finalizer from MurmurHash3
+    static uint64_t hash(uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return key;
+    }
+};
+
+#endif // ACCOUNTINDEX_H
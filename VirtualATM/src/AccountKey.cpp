@@ -0,0 +1,65 @@
+#include "AccountKey.h"
+
+namespace {
+    const int VALUE_BITS = 57;
+    const uint64_t VALUE_MASK = (uint64_t(1) << VALUE_BITS) - 1;
+    const uint64_t HASHED_LENGTH = 127;
+}
+
+uint64_t AccountKey::encode(const std::string& accountNumber) {
+    return encode(accountNumber.data(), accountNumber.size());
+}
+
+uint64_t AccountKey::encode(const char* digits, size_t length) {
+    if (length == 0 || length > MAX_DIGITS) {
+        return 0;
+    }
+    uint64_t value = 0;
+    for (size_t i = 0; i < length; ++i) {
+        unsigned digit = static_cast<unsigned char>(digits[i]) - '0';
+        if (digit > 9) {
+            return 0;
+        }
+        value = value * 10 + digit;
+    }
+    return (static_cast<uint64_t>(length) << VALUE_BITS) | value;
+}
+
+// FNV-1a, finished with a 64-bit mixer
+uint64_t AccountKey::hashed(const std::string& accountNumber) {
+    uint64_t h = 1469598103934665603ULL;
+    for (unsigned char c : accountNumber) {
+        h = (h ^ c) * 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (HASHED_LENGTH << VALUE_BITS) | (h & VALUE_MASK);
+}
+
+uint64_t AccountKey::ledgerKey(const std::string& accountNumber) {
+    uint64_t key = encode(accountNumber);
+    return key != 0 ? key : hashed(accountNumber);
+}
+
+uint64_t AccountKey::fromValue(uint64_t value, size_t digits) {
+    return (static_cast<uint64_t>(digits) << VALUE_BITS) | value;
+}
+
+std::string AccountKey::decode(uint64_t key) {
+    char digits[MAX_DIGITS];
+    return std::string(digits, decodeTo(key, digits));
+}
+
+size_t AccountKey::decodeTo(uint64_t key, char* out) {
+    size_t length = static_cast<size_t>(key >> VALUE_BITS);
+    uint64_t value = key & VALUE_MASK;
+    if (length == 0 || length > MAX_DIGITS) {
+        return 0;
+    }
+    for (size_t i = length; i-- > 0;) {
+        out[i] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }
+    return length;
+}
@@ -0,0 +1,37 @@
+#ifndef ACCOUNTKEY_H
+#define ACCOUNTKEY_H
+
+#include <cstdint>
+#include <string>
+
+// Compact numeric form of an account number for binary formats.
+//
+// Account numbers are digit strings of 1-17 characters. The key keeps the
+// length in the top bits so leading zeros survive the round trip:
+// [ 7-bit length | 57-bit value ]. Key 0 is never a valid account. Other
+// numbers get a hashed key with length 127 so ledger entries can still name
+// them; those keys decode to nothing.
+class AccountKey {
+public:
+    static const size_t MAX_DIGITS = 17;
+
+    // 0 if the account number is empty, too long or not all digits
+    static uint64_t encode(const std::string& accountNumber);
+    static uint64_t encode(const char* digits, size_t length);
+
+    // Hashed key for any number, distinct from every encode() key
+    static uint64_t hashed(const std::string& accountNumber);
+
+    // encode(), or hashed() for a number encode() cannot represent
+    static uint64_t ledgerKey(const std::string& accountNumber);
+
+    // Key for a number already known to have exactly `digits` digits
+    static uint64_t fromValue(uint64_t value, size_t digits);
+
+    static std::string decode(uint64_t key);
+
+    // Write the digits to out (at least MAX_DIGITS bytes); returns the length
+    static size_t decodeTo(uint64_t key, char* out);
+};
+
+#endif // ACCOUNTKEY_H
@@ -0,0 +1,580 @@
+#include "AccountStore.h"
+#include "AccountKey.h"
+#include "FileManager.h"
+#include "Metrics.h"
+#include "StoreImage.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+
+namespace {
+    // Seqlock write section over the accounts one posting changes, which
+    // also keeps their versions for open snapshots; taken under their
+    // stripe locks
+    class WriteSection {
+    public:
+        WriteSection(SnapshotManager& snapshots, Account& account, Account* other = nullptr)
+            : first(account), second(other != &account ? other : nullptr) {
+            uint64_t epoch = snapshots.currentEpoch();
+            first.beginWrite();
+            snapshots.beforeWrite(first, epoch);
+            if (second) {
+                second->beginWrite();
+                snapshots.beforeWrite(*second, epoch);
+            }
+        }
+
+        ~WriteSection() {
+            if (second) {
+                second->endWrite();
+            }
+            first.endWrite();
+        }
+
+        WriteSection(const WriteSection&) = delete;
+        WriteSection& operator=(const WriteSection&) = delete;
+
+    private:
+        Account& first;
+        Account* second;
+    };
+}
+
+AccountStore::AccountStore()
+    : index(new AccountIndex(0)), filter(new AccountFilter(0)), stripes(new std::mutex[STRIPE_COUNT]),
+      journalAck(JournalAck::Async), dailyLimitCents(0) {}
+
+AccountStore::~AccountStore() {
+    for (auto& account : accounts) {
+        snapshots.release(account);
+    }
+}
+
+// Start from the warm-start image when it matches the accounts file;
+// otherwise parse the file and build the lookup index, reusing the saved
+// Bloom filter if the file has not changed since it was written. A tiered
+// store's crash leaves the newest balances in the image: those are
+// exported to the file first.
+bool AccountStore::load(const std::string& path, bool useImage) {
+    ATM_TRACE_SPAN("AccountStore::load");
+    FileManager::initializeDataFile(path);
+    if (!StoreImage::recover(path)) {
+        std::cerr << "Warning: Could not recover " << path << " from its image" << std::endl;
+    }
+    StoreImage image;
+    if (useImage && image.open(path)) {
+        install(image.loadAccounts(), path, image.loadFilter(), image.loadIndex());
+        return true;
+    }
+    std::unique_ptr<AccountFilter> saved = AccountFilter::loadFor(path);
+    install(FileManager::loadAccounts(path), path, std::move(saved), nullptr);
+    return true;
+}
+
+void AccountStore::adopt(std::vector<Account> loaded, const std::string& path) {
+    install(std::move(loaded), path, nullptr, nullptr);
+}
+
+void AccountStore::install(std::vector<Account> loaded, const std::string& path,
+                           std::unique_ptr<AccountFilter> savedFilter, std::unique_ptr<AccountIndex> savedIndex) {
+    for (auto& account : accounts) {
+        snapshots.release(account);
+    }
+    accounts = std::move(loaded);
+    dataFilePath = path;
+    // Numbers AccountKey cannot encode (not digits, or too long) are
+    // looked up by their hashed key; the image's index never holds them
+    otherNumbers.clear();
+    index = std::move(savedIndex);
+    bool building = !index;
+    if (building) {
+        index.reset(new AccountIndex(accounts.size()));
+    }
+    for (size_t i = 0; i < accounts.size(); ++i) {
+        std::string number = accounts[i].getAccountNumber();
+        uint64_t key = AccountKey::encode(number);
+        if (key == 0) {
+            if (!otherNumbers.emplace(AccountKey::hashed(number), i).second) {
+                std::cerr << "Warning: Account " << number << " shares a hashed key; its postings are not replicated"
+                          << std::endl;
+            }
+        } else if (building) {
+            index->insert(key, static_cast<uint32_t>(i));
+        }
+    }
+    // A saved filter built for more keys than were loaded still has no
+    // false negatives; one for fewer might, so it is rebuilt
+    if (savedFilter && savedFilter->getKeys() >= accounts.size()) {
+        filter = std::move(savedFilter);
+    } else {
+        filter.reset(new AccountFilter(accounts.size()));
+        for (const auto& account : accounts) {
+            filter->insert(account.getAccountNumber());
+        }
+    }
+    if (velocity) {
+        velocity->attach(accounts.size());
+    }
+}
+
+// Copy the accounts from a snapshot, then write the copy
+bool AccountStore::save() {
+    return saveTo(dataFilePath);
+}
+
+bool AccountStore::saveTo(const std::string& path) {
+    return write(path, false);
+}
+
+// Save, then image the same copy of the accounts for the next start
+bool AccountStore::checkpoint() {
+    return write(dataFilePath, true);
+}
+
+// With a background backend, saves of the data file are formatted here
+// and written behind the caller's back (the journal is already on its
+// way); any other write first waits for those, so none lands after it
+bool AccountStore::write(const std::string& path, bool withImage) {
+    ATM_TRACE_SPAN("AccountStore::save");
+    std::lock_guard<std::mutex> saving(saveMutex);
+    std::vector<Account> snapshot;
+    snapshot.reserve(accounts.size());
+    {
+        StoreSnapshot view = openSnapshot();
+        for (size_t i = 0; i < view.size(); ++i) {
+            snapshot.push_back(view.copy(i));
+        }
+    }
+    bool journaled = true;
+    if (saver) {
+        if (!withImage && path == dataFilePath) {
+            std::string text;
+            if (!FileManager::formatAccounts(snapshot, text)) {
+                return false;
+            }
+            saver->save(path, std::move(text));
+            return true;
+        }
+        journaled = saver->wait();
+    }
+    if (asyncJournal) {
+        journaled = asyncJournal->flush() && journaled;
+    }
+    if (journal) {
+        std::lock_guard<std::mutex> lock(journalMutex);
+        journaled = journal->flush();
+    }
+    bool saved = FileManager::saveAccounts(snapshot, path);
+    if (saved && !filter->saveFor(path)) {
+        std::remove(AccountFilter::pathFor(path).c_str()); // never leave a stale filter behind
+    }
+    bool imaged = !withImage || (saved && StoreImage::write(path, snapshot, *index, *filter));
+    return saved && journaled && imaged;
+}
+
+bool AccountStore::openJournal(const std::string& path) {
+    if (io) {
+        std::unique_ptr<AsyncJournal> writer(new AsyncJournal(*io));
+        if (!writer->open(path)) {
+            return false;
+        }
+        asyncJournal = std::move(writer);
+        return true;
+    }
+    std::unique_ptr<LedgerWriter> writer(new LedgerWriter());
+    if (!writer->open(path)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(journalMutex);
+    journal = std::move(writer);
+    return true;
+}
+
+// Saves hand the filter's stamp over to the new accounts file once it is
+// in place, as a blocking save does. The hook runs on the completion
+// thread, so the filter goes to disk as a save of its own.
+bool AccountStore::persistAsync(const std::string& backend, JournalAck ack, std::string& error) {
+    std::unique_ptr<AsyncIO> created = AsyncIO::create(backend, error);
+    if (!created) {
+        return false;
+    }
+    io = std::move(created);
+    journalAck = ack;
+    saver.reset(new AsyncSaver(*io, [this](const std::string& path) {
+        if (path != dataFilePath) {
+            return; // the filter's own save
+        }
+        std::string bytes;
+        if (filter->encodeFor(path, bytes)) {
+            saver->save(AccountFilter::pathFor(path), std::move(bytes));
+        } else {
+            std::remove(AccountFilter::pathFor(path).c_str());
+        }
+    }));
+    return true;
+}
+
+const AsyncIO* AccountStore::getIo() const {
+    return io.get();
+}
+
+AsyncJournal* AccountStore::getAsyncJournal() {
+    return asyncJournal.get();
+}
+
+AsyncSaver* AccountStore::getSaver() {
+    return saver.get();
+}
+
+void AccountStore::setVelocityRules(std::unique_ptr<VelocityEngine> engine) {
+    velocity = std::move(engine);
+    if (velocity) {
+        velocity->attach(accounts.size());
+    }
+}
+
+bool AccountStore::loadVelocityRules(const std::string& path, std::string& error) {
+    std::vector<VelocityRule> rules;
+    std::unique_ptr<VelocityEngine> engine(new VelocityEngine());
+    if (!VelocityEngine::loadRules(path, rules, error) || !engine->compile(rules, error)) {
+        return false;
+    }
+    setVelocityRules(std::move(engine));
+    return true;
+}
+
+bool AccountStore::replicateTo(const std::string& socketPath, ReplicaAck mode, std::string& error) {
+    std::unique_ptr<ReplicationSender> sender(new ReplicationSender());
+    if (!sender->connect(socketPath, mode, error)) {
+        return false;
+    }
+    replica = std::move(sender);
+    return true;
+}
+
+ReplicationSender* AccountStore::getReplica() {
+    return replica.get();
+}
+
+// Entries arrive in posting order per account, so the balance never dips
+// below what the primary saw; daily totals follow when a limit is set here
+bool AccountStore::applyReplicated(const LedgerEntry& entry) {
+    Account* found = findKey(entry.accountKey);
+    if (!found) {
+        return false;
+    }
+    Account& account = *found;
+    int64_t delta = Ledger::balanceDelta(entry);
+    if (delta == 0) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(stripeFor(account));
+    WriteSection writing(snapshots, account);
+    account.updateBalance(static_cast<double>(delta) / 100.0);
+    if (dailyLimitCents > 0 && entry.type == static_cast<uint8_t>(LedgerType::Withdrawal)) {
+        account.addWithdrawn(static_cast<int32_t>(entry.timestampUs / 86400000000LL), entry.amountCents);
+    }
+    return true;
+}
+
+void AccountStore::setDailyLimit(int64_t cents) {
+    dailyLimitCents = cents > 0 ? cents : 0;
+}
+
+int64_t AccountStore::getDailyLimit() const {
+    return dailyLimitCents;
+}
+
+int64_t AccountStore::remainingToday(const Account& account) const {
+    if (dailyLimitCents == 0) {
+        return -1;
+    }
+    int32_t today = static_cast<int32_t>(std::time(nullptr) / 86400);
+    AccountSnapshot current = account.snapshot();
+    int64_t withdrawn = current.usageDay == today ? current.withdrawnTodayCents : 0;
+    return std::max<int64_t>(0, dailyLimitCents - withdrawn);
+}
+
+// Once the pin is published, passing through every stripe waits out the
+// postings that started in the pinned epoch; later ones keep versions
+StoreSnapshot AccountStore::openSnapshot() {
+    StoreSnapshot snapshot(*this, snapshots, snapshots.pin());
+    for (size_t i = 0; i < STRIPE_COUNT; ++i) {
+        std::lock_guard<std::mutex> lock(stripes[i]);
+    }
+    return snapshot;
+}
+
+uint64_t AccountStore::getLiveVersions() const {
+    return snapshots.getLiveVersions();
+}
+
+Account* AccountStore::find(const std::string& accountNumber) {
+    ATM_TRACE_SPAN("AccountStore::find");
+    if (!filter->mayContain(accountNumber)) {
+        return nullptr;
+    }
+    uint64_t key = AccountKey::encode(accountNumber);
+    Account* account = findKey(key != 0 ? key : AccountKey::hashed(accountNumber));
+    return key != 0 || (account && account->getAccountNumber() == accountNumber) ? account : nullptr;
+}
+
+// Encoded keys are in the index, hashed ones in otherNumbers
+Account* AccountStore::findKey(uint64_t key) {
+    uint32_t slot = index->find(key);
+    if (slot != AccountIndex::NOT_FOUND) {
+        return &accounts[slot];
+    }
+    auto it = otherNumbers.find(key);
+    return it != otherNumbers.end() ? &accounts[it->second] : nullptr;
+}
+
+const AccountFilter& AccountStore::getFilter() const {
+    return *filter;
+}
+
+size_t AccountStore::size() const {
+    return accounts.size();
+}
+
+Account& AccountStore::at(size_t position) {
+    return accounts[position];
+}
+
+size_t AccountStore::positionOf(const Account& account) const {
+    return static_cast<size_t>(&account - accounts.data());
+}
+
+const std::string& AccountStore::getDataFilePath() const {
+    return dataFilePath;
+}
+
+std::mutex& AccountStore::stripeFor(const Account& account) const {
+    return stripes[positionOf(account) % STRIPE_COUNT];
+}
+
+namespace {
+    void countOutcome(TransactionKind kind, bool succeeded) {
+        const AtmMetrics& metrics = AtmMetrics::get();
+        int index = static_cast<int>(kind);
+        MetricsRegistry::instance().add(succeeded ? metrics.transactionsSucceeded[index]
+                                                  : metrics.transactionsFailed[index]);
+    }
+
+    LedgerType ledgerTypeOf(TransactionKind kind) {
+        switch (kind) {
+            case TransactionKind::Withdrawal: return LedgerType::Withdrawal;
+            case TransactionKind::Deposit: return LedgerType::Deposit;
+            case TransactionKind::BalanceInquiry: return LedgerType::BalanceInquiry;
+            case TransactionKind::Transfer: return LedgerType::TransferOut;
+        }
+        return LedgerType::BalanceInquiry;
+    }
+
+    LedgerEntry postingEntry(const Account& account, LedgerType type, double amount, bool succeeded,
+                             uint32_t terminal) {
+        LedgerEntry entry;
+        entry.accountKey = AccountKey::ledgerKey(account.getAccountNumber());
+        entry.timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                                std::chrono::system_clock::now().time_since_epoch()).count();
+        entry.amountCents = type == LedgerType::BalanceInquiry ? 0 : Ledger::toCents(amount);
+        entry.type = static_cast<uint8_t>(type);
+        entry.flags = succeeded ? 0 : LEDGER_FLAG_FAILED;
+        entry.reserved = 0;
+        entry.terminal = terminal;
+        return entry;
+    }
+
+    void transferLegs(const Transfer& transfer, const Account& from, bool succeeded, uint32_t terminal,
+                      LedgerEntry (&legs)[2]) {
+        legs[0] = postingEntry(from, LedgerType::TransferOut, transfer.getAmount(), succeeded, terminal);
+        legs[1] = legs[0];
+        legs[1].accountKey = AccountKey::ledgerKey(transfer.getTarget().getAccountNumber());
+        legs[1].type = static_cast<uint8_t>(LedgerType::TransferIn);
+    }
+}
+
+bool AccountStore::journaling() const {
+    return journal || asyncJournal;
+}
+
+// Journal entries are appended after the posting, so two postings on one
+// account may reach the journal out of order; reconciliation only sums them.
+// Returns the background journal's sequence for awaitJournal, else 0.
+uint64_t AccountStore::journalPostings(const LedgerEntry* entries, size_t count) {
+    if (asyncJournal) {
+        return asyncJournal->append(entries, count);
+    }
+    std::lock_guard<std::mutex> lock(journalMutex);
+    for (size_t i = 0; i < count; ++i) {
+        journal->append(entries[i]);
+    }
+    return 0;
+}
+
+// Like durable replication, a durable journal holds the posting thread,
+// never the account's lock, until its batch is synced
+void AccountStore::awaitJournal(uint64_t sequence) {
+    if (sequence != 0 && journalAck == JournalAck::Durable) {
+        asyncJournal->waitDurable(sequence);
+    }
+}
+
+// Durable replication holds the posting thread, but never the account's
+// lock, until the standby has the entry on disk
+void AccountStore::awaitReplica(uint64_t sequence) {
+    if (sequence != 0 && replica->getMode() == ReplicaAck::Durable) {
+        replica->waitDurable(sequence);
+    }
+}
+
+bool AccountStore::apply(Transaction& transaction, Account& account, uint32_t terminal) {
+    ATM_TRACE_SPAN("AccountStore::apply");
+    if (transaction.getKind() == TransactionKind::BalanceInquiry) {
+        return inquire(static_cast<BalanceInquiry&>(transaction), account, terminal);
+    }
+    bool succeeded;
+    bool checked = (velocity || dailyLimitCents > 0) && transaction.getKind() == TransactionKind::Withdrawal;
+    if (checked && velocity) {
+        velocity->prefetch(positionOf(account));
+    }
+    LedgerType type = ledgerTypeOf(transaction.getKind());
+    LedgerEntry entry;
+    uint64_t sequence = 0;
+    {
+        const AtmMetrics& metrics = AtmMetrics::get();
+        ScopedTimer timer(metrics.transactionDuration[static_cast<int>(transaction.getKind())],
+                          AtmMetrics::TRANSACTION_SAMPLE_INTERVAL);
+        std::lock_guard<std::mutex> lock(stripeFor(account));
+        ATM_TRACE_SPAN("Transaction::process");
+        WriteSection writing(snapshots, account);
+        if (checked) {
+            succeeded = checkedWithdrawal(static_cast<Withdrawal&>(transaction), account);
+        } else {
+            succeeded = transaction.process(account);
+        }
+        if (replica) {
+            entry = postingEntry(account, type, transaction.getAmount(), succeeded, terminal);
+            sequence = replica->publish(&entry, 1);
+        }
+    }
+    countOutcome(transaction.getKind(), succeeded);
+    uint64_t journaled = 0;
+    if (journaling()) {
+        if (!replica) {
+            entry = postingEntry(account, type, transaction.getAmount(), succeeded, terminal);
+        }
+        journaled = journalPostings(&entry, 1);
+    }
+    awaitReplica(sequence);
+    awaitJournal(journaled);
+    return succeeded;
+}
+
+// Inquiries only read the balance, so they skip the account's lock and
+// never wait behind a posting
+bool AccountStore::inquire(BalanceInquiry& inquiry, Account& account, uint32_t terminal) {
+    LedgerEntry entry;
+    uint64_t sequence = 0;
+    {
+        const AtmMetrics& metrics = AtmMetrics::get();
+        ScopedTimer timer(metrics.transactionDuration[static_cast<int>(TransactionKind::BalanceInquiry)],
+                          AtmMetrics::TRANSACTION_SAMPLE_INTERVAL);
+        ATM_TRACE_SPAN("Transaction::process");
+        inquiry.process(account);
+        if (replica || journaling()) {
+            entry = postingEntry(account, LedgerType::BalanceInquiry, 0.0, true, terminal);
+        }
+        if (replica) {
+            sequence = replica->publish(&entry, 1);
+        }
+    }
+    countOutcome(TransactionKind::BalanceInquiry, true);
+    uint64_t journaled = 0;
+    if (journaling()) {
+        journaled = journalPostings(&entry, 1);
+    }
+    awaitReplica(sequence);
+    awaitJournal(journaled);
+    return true;
+}
+
+// Called under the account's lock, which also guards its velocity state
+// and daily total; only completed withdrawals count towards either
+bool AccountStore::checkedWithdrawal(Withdrawal& withdrawal, Account& account) {
+    int64_t cents = Ledger::toCents(withdrawal.getAmount());
+    int64_t now = static_cast<int64_t>(std::time(nullptr));
+    int32_t today = static_cast<int32_t>(now / 86400);
+    if (dailyLimitCents > 0 && account.getWithdrawnOn(today) + cents > dailyLimitCents) {
+        withdrawal.declineOverDailyLimit();
+        MetricsRegistry::instance().add(AtmMetrics::get().dailyLimitDeclined);
+        return false;
+    }
+    size_t position = positionOf(account);
+    if (velocity) {
+        uint16_t rule = velocity->check(position, cents, now);
+        if (rule != 0) {
+            withdrawal.decline(rule);
+            MetricsRegistry::instance().add(AtmMetrics::get().velocityDeclined);
+            return false;
+        }
+    }
+    bool succeeded = withdrawal.process(account);
+    if (succeeded) {
+        if (velocity) {
+            velocity->record(position, cents);
+        }
+        if (dailyLimitCents > 0) {
+            account.addWithdrawn(today, cents);
+        }
+    }
+    return succeeded;
+}
+
+// Lock both stripes in a fixed order so opposite transfers cannot deadlock
+bool AccountStore::transfer(Transfer& transfer, Account& from, uint32_t terminal) {
+    ATM_TRACE_SPAN("AccountStore::transfer");
+    LedgerEntry legs[2];
+    uint64_t sequence = 0;
+    bool succeeded = lockedTransfer(transfer, from, terminal, legs, sequence);
+    countOutcome(TransactionKind::Transfer, succeeded);
+    uint64_t journaled = 0;
+    if (journaling()) {
+        if (!replica) {
+            transferLegs(transfer, from, succeeded, terminal, legs);
+        }
+        journaled = journalPostings(legs, 2);
+    }
+    awaitReplica(sequence);
+    awaitJournal(journaled);
+    return succeeded;
+}
+
+bool AccountStore::lockedTransfer(Transfer& transfer, Account& from, uint32_t terminal, LedgerEntry (&legs)[2],
+                                  uint64_t& sequence) {
+    ScopedTimer timer(AtmMetrics::get().transactionDuration[static_cast<int>(TransactionKind::Transfer)],
+                      AtmMetrics::TRANSACTION_SAMPLE_INTERVAL);
+    auto process = [&] {
+        WriteSection writing(snapshots, from, &transfer.getTarget());
+        bool succeeded = transfer.process(from);
+        if (replica) {
+            transferLegs(transfer, from, succeeded, terminal, legs);
+            sequence = replica->publish(legs, 2);
+        }
+        return succeeded;
+    };
+    std::mutex& first = stripeFor(from);
+    std::mutex& second = stripeFor(transfer.getTarget());
+    if (&first == &second) {
+        std::lock_guard<std::mutex> lock(first);
+        return process();
+    }
+    std::mutex& lower = (&first < &second) ? first : second;
+    std::mutex& upper = (&first < &second) ? second : first;
+    std::lock_guard<std::mutex> lockLower(lower);
+    std::lock_guard<std::mutex> lockUpper(upper);
+    return process();
+}
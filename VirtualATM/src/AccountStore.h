@@ -0,0 +1,152 @@
+#ifndef ACCOUNTSTORE_H
+#define ACCOUNTSTORE_H
+
+#include "Account.h"
+#include "AccountFilter.h"
+#include "AccountIndex.h"
+#include "AsyncPersistence.h"
+#include "Ledger.h"
+#include "Replication.h"
+#include "Snapshot.h"
+#include "Transaction.h"
+#include "VelocityRules.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Shared account table behind one or more ATM sessions.
+//
+// Postings lock a striped mutex and open the account's seqlock write
+// section, so balance inquiries and whole-table readers never take the
+// lock (see Account). The journal, limits, replication and background I/O
+// are optional; each is described at the call that turns it on.
+class AccountStore {
+private:
+    static const size_t STRIPE_COUNT = 1024;
+
+    std::vector<Account> accounts;        // never resized once loaded, so find()'s pointers stay valid
+    std::unique_ptr<AccountIndex> index;  // AccountKey -> position
+    std::unordered_map<uint64_t, size_t> otherNumbers; // AccountKey::hashed -> position, for the rest
+    // Rejects most unknown numbers before the index is touched; saved with
+    // the accounts file and reused while that file is unchanged
+    std::unique_ptr<AccountFilter> filter;
+    std::unique_ptr<std::mutex[]> stripes; // chosen by position: different accounts rarely contend
+    std::string dataFilePath;
+    std::mutex saveMutex;
+    std::unique_ptr<LedgerWriter> journal;
+    std::mutex journalMutex;
+    std::unique_ptr<AsyncIO> io;
+    std::unique_ptr<AsyncJournal> asyncJournal;
+    std::unique_ptr<AsyncSaver> saver;
+    JournalAck journalAck;
+    std::unique_ptr<VelocityEngine> velocity;
+    int64_t dailyLimitCents;
+    std::unique_ptr<ReplicationSender> replica;
+    SnapshotManager snapshots;            // versions kept for open StoreSnapshots
+
+    std::mutex& stripeFor(const Account& account) const;
+    Account* findKey(uint64_t key);
+    bool checkedWithdrawal(Withdrawal& withdrawal, Account& account);
+    bool inquire(BalanceInquiry& inquiry, Account& account, uint32_t terminal);
+    bool lockedTransfer(Transfer& transfer, Account& from, uint32_t terminal, LedgerEntry (&legs)[2],
+                        uint64_t& sequence);
+    bool journaling() const;
+    uint64_t journalPostings(const LedgerEntry* entries, size_t count);
+    void awaitJournal(uint64_t sequence);
+    void awaitReplica(uint64_t sequence);
+    void install(std::vector<Account> loaded, const std::string& path, std::unique_ptr<AccountFilter> savedFilter,
+                 std::unique_ptr<AccountIndex> savedIndex);
+    bool write(const std::string& path, bool withImage);
+
+public:
+    AccountStore();
+    ~AccountStore();
+
+    AccountStore(const AccountStore&) = delete;
+    AccountStore& operator=(const AccountStore&) = delete;
+
+    // Load the accounts file, creating sample data if it does not exist;
+    // from its warm-start image when that is current (and useImage is set)
+    bool load(const std::string& path, bool useImage = true);
+
+    // Take ownership of an already built account list (with no snapshot open)
+    void adopt(std::vector<Account> loaded, const std::string& path);
+
+    // Write every account, as of one moment, back to the data file (and
+    // flush the journal); with a background backend, the write is only
+    // queued
+    bool save();
+
+    // Same, to another file; the data file path is unchanged
+    bool saveTo(const std::string& path);
+
+    // Save, and write the warm-start image (StoreImage: accounts, index and
+    // filter) the next load() copies in instead of parsing the text; on
+    // clean shutdown, or as a checkpoint
+    bool checkpoint();
+
+    // Append postings to this ledger, for end-of-day reconciliation, from
+    // now on; open it before any session starts posting
+    bool openJournal(const std::string& path);
+
+    // Write the journal and saves of the data file through a background
+    // I/O backend ("uring", "threads" or "auto") from now on; Durable
+    // postings wait for their journal entry's sync. Call before
+    // openJournal() and before any session starts posting.
+    bool persistAsync(const std::string& backend, JournalAck ack, std::string& error);
+    const AsyncIO* getIo() const;
+    AsyncJournal* getAsyncJournal();
+    AsyncSaver* getSaver();
+
+    // Check withdrawals against these compiled rules, under the account's
+    // lock, from now on; set them before any session starts posting
+    void setVelocityRules(std::unique_ptr<VelocityEngine> engine);
+
+    // Parse, compile and set a rules file; false with a message on error
+    bool loadVelocityRules(const std::string& path, std::string& error);
+
+    // Most each account may withdraw per UTC day, in cents; 0 (the
+    // default) turns the limit off. The day's total lives in the Account
+    // and is saved with it. Set before sessions start.
+    void setDailyLimit(int64_t cents);
+    int64_t getDailyLimit() const;
+
+    // What the account may still withdraw today; -1 without a limit
+    int64_t remainingToday(const Account& account) const;
+
+    // Ship every posting to a standby listening on socketPath from now on,
+    // while the account is still locked; connect before any session starts
+    // posting
+    bool replicateTo(const std::string& socketPath, ReplicaAck mode, std::string& error);
+    ReplicationSender* getReplica();
+
+    // Apply a posting shipped from a primary (standby side); false if the
+    // account does not exist here
+    bool applyReplicated(const LedgerEntry& entry);
+
+    // Consistent view of every account as of now; postings continue, so
+    // scans and saves run alongside them
+    StoreSnapshot openSnapshot();
+    uint64_t getLiveVersions() const;
+
+    // Bloom filter, then hash lookup; nullptr if the account does not exist
+    Account* find(const std::string& accountNumber);
+    const AccountFilter& getFilter() const;
+
+    size_t size() const;
+    Account& at(size_t position);
+    size_t positionOf(const Account& account) const;
+    const std::string& getDataFilePath() const;
+
+    // Run a single-account transaction under the account's lock (balance
+    // inquiries read without it); terminal identifies the poster in the
+    // journal
+    bool apply(Transaction& transaction, Account& account, uint32_t terminal = 0);
+
+    // Move money between two accounts atomically
+    bool transfer(Transfer& transfer, Account& from, uint32_t terminal = 0);
+};
+
+#endif // ACCOUNTSTORE_H
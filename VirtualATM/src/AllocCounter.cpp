@@ -0,0 +1,87 @@
+#include "AllocCounter.h"
+#include <cstdlib>
+#include <new>
+
+namespace {
+    // Zero-initialized, so touching them never allocates
+    thread_local uint64_t threadAllocations = 0;
+    thread_local uint64_t threadBytes = 0;
+}
+
+bool AllocCounter::isCounting() {
+#ifdef ATM_COUNT_ALLOCS
+    return true;
+#else
+    return false;
+#endif
+}
+
+AllocStats AllocCounter::current() {
+    return AllocStats{threadAllocations, threadBytes};
+}
+
+#ifdef ATM_COUNT_ALLOCS
+
+namespace {
+    void* countedAllocate(std::size_t size) {
+        ++threadAllocations;
+        threadBytes += size;
+        return std::malloc(size ? size : 1);
+    }
+
+    void* countedAllocateOrThrow(std::size_t size) {
+        while (true) {
+            if (void* memory = countedAllocate(size)) {
+                return memory;
+            }
+            std::new_handler handler = std::get_new_handler();
+            if (!handler) {
+                throw std::bad_alloc();
+            }
+            handler();
+        }
+    }
+}
+
+// Replacement global allocation functions (aligned forms keep the default)
+void* operator new(std::size_t size) {
+    return countedAllocateOrThrow(size);
+}
+
+void* operator new[](std::size_t size) {
+    return countedAllocateOrThrow(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return countedAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return countedAllocate(size);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+
+#endif // ATM_COUNT_ALLOCS
@@ -0,0 +1,43 @@
+#ifndef ALLOCCOUNTER_H
+#define ALLOCCOUNTER_H
+
+#include <cstdint>
+
+// Heap allocation accounting.
+//
+// Built into atm_bench only, not atm_core. With ATM_COUNT_ALLOCS its
+// translation unit replaces the global operator new/delete with versions
+// that count calls and requested bytes per thread; the app and the tools
+// keep the stock allocator. Without ATM_COUNT_ALLOCS every count reads zero.
+struct AllocStats {
+    uint64_t allocations;
+    uint64_t bytes;
+};
+
+class AllocCounter {
+public:
+    // Whether the counting operator new is compiled in
+    static bool isCounting();
+
+    // Running totals for the calling thread
+    static AllocStats current();
+};
+
+// Allocations made by the calling thread since construction
+class AllocScope {
+private:
+    AllocStats start;
+
+public:
+    AllocScope() : start(AllocCounter::current()) {}
+
+    AllocStats elapsed() const {
+        AllocStats now = AllocCounter::current();
+        return AllocStats{now.allocations - start.allocations, now.bytes - start.bytes};
+    }
+
+    uint64_t allocations() const { return elapsed().allocations; }
+    uint64_t bytes() const { return elapsed().bytes; }
+};
+
+#endif // ALLOCCOUNTER_H
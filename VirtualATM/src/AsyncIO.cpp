@@ -0,0 +1,498 @@
+#include "AsyncIO.h"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define ATM_HAVE_IO_URING 1
+#endif
+
+AsyncIO::AsyncIO() : submissions(0), completed(0) {}
+
+AsyncIO::~AsyncIO() = default;
+
+uint64_t AsyncIO::getSubmissions() const {
+    return submissions.load(std::memory_order_relaxed);
+}
+
+uint64_t AsyncIO::getCompleted() const {
+    return completed.load(std::memory_order_relaxed);
+}
+
+#ifndef _WIN32
+namespace {
+    // One queued write or sync; owned by the backend until its callback ran
+    struct Op {
+        IoCallback done;
+        int fd;
+        bool sync;
+        const char* data;
+        size_t size;
+        uint64_t offset;
+        size_t written;
+        uint64_t order; // thread pool only: position in queueing order
+    };
+
+    Op* writeOp(int fd, const void* data, size_t size, uint64_t offset, IoCallback done) {
+        return new Op{std::move(done), fd, false, static_cast<const char*>(data), size, offset, 0, 0};
+    }
+
+    Op* syncOp(int fd, IoCallback done) {
+        return new Op{std::move(done), fd, true, nullptr, 0, 0, 0, 0};
+    }
+
+#ifdef ATM_HAVE_IO_URING
+    // io_uring through its system calls: the submission and completion
+    // rings are mapped once; callers fill SQEs under a mutex and one
+    // io_uring_enter submits them, a reaper thread waits for CQEs and runs
+    // the callbacks. Syncs carry IOSQE_IO_DRAIN, which holds them until
+    // everything submitted earlier has completed.
+    class UringIO : public AsyncIO {
+    public:
+        static const unsigned ENTRIES = 64;
+
+        UringIO()
+            : ringFd(-1), sqRing(MAP_FAILED), cqRing(MAP_FAILED), sqeArea(MAP_FAILED), sqRingBytes(0),
+              cqRingBytes(0), sqeBytes(0), queued(0), inFlight(0) {}
+
+        ~UringIO() override {
+            if (reaper.joinable()) {
+                drain();
+                std::lock_guard<std::mutex> lock(mutex);
+                io_uring_sqe& sqe = nextSqe();
+                sqe.opcode = IORING_OP_NOP;
+                sqe.user_data = 0; // tells the reaper to stop
+                pushSqe();
+                submitLocked();
+            }
+            if (reaper.joinable()) {
+                reaper.join();
+            }
+            if (sqeArea != MAP_FAILED) {
+                munmap(sqeArea, sqeBytes);
+            }
+            if (cqRing != MAP_FAILED && cqRing != sqRing) {
+                munmap(cqRing, cqRingBytes);
+            }
+            if (sqRing != MAP_FAILED) {
+                munmap(sqRing, sqRingBytes);
+            }
+            if (ringFd >= 0) {
+                ::close(ringFd);
+            }
+        }
+
+        bool setup(std::string& error) {
+            io_uring_params params;
+            std::memset(&params, 0, sizeof(params));
+            ringFd = static_cast<int>(::syscall(__NR_io_uring_setup, ENTRIES, &params));
+            if (ringFd < 0) {
+                error = std::string("io_uring_setup: ") + std::strerror(errno);
+                return false;
+            }
+            if (!probe(error)) {
+                return false;
+            }
+            sqRingBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cqRingBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (single) {
+                sqRingBytes = cqRingBytes = std::max(sqRingBytes, cqRingBytes);
+            }
+            sqRing = mmap(nullptr, sqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                          IORING_OFF_SQ_RING);
+            if (sqRing != MAP_FAILED) {
+                cqRing = single ? sqRing
+                                : mmap(nullptr, cqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                       ringFd, IORING_OFF_CQ_RING);
+            }
+            sqeBytes = params.sq_entries * sizeof(io_uring_sqe);
+            if (cqRing != MAP_FAILED) {
+                sqeArea = mmap(nullptr, sqeBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                               IORING_OFF_SQES);
+            }
+            if (sqeArea == MAP_FAILED) {
+                error = std::string("mapping the io_uring rings: ") + std::strerror(errno);
+                return false;
+            }
+            char* sq = static_cast<char*>(sqRing);
+            char* cq = static_cast<char*>(cqRing);
+            sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+            sqEntries = params.sq_entries;
+            sqes = static_cast<io_uring_sqe*>(sqeArea);
+            cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+            reaper = std::thread(&UringIO::reap, this);
+            return true;
+        }
+
+        void write(int fd, const void* data, size_t size, uint64_t offset, IoCallback done) override {
+            queue(writeOp(fd, data, size, offset, std::move(done)));
+        }
+
+        void sync(int fd, IoCallback done) override {
+            queue(syncOp(fd, std::move(done)));
+        }
+
+        void submit() override {
+            std::lock_guard<std::mutex> lock(mutex);
+            submitLocked();
+        }
+
+        void drain() override {
+            std::unique_lock<std::mutex> lock(mutex);
+            submitLocked();
+            settled.wait(lock, [this] { return inFlight == 0 && overflow.empty(); });
+        }
+
+        const char* getName() const override {
+            return "io_uring";
+        }
+
+    private:
+        int ringFd;
+        void* sqRing;
+        void* cqRing;
+        void* sqeArea;
+        size_t sqRingBytes;
+        size_t cqRingBytes;
+        size_t sqeBytes;
+        unsigned* sqTail;
+        unsigned sqMask;
+        unsigned* sqArray;
+        unsigned sqEntries;
+        io_uring_sqe* sqes;
+        unsigned* cqHead;
+        unsigned* cqTail;
+        unsigned cqMask;
+        io_uring_cqe* cqes;
+
+        std::mutex mutex;
+        std::condition_variable settled;
+        unsigned queued;   // SQEs in the ring not yet handed to the kernel
+        unsigned inFlight; // operations in the ring or the kernel
+        std::deque<Op*> overflow; // queued by callbacks while the ring was full
+        std::thread reaper;
+
+        // Kernels before 5.6 have neither the probe nor IORING_OP_WRITE, so a
+        // failed probe means the same as a missing opcode
+        bool probe(std::string& error) {
+            const unsigned OPS = 256;
+            std::vector<char> buffer(sizeof(io_uring_probe) + OPS * sizeof(io_uring_probe_op), 0);
+            io_uring_probe* probed = reinterpret_cast<io_uring_probe*>(buffer.data());
+            if (::syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probed, OPS) < 0) {
+                error = std::string("io_uring probe: ") + std::strerror(errno);
+                return false;
+            }
+            for (unsigned opcode : {IORING_OP_NOP, IORING_OP_WRITE, IORING_OP_FSYNC}) {
+                if (opcode > probed->last_op || !(probed->ops[opcode].flags & IO_URING_OP_SUPPORTED)) {
+                    error = "io_uring: the kernel lacks opcode " + std::to_string(opcode);
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // At most sqEntries operations are in flight, so the ring always has
+        // room for the next SQE and the completion ring (twice as large)
+        // never overflows. Callers wait for room; the reaper only ever
+        // requeues operations already counted, and callbacks running on it
+        // park theirs in the overflow list instead of waiting for itself.
+        // Overflowed operations go in before anything queued after them.
+        void queue(Op* op) {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (std::this_thread::get_id() == reaper.get_id()) {
+                if (inFlight >= sqEntries || !overflow.empty()) {
+                    overflow.push_back(op);
+                    return;
+                }
+            } else if (inFlight >= sqEntries || !overflow.empty()) {
+                submitLocked();
+                settled.wait(lock, [this] { return inFlight < sqEntries && overflow.empty(); });
+            }
+            inFlight++;
+            fill(op);
+        }
+
+        // Runs on the reaper after a round of completions freed some room
+        void admitOverflow() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (overflow.empty()) {
+                    return;
+                }
+                while (!overflow.empty() && inFlight < sqEntries) {
+                    inFlight++;
+                    fill(overflow.front());
+                    overflow.pop_front();
+                }
+                submitLocked();
+            }
+            settled.notify_all();
+        }
+
+        io_uring_sqe& nextSqe() {
+            io_uring_sqe& sqe = sqes[*sqTail & sqMask];
+            std::memset(&sqe, 0, sizeof(sqe));
+            return sqe;
+        }
+
+        // The release store publishes the SQE to the kernel
+        void pushSqe() {
+            unsigned tail = *sqTail;
+            sqArray[tail & sqMask] = tail & sqMask;
+            __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+            queued++;
+        }
+
+        void fill(Op* op) {
+            io_uring_sqe& sqe = nextSqe();
+            sqe.fd = op->fd;
+            if (op->sync) {
+                sqe.opcode = IORING_OP_FSYNC;
+                sqe.flags = IOSQE_IO_DRAIN;
+                sqe.fsync_flags = IORING_FSYNC_DATASYNC;
+            } else {
+                sqe.opcode = IORING_OP_WRITE;
+                sqe.addr = reinterpret_cast<uint64_t>(op->data + op->written);
+                sqe.len = static_cast<uint32_t>(std::min<size_t>(op->size - op->written, 1u << 30));
+                sqe.off = op->offset + op->written;
+            }
+            sqe.user_data = reinterpret_cast<uint64_t>(op);
+            pushSqe();
+        }
+
+        void submitLocked() {
+            while (queued > 0) {
+                long consumed = ::syscall(__NR_io_uring_enter, ringFd, queued, 0, 0, nullptr, 0);
+                if (consumed < 0) {
+                    if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    return; // left in the ring for the next submission
+                }
+                queued -= static_cast<unsigned>(consumed);
+                submissions.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        void reap() {
+            std::vector<io_uring_cqe> ready(ENTRIES * 2);
+            for (;;) {
+                unsigned head = *cqHead;
+                unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+                if (head == tail) {
+                    ::syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+                    continue;
+                }
+                size_t count = 0;
+                for (; head != tail && count < ready.size(); ++head) {
+                    ready[count++] = cqes[head & cqMask];
+                }
+                __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+                bool stop = false;
+                for (size_t i = 0; i < count; ++i) {
+                    if (ready[i].user_data == 0) {
+                        stop = true;
+                    } else {
+                        finish(reinterpret_cast<Op*>(ready[i].user_data), ready[i].res);
+                    }
+                }
+                if (stop) {
+                    return;
+                }
+                admitOverflow();
+            }
+        }
+
+        void finish(Op* op, int32_t result) {
+            if (!op->sync && result > 0 && op->written + static_cast<size_t>(result) < op->size) {
+                op->written += static_cast<size_t>(result);
+                std::lock_guard<std::mutex> lock(mutex);
+                fill(op);
+                submitLocked();
+                return;
+            }
+            int64_t outcome = result;
+            if (!op->sync && result >= 0) {
+                outcome = result == 0 && op->size > op->written ? -EIO : static_cast<int64_t>(op->size);
+            }
+            op->done(outcome);
+            delete op;
+            completed.fetch_add(1, std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                inFlight--;
+            }
+            settled.notify_all();
+        }
+    };
+
+    const unsigned UringIO::ENTRIES;
+#endif
+
+    // Fallback: pwrite and fdatasync on a few threads. Operations are taken
+    // in queueing order; a sync waits until every earlier one is done,
+    // which never deadlocks because those were all taken before it.
+    class ThreadPoolIO : public AsyncIO {
+    public:
+        static const unsigned THREADS = 2;
+
+        ThreadPoolIO() : nextOrder(0), stopping(false) {
+            for (unsigned i = 0; i < THREADS; ++i) {
+                workers.emplace_back(&ThreadPoolIO::work, this);
+            }
+        }
+
+        ~ThreadPoolIO() override {
+            drain();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            ready.notify_all();
+            for (std::thread& worker : workers) {
+                worker.join();
+            }
+        }
+
+        void write(int fd, const void* data, size_t size, uint64_t offset, IoCallback done) override {
+            queue(writeOp(fd, data, size, offset, std::move(done)));
+        }
+
+        void sync(int fd, IoCallback done) override {
+            queue(syncOp(fd, std::move(done)));
+        }
+
+        void submit() override {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (queued.empty()) {
+                    return;
+                }
+                tasks.insert(tasks.end(), queued.begin(), queued.end());
+                queued.clear();
+            }
+            submissions.fetch_add(1, std::memory_order_relaxed);
+            ready.notify_all();
+        }
+
+        void drain() override {
+            submit();
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [this] { return outstanding.empty(); });
+        }
+
+        const char* getName() const override {
+            return "threads";
+        }
+
+    private:
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::condition_variable finished;
+        std::vector<Op*> queued;
+        std::deque<Op*> tasks;
+        std::set<uint64_t> outstanding; // orders of operations not yet done
+        uint64_t nextOrder;
+        bool stopping;
+        std::vector<std::thread> workers;
+
+        void queue(Op* op) {
+            std::lock_guard<std::mutex> lock(mutex);
+            op->order = nextOrder++;
+            outstanding.insert(op->order);
+            queued.push_back(op);
+        }
+
+        static int64_t run(Op* op) {
+            if (op->sync) {
+                return ::fdatasync(op->fd) == 0 ? 0 : -errno;
+            }
+            while (op->written < op->size) {
+                ssize_t written = ::pwrite(op->fd, op->data + op->written, op->size - op->written,
+                                           static_cast<off_t>(op->offset + op->written));
+                if (written < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (written <= 0) {
+                    return written < 0 ? -errno : -EIO;
+                }
+                op->written += static_cast<size_t>(written);
+            }
+            return static_cast<int64_t>(op->size);
+        }
+
+        void work() {
+            for (;;) {
+                Op* op;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+                    if (tasks.empty()) {
+                        return;
+                    }
+                    op = tasks.front();
+                    tasks.pop_front();
+                    if (op->sync) {
+                        finished.wait(lock, [this, op] { return *outstanding.begin() == op->order; });
+                    }
+                }
+                op->done(run(op));
+                completed.fetch_add(1, std::memory_order_relaxed);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    outstanding.erase(op->order);
+                }
+                finished.notify_all();
+                delete op;
+            }
+        }
+    };
+
+    const unsigned ThreadPoolIO::THREADS;
+}
+#endif
+
+std::unique_ptr<AsyncIO> AsyncIO::create(const std::string& backend, std::string& error) {
+#ifndef _WIN32
+    if (backend == "uring" || backend == "auto") {
+#ifdef ATM_HAVE_IO_URING
+        std::unique_ptr<UringIO> uring(new UringIO());
+        if (uring->setup(error)) {
+            return std::unique_ptr<AsyncIO>(uring.release());
+        }
+#else
+        error = "io_uring is not available in this build";
+#endif
+        if (backend == "uring") {
+            return nullptr;
+        }
+    }
+    if (backend == "threads" || backend == "auto") {
+        error.clear();
+        return std::unique_ptr<AsyncIO>(new ThreadPoolIO());
+    }
+    error = "unknown I/O backend '" + backend + "' (use uring, threads or auto)";
+    return nullptr;
+#else
+    error = "asynchronous I/O needs a POSIX system";
+    return nullptr;
+#endif
+}
@@ -0,0 +1,61 @@
+#ifndef ASYNCIO_H
+#define ASYNCIO_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+// Result of one asynchronous operation: bytes written (0 for a sync), or
+// -errno
+using IoCallback = std::function<void(int64_t result)>;
+
+// Background file writes and syncs for the persistence paths.
+//
+// Callers queue operations, then submit() hands everything queued to the
+// backend at once: io_uring takes the whole batch in one io_uring_enter
+// (the raw system calls; no liburing needed), the fallback hands it to a
+// small pool of threads running pwrite and fdatasync. A sync starts only
+// after every operation queued before it has completed, so a batch of
+// writes followed by a sync is durable when the sync's callback runs.
+// Callbacks run on the backend's completion thread (or a pool thread);
+// they may queue and submit further operations (queueing there never waits
+// for room in the ring), but must not block.
+class AsyncIO {
+public:
+    virtual ~AsyncIO();
+
+    // "uring", "threads", or "auto" (io_uring if the kernel allows it,
+    // otherwise threads); nullptr with a message if none can be used
+    static std::unique_ptr<AsyncIO> create(const std::string& backend, std::string& error);
+
+    // Queue a write of `size` bytes at `offset`; data must stay valid and
+    // unchanged until the callback runs. Short writes are continued, so
+    // the result is `size` or an error.
+    virtual void write(int fd, const void* data, size_t size, uint64_t offset, IoCallback done) = 0;
+
+    // Queue an fdatasync that waits for everything queued before it
+    virtual void sync(int fd, IoCallback done) = 0;
+
+    // Hand everything queued to the backend
+    virtual void submit() = 0;
+
+    // Submit, then wait until every operation's callback has returned
+    virtual void drain() = 0;
+
+    virtual const char* getName() const = 0;
+
+    // Submissions made and operations completed so far
+    uint64_t getSubmissions() const;
+    uint64_t getCompleted() const;
+
+protected:
+    AsyncIO();
+
+    std::atomic<uint64_t> submissions;
+    std::atomic<uint64_t> completed;
+};
+
+#endif // ASYNCIO_H
@@ -0,0 +1,335 @@
+#include "AsyncPersistence.h"
+#include "Metrics.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const size_t AsyncJournal::MAX_PENDING;
+
+namespace {
+    // Batches start out this large; they grow under load
+    const size_t BATCH_RESERVE = 4096;
+
+    int64_t steadyNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+bool AsyncJournal::parseAck(const std::string& name, JournalAck& mode) {
+    if (name == "async") {
+        mode = JournalAck::Async;
+    } else if (name == "durable") {
+        mode = JournalAck::Durable;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* AsyncJournal::ackName(JournalAck mode) {
+    return mode == JournalAck::Durable ? "durable" : "async";
+}
+
+AsyncJournal::AsyncJournal(AsyncIO& io)
+    : io(io), fd(-1), offset(0), batchOffset(0), batchBytes(0), batchInFlight(false), writeError(false), failed(false), appended(0), durable(0),
+      batchLast(0), batches(0), batchStartedNs(0) {}
+
+AsyncJournal::~AsyncJournal() {
+    close();
+}
+
+bool AsyncJournal::open(const std::string& path) {
+#ifndef _WIN32
+    close();
+    int file = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (file < 0) {
+        return false;
+    }
+    struct stat st;
+    if (::fstat(file, &st) != 0) {
+        ::close(file);
+        return false;
+    }
+    uint64_t size = static_cast<uint64_t>(st.st_size);
+    if (size == 0) {
+        char header[Ledger::HEADER_SIZE];
+        Ledger::fillHeader(header);
+        if (::pwrite(file, header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+            ::close(file);
+            return false;
+        }
+        size = sizeof(header);
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    fd = file;
+    offset = size;
+    failed = false;
+    filling.reserve(BATCH_RESERVE);
+    writing.reserve(BATCH_RESERVE);
+    return true;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+void AsyncJournal::close() {
+    if (fd < 0) {
+        return;
+    }
+    flush();
+    std::lock_guard<std::mutex> lock(mutex);
+#ifndef _WIN32
+    ::close(fd);
+#endif
+    fd = -1;
+}
+
+// Once a batch has failed, later entries are dropped: writing them after
+// the gap would leave a ledger that looks whole
+uint64_t AsyncJournal::append(const LedgerEntry* entries, size_t count) {
+    uint64_t sequence;
+    bool started = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (filling.size() >= MAX_PENDING) {
+            progress.wait(lock, [this] { return filling.size() < MAX_PENDING || failed; });
+        }
+        appended += count;
+        sequence = appended;
+        if (!failed) {
+            filling.insert(filling.end(), entries, entries + count);
+            if (!batchInFlight) {
+                startBatch();
+                started = true;
+            }
+        }
+    }
+    if (started) {
+        submitBatch();
+    }
+    return sequence;
+}
+
+// Called with the mutex held and no batch in flight; claims the filled
+// entries and their place in the file
+void AsyncJournal::startBatch() {
+    writing.swap(filling);
+    batchInFlight = true;
+    writeError = false;
+    batchLast = appended;
+    batchStartedNs = steadyNs();
+    batchOffset = offset;
+    batchBytes = writing.size() * sizeof(LedgerEntry);
+    offset += batchBytes;
+}
+
+// Called without the mutex, since queueing can wait for room in the
+// backend: the write and the sync go to it in one submission. Until the
+// sync completes nothing else touches the batch.
+void AsyncJournal::submitBatch() {
+    io.write(fd, writing.data(), batchBytes, batchOffset, [this](int64_t result) { batchWritten(result); });
+    io.sync(fd, [this](int64_t result) { batchSynced(result); });
+    io.submit();
+}
+
+void AsyncJournal::batchWritten(int64_t result) {
+    if (result < 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        writeError = true;
+    }
+}
+
+// Whatever arrived while the batch was in flight goes out as the next one
+void AsyncJournal::batchSynced(int64_t result) {
+    const AtmMetrics& metrics = AtmMetrics::get();
+    bool started = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        MetricsRegistry::instance().observe(metrics.journalSyncDuration,
+                                            static_cast<uint64_t>(steadyNs() - batchStartedNs));
+        if ((result < 0 || writeError) && !failed) {
+            failed = true;
+            filling.clear();
+            std::cerr << "Error: Journal write failed; postings are no longer journaled." << std::endl;
+        }
+        if (!failed) {
+            durable = batchLast;
+            batches++;
+            MetricsRegistry::instance().add(metrics.journalBatches);
+        }
+        writing.clear();
+        batchInFlight = false;
+        if (!filling.empty()) {
+            startBatch();
+            started = true;
+        }
+    }
+    if (started) {
+        submitBatch();
+    }
+    progress.notify_all();
+}
+
+bool AsyncJournal::waitDurable(uint64_t sequence) {
+    std::unique_lock<std::mutex> lock(mutex);
+    progress.wait(lock, [this, sequence] { return durable >= sequence || failed; });
+    return durable >= sequence;
+}
+
+bool AsyncJournal::flush() {
+    uint64_t last;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        last = appended;
+    }
+    return waitDurable(last);
+}
+
+uint64_t AsyncJournal::getAppended() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return appended;
+}
+
+uint64_t AsyncJournal::getDurable() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return durable;
+}
+
+uint64_t AsyncJournal::getBatches() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return batches;
+}
+
+AsyncSaver::AsyncSaver(AsyncIO& io, SavedHook saved)
+    : io(io), saved(std::move(saved)), writing(false), writeFailed(false), failedSinceWait(false),
+      fd(-1), savedCount(0), superseded(0) {}
+
+AsyncSaver::~AsyncSaver() {
+    wait();
+}
+
+void AsyncSaver::save(const std::string& path, std::string text) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (writing) {
+            for (Job& job : waiting) {
+                if (job.path == path) {
+                    job.text = std::move(text);
+                    superseded++;
+                    MetricsRegistry::instance().add(AtmMetrics::get().fileSavesSuperseded);
+                    return;
+                }
+            }
+            waiting.push_back(Job{path, std::move(text)});
+            return;
+        }
+        current.path = path;
+        current.text = std::move(text);
+        writing = true;
+    }
+    start();
+}
+
+// Called without the mutex, since queueing can wait for room in the
+// backend; while `writing` is set only the save in progress touches
+// current and fd. A save whose temporary file cannot be created is
+// skipped in favour of the next one waiting, if any.
+void AsyncSaver::start() {
+#ifndef _WIN32
+    for (;;) {
+        std::string temporary = current.path + ".tmp";
+        fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd >= 0) {
+            writeFailed = false;
+            if (!current.text.empty()) {
+                io.write(fd, current.text.data(), current.text.size(), 0, [this](int64_t result) {
+                    if (result < 0) {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        writeFailed = true;
+                    }
+                });
+            }
+            io.sync(fd, [this](int64_t result) { synced(result); });
+            io.submit();
+            return;
+        }
+        std::cerr << "Error: Could not open " << temporary << " for writing." << std::endl;
+        std::lock_guard<std::mutex> lock(mutex);
+        failedSinceWait = true;
+        if (waiting.empty()) {
+            break;
+        }
+        current = std::move(waiting.front());
+        waiting.pop_front();
+    }
+#endif
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        writing = false;
+    }
+    idle.notify_all();
+}
+
+void AsyncSaver::synced(int64_t result) {
+    std::string path;
+    bool renamed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+#ifndef _WIN32
+        ::close(fd);
+#endif
+        fd = -1;
+        path = current.path;
+        std::string temporary = path + ".tmp";
+        renamed = result == 0 && !writeFailed && std::rename(temporary.c_str(), path.c_str()) == 0;
+        if (renamed) {
+            savedCount++;
+            MetricsRegistry::instance().add(AtmMetrics::get().fileSaveBytes, current.text.size());
+        } else {
+            std::remove(temporary.c_str());
+            failedSinceWait = true;
+            std::cerr << "Error: Could not save " << path << std::endl;
+        }
+        current.text = std::string();
+    }
+    if (renamed && saved) {
+        saved(path);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (waiting.empty()) {
+            writing = false;
+            idle.notify_all();
+            return;
+        }
+        current = std::move(waiting.front());
+        waiting.pop_front();
+    }
+    start();
+}
+
+bool AsyncSaver::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return !writing; });
+    bool ok = !failedSinceWait;
+    failedSinceWait = false;
+    return ok;
+}
+
+uint64_t AsyncSaver::getSaved() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return savedCount;
+}
+
+uint64_t AsyncSaver::getSuperseded() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return superseded;
+}
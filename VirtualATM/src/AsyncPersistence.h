@@ -0,0 +1,138 @@
+#ifndef ASYNCPERSISTENCE_H
+#define ASYNCPERSISTENCE_H
+
+#include "AsyncIO.h"
+#include "Ledger.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// When a posting returns relative to its journal entry reaching the disk
+enum class JournalAck {
+    Async,  // once handed to the background writer
+    Durable // once the batch holding it is synced
+};
+
+// Group-committing journal appender on an AsyncIO backend.
+//
+// Postings append to an in-memory batch. Whenever no batch is being
+// written, the current one is submitted as one write plus one fdatasync
+// and the next batch starts filling, so postings never wait for the disk
+// and batches grow with the load. Every entry of a batch is durable once
+// its sync completes. Entries reach the file in append order, in the same
+// format LedgerWriter writes.
+class AsyncJournal {
+public:
+    // Appends wait while this many entries are waiting for a batch
+    static const size_t MAX_PENDING = 1 << 18;
+
+    static bool parseAck(const std::string& name, JournalAck& mode);
+    static const char* ackName(JournalAck mode);
+
+    explicit AsyncJournal(AsyncIO& io);
+    ~AsyncJournal();
+
+    AsyncJournal(const AsyncJournal&) = delete;
+    AsyncJournal& operator=(const AsyncJournal&) = delete;
+
+    // Append to path (created with its header if new)
+    bool open(const std::string& path);
+
+    // Write and sync everything appended, then close the file
+    void close();
+
+    // Sequence number of the last entry (the first is 1)
+    uint64_t append(const LedgerEntry* entries, size_t count);
+
+    // Wait until `sequence` is synced; false if a write or sync failed
+    bool waitDurable(uint64_t sequence);
+
+    // Wait until everything appended so far is synced
+    bool flush();
+
+    uint64_t getAppended() const;
+    uint64_t getDurable() const;
+    uint64_t getBatches() const;
+
+private:
+    AsyncIO& io;
+    int fd;
+    uint64_t offset;
+    uint64_t batchOffset; // where the batch in flight goes
+    size_t batchBytes;
+
+    mutable std::mutex mutex;
+    std::condition_variable progress;
+    std::vector<LedgerEntry> filling;
+    std::vector<LedgerEntry> writing;
+    bool batchInFlight;
+    bool writeError;  // the batch in flight failed to write
+    bool failed;      // a batch failed; nothing more is written
+    uint64_t appended;
+    uint64_t durable;
+    uint64_t batchLast; // sequence of the last entry in the batch in flight
+    uint64_t batches;
+    int64_t batchStartedNs;
+
+    void startBatch();
+    void submitBatch();
+    void batchWritten(int64_t result);
+    void batchSynced(int64_t result);
+};
+
+// Accounts file saves on an AsyncIO backend.
+//
+// The caller formats the text; it is written to <path>.tmp, synced and
+// renamed over path in the background, so the file on disk is always a
+// whole old or a whole new version. One save is written at a time and the
+// others wait in order; a save made while one for the same path is
+// waiting replaces the waiting one, since it holds the later state.
+class AsyncSaver {
+public:
+    // Runs on the backend's thread once a save is renamed into place
+    using SavedHook = std::function<void(const std::string& path)>;
+
+    AsyncSaver(AsyncIO& io, SavedHook saved);
+    ~AsyncSaver();
+
+    AsyncSaver(const AsyncSaver&) = delete;
+    AsyncSaver& operator=(const AsyncSaver&) = delete;
+
+    void save(const std::string& path, std::string text);
+
+    // Wait until nothing is being written; false if a save failed since
+    // the last wait
+    bool wait();
+
+    uint64_t getSaved() const;
+    uint64_t getSuperseded() const;
+
+private:
+    struct Job {
+        std::string path;
+        std::string text;
+    };
+
+    AsyncIO& io;
+    SavedHook saved;
+
+    mutable std::mutex mutex;
+    std::condition_variable idle;
+    Job current;
+    std::deque<Job> waiting;
+    bool writing;
+    bool writeFailed;
+    bool failedSinceWait;
+    int fd;
+    uint64_t savedCount;
+    uint64_t superseded;
+
+    void start();
+    void synced(int64_t result);
+};
+
+#endif // ASYNCPERSISTENCE_H
@@ -0,0 +1,153 @@
+#include "BlockCompressor.h"
+#include <cstring>
+
+const size_t BlockCompressor::MIN_MATCH;
+const size_t BlockCompressor::MAX_OFFSET;
+
+namespace {
+    const unsigned HASH_BITS = 14;
+
+    // The last bytes are always literals, so the decoder's match copies
+    // never run to the very end of a block
+    const size_t TAIL_LITERALS = 8;
+
+    uint32_t read32(const uint8_t* p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    uint32_t hash4(const uint8_t* p) {
+        return (read32(p) * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    void putLength(std::vector<uint8_t>& out, size_t length) {
+        while (length >= 255) {
+            out.push_back(255);
+            length -= 255;
+        }
+        out.push_back(static_cast<uint8_t>(length));
+    }
+
+    void putSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literalCount, size_t offset,
+                     size_t matchLength) {
+        size_t matchCode = matchLength ? matchLength - BlockCompressor::MIN_MATCH : 0;
+        uint8_t token = static_cast<uint8_t>((literalCount < 15 ? literalCount : 15) << 4 |
+                                             (matchCode < 15 ? matchCode : 15));
+        out.push_back(token);
+        if (literalCount >= 15) {
+            putLength(out, literalCount - 15);
+        }
+        out.insert(out.end(), literals, literals + literalCount);
+        if (matchLength == 0) {
+            return;
+        }
+        out.push_back(static_cast<uint8_t>(offset));
+        out.push_back(static_cast<uint8_t>(offset >> 8));
+        if (matchCode >= 15) {
+            putLength(out, matchCode - 15);
+        }
+    }
+
+    bool getLength(const uint8_t*& in, const uint8_t* end, size_t& length) {
+        uint8_t byte;
+        do {
+            if (in >= end) {
+                return false;
+            }
+            byte = *in++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+}
+
+size_t BlockCompressor::bound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+size_t BlockCompressor::compress(const uint8_t* input, size_t size, std::vector<uint8_t>& out) {
+    size_t start = out.size();
+    out.reserve(start + bound(size));
+    std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0); // position + 1; 0 is empty
+    size_t anchor = 0;
+    size_t position = 0;
+    size_t limit = size > TAIL_LITERALS + MIN_MATCH ? size - TAIL_LITERALS - MIN_MATCH : 0;
+    while (position < limit) {
+        uint32_t hash = hash4(input + position);
+        size_t candidate = table[hash];
+        table[hash] = static_cast<uint32_t>(position + 1);
+        if (candidate == 0 || position - (candidate - 1) > MAX_OFFSET ||
+            read32(input + candidate - 1) != read32(input + position)) {
+            ++position;
+            continue;
+        }
+        size_t match = candidate - 1;
+        size_t length = MIN_MATCH;
+        size_t maxLength = size - TAIL_LITERALS - position;
+        while (length < maxLength && input[match + length] == input[position + length]) {
+            ++length;
+        }
+        // Extend backwards over literals that also match
+        while (position > anchor && match > 0 && input[match - 1] == input[position - 1]) {
+            --position;
+            --match;
+            ++length;
+        }
+        putSequence(out, input + anchor, position - anchor, position - match, length);
+        position += length;
+        anchor = position;
+        if (position - 2 < limit) {
+            table[hash4(input + position - 2)] = static_cast<uint32_t>(position - 2 + 1);
+        }
+    }
+    putSequence(out, input + anchor, size - anchor, 0, 0);
+    return out.size() - start;
+}
+
+bool BlockCompressor::decompress(const uint8_t* input, size_t inputSize, uint8_t* out, size_t size) {
+    const uint8_t* in = input;
+    const uint8_t* end = input + inputSize;
+    size_t written = 0;
+    while (in < end) {
+        uint8_t token = *in++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !getLength(in, end, literals)) {
+            return false;
+        }
+        if (literals > static_cast<size_t>(end - in) || literals > size - written) {
+            return false;
+        }
+        std::memcpy(out + written, in, literals);
+        in += literals;
+        written += literals;
+        if (in == end) {
+            break; // the last sequence has no match
+        }
+        if (end - in < 2) {
+            return false;
+        }
+        size_t offset = static_cast<size_t>(in[0]) | static_cast<size_t>(in[1]) << 8;
+        in += 2;
+        size_t length = token & 15;
+        if (length == 15 && !getLength(in, end, length)) {
+            return false;
+        }
+        length += MIN_MATCH;
+        if (offset == 0 || offset > written || length > size - written) {
+            return false;
+        }
+        // Byte by byte where the match overlaps what it produces
+        const uint8_t* from = out + written - offset;
+        uint8_t* to = out + written;
+        if (offset >= length) {
+            std::memcpy(to, from, length);
+        } else {
+            for (size_t i = 0; i < length; ++i) {
+                to[i] = from[i];
+            }
+        }
+        written += length;
+    }
+    return written == size;
+}
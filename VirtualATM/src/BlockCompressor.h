@@ -0,0 +1,31 @@
+#ifndef BLOCKCOMPRESSOR_H
+#define BLOCKCOMPRESSOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Small LZ77 byte compressor for sealed ledger blocks.
+//
+// The format follows LZ4's block layout: a sequence is a token (literal
+// count in the high nibble, match length - 4 in the low one, 15 meaning
+// more length bytes follow, each adding up to 255), the literals, and a
+// 16-bit little-endian offset back into the output. The last sequence has
+// literals only. Matches are found through a hash table of 4-byte
+// prefixes, one probe per position, which favours speed over ratio.
+class BlockCompressor {
+public:
+    static const size_t MIN_MATCH = 4;
+    static const size_t MAX_OFFSET = 65535;
+
+    // Worst-case compressed size of `size` input bytes
+    static size_t bound(size_t size);
+
+    // Append the compressed form of input to out; returns its size
+    static size_t compress(const uint8_t* input, size_t size, std::vector<uint8_t>& out);
+
+    // Decode exactly `size` bytes into out; false on malformed input
+    static bool decompress(const uint8_t* input, size_t inputSize, uint8_t* out, size_t size);
+};
+
+#endif // BLOCKCOMPRESSOR_H
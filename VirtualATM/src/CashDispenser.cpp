@@ -0,0 +1,169 @@
+#include "CashDispenser.h"
+#include "ChangeTable.h"
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+const uint32_t CashDispenser::DENOMINATIONS[DispensePlan::MAX_CASSETTES] = {5, 10, 20, 50, 100};
+const uint32_t CashDispenser::MAX_DISPENSE;
+const uint32_t CashDispenser::LOW_WATER_PERCENT;
+const size_t DispensePlan::MAX_CASSETTES;
+
+namespace {
+    const size_t DENOMINATION_COUNT = DispensePlan::MAX_CASSETTES;
+    const uint32_t TABLE_UNIT = 5;
+    const size_t TABLE_UNITS = CashDispenser::MAX_DISPENSE / TABLE_UNIT;
+
+    using DollarTable = ChangeTable<DENOMINATION_COUNT, TABLE_UNITS>;
+
+    constexpr uint32_t DOLLAR_NOTES[DENOMINATION_COUNT] = {5, 10, 20, 50, 100};
+
+    // 32 subsets x 401 amounts, computed by the compiler into read-only data
+    constexpr DollarTable TABLE(DOLLAR_NOTES);
+
+    static_assert(TABLE.unit == TABLE_UNIT, "amounts are looked up in multiples of the smallest note");
+    static_assert(TABLE.notes[31][60 / TABLE_UNIT] == 2, "60 is 50 + 10");
+    static_assert(TABLE.notes[(1 << 2) | (1 << 3)][60 / TABLE_UNIT] == 3, "60 from 20s and 50s is 3 x 20");
+    static_assert(TABLE.notes[(1 << 2) | (1 << 3)][30 / TABLE_UNIT] == DollarTable::IMPOSSIBLE,
+                  "30 cannot be made from 20s and 50s");
+}
+
+CashDispenser::CashDispenser() : cassettes(), tableIndex(), cassetteCount(0) {}
+
+bool CashDispenser::parse(const std::string& spec, std::vector<Cassette>& cassettes, std::string& error) {
+    std::istringstream input(spec);
+    std::string item;
+    while (std::getline(input, item, ',')) {
+        Cassette cassette = {0, 0, 0};
+        unsigned long denomination = 0, count = 0, capacity = 0;
+        char extra = 0;
+        int fields = std::sscanf(item.c_str(), "%lu:%lu:%lu%c", &denomination, &count, &capacity, &extra);
+        if (fields != 2 && fields != 3) {
+            error = "expected denomination:count[:capacity], got \"" + item + "\"";
+            return false;
+        }
+        cassette.denomination = static_cast<uint32_t>(denomination);
+        cassette.count = static_cast<uint32_t>(count);
+        cassette.capacity = static_cast<uint32_t>(fields == 3 ? capacity : count);
+        cassettes.push_back(cassette);
+    }
+    return true;
+}
+
+bool CashDispenser::configure(const std::vector<Cassette>& loaded, std::string& error) {
+    if (loaded.empty() || loaded.size() > DispensePlan::MAX_CASSETTES) {
+        error = "between 1 and " + std::to_string(DispensePlan::MAX_CASSETTES) + " cassettes";
+        return false;
+    }
+    // Smallest denomination first, whatever the order given
+    std::vector<Cassette> sorted(loaded);
+    std::sort(sorted.begin(), sorted.end(),
+              [](const Cassette& a, const Cassette& b) { return a.denomination < b.denomination; });
+    unsigned used = 0;
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        size_t index = 0;
+        while (index < DENOMINATION_COUNT && DENOMINATIONS[index] != sorted[i].denomination) {
+            ++index;
+        }
+        if (index == DENOMINATION_COUNT || (used & (1u << index))) {
+            error = "unsupported or repeated denomination " + std::to_string(sorted[i].denomination);
+            return false;
+        }
+        used |= 1u << index;
+        cassettes[i] = sorted[i];
+        tableIndex[i] = static_cast<uint8_t>(index);
+    }
+    cassetteCount = loaded.size();
+    return true;
+}
+
+size_t CashDispenser::getCassetteCount() const {
+    return cassetteCount;
+}
+
+const Cassette& CashDispenser::getCassette(size_t index) const {
+    return cassettes[index];
+}
+
+int64_t CashDispenser::getTotalCents() const {
+    int64_t total = 0;
+    for (size_t i = 0; i < cassetteCount; ++i) {
+        total += static_cast<int64_t>(cassettes[i].denomination) * cassettes[i].count * 100;
+    }
+    return total;
+}
+
+// Look up the best mix from the cassettes in `mask`; when a cassette runs
+// short, use what it has and look the rest up without it. At most one
+// lookup per cassette.
+bool CashDispenser::fill(uint32_t units, unsigned mask, DispensePlan& out) const {
+    for (size_t i = 0; i < cassetteCount; ++i) {
+        out.notes[i] = 0;
+    }
+    out.noteCount = 0;
+    for (size_t round = 0; round <= cassetteCount; ++round) {
+        if (units == 0) {
+            return true;
+        }
+        unsigned tableMask = 0;
+        for (size_t i = 0; i < cassetteCount; ++i) {
+            if (mask & (1u << i)) {
+                tableMask |= 1u << tableIndex[i];
+            }
+        }
+        if (TABLE.notes[tableMask][units] == DollarTable::IMPOSSIBLE ||
+            out.noteCount + TABLE.notes[tableMask][units] > DollarTable::MAX_NOTES) {
+            return false;
+        }
+        const uint8_t* mix = TABLE.counts[tableMask][units];
+        size_t shortCassette = cassetteCount;
+        for (size_t i = 0; i < cassetteCount; ++i) {
+            if (out.notes[i] + mix[tableIndex[i]] > cassettes[i].count) {
+                shortCassette = i;
+                break;
+            }
+        }
+        if (shortCassette == cassetteCount) {
+            for (size_t i = 0; i < cassetteCount; ++i) {
+                out.notes[i] += mix[tableIndex[i]];
+                out.noteCount += mix[tableIndex[i]];
+            }
+            return true;
+        }
+        uint32_t take = cassettes[shortCassette].count - out.notes[shortCassette];
+        out.notes[shortCassette] += take;
+        out.noteCount += take;
+        units -= take * TABLE.units[tableIndex[shortCassette]];
+        mask &= ~(1u << shortCassette);
+    }
+    return units == 0;
+}
+
+bool CashDispenser::plan(int64_t cents, DispensePlan& out) const {
+    const int64_t UNIT_CENTS = TABLE_UNIT * 100;
+    if (cents <= 0 || cents % UNIT_CENTS != 0 || cents / UNIT_CENTS > static_cast<int64_t>(TABLE_UNITS)) {
+        return false;
+    }
+    uint32_t units = static_cast<uint32_t>(cents / UNIT_CENTS);
+    unsigned loaded = 0, plentiful = 0;
+    for (size_t i = 0; i < cassetteCount; ++i) {
+        if (cassettes[i].count > 0) {
+            loaded |= 1u << i;
+            if (static_cast<uint64_t>(cassettes[i].count) * 100 >
+                static_cast<uint64_t>(cassettes[i].capacity) * LOW_WATER_PERCENT) {
+                plentiful |= 1u << i;
+            }
+        }
+    }
+    // Spare the scarce denominations when the others can pay on their own
+    if (plentiful != loaded && plentiful != 0 && fill(units, plentiful, out)) {
+        return true;
+    }
+    return fill(units, loaded, out);
+}
+
+void CashDispenser::dispense(const DispensePlan& plan) {
+    for (size_t i = 0; i < cassetteCount; ++i) {
+        cassettes[i].count -= plan.notes[i];
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef CASHDISPENSER_H
+#define CASHDISPENSER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct Cassette {
+    uint32_t denomination; // whole currency units per note
+    uint32_t count;        // notes loaded
+    uint32_t capacity;     // notes the cassette holds when full
+};
+
+// Notes to pay out, one count per configured cassette
+struct DispensePlan {
+    static const size_t MAX_CASSETTES = 5;
+
+    uint32_t notes[MAX_CASSETTES];
+    uint32_t noteCount;
+};
+
+// Note inventory of one ATM and the planner that pays amounts out of it.
+//
+// Denominations are drawn from DENOMINATIONS (5, 10, 20, 50 and 100), for
+// which ChangeTable precomputes the minimum-note mix of every amount up to
+// MAX_DISPENSE from every subset of cassettes. A plan is a lookup for the
+// cassettes that can be used; a cassette below its low-water mark is left
+// out while the amount can be paid without it, and one with too few notes
+// is used up and the rest looked up without it. No search is ever done.
+//
+// One dispenser belongs to one terminal; it is not shared between threads.
+class CashDispenser {
+public:
+    static const uint32_t DENOMINATIONS[DispensePlan::MAX_CASSETTES];
+    static const uint32_t MAX_DISPENSE = 2000;
+    static const uint32_t LOW_WATER_PERCENT = 10;
+
+    CashDispenser();
+
+    // "denomination:count[:capacity],..." e.g. "20:2000,50:1000,100:500"
+    static bool parse(const std::string& spec, std::vector<Cassette>& cassettes, std::string& error);
+
+    // Cassettes are kept smallest denomination first
+    bool configure(const std::vector<Cassette>& cassettes, std::string& error);
+
+    // Choose notes for `cents` without changing the inventory; false if the
+    // amount cannot be paid from the notes loaded
+    bool plan(int64_t cents, DispensePlan& out) const;
+
+    // Take a plan's notes out of the cassettes
+    void dispense(const DispensePlan& plan);
+
+    size_t getCassetteCount() const;
+    const Cassette& getCassette(size_t index) const;
+    int64_t getTotalCents() const;
+
+private:
+    Cassette cassettes[DispensePlan::MAX_CASSETTES];
+    uint8_t tableIndex[DispensePlan::MAX_CASSETTES]; // position in DENOMINATIONS
+    size_t cassetteCount;
+
+    bool fill(uint32_t units, unsigned mask, DispensePlan& out) const;
+};
+
+#endif // CASHDISPENSER_H
@@ -0,0 +1,63 @@
+#ifndef CHANGETABLE_H
+#define CHANGETABLE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Minimum-note change-making table, built at compile time.
+//
+// For a fixed list of N denominations (in whole currency units, ascending)
+// the table holds, for every subset of them (a bit mask) and every amount up
+// to MAX_UNITS multiples of the smallest denomination, the note mix with the
+// fewest notes - or IMPOSSIBLE when the amount cannot be made from that
+// subset within MAX_NOTES notes. Planning a dispense is then a lookup.
+template <size_t N, size_t MAX_UNITS>
+struct ChangeTable {
+    static constexpr size_t MASKS = size_t(1) << N;
+    static constexpr uint8_t IMPOSSIBLE = 0xFF;
+    static constexpr uint8_t MAX_NOTES = 60;
+
+    uint32_t denominations[N] = {};
+    uint32_t unit = 0;             // the smallest denomination
+    uint32_t units[N] = {};        // denominations as multiples of unit
+    uint8_t notes[MASKS][MAX_UNITS + 1] = {};
+    uint8_t counts[MASKS][MAX_UNITS + 1][N] = {};
+
+    constexpr explicit ChangeTable(const uint32_t (&values)[N]) {
+        for (size_t i = 0; i < N; ++i) {
+            denominations[i] = values[i];
+        }
+        unit = values[0];
+        for (size_t i = 0; i < N; ++i) {
+            units[i] = values[i] / unit;
+        }
+        for (size_t mask = 0; mask < MASKS; ++mask) {
+            notes[mask][0] = 0;
+            for (size_t amount = 1; amount <= MAX_UNITS; ++amount) {
+                uint8_t best = IMPOSSIBLE;
+                size_t bestDenomination = 0;
+                // Largest first, so ties keep the larger notes
+                for (size_t i = N; i-- > 0;) {
+                    if (!(mask & (size_t(1) << i)) || units[i] > amount) {
+                        continue;
+                    }
+                    uint8_t before = notes[mask][amount - units[i]];
+                    if (before != IMPOSSIBLE && before + 1 < best && before + 1 <= MAX_NOTES) {
+                        best = static_cast<uint8_t>(before + 1);
+                        bestDenomination = i;
+                    }
+                }
+                notes[mask][amount] = best;
+                if (best != IMPOSSIBLE) {
+                    size_t from = amount - units[bestDenomination];
+                    for (size_t i = 0; i < N; ++i) {
+                        counts[mask][amount][i] = counts[mask][from][i];
+                    }
+                    counts[mask][amount][bestDenomination]++;
+                }
+            }
+        }
+    }
+};
+
+#endif // CHANGETABLE_H
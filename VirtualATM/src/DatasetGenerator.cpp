@@ -0,0 +1,237 @@
+#include "DatasetGenerator.h"
+#include "AccountKey.h"
+#include "FastRandom.h"
+#include "Ledger.h"
+#include "Parallel.h"
+#include "ZipfDistribution.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+const uint64_t DatasetGenerator::CHUNK_ACCOUNTS;
+const uint64_t DatasetGenerator::CHUNK_ENTRIES;
+const uint64_t DatasetGenerator::MAX_ACCOUNTS;
+
+namespace {
+    const uint64_t SERIALS_PER_BRANCH = 1000000;
+    const int64_t MAX_BALANCE_CENTS = 100000000000LL; // $1 billion
+    const uint64_t WITHDRAWAL_NOTES[] = {2000, 4000, 6000, 8000, 10000, 20000, 30000, 40000, 50000};
+
+    uint64_t gcd(uint64_t a, uint64_t b) {
+        while (b != 0) {
+            uint64_t t = a % b;
+            a = b;
+            b = t;
+        }
+        return a;
+    }
+
+    unsigned luhnCheckDigit(uint64_t value) {
+        unsigned sum = 0;
+        bool doubleIt = true;
+        for (; value > 0; value /= 10, doubleIt = !doubleIt) {
+            unsigned digit = static_cast<unsigned>(value % 10);
+            if (doubleIt) {
+                digit *= 2;
+                if (digit > 9) {
+                    digit -= 9;
+                }
+            }
+            sum += digit;
+        }
+        return (10 - sum % 10) % 10;
+    }
+
+    // Writes value right-aligned into exactly `width` digits
+    void putDigits(char* out, uint64_t value, int width) {
+        for (int i = width - 1; i >= 0; --i) {
+            out[i] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        }
+    }
+
+    size_t putUnsigned(char* out, uint64_t value) {
+        char digits[20];
+        size_t length = 0;
+        do {
+            digits[length++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value > 0);
+        for (size_t i = 0; i < length; ++i) {
+            out[i] = digits[length - 1 - i];
+        }
+        return length;
+    }
+}
+
+DatasetGenerator::DatasetGenerator(const DatasetConfig& config) : config(config) {
+    this->config.accounts = std::max<uint64_t>(1, std::min(config.accounts, MAX_ACCOUNTS));
+    uint64_t needed = (this->config.accounts + SERIALS_PER_BRANCH - 1) / SERIALS_PER_BRANCH;
+    branches = static_cast<unsigned>(std::min<uint64_t>(900, std::max<uint64_t>(config.branches, needed)));
+
+    threads = Parallel::resolveThreads(config.threads);
+
+    // Multiplier coprime with the account count: rank -> index is a bijection
+    // that scatters the hot accounts over the whole table
+    uint64_t n = this->config.accounts;
+    activityMultiplier = n > 1 ? 0x9E3779B97F4A7C15ULL % n : 1;
+    while (n > 1 && (activityMultiplier == 0 || gcd(activityMultiplier, n) != 1)) {
+        activityMultiplier = (activityMultiplier + 1) % n;
+    }
+}
+
+unsigned DatasetGenerator::getBranches() const {
+    return branches;
+}
+
+unsigned DatasetGenerator::getThreads() const {
+    return threads;
+}
+
+// Branch code, serial within the branch, Luhn check digit
+uint64_t DatasetGenerator::accountValue(uint64_t index) const {
+    uint64_t branch = 100 + index % branches;
+    uint64_t serial = index / branches;
+    uint64_t body = branch * SERIALS_PER_BRANCH + serial;
+    return body * 10 + luhnCheckDigit(body);
+}
+
+std::string DatasetGenerator::accountNumber(uint64_t index) const {
+    char digits[10];
+    putDigits(digits, accountValue(index), 10);
+    return std::string(digits, sizeof(digits));
+}
+
+uint64_t DatasetGenerator::activeAccount(uint64_t rank) const {
+    return ((rank - 1) % config.accounts) * activityMultiplier % config.accounts;
+}
+
+int64_t DatasetGenerator::drawBalanceCents(FastRandom& random) const {
+    double balance = 0.0;
+    switch (config.balanceModel) {
+        case BalanceModel::Uniform:
+            balance = random.uniform() * config.balanceScale;
+            break;
+        case BalanceModel::LogNormal: {
+            // Box-Muller; 1 - u keeps the logarithm finite
+            double u1 = 1.0 - random.uniform();
+            double u2 = random.uniform();
+            double normal = std::sqrt(-2.0 * std::log(u1)) * std::cos(6.283185307179586 * u2);
+            balance = config.balanceScale * std::exp(config.balanceShape * normal);
+            break;
+        }
+        case BalanceModel::Pareto:
+            balance = config.balanceScale / std::pow(1.0 - random.uniform(), 1.0 / config.balanceShape);
+            break;
+    }
+    return std::min(MAX_BALANCE_CENTS, std::max<int64_t>(0, std::llround(balance * 100.0)));
+}
+
+// number,pin,balance with two decimals, as Account::toString writes it
+size_t DatasetGenerator::formatAccount(uint64_t index, uint64_t pin, int64_t cents, char* out) const {
+    char* p = out;
+    putDigits(p, accountValue(index), 10);
+    p += 10;
+    *p++ = ',';
+    putDigits(p, pin, 4);
+    p += 4;
+    *p++ = ',';
+    p += putUnsigned(p, static_cast<uint64_t>(cents / 100));
+    *p++ = '.';
+    putDigits(p, static_cast<uint64_t>(cents % 100), 2);
+    p += 2;
+    *p++ = '\n';
+    return static_cast<size_t>(p - out);
+}
+
+bool DatasetGenerator::writeAccounts(const std::string& path) const {
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Error: Could not open " << path << " for writing." << std::endl;
+        return false;
+    }
+
+    const size_t MAX_LINE = 48;
+    std::vector<std::vector<char>> buffers(threads, std::vector<char>(CHUNK_ACCOUNTS * MAX_LINE));
+    std::vector<size_t> lengths(threads, 0);
+    uint64_t chunks = (config.accounts + CHUNK_ACCOUNTS - 1) / CHUNK_ACCOUNTS;
+
+    auto work = [&](uint64_t chunk, unsigned slot) {
+        FastRandom random(config.seed ^ (chunk * 0xD1B54A32D192ED03ULL));
+        uint64_t first = chunk * CHUNK_ACCOUNTS;
+        uint64_t last = std::min(config.accounts, first + CHUNK_ACCOUNTS);
+        char* out = buffers[slot].data();
+        size_t length = 0;
+        for (uint64_t index = first; index < last; ++index) {
+            uint64_t pin = random.below(10000);
+            length += formatAccount(index, pin, drawBalanceCents(random), out + length);
+        }
+        lengths[slot] = length;
+    };
+    auto emit = [&](unsigned slot) {
+        return std::fwrite(buffers[slot].data(), 1, lengths[slot], file) == lengths[slot];
+    };
+
+    bool ok = Parallel::inWaves(chunks, threads, work, emit);
+    ok = std::fclose(file) == 0 && ok;
+    return ok;
+}
+
+bool DatasetGenerator::writeLedger(const std::string& path) const {
+    LedgerWriter writer;
+    if (!writer.open(path, true)) {
+        std::cerr << "Error: Could not open " << path << " for writing." << std::endl;
+        return false;
+    }
+
+    const ZipfDistribution activity(config.accounts, config.zipfExponent);
+    const int64_t spanUs = static_cast<int64_t>(config.historyDays) * 86400LL * 1000000LL;
+    const double stepUs = config.historyEntries ? static_cast<double>(spanUs) / static_cast<double>(config.historyEntries) : 0.0;
+
+    std::vector<std::vector<LedgerEntry>> buffers(threads, std::vector<LedgerEntry>(CHUNK_ENTRIES));
+    std::vector<size_t> lengths(threads, 0);
+    uint64_t chunks = (config.historyEntries + CHUNK_ENTRIES - 1) / CHUNK_ENTRIES;
+
+    auto work = [&](uint64_t chunk, unsigned slot) {
+        FastRandom random(~config.seed ^ (chunk * 0x9E3779B97F4A7C15ULL));
+        uint64_t first = chunk * CHUNK_ENTRIES;
+        uint64_t last = std::min(config.historyEntries, first + CHUNK_ENTRIES);
+        LedgerEntry* out = buffers[slot].data();
+        for (uint64_t j = first; j < last; ++j) {
+            LedgerEntry& entry = out[j - first];
+            entry.accountKey = AccountKey::fromValue(accountValue(activeAccount(activity.sample(random))), 10);
+            entry.timestampUs = config.historyStartUs + static_cast<int64_t>(stepUs * static_cast<double>(j)) +
+                                static_cast<int64_t>(random.uniform() * stepUs);
+            entry.flags = 0;
+            entry.reserved = 0;
+            entry.terminal = static_cast<uint32_t>(1 + random.below(500));
+
+            double kind = random.uniform();
+            if (kind < 0.55) {
+                entry.type = static_cast<uint8_t>(LedgerType::Withdrawal);
+                entry.amountCents = static_cast<int64_t>(WITHDRAWAL_NOTES[random.below(9)]);
+            } else if (kind < 0.90) {
+                entry.type = static_cast<uint8_t>(LedgerType::Deposit);
+                double u1 = 1.0 - random.uniform();
+                double u2 = random.uniform();
+                double normal = std::sqrt(-2.0 * std::log(u1)) * std::cos(6.283185307179586 * u2);
+                entry.amountCents = std::max<int64_t>(100, std::llround(30000.0 * std::exp(0.8 * normal)));
+            } else {
+                entry.type = static_cast<uint8_t>(LedgerType::BalanceInquiry);
+                entry.amountCents = 0;
+            }
+        }
+        lengths[slot] = static_cast<size_t>(last - first);
+    };
+    auto emit = [&](unsigned slot) {
+        writer.append(buffers[slot].data(), lengths[slot]);
+        return true;
+    };
+
+    bool ok = Parallel::inWaves(chunks, threads, work, emit);
+    ok = writer.flush() && ok;
+    writer.close();
+    return ok;
+}
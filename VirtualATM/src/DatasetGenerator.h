@@ -0,0 +1,74 @@
+#ifndef DATASETGENERATOR_H
+#define DATASETGENERATOR_H
+
+#include <cstdint>
+#include <string>
+
+class FastRandom;
+
+// Synthetic bank datasets for large-scale testing.
+//
+// Accounts are generated in fixed-size chunks, each with its own RNG seeded
+// from (seed, chunk index), so output is identical for a given seed no
+// matter how many threads produce it. Chunks are generated in parallel and
+// written in order.
+enum class BalanceModel { Uniform, LogNormal, Pareto };
+
+struct DatasetConfig {
+    uint64_t accounts = 1000;
+    uint64_t seed = 42;
+
+    // Uniform: balances in [0, balanceScale]; LogNormal: median balanceScale
+    // with sigma balanceShape; Pareto: minimum balanceScale, alpha balanceShape
+    BalanceModel balanceModel = BalanceModel::LogNormal;
+    double balanceScale = 2500.0;
+    double balanceShape = 1.0;
+
+    // Account numbers: 3-digit branch, 6-digit serial, Luhn check digit.
+    // 0 picks the fewest branches that fit the account count.
+    unsigned branches = 0;
+
+    // Optional transaction history with Zipf-skewed account activity
+    uint64_t historyEntries = 0;
+    double zipfExponent = 1.0;
+    int64_t historyStartUs = 1759276800000000LL; // 2025-10-01T00:00:00Z
+    unsigned historyDays = 30;
+
+    unsigned threads = 0; // 0: hardware concurrency
+};
+
+class DatasetGenerator {
+public:
+    static const uint64_t CHUNK_ACCOUNTS = 65536;
+    static const uint64_t CHUNK_ENTRIES = 262144;
+    static const uint64_t MAX_ACCOUNTS = 900ULL * 1000000ULL;
+
+    explicit DatasetGenerator(const DatasetConfig& config);
+
+    // accounts.txt format: number,pin,balance
+    bool writeAccounts(const std::string& path) const;
+
+    // Binary ledger (see Ledger.h), ordered by time
+    bool writeLedger(const std::string& path) const;
+
+    // Account number of the index-th generated account
+    std::string accountNumber(uint64_t index) const;
+
+    // Account index for the rank-th most active account
+    uint64_t activeAccount(uint64_t rank) const;
+
+    unsigned getBranches() const;
+    unsigned getThreads() const;
+
+private:
+    DatasetConfig config;
+    unsigned branches;
+    unsigned threads;
+    uint64_t activityMultiplier;
+
+    size_t formatAccount(uint64_t index, uint64_t pin, int64_t cents, char* out) const;
+    int64_t drawBalanceCents(FastRandom& random) const;
+    uint64_t accountValue(uint64_t index) const;
+};
+
+#endif // DATASETGENERATOR_H
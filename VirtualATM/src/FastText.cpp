@@ -0,0 +1,184 @@
+#include "FastText.h"
+#include "AccountKey.h"
+#include <cstring>
+
+const size_t FastText::MAX_FIELD;
+
+bool FastText::nextAccountLine(const char*& cursor, const char* end, AccountLine& line) {
+    if (cursor >= end) {
+        return false;
+    }
+    const char* newline = static_cast<const char*>(std::memchr(cursor, '\n', static_cast<size_t>(end - cursor)));
+    line.begin = cursor;
+    line.end = newline ? newline : end;
+    cursor = newline ? newline + 1 : end;
+    if (line.end > line.begin && line.end[-1] == '\r') {
+        --line.end;
+    }
+
+    line.accountKey = 0;
+    line.balance = line.end;
+    line.balanceEnd = line.end;
+    line.balanceCents = 0;
+    const char* firstComma = static_cast<const char*>(std::memchr(line.begin, ',', line.end - line.begin));
+    if (!firstComma) {
+        return true;
+    }
+    const char* secondComma = static_cast<const char*>(std::memchr(firstComma + 1, ',', line.end - firstComma - 1));
+    if (!secondComma) {
+        return true;
+    }
+    const char* thirdComma = static_cast<const char*>(std::memchr(secondComma + 1, ',', line.end - secondComma - 1));
+    const char* balanceEnd = thirdComma ? thirdComma : line.end;
+    if (!parseCents(secondComma + 1, balanceEnd, line.balanceCents)) {
+        return true;
+    }
+    line.balance = secondComma + 1;
+    line.balanceEnd = balanceEnd;
+    line.accountKey = AccountKey::encode(line.begin, static_cast<size_t>(firstComma - line.begin));
+    return true;
+}
+
+bool FastText::parseCents(const char* begin, const char* end, int64_t& cents) {
+    bool negative = begin < end && *begin == '-';
+    const char* p = negative ? begin + 1 : begin;
+    if (p >= end) {
+        return false;
+    }
+    int64_t whole = 0;
+    bool digits = false;
+    while (p < end && *p >= '0' && *p <= '9') {
+        whole = whole * 10 + (*p++ - '0');
+        digits = true;
+    }
+    int64_t fraction = 0;
+    int fractionDigits = 0;
+    bool roundUp = false;
+    if (p < end && *p == '.') {
+        ++p;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (fractionDigits < 2) {
+                fraction = fraction * 10 + (*p - '0');
+            } else if (fractionDigits == 2) {
+                roundUp = *p >= '5';
+            }
+            ++fractionDigits;
+            ++p;
+            digits = true;
+        }
+    }
+    if (!digits || p != end) {
+        return false;
+    }
+    if (fractionDigits == 1) {
+        fraction *= 10;
+    }
+    int64_t value = whole * 100 + fraction + (roundUp ? 1 : 0);
+    cents = negative ? -value : value;
+    return true;
+}
+
+char* FastText::writeUnsigned(char* out, uint64_t value) {
+    char digits[20];
+    size_t count = 0;
+    do {
+        digits[count++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (count > 0) {
+        *out++ = digits[--count];
+    }
+    return out;
+}
+
+char* FastText::writeCents(char* out, int64_t cents) {
+    uint64_t magnitude = cents < 0 ? static_cast<uint64_t>(-(cents + 1)) + 1 : static_cast<uint64_t>(cents);
+    if (cents < 0) {
+        *out++ = '-';
+    }
+    out = writeUnsigned(out, magnitude / 100);
+    unsigned fraction = static_cast<unsigned>(magnitude % 100);
+    *out++ = '.';
+    *out++ = static_cast<char>('0' + fraction / 10);
+    *out++ = static_cast<char>('0' + fraction % 10);
+    return out;
+}
+
+char* FastText::writeAccount(char* out, uint64_t accountKey) {
+    return out + AccountKey::decodeTo(accountKey, out);
+}
+
+char* FastText::writeLeft(char* out, const char* text, size_t length, size_t width) {
+    std::memcpy(out, text, length);
+    out += length;
+    for (; length < width; ++length) {
+        *out++ = ' ';
+    }
+    return out;
+}
+
+char* FastText::writeRight(char* out, const char* text, size_t length, size_t width) {
+    for (; length < width; --width) {
+        *out++ = ' ';
+    }
+    std::memcpy(out, text, length);
+    return out + length;
+}
+
+namespace {
+    char* writeTwo(char* out, unsigned value) {
+        *out++ = static_cast<char>('0' + value / 10 % 10);
+        *out++ = static_cast<char>('0' + value % 10);
+        return out;
+    }
+
+    int64_t floorDiv(int64_t value, int64_t divisor) {
+        int64_t quotient = value / divisor;
+        return (value % divisor != 0 && (value < 0) != (divisor < 0)) ? quotient - 1 : quotient;
+    }
+}
+
+char* FastText::writeDate(char* out, int64_t timestampUs) {
+    int year = 0;
+    unsigned month = 0, day = 0;
+    civilFromDays(floorDiv(timestampUs, 86400LL * 1000000LL), year, month, day);
+    out = writeTwo(out, static_cast<unsigned>(year / 100));
+    out = writeTwo(out, static_cast<unsigned>(year % 100));
+    *out++ = '-';
+    out = writeTwo(out, month);
+    *out++ = '-';
+    return writeTwo(out, day);
+}
+
+char* FastText::writeDateTime(char* out, int64_t timestampUs) {
+    out = writeDate(out, timestampUs);
+    int64_t second = floorDiv(timestampUs, 1000000LL) - floorDiv(timestampUs, 86400LL * 1000000LL) * 86400LL;
+    *out++ = ' ';
+    out = writeTwo(out, static_cast<unsigned>(second / 3600));
+    *out++ = ':';
+    out = writeTwo(out, static_cast<unsigned>(second / 60 % 60));
+    *out++ = ':';
+    return writeTwo(out, static_cast<unsigned>(second % 60));
+}
+
+// Howard Hinnant's civil calendar algorithms (proleptic Gregorian)
+int64_t FastText::daysFromCivil(int year, unsigned month, unsigned day) {
+    int y = year - (month <= 2 ? 1 : 0);
+    int era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = static_cast<unsigned>(y - era * 400);
+    unsigned doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return static_cast<int64_t>(era) * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+void FastText::civilFromDays(int64_t days, int& year, unsigned& month, unsigned& day) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    unsigned doe = static_cast<unsigned>(days - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    day = doy - (153 * mp + 2) / 5 + 1;
+    month = mp < 10 ? mp + 3 : mp - 9;
+    year = static_cast<int>(static_cast<int64_t>(yoe) + era * 400 + (month <= 2 ? 1 : 0));
+}
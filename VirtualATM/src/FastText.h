@@ -0,0 +1,51 @@
+#ifndef FASTTEXT_H
+#define FASTTEXT_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Allocation-free parsing and formatting for the batch tools.
+//
+// Writers append to a caller-provided buffer and return the new end; the
+// caller guarantees room (MAX_FIELD bytes per call is always enough).
+struct AccountLine {
+    uint64_t accountKey; // AccountKey of the number, 0 if malformed
+    const char* begin;   // the whole line, without the newline
+    const char* end;
+    const char* balance; // start of the balance field
+    const char* balanceEnd; // its end; optional fields may follow
+    int64_t balanceCents;
+};
+
+class FastText {
+public:
+    static const size_t MAX_FIELD = 32;
+
+    // Parse one "number,pin,balance[,...]" line at cursor and advance past
+    // its newline; false at the end of the input. Malformed lines come back
+    // with accountKey 0.
+    static bool nextAccountLine(const char*& cursor, const char* end, AccountLine& line);
+
+    // "-1234.56"; balances with more than two decimals are rounded
+    static bool parseCents(const char* begin, const char* end, int64_t& cents);
+
+    static char* writeCents(char* out, int64_t cents);
+    static char* writeUnsigned(char* out, uint64_t value);
+    static char* writeAccount(char* out, uint64_t accountKey);
+
+    // Fixed-width columns, padded with spaces (text longer than width is
+    // written whole)
+    static char* writeLeft(char* out, const char* text, size_t length, size_t width);
+    static char* writeRight(char* out, const char* text, size_t length, size_t width);
+
+    // "YYYY-MM-DD" and "YYYY-MM-DD HH:MM:SS" for microseconds since the
+    // epoch, in UTC
+    static char* writeDate(char* out, int64_t timestampUs);
+    static char* writeDateTime(char* out, int64_t timestampUs);
+
+    // Days since 1970-01-01 for a civil date and back
+    static int64_t daysFromCivil(int year, unsigned month, unsigned day);
+    static void civilFromDays(int64_t days, int& year, unsigned& month, unsigned& day);
+};
+
+#endif // FASTTEXT_H
@@ -1,14 +1,30 @@
 #include "FileManager.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include <cstdio>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <algorithm>
 
 const std::string FileManager::DATA_FILE_PATH = "data/accounts.txt";
 
-// Load all accounts from file
+const std::string& FileManager::defaultDataFilePath() {
+    return DATA_FILE_PATH;
+}
+
+// Load all accounts from the default file
 std::vector<Account> FileManager::loadAccounts() {
+    return loadAccounts(DATA_FILE_PATH);
+}
+
+// Load all accounts from file
+std::vector<Account> FileManager::loadAccounts(const std::string& path) {
+    ATM_TRACE_SPAN("FileManager::loadAccounts");
+    const AtmMetrics& metrics = AtmMetrics::get();
+    ScopedTimer timer(metrics.fileLoadDuration);
     std::vector<Account> accounts;
-    std::ifstream file(DATA_FILE_PATH);
+    std::ifstream file(path);
     
     if (!file.is_open()) {
         std::cerr << "Warning: Could not open accounts file. Using empty account list." << std::endl;
@@ -16,7 +32,9 @@ std::vector<Account> FileManager::loadAccounts() {
     }
     
     std::string line;
+    uint64_t bytes = 0;
     while (std::getline(file, line)) {
+        bytes += line.size() + 1;
         if (!line.empty()) {
             try {
                 accounts.push_back(Account::fromString(line));
@@ -27,23 +45,70 @@ std::vector<Account> FileManager::loadAccounts() {
     }
     
     file.close();
+    MetricsRegistry::instance().add(metrics.fileLoadBytes, bytes);
     return accounts;
 }
 
-// Save all accounts to file
+// Save all accounts to the default file
 bool FileManager::saveAccounts(const std::vector<Account>& accounts) {
-    std::ofstream file(DATA_FILE_PATH);
+    return saveAccounts(accounts, DATA_FILE_PATH);
+}
+
+// Save all accounts to file
+bool FileManager::saveAccounts(const std::vector<Account>& accounts, const std::string& path) {
+    ATM_TRACE_SPAN("FileManager::saveAccounts");
+    const AtmMetrics& metrics = AtmMetrics::get();
+    ScopedTimer timer(metrics.fileSaveDuration);
+    std::string temporary = path + ".tmp";
+    std::ofstream file(temporary);
     
     if (!file.is_open()) {
         std::cerr << "Error: Could not open accounts file for writing." << std::endl;
         return false;
     }
     
+    char line[128];
     for (const auto& account : accounts) {
-        file << account.toString() << std::endl;
+        size_t length = account.formatTo(line, sizeof(line) - 1);
+        if (length == 0) {
+            file.close();
+            std::remove(temporary.c_str());
+            std::cerr << "Error: Account " << account.getAccountNumber() << " does not fit an accounts file line."
+                      << std::endl;
+            return false;
+        }
+        line[length++] = '\n';
+        file.write(line, static_cast<std::streamsize>(length));
     }
     
+    std::streamoff bytes = file.tellp();
     file.close();
+    if (!file || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        std::cerr << "Error: Could not write accounts file." << std::endl;
+        return false;
+    }
+    if (bytes > 0) {
+        MetricsRegistry::instance().add(metrics.fileSaveBytes, static_cast<uint64_t>(bytes));
+    }
+    return true;
+}
+
+bool FileManager::formatAccounts(const std::vector<Account>& accounts, std::string& out) {
+    ATM_TRACE_SPAN("FileManager::formatAccounts");
+    out.clear();
+    out.reserve(accounts.size() * 48);
+    char line[128];
+    for (const auto& account : accounts) {
+        size_t length = account.formatTo(line, sizeof(line) - 1);
+        if (length == 0) {
+            std::cerr << "Error: Account " << account.getAccountNumber() << " does not fit an accounts file line."
+                      << std::endl;
+            return false;
+        }
+        line[length++] = '\n';
+        out.append(line, length);
+    }
     return true;
 }
 
@@ -57,9 +122,14 @@ Account* FileManager::findAccount(std::vector<Account>& accounts, const std::str
     return (it != accounts.end()) ? &(*it) : nullptr;
 }
 
-// Update specific account in file
+// Update specific account in the default file
 bool FileManager::updateAccount(const Account& account) {
-    std::vector<Account> accounts = loadAccounts();
+    return updateAccount(account, DATA_FILE_PATH);
+}
+
+// Update specific account in file
+bool FileManager::updateAccount(const Account& account, const std::string& path) {
+    std::vector<Account> accounts = loadAccounts(path);
     
     auto it = std::find_if(accounts.begin(), accounts.end(),
         [&account](const Account& acc) {
@@ -68,12 +138,24 @@ bool FileManager::updateAccount(const Account& account) {
     
     if (it != accounts.end()) {
         *it = account;
-        return saveAccounts(accounts);
+        return saveAccounts(accounts, path);
     }
     
     return false;
 }
 
+// Size and modification time, as stamped into derived files
+bool FileManager::stampOf(const std::string& path, uint64_t& bytes, int64_t& modified) {
+    std::error_code error;
+    bytes = std::filesystem::file_size(path, error);
+    if (error) {
+        return false;
+    }
+    auto time = std::filesystem::last_write_time(path, error);
+    modified = static_cast<int64_t>(time.time_since_epoch().count());
+    return !error;
+}
+
 // Check if file exists
 bool FileManager::fileExists(const std::string& filename) {
     std::ifstream file(filename);
@@ -82,14 +164,29 @@ bool FileManager::fileExists(const std::string& filename) {
 
 // Initialize data file with sample data if it doesn't exist
 void FileManager::initializeDataFile() {
-    if (!fileExists(DATA_FILE_PATH)) {
+    initializeDataFile(DATA_FILE_PATH);
+}
+
+void FileManager::initializeDataFile(const std::string& path) {
+    if (!fileExists(path)) {
         std::cout << "Data file not found. Creating sample data..." << std::endl;
-        createSampleData();
+        createSampleData(path);
+    }
+}
+
+// Copy a data file byte for byte
+bool FileManager::copyDataFile(const std::string& from, const std::string& to) {
+    std::ifstream source(from, std::ios::binary);
+    std::ofstream target(to, std::ios::binary | std::ios::trunc);
+    if (!source.is_open() || !target.is_open()) {
+        return false;
     }
+    target << source.rdbuf();
+    return static_cast<bool>(target);
 }
 
 // Create sample account data
-void FileManager::createSampleData() {
+void FileManager::createSampleData(const std::string& path) {
     std::vector<Account> sampleAccounts;
     
     // Create sample accounts
@@ -100,7 +197,7 @@ void FileManager::createSampleData() {
     sampleAccounts.emplace_back("33333", "3333", 0.00);
     
     // Save sample accounts
-    if (saveAccounts(sampleAccounts)) {
+    if (saveAccounts(sampleAccounts, path)) {
         std::cout << "Sample account data created successfully!" << std::endl;
         std::cout << "Available test accounts:" << std::endl;
         std::cout << "  Account: 12345, PIN: 1234, Balance: $1500.75" << std::endl;
@@ -2,6 +2,7 @@
 #define FILEMANAGER_H
 
 #include "Account.h"
+#include <cstdint>
 #include <vector>
 #include <string>
 
@@ -10,25 +11,44 @@ private:
     static const std::string DATA_FILE_PATH;
     
 public:
+    // Default location of the accounts file
+    static const std::string& defaultDataFilePath();
+    
     // Load all accounts from file
     static std::vector<Account> loadAccounts();
+    static std::vector<Account> loadAccounts(const std::string& path);
     
-    // Save all accounts to file
+    // Save all accounts to file; the file is replaced only once every line
+    // has been written
     static bool saveAccounts(const std::vector<Account>& accounts);
+    static bool saveAccounts(const std::vector<Account>& accounts, const std::string& path);
+    
+    // The text saveAccounts writes, for saving in the background; false if
+    // an account's line does not fit
+    static bool formatAccounts(const std::vector<Account>& accounts, std::string& out);
     
     // Find account by account number
     static Account* findAccount(std::vector<Account>& accounts, const std::string& accountNumber);
     
     // Update specific account in file
     static bool updateAccount(const Account& account);
+    static bool updateAccount(const Account& account, const std::string& path);
     
     // Check if data file exists and create with sample data if not
     static void initializeDataFile();
+    static void initializeDataFile(const std::string& path);
+    
+    // Copy a data file, e.g. to give a scripted session its own store
+    static bool copyDataFile(const std::string& from, const std::string& to);
+    
+    // Size and modification time of a data file, which files derived from
+    // it record to tell whether they are still current; false if missing
+    static bool stampOf(const std::string& path, uint64_t& bytes, int64_t& modified);
     
 private:
     // Helper functions
     static bool fileExists(const std::string& filename);
-    static void createSampleData();
+    static void createSampleData(const std::string& path);
 };
 
 #endif // FILEMANAGER_H
@@ -0,0 +1,73 @@
+#include "HashRing.h"
+#include <algorithm>
+
+const uint32_t HashRing::VIRTUAL_NODES;
+
+// splitmix64 finalizer: account keys are dense digit values, so they are
+// mixed before they are placed on the ring
+uint64_t HashRing::hashKey(uint64_t accountKey) {
+    uint64_t z = accountKey + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+HashRing::HashRing() : shardCount(0) {}
+
+HashRing::HashRing(uint32_t count) : shardCount(0) {
+    for (uint32_t shard = 0; shard < count; ++shard) {
+        addShard(shard);
+    }
+}
+
+void HashRing::addShard(uint32_t shard) {
+    for (uint32_t node = 0; node < VIRTUAL_NODES; ++node) {
+        Point point;
+        point.hash = hashKey((static_cast<uint64_t>(shard) << 32 | node) ^ 0x5348415244ULL);
+        point.shard = shard;
+        points.push_back(point);
+    }
+    std::sort(points.begin(), points.end(), [](const Point& a, const Point& b) { return a.hash < b.hash; });
+    ++shardCount;
+}
+
+uint32_t HashRing::shardOf(uint64_t accountKey) const {
+    return ownerOfHash(hashKey(accountKey));
+}
+
+uint32_t HashRing::ownerOfHash(uint64_t hash) const {
+    auto it = std::lower_bound(points.begin(), points.end(), hash,
+                               [](const Point& point, uint64_t value) { return point.hash < value; });
+    return it != points.end() ? it->shard : points.front().shard;
+}
+
+// Point i owns (points[i-1], points[i]]; the first point also owns
+// everything above the last one
+std::vector<HashRing::Range> HashRing::rangesOf(uint32_t shard) const {
+    std::vector<Range> ranges;
+    for (size_t i = 0; i < points.size(); ++i) {
+        if (points[i].shard != shard) {
+            continue;
+        }
+        if (i == 0) {
+            ranges.emplace_back(0, points[0].hash);
+            if (points.back().hash != UINT64_MAX) {
+                ranges.emplace_back(points.back().hash + 1, UINT64_MAX);
+            }
+        } else if (points[i - 1].hash != points[i].hash) {
+            ranges.emplace_back(points[i - 1].hash + 1, points[i].hash);
+        }
+    }
+    std::sort(ranges.begin(), ranges.end());
+    return ranges;
+}
+
+bool HashRing::inRanges(uint64_t hash, const std::vector<Range>& ranges) {
+    auto it = std::upper_bound(ranges.begin(), ranges.end(), hash,
+                               [](uint64_t value, const Range& range) { return value < range.first; });
+    return it != ranges.begin() && hash <= (it - 1)->second;
+}
+
+size_t HashRing::getShardCount() const {
+    return shardCount;
+}
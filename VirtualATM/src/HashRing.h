@@ -0,0 +1,53 @@
+#ifndef HASHRING_H
+#define HASHRING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Consistent hashing of account keys onto shards.
+//
+// Every shard places VIRTUAL_NODES points on a 64-bit ring; an account
+// belongs to the shard of the first point at or after the hash of its
+// AccountKey, wrapping at the top. Points depend only on the shard id, so
+// every process that knows the shard ids computes the same owners, and
+// adding a shard moves only the accounts its new points take over.
+class HashRing {
+public:
+    static const uint32_t VIRTUAL_NODES = 128;
+
+    // Inclusive [first, last] stretch of hash values
+    using Range = std::pair<uint64_t, uint64_t>;
+
+    static uint64_t hashKey(uint64_t accountKey);
+
+    HashRing();
+
+    // Shards 0 .. count-1
+    explicit HashRing(uint32_t count);
+
+    void addShard(uint32_t shard);
+
+    uint32_t shardOf(uint64_t accountKey) const;
+    uint32_t ownerOfHash(uint64_t hash) const;
+
+    // The hash values `shard` owns, as sorted non-wrapping ranges
+    std::vector<Range> rangesOf(uint32_t shard) const;
+
+    // Binary search over sorted, disjoint ranges
+    static bool inRanges(uint64_t hash, const std::vector<Range>& ranges);
+
+    size_t getShardCount() const;
+
+private:
+    struct Point {
+        uint64_t hash;
+        uint32_t shard;
+    };
+
+    std::vector<Point> points; // sorted by hash
+    size_t shardCount;
+};
+
+#endif // HASHRING_H
@@ -0,0 +1,319 @@
+#include "HistoryStore.h"
+#include "AccountKey.h"
+#include "LedgerSorter.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+const char HistoryStore::MAGIC[8] = {'A', 'T', 'M', 'H', 'I', 'S', 'T', '1'};
+const size_t HistoryStore::BLOCK_ENTRIES;
+const uint32_t HistoryFilter::ALL_TYPES;
+
+static_assert(sizeof(HistoryStore::Block) == 48, "Block is a fixed 48-byte record");
+
+namespace {
+    const size_t WRITE_BUFFER_ENTRIES = 4096;
+
+    // File layout: this header, the entries, the blocks, then the directory
+    struct FileHeader {
+        char magic[8];
+        uint32_t partition;
+        uint32_t partitions;
+        uint64_t accounts;
+        uint64_t blocks;
+        uint64_t entries;
+        uint64_t blockOffset;
+        uint64_t directoryOffset;
+        uint64_t reserved;
+    };
+
+    static_assert(sizeof(FileHeader) == 64, "FileHeader is a fixed 64-byte record");
+
+    uint32_t typeBit(uint8_t type) {
+        return type < 32 ? 1u << type : 0;
+    }
+
+    // Writes one partition's sorted records as entries, blocks and directory
+    class HistoryWriter : public LedgerSink {
+    private:
+        std::FILE* file;
+        std::vector<LedgerEntry> buffer;
+        std::vector<HistoryStore::Block> blocks;
+        std::vector<uint64_t> directory;
+        uint64_t entries;
+        uint64_t account;
+
+    public:
+        bool failed;
+
+        explicit HistoryWriter(std::FILE* file) : file(file), entries(0), account(0), failed(false) {
+            buffer.reserve(WRITE_BUFFER_ENTRIES);
+            FileHeader header = {};
+            failed = std::fwrite(&header, sizeof(header), 1, file) != 1;
+        }
+
+        void consume(const LedgerEntry& record) override {
+            if (record.type == LedgerSorter::OPENING_RECORD) {
+                return;
+            }
+            if (directory.empty() || record.accountKey != account) {
+                account = record.accountKey;
+                directory.push_back(account);
+                directory.push_back(blocks.size());
+                startBlock(record);
+            } else if (blocks.back().count == HistoryStore::BLOCK_ENTRIES) {
+                startBlock(record);
+            }
+            HistoryStore::Block& block = blocks.back();
+            block.maxTimeUs = record.timestampUs;
+            block.minCents = std::min(block.minCents, record.amountCents);
+            block.maxCents = std::max(block.maxCents, record.amountCents);
+            block.typeMask |= typeBit(record.type);
+            block.count++;
+
+            buffer.push_back(record);
+            entries++;
+            if (buffer.size() == WRITE_BUFFER_ENTRIES) {
+                flush();
+            }
+        }
+
+        bool finish(uint32_t partition, uint32_t partitions, HistoryBuildStats& partial) {
+            flush();
+            uint64_t accounts = directory.size() / 2;
+            directory.push_back(0);
+            directory.push_back(blocks.size());
+
+            FileHeader header = {};
+            std::memcpy(header.magic, HistoryStore::MAGIC, sizeof(header.magic));
+            header.partition = partition;
+            header.partitions = partitions;
+            header.accounts = accounts;
+            header.blocks = blocks.size();
+            header.entries = entries;
+            header.blockOffset = sizeof(FileHeader) + entries * sizeof(LedgerEntry);
+            header.directoryOffset = header.blockOffset + blocks.size() * sizeof(HistoryStore::Block);
+            if (!failed && (std::fwrite(blocks.data(), sizeof(HistoryStore::Block), blocks.size(), file) != blocks.size() ||
+                            std::fwrite(directory.data(), sizeof(uint64_t), directory.size(), file) != directory.size() ||
+                            std::fseek(file, 0, SEEK_SET) != 0 ||
+                            std::fwrite(&header, sizeof(header), 1, file) != 1)) {
+                failed = true;
+            }
+            partial.accounts = accounts;
+            partial.entries = entries;
+            partial.blocks = blocks.size();
+            return !failed;
+        }
+
+    private:
+        void startBlock(const LedgerEntry& record) {
+            HistoryStore::Block block = {};
+            block.minTimeUs = record.timestampUs;
+            block.minCents = record.amountCents;
+            block.maxCents = record.amountCents;
+            block.firstEntry = entries;
+            blocks.push_back(block);
+        }
+
+        void flush() {
+            if (!buffer.empty() && !failed &&
+                std::fwrite(buffer.data(), sizeof(LedgerEntry), buffer.size(), file) != buffer.size()) {
+                failed = true;
+            }
+            buffer.clear();
+        }
+    };
+
+    bool blockMatches(const HistoryStore::Block& block, const HistoryFilter& filter) {
+        return (block.typeMask & filter.typeMask) != 0 && block.maxCents >= filter.minCents &&
+               block.minCents <= filter.maxCents;
+    }
+
+    bool entryMatches(const LedgerEntry& entry, const HistoryFilter& filter) {
+        return (typeBit(entry.type) & filter.typeMask) != 0 && entry.timestampUs >= filter.fromUs &&
+               entry.timestampUs < filter.toUs && entry.amountCents >= filter.minCents &&
+               entry.amountCents <= filter.maxCents && (filter.includeFailed || !(entry.flags & LEDGER_FLAG_FAILED));
+    }
+}
+
+uint32_t HistoryFilter::typeMaskFor(const std::string& transactionType) {
+    if (transactionType == "TRANSFER") {
+        return typeBit(static_cast<uint8_t>(LedgerType::TransferOut)) |
+               typeBit(static_cast<uint8_t>(LedgerType::TransferIn));
+    }
+    for (uint8_t type = static_cast<uint8_t>(LedgerType::Withdrawal);
+         type <= static_cast<uint8_t>(LedgerType::TransferIn); ++type) {
+        if (transactionType == Ledger::typeName(type)) {
+            return typeBit(type);
+        }
+    }
+    return 0;
+}
+
+HistoryStore::HistoryStore() : totalAccounts(0), totalEntries(0) {}
+
+HistoryStore::~HistoryStore() {
+    close();
+}
+
+std::string HistoryStore::partitionPath(const std::string& directory, size_t partition) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "/history-%04zu.bin", partition);
+    return directory + name;
+}
+
+bool HistoryStore::build(const HistoryBuildConfig& config, HistoryBuildStats& stats) {
+    auto started = std::chrono::steady_clock::now();
+    stats = HistoryBuildStats();
+    std::error_code error;
+    std::filesystem::create_directories(config.outputDir, error);
+
+    LedgerSortConfig sortConfig;
+    sortConfig.ledgerPath = config.ledgerPath;
+    sortConfig.tempDir = config.tempDir.empty() ? config.outputDir + "/tmp" : config.tempDir;
+    sortConfig.memoryBudget = config.memoryBudget;
+    sortConfig.threads = config.threads;
+    LedgerSorter sorter(sortConfig);
+    size_t partitions = sorter.getPartitions();
+    stats.partitions = partitions;
+    if (!sorter.scatter()) {
+        return false;
+    }
+
+    std::vector<HistoryBuildStats> partials(partitions);
+    std::vector<char> written(partitions, 0);
+    Parallel::forEach(partitions, sorter.getThreads(), [&](size_t partition, unsigned) {
+        std::string path = partitionPath(config.outputDir, partition);
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        if (!file) {
+            std::cerr << "Error: Could not open " << path << std::endl;
+            return;
+        }
+        HistoryWriter writer(file);
+        bool sorted = sorter.sortPartition(partition, writer);
+        bool finished = writer.finish(static_cast<uint32_t>(partition), static_cast<uint32_t>(partitions),
+                                      partials[partition]);
+        written[partition] = std::fclose(file) == 0 && sorted && finished ? 1 : 0;
+    });
+    for (const HistoryBuildStats& partial : partials) {
+        stats.accounts += partial.accounts;
+        stats.entries += partial.entries;
+        stats.blocks += partial.blocks;
+    }
+    std::filesystem::remove_all(sortConfig.tempDir, error);
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return std::all_of(written.begin(), written.end(), [](char ok) { return ok != 0; });
+}
+
+bool HistoryStore::open(const std::string& directory) {
+    close();
+    size_t count = 1;
+    for (size_t partition = 0; partition < count; ++partition) {
+        std::string path = partitionPath(directory, partition);
+        std::unique_ptr<MappedFile> file(new MappedFile());
+        FileHeader header;
+        if (!file->open(path) || file->size() < sizeof(header)) {
+            std::cerr << "Error: Could not open " << path << std::endl;
+            close();
+            return false;
+        }
+        std::memcpy(&header, file->data(), sizeof(header));
+        if (partition == 0) {
+            count = header.partitions;
+        }
+        uint64_t directoryBytes = (header.accounts + 1) * 2 * sizeof(uint64_t);
+        if (std::memcmp(header.magic, MAGIC, sizeof(header.magic)) != 0 || header.partition != partition ||
+            header.partitions != count || header.directoryOffset + directoryBytes != file->size()) {
+            std::cerr << "Error: " << path << " is not a valid history file" << std::endl;
+            close();
+            return false;
+        }
+        Partition part;
+        part.entries = reinterpret_cast<const LedgerEntry*>(file->data() + sizeof(FileHeader));
+        part.blocks = reinterpret_cast<const Block*>(file->data() + header.blockOffset);
+        part.directory = reinterpret_cast<const uint64_t*>(file->data() + header.directoryOffset);
+        part.accounts = header.accounts;
+        part.file = std::move(file);
+        partitions.push_back(std::move(part));
+        totalAccounts += header.accounts;
+        totalEntries += header.entries;
+    }
+    return true;
+}
+
+void HistoryStore::close() {
+    partitions.clear();
+    totalAccounts = 0;
+    totalEntries = 0;
+}
+
+uint64_t HistoryStore::getAccounts() const {
+    return totalAccounts;
+}
+
+uint64_t HistoryStore::getEntries() const {
+    return totalEntries;
+}
+
+bool HistoryStore::query(const std::string& accountNumber, const HistoryFilter& filter,
+                         std::vector<LedgerEntry>& out, HistoryQueryStats* stats) const {
+    return query(AccountKey::ledgerKey(accountNumber), filter, out, stats);
+}
+
+bool HistoryStore::query(uint64_t accountKey, const HistoryFilter& filter, std::vector<LedgerEntry>& out,
+                         HistoryQueryStats* stats) const {
+    if (partitions.empty()) {
+        return false;
+    }
+    const Partition& part = partitions[LedgerSorter::partitionOf(accountKey, partitions.size())];
+    uint64_t low = 0, high = part.accounts;
+    while (low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        if (part.directory[middle * 2] < accountKey) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low == part.accounts || part.directory[low * 2] != accountKey) {
+        return false;
+    }
+
+    // Blocks are in time order: the range covers those that may overlap it
+    const Block* begin = part.blocks + part.directory[low * 2 + 1];
+    const Block* end = part.blocks + part.directory[low * 2 + 3];
+    begin = std::partition_point(begin, end, [&](const Block& block) { return block.maxTimeUs < filter.fromUs; });
+    end = std::partition_point(begin, end, [&](const Block& block) { return block.minTimeUs < filter.toUs; });
+
+    HistoryQueryStats local;
+    size_t wanted = filter.limit == 0 ? std::numeric_limits<size_t>::max() : filter.limit;
+    size_t found = 0;
+    size_t blocks = static_cast<size_t>(end - begin);
+    for (size_t i = 0; i < blocks && found < wanted; ++i) {
+        const Block& block = filter.newestFirst ? end[-1 - static_cast<ptrdiff_t>(i)] : begin[i];
+        if (!blockMatches(block, filter)) {
+            local.blocksSkipped++;
+            continue;
+        }
+        local.blocksScanned++;
+        const LedgerEntry* entries = part.entries + block.firstEntry;
+        for (uint32_t j = 0; j < block.count && found < wanted; ++j) {
+            const LedgerEntry& entry = entries[filter.newestFirst ? block.count - 1 - j : j];
+            local.entriesScanned++;
+            if (entryMatches(entry, filter)) {
+                out.push_back(entry);
+                found++;
+            }
+        }
+    }
+    if (stats) {
+        stats->blocksScanned += local.blocksScanned;
+        stats->blocksSkipped += local.blocksSkipped;
+        stats->entriesScanned += local.entriesScanned;
+    }
+    return true;
+}
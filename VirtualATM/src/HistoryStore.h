@@ -0,0 +1,118 @@
+#ifndef HISTORYSTORE_H
+#define HISTORYSTORE_H
+
+#include "Ledger.h"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+class MappedFile;
+
+// Which entries a history query returns. Ranges are inclusive except the
+// time range, which is [fromUs, toUs) like the statement periods.
+struct HistoryFilter {
+    static const uint32_t ALL_TYPES = 0xFFFFFFFFu;
+
+    uint32_t typeMask = ALL_TYPES; // bit (1 << LedgerType) per accepted type
+    int64_t fromUs = std::numeric_limits<int64_t>::min();
+    int64_t toUs = std::numeric_limits<int64_t>::max();
+    int64_t minCents = 0;
+    int64_t maxCents = std::numeric_limits<int64_t>::max();
+    bool includeFailed = false;
+    bool newestFirst = false;
+    size_t limit = 0;              // 0: no limit
+
+    // Type bits for a Transaction::getTransactionType() name ("TRANSFER"
+    // covers both legs) or a Ledger::typeName(); 0 if unknown
+    static uint32_t typeMaskFor(const std::string& transactionType);
+};
+
+struct HistoryQueryStats {
+    uint64_t blocksScanned = 0;
+    uint64_t blocksSkipped = 0; // ruled out by their summaries
+    uint64_t entriesScanned = 0;
+};
+
+struct HistoryBuildConfig {
+    std::string ledgerPath;
+    std::string outputDir = "history";
+    std::string tempDir;       // empty: <outputDir>/tmp
+    size_t memoryBudget = size_t(256) << 20;
+    unsigned threads = 0;      // 0: hardware concurrency
+};
+
+struct HistoryBuildStats {
+    uint64_t accounts = 0;
+    uint64_t entries = 0;
+    uint64_t blocks = 0;
+    size_t partitions = 0;
+    double seconds = 0.0;
+};
+
+// Per-account transaction history indexed for filtered queries.
+//
+// build() sorts the ledger by account and time (LedgerSorter) and writes
+// one file per partition: the entries grouped by account in time order, a
+// summary per block of BLOCK_ENTRIES entries (time and amount range, types
+// present) and a directory of accounts sorted by key. A query finds the
+// account by binary search, the first block of the time range by binary
+// search over the block end times, and skips every block whose summary
+// cannot match the filter, so it reads only the blocks that hold results.
+class HistoryStore {
+public:
+    static const char MAGIC[8];
+    static const size_t BLOCK_ENTRIES = 256;
+
+    // On-disk block summary
+    struct Block {
+        int64_t minTimeUs;
+        int64_t maxTimeUs;
+        int64_t minCents;
+        int64_t maxCents;
+        uint64_t firstEntry;
+        uint32_t count;
+        uint32_t typeMask;
+    };
+
+    HistoryStore();
+    ~HistoryStore();
+
+    HistoryStore(const HistoryStore&) = delete;
+    HistoryStore& operator=(const HistoryStore&) = delete;
+
+    static bool build(const HistoryBuildConfig& config, HistoryBuildStats& stats);
+
+    // Map every partition file written by build()
+    bool open(const std::string& directory);
+    void close();
+
+    // Append matching entries of one account to out; false if the account
+    // has no history
+    bool query(uint64_t accountKey, const HistoryFilter& filter, std::vector<LedgerEntry>& out,
+               HistoryQueryStats* stats = nullptr) const;
+    bool query(const std::string& accountNumber, const HistoryFilter& filter, std::vector<LedgerEntry>& out,
+               HistoryQueryStats* stats = nullptr) const;
+
+    uint64_t getAccounts() const;
+    uint64_t getEntries() const;
+
+    static std::string partitionPath(const std::string& directory, size_t partition);
+
+private:
+    struct Partition {
+        std::unique_ptr<MappedFile> file;
+        const LedgerEntry* entries;
+        const Block* blocks;
+        const uint64_t* directory; // (accountKey, firstBlock) pairs plus an end sentinel
+        uint64_t accounts;
+    };
+
+    std::vector<Partition> partitions;
+    uint64_t totalAccounts;
+    uint64_t totalEntries;
+};
+
+#endif // HISTORYSTORE_H
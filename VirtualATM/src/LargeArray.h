@@ -0,0 +1,83 @@
+#ifndef LARGEARRAY_H
+#define LARGEARRAY_H
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// Fixed-size array for the batch tools' big tables.
+//
+// Tables of hundreds of megabytes are read at random; with 4 KiB pages
+// nearly every access also misses the TLB. On Linux the memory is mapped
+// directly and marked for transparent huge pages. Elements are
+// value-initialized by the mapping (zero bytes), so T must be valid as all
+// zeros; only trivially destructible types are supported.
+template <typename T>
+class LargeArray {
+private:
+    T* elements;
+    size_t count;
+    size_t bytes;
+    bool mapped;
+
+    void release() {
+#ifdef __linux__
+        if (mapped) {
+            munmap(elements, bytes);
+        } else
+#endif
+        {
+            ::operator delete(elements);
+        }
+        elements = nullptr;
+        count = 0;
+        bytes = 0;
+        mapped = false;
+    }
+
+public:
+    LargeArray() : elements(nullptr), count(0), bytes(0), mapped(false) {}
+    explicit LargeArray(size_t size) : LargeArray() { reset(size); }
+    ~LargeArray() { release(); }
+
+    LargeArray(const LargeArray&) = delete;
+    LargeArray& operator=(const LargeArray&) = delete;
+
+    // Replace the contents with `size` zeroed elements
+    void reset(size_t size) {
+        release();
+        if (size == 0) {
+            return;
+        }
+        bytes = size * sizeof(T);
+#ifdef __linux__
+        const size_t HUGE_PAGE = 2 << 20;
+        if (bytes >= HUGE_PAGE) {
+            void* base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (base != MAP_FAILED) {
+                madvise(base, bytes, MADV_HUGEPAGE);
+                elements = static_cast<T*>(base);
+                count = size;
+                mapped = true;
+                return;
+            }
+        }
+#endif
+        elements = static_cast<T*>(::operator new(bytes));
+        std::memset(static_cast<void*>(elements), 0, bytes);
+        count = size;
+    }
+
+    T& operator[](size_t index) { return elements[index]; }
+    const T& operator[](size_t index) const { return elements[index]; }
+
+    T* data() { return elements; }
+    const T* data() const { return elements; }
+    size_t size() const { return count; }
+};
+
+#endif // LARGEARRAY_H
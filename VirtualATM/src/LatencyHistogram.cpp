@@ -0,0 +1,101 @@
+#include "LatencyHistogram.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    int mostSignificantBit(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+        return 63 - __builtin_clzll(value);
+#else
+        int msb = 0;
+        while (value >>= 1) {
+            ++msb;
+        }
+        return msb;
+#endif
+    }
+}
+
+LatencyHistogram::LatencyHistogram() : counts(BUCKET_COUNT, 0), total(0), maxValue(0), sum(0.0) {}
+
+// index = value for small values, otherwise (exponent + 1) * 64 + top bits
+int LatencyHistogram::indexOf(uint64_t value) {
+    const uint64_t exact = uint64_t(1) << SUB_BUCKET_BITS;
+    if (value < exact) {
+        return static_cast<int>(value);
+    }
+    int exponent = mostSignificantBit(value) - SUB_BUCKET_BITS + 1;
+    uint64_t sub = value >> exponent;
+    return (exponent << (SUB_BUCKET_BITS - 1)) + static_cast<int>(sub);
+}
+
+uint64_t LatencyHistogram::highestEquivalent(int index) {
+    const int half = 1 << (SUB_BUCKET_BITS - 1);
+    if (index < 2 * half) {
+        return static_cast<uint64_t>(index);
+    }
+    int exponent = index / half - 1;
+    uint64_t sub = static_cast<uint64_t>(index % half + half);
+    return ((sub + 1) << exponent) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value) {
+    counts[indexOf(value)]++;
+    total++;
+    sum += static_cast<double>(value);
+    maxValue = std::max(maxValue, value);
+}
+
+void LatencyHistogram::recordCorrected(uint64_t value, uint64_t expectedInterval) {
+    record(value);
+    if (expectedInterval == 0 || value <= expectedInterval) {
+        return;
+    }
+    for (uint64_t missing = value - expectedInterval; missing >= expectedInterval; missing -= expectedInterval) {
+        record(missing);
+    }
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < counts.size(); ++i) {
+        counts[i] += other.counts[i];
+    }
+    total += other.total;
+    sum += other.sum;
+    maxValue = std::max(maxValue, other.maxValue);
+}
+
+void LatencyHistogram::reset() {
+    std::fill(counts.begin(), counts.end(), 0);
+    total = 0;
+    sum = 0.0;
+    maxValue = 0;
+}
+
+uint64_t LatencyHistogram::getCount() const {
+    return total;
+}
+
+uint64_t LatencyHistogram::getMax() const {
+    return maxValue;
+}
+
+double LatencyHistogram::getMean() const {
+    return total ? sum / static_cast<double>(total) : 0.0;
+}
+
+uint64_t LatencyHistogram::percentile(double percent) const {
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(std::ceil(percent / 100.0 * static_cast<double>(total)));
+    rank = std::max<uint64_t>(1, std::min(rank, total));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return std::min(highestEquivalent(static_cast<int>(i)), maxValue);
+        }
+    }
+    return maxValue;
+}
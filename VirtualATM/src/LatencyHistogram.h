@@ -0,0 +1,48 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <cstdint>
+#include <vector>
+
+// HDR-style log-linear latency histogram.
+//
+// Values below 128 are counted exactly; above that every power of two is
+// split into 64 linear sub-buckets, so any recorded value is reported
+// within 1.6% over the full 64-bit range with a fixed 30 KB of counters.
+// A histogram has a single writer: give each thread its own and merge()
+// them when the run is over.
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void record(uint64_t value);
+
+    // Coordinated-omission correction: when a value exceeds the interval at
+    // which requests were meant to be issued, also record the latencies the
+    // requests stuck behind it would have seen
+    void recordCorrected(uint64_t value, uint64_t expectedInterval);
+
+    void merge(const LatencyHistogram& other);
+    void reset();
+
+    uint64_t getCount() const;
+    uint64_t getMax() const;
+    double getMean() const;
+
+    // Highest value equivalent to the given percentile (0-100)
+    uint64_t percentile(double percent) const;
+
+private:
+    static const int SUB_BUCKET_BITS = 7;
+    static const int BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 2) << (SUB_BUCKET_BITS - 1);
+
+    std::vector<uint64_t> counts;
+    uint64_t total;
+    uint64_t maxValue;
+    double sum;
+
+    static int indexOf(uint64_t value);
+    static uint64_t highestEquivalent(int index);
+};
+
+#endif // LATENCYHISTOGRAM_H
@@ -0,0 +1,215 @@
+#include "Ledger.h"
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char Ledger::MAGIC[8] = {'A', 'T', 'M', 'L', 'E', 'D', 'G', '1'};
+
+namespace {
+    const size_t WRITE_BUFFER_ENTRIES = 2048;
+
+    bool checkHeader(const char* header) {
+        uint32_t entrySize = 0;
+        std::memcpy(&entrySize, header + 8, sizeof(entrySize));
+        return std::memcmp(header, Ledger::MAGIC, sizeof(Ledger::MAGIC)) == 0 && entrySize == sizeof(LedgerEntry);
+    }
+}
+
+void Ledger::fillHeader(char* header) {
+    std::memset(header, 0, HEADER_SIZE);
+    std::memcpy(header, MAGIC, sizeof(MAGIC));
+    uint32_t entrySize = sizeof(LedgerEntry);
+    std::memcpy(header + 8, &entrySize, sizeof(entrySize));
+}
+
+const char* Ledger::typeName(uint8_t type) {
+    switch (static_cast<LedgerType>(type)) {
+        case LedgerType::Withdrawal: return "WITHDRAWAL";
+        case LedgerType::Deposit: return "DEPOSIT";
+        case LedgerType::BalanceInquiry: return "BALANCE_INQUIRY";
+        case LedgerType::TransferOut: return "TRANSFER_OUT";
+        case LedgerType::TransferIn: return "TRANSFER_IN";
+    }
+    return "UNKNOWN";
+}
+
+int64_t Ledger::balanceDelta(const LedgerEntry& entry) {
+    if (entry.flags & LEDGER_FLAG_FAILED) {
+        return 0;
+    }
+    switch (static_cast<LedgerType>(entry.type)) {
+        case LedgerType::Withdrawal:
+        case LedgerType::TransferOut:
+            return -entry.amountCents;
+        case LedgerType::Deposit:
+        case LedgerType::TransferIn:
+            return entry.amountCents;
+        default:
+            return 0;
+    }
+}
+
+int64_t Ledger::toCents(double amount) {
+    return std::llround(amount * 100.0);
+}
+
+// LedgerWriter implementation
+LedgerWriter::LedgerWriter() : file(nullptr), appended(0) {}
+
+LedgerWriter::~LedgerWriter() {
+    close();
+}
+
+bool LedgerWriter::open(const std::string& path, bool truncate) {
+    close();
+    file = std::fopen(path.c_str(), truncate ? "wb" : "ab");
+    if (!file) {
+        return false;
+    }
+    std::fseek(file, 0, SEEK_END);
+    if (std::ftell(file) == 0) {
+        char header[Ledger::HEADER_SIZE];
+        Ledger::fillHeader(header);
+        if (std::fwrite(header, 1, sizeof(header), file) != sizeof(header)) {
+            close();
+            return false;
+        }
+    }
+    buffer.reserve(WRITE_BUFFER_ENTRIES);
+    return true;
+}
+
+bool LedgerWriter::isOpen() const {
+    return file != nullptr;
+}
+
+void LedgerWriter::close() {
+    if (file) {
+        flush();
+        std::fclose(file);
+        file = nullptr;
+    }
+}
+
+void LedgerWriter::append(const LedgerEntry& entry) {
+    buffer.push_back(entry);
+    appended++;
+    if (buffer.size() >= WRITE_BUFFER_ENTRIES) {
+        flush();
+    }
+}
+
+void LedgerWriter::append(const LedgerEntry* entries, size_t count) {
+    flush();
+    if (file && count > 0) {
+        std::fwrite(entries, sizeof(LedgerEntry), count, file);
+    }
+    appended += count;
+}
+
+bool LedgerWriter::flush() {
+    if (!file) {
+        return false;
+    }
+    bool ok = true;
+    if (!buffer.empty()) {
+        ok = std::fwrite(buffer.data(), sizeof(LedgerEntry), buffer.size(), file) == buffer.size();
+        buffer.clear();
+    }
+    return std::fflush(file) == 0 && ok;
+}
+
+bool LedgerWriter::sync() {
+#ifndef _WIN32
+    return flush() && ::fdatasync(fileno(file)) == 0;
+#else
+    return flush();
+#endif
+}
+
+uint64_t LedgerWriter::getAppended() const {
+    return appended;
+}
+
+// LedgerReader implementation
+LedgerReader::LedgerReader() : entries(nullptr), count(0), mappedBase(nullptr), mappedSize(0) {}
+
+LedgerReader::~LedgerReader() {
+    close();
+}
+
+bool LedgerReader::open(const std::string& path) {
+    close();
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < Ledger::HEADER_SIZE) {
+        ::close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void* base = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        return false;
+    }
+    if (!checkHeader(static_cast<const char*>(base))) {
+        munmap(base, size);
+        return false;
+    }
+    madvise(base, size, MADV_SEQUENTIAL);
+    mappedBase = base;
+    mappedSize = size;
+    entries = reinterpret_cast<const LedgerEntry*>(static_cast<const char*>(base) + Ledger::HEADER_SIZE);
+    count = (size - Ledger::HEADER_SIZE) / sizeof(LedgerEntry);
+    return true;
+#else
+    std::ifstream file(path, std::ios::binary);
+    char header[Ledger::HEADER_SIZE];
+    if (!file.read(header, sizeof(header)) || !checkHeader(header)) {
+        return false;
+    }
+    LedgerEntry entry;
+    while (file.read(reinterpret_cast<char*>(&entry), sizeof(entry))) {
+        loaded.push_back(entry);
+    }
+    entries = loaded.data();
+    count = loaded.size();
+    return true;
+#endif
+}
+
+void LedgerReader::close() {
+#ifndef _WIN32
+    if (mappedBase) {
+        munmap(mappedBase, mappedSize);
+    }
+#endif
+    mappedBase = nullptr;
+    mappedSize = 0;
+    loaded.clear();
+    entries = nullptr;
+    count = 0;
+}
+
+const LedgerEntry* LedgerReader::data() const {
+    return entries;
+}
+
+size_t LedgerReader::size() const {
+    return count;
+}
+
+const LedgerEntry& LedgerReader::operator[](size_t index) const {
+    return entries[index];
+}
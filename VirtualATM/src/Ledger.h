@@ -0,0 +1,106 @@
+#ifndef LEDGER_H
+#define LEDGER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Append-only binary transaction ledger.
+//
+// File layout: a 16-byte header (magic "ATMLEDG1", entry size, reserved)
+// followed by fixed-size 32-byte little-endian entries in posting order.
+// Fixed-size entries let readers map the file and split it into ranges
+// without parsing.
+enum class LedgerType : uint8_t {
+    Withdrawal = 1,
+    Deposit = 2,
+    BalanceInquiry = 3,
+    TransferOut = 4,
+    TransferIn = 5
+};
+
+const uint8_t LEDGER_FLAG_FAILED = 0x01;
+
+struct LedgerEntry {
+    uint64_t accountKey;  // AccountKey::ledgerKey of the account number
+    int64_t timestampUs;  // microseconds since the Unix epoch
+    int64_t amountCents;  // always non-negative; the type gives the direction
+    uint8_t type;         // LedgerType
+    uint8_t flags;        // LEDGER_FLAG_*
+    uint16_t reserved;
+    uint32_t terminal;    // terminal that posted the entry, 0 if unknown
+};
+
+static_assert(sizeof(LedgerEntry) == 32, "LedgerEntry is a fixed 32-byte record");
+
+class Ledger {
+public:
+    static const char MAGIC[8];
+    static const size_t HEADER_SIZE = 16;
+
+    // The header a new ledger file starts with
+    static void fillHeader(char* header);
+
+    static const char* typeName(uint8_t type);
+
+    // Effect of an entry on the account balance, in cents
+    static int64_t balanceDelta(const LedgerEntry& entry);
+
+    static int64_t toCents(double amount);
+};
+
+// Buffered appender; creates the file and header on first use
+class LedgerWriter {
+private:
+    std::FILE* file;
+    std::vector<LedgerEntry> buffer;
+    uint64_t appended;
+
+public:
+    LedgerWriter();
+    ~LedgerWriter();
+
+    LedgerWriter(const LedgerWriter&) = delete;
+    LedgerWriter& operator=(const LedgerWriter&) = delete;
+
+    // truncate: start a new ledger instead of appending to an existing one
+    bool open(const std::string& path, bool truncate = false);
+    bool isOpen() const;
+    void close();
+
+    void append(const LedgerEntry& entry);
+    void append(const LedgerEntry* entries, size_t count);
+    bool flush();
+
+    // Flush and wait for the entries to reach the disk
+    bool sync();
+
+    uint64_t getAppended() const;
+};
+
+// Read-only view of a whole ledger file (memory-mapped where available)
+class LedgerReader {
+private:
+    const LedgerEntry* entries;
+    size_t count;
+    void* mappedBase;
+    size_t mappedSize;
+    std::vector<LedgerEntry> loaded;
+
+public:
+    LedgerReader();
+    ~LedgerReader();
+
+    LedgerReader(const LedgerReader&) = delete;
+    LedgerReader& operator=(const LedgerReader&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    const LedgerEntry* data() const;
+    size_t size() const;
+    const LedgerEntry& operator[](size_t index) const;
+};
+
+#endif // LEDGER_H
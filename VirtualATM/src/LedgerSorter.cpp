@@ -0,0 +1,306 @@
+#include "LedgerSorter.h"
+#include "FastText.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <vector>
+
+const uint8_t LedgerSorter::OPENING_RECORD;
+const size_t LedgerSorter::MAX_PARTITIONS;
+
+namespace {
+    const size_t SCAN_PIECE_ENTRIES = 1 << 20;
+    const size_t READ_BUFFER_ENTRIES = 4096;
+
+    // Sequential reader over a file of records with a fixed-size buffer
+    class RecordReader {
+    private:
+        std::FILE* file;
+        std::vector<LedgerEntry> buffer;
+        size_t position;
+        size_t filled;
+
+    public:
+        RecordReader() : file(nullptr), position(0), filled(0) {}
+        RecordReader(const RecordReader&) = delete;
+        RecordReader& operator=(const RecordReader&) = delete;
+        ~RecordReader() {
+            if (file) {
+                std::fclose(file);
+            }
+        }
+
+        bool open(const std::string& path) {
+            file = std::fopen(path.c_str(), "rb");
+            buffer.resize(READ_BUFFER_ENTRIES);
+            return file != nullptr;
+        }
+
+        const LedgerEntry* next() {
+            if (position == filled) {
+                filled = std::fread(buffer.data(), sizeof(LedgerEntry), buffer.size(), file);
+                position = 0;
+                if (filled == 0) {
+                    return nullptr;
+                }
+            }
+            return &buffer[position++];
+        }
+    };
+
+    struct RunHead {
+        LedgerEntry record;
+        size_t run;
+    };
+
+    struct RunHeadAfter {
+        bool operator()(const RunHead& a, const RunHead& b) const {
+            return LedgerSorter::recordBefore(b.record, a.record);
+        }
+    };
+}
+
+LedgerSorter::LedgerSorter(const LedgerSortConfig& config)
+    : config(config), threads(Parallel::resolveThreads(config.threads)), spilledRuns(0) {
+    std::error_code error;
+    uint64_t records = 0;
+    if (std::filesystem::exists(config.ledgerPath, error)) {
+        records += std::filesystem::file_size(config.ledgerPath, error) / sizeof(LedgerEntry);
+    }
+    if (!config.openingPath.empty() && std::filesystem::exists(config.openingPath, error)) {
+        records += std::filesystem::file_size(config.openingPath, error) / 16;
+    }
+
+    runEntries = std::max<size_t>(READ_BUFFER_ENTRIES, config.memoryBudget / 2 / threads / sizeof(LedgerEntry));
+    partitions = static_cast<size_t>(std::min<uint64_t>(MAX_PARTITIONS, records / runEntries + 1));
+    partitions = std::max<size_t>(partitions, threads);
+    bufferEntries = std::max<size_t>(64, config.memoryBudget / 4 / (threads * partitions * sizeof(LedgerEntry)));
+}
+
+LedgerSorter::~LedgerSorter() {
+    std::error_code error;
+    for (size_t partition = 0; partition < partitions; ++partition) {
+        std::filesystem::remove(partitionPath(partition), error);
+    }
+}
+
+size_t LedgerSorter::getPartitions() const {
+    return partitions;
+}
+
+unsigned LedgerSorter::getThreads() const {
+    return threads;
+}
+
+uint64_t LedgerSorter::getSpilledRuns() const {
+    return spilledRuns.load();
+}
+
+size_t LedgerSorter::partitionOf(uint64_t accountKey, size_t partitions) {
+    uint64_t mixed = (accountKey ^ (accountKey >> 31)) * 0x9E3779B97F4A7C15ULL;
+    mixed ^= mixed >> 29;
+#if defined(__SIZEOF_INT128__)
+    return static_cast<size_t>((static_cast<unsigned __int128>(mixed) * partitions) >> 64);
+#else
+    return static_cast<size_t>(mixed % partitions);
+#endif
+}
+
+bool LedgerSorter::recordBefore(const LedgerEntry& a, const LedgerEntry& b) {
+    if (a.accountKey != b.accountKey) return a.accountKey < b.accountKey;
+    if (a.timestampUs != b.timestampUs) return a.timestampUs < b.timestampUs;
+    if (a.type != b.type) return a.type < b.type;
+    if (a.amountCents != b.amountCents) return a.amountCents < b.amountCents;
+    if (a.flags != b.flags) return a.flags < b.flags;
+    return a.terminal < b.terminal;
+}
+
+std::string LedgerSorter::partitionPath(size_t partition) const {
+    return config.tempDir + "/part-" + std::to_string(partition) + ".bin";
+}
+
+std::string LedgerSorter::runPath(size_t partition, uint64_t run) const {
+    return config.tempDir + "/part-" + std::to_string(partition) + "-run-" + std::to_string(run) + ".bin";
+}
+
+bool LedgerSorter::scatter() {
+    std::error_code error;
+    std::filesystem::create_directories(config.tempDir, error);
+    if (error) {
+        std::cerr << "Error: Could not create " << config.tempDir << std::endl;
+        return false;
+    }
+
+    std::vector<std::FILE*> files(partitions, nullptr);
+    std::unique_ptr<std::mutex[]> locks(new std::mutex[partitions]);
+    std::atomic<bool> failed(false);
+    for (size_t partition = 0; partition < partitions; ++partition) {
+        files[partition] = std::fopen(partitionPath(partition).c_str(), "wb");
+        if (!files[partition]) {
+            failed = true;
+        }
+    }
+
+    // One buffer per (thread, partition); a full buffer is appended to its
+    // partition file under that partition's lock
+    std::vector<std::vector<std::vector<LedgerEntry>>> buffers(threads);
+    for (auto& perThread : buffers) {
+        perThread.resize(partitions);
+        for (auto& buffer : perThread) {
+            buffer.reserve(bufferEntries);
+        }
+    }
+    auto spill = [&](std::vector<LedgerEntry>& buffer, size_t partition) {
+        if (buffer.empty()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(locks[partition]);
+        if (!files[partition] ||
+            std::fwrite(buffer.data(), sizeof(LedgerEntry), buffer.size(), files[partition]) != buffer.size()) {
+            failed = true;
+        }
+        buffer.clear();
+    };
+    auto add = [&](unsigned thread, const LedgerEntry& record) {
+        size_t partition = partitionOf(record.accountKey, partitions);
+        std::vector<LedgerEntry>& buffer = buffers[thread][partition];
+        buffer.push_back(record);
+        if (buffer.size() == bufferEntries) {
+            spill(buffer, partition);
+        }
+    };
+
+    LedgerReader ledger;
+    if (!failed && !ledger.open(config.ledgerPath)) {
+        std::cerr << "Error: Could not open ledger " << config.ledgerPath << std::endl;
+        failed = true;
+    }
+    if (!failed) {
+        const LedgerEntry* entries = ledger.data();
+        size_t count = ledger.size();
+        size_t pieces = count / SCAN_PIECE_ENTRIES + 1;
+        Parallel::forEach(pieces, threads, [&](size_t piece, unsigned thread) {
+            size_t first = count / pieces * piece;
+            size_t last = piece + 1 == pieces ? count : count / pieces * (piece + 1);
+            for (size_t i = first; i < last; ++i) {
+                if (entries[i].timestampUs < config.beforeUs) {
+                    add(thread, entries[i]);
+                }
+            }
+        });
+    }
+
+    MappedFile opening;
+    if (!failed && !config.openingPath.empty()) {
+        if (!opening.open(config.openingPath)) {
+            std::cerr << "Error: Could not open " << config.openingPath << std::endl;
+            failed = true;
+        } else {
+            std::vector<size_t> offsets = opening.splitLines(opening.size() / (4 << 20) + 1);
+            Parallel::forEach(offsets.size() - 1, threads, [&](size_t piece, unsigned thread) {
+                const char* cursor = opening.data() + offsets[piece];
+                const char* end = opening.data() + offsets[piece + 1];
+                AccountLine line;
+                LedgerEntry record = {};
+                record.type = OPENING_RECORD;
+                record.timestampUs = std::numeric_limits<int64_t>::min();
+                while (FastText::nextAccountLine(cursor, end, line)) {
+                    if (line.accountKey != 0) {
+                        record.accountKey = line.accountKey;
+                        record.amountCents = line.balanceCents;
+                        add(thread, record);
+                    }
+                }
+            });
+        }
+    }
+
+    for (auto& perThread : buffers) {
+        for (size_t partition = 0; partition < partitions; ++partition) {
+            spill(perThread[partition], partition);
+        }
+    }
+    for (std::FILE* file : files) {
+        if (file && std::fclose(file) != 0) {
+            failed = true;
+        }
+    }
+    return !failed;
+}
+
+// Whole partitions that fit runEntries are sorted and fed from memory;
+// bigger ones are cut into sorted runs and merged through a heap
+bool LedgerSorter::sortPartition(size_t partition, LedgerSink& sink) {
+    std::string path = partitionPath(partition);
+    std::FILE* input = std::fopen(path.c_str(), "rb");
+    if (!input) {
+        std::cerr << "Error: Could not open " << path << std::endl;
+        return false;
+    }
+
+    bool ok = true;
+    std::vector<LedgerEntry> run(runEntries);
+    uint64_t runs = 0;
+    size_t firstRunSize = 0;
+    for (;;) {
+        size_t size = std::fread(run.data(), sizeof(LedgerEntry), runEntries, input);
+        if (size == 0) {
+            break;
+        }
+        std::sort(run.begin(), run.begin() + size, recordBefore);
+        if (runs == 0 && size < runEntries) {
+            firstRunSize = size;
+            runs = 1;
+            break;
+        }
+        std::FILE* spill = std::fopen(runPath(partition, runs).c_str(), "wb");
+        bool written = spill && std::fwrite(run.data(), sizeof(LedgerEntry), size, spill) == size;
+        if (spill) {
+            std::fclose(spill);
+        }
+        runs++;
+        if (!written) {
+            ok = false;
+            break;
+        }
+    }
+    std::fclose(input);
+    std::remove(path.c_str());
+
+    if (ok && firstRunSize > 0) {
+        for (size_t i = 0; i < firstRunSize; ++i) {
+            sink.consume(run[i]);
+        }
+    } else if (runs > 0) {
+        std::vector<LedgerEntry>().swap(run);
+        if (ok) {
+            spilledRuns += runs;
+            std::vector<RecordReader> readers(runs);
+            std::priority_queue<RunHead, std::vector<RunHead>, RunHeadAfter> heads;
+            for (uint64_t i = 0; i < runs; ++i) {
+                const LedgerEntry* record = readers[i].open(runPath(partition, i)) ? readers[i].next() : nullptr;
+                if (record) {
+                    heads.push({*record, static_cast<size_t>(i)});
+                }
+            }
+            while (!heads.empty()) {
+                RunHead head = heads.top();
+                heads.pop();
+                sink.consume(head.record);
+                if (const LedgerEntry* record = readers[head.run].next()) {
+                    heads.push({*record, head.run});
+                }
+            }
+        }
+        for (uint64_t i = 0; i < runs; ++i) {
+            std::remove(runPath(partition, i).c_str());
+        }
+    }
+    return ok;
+}
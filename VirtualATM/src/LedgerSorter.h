@@ -0,0 +1,75 @@
+#ifndef LEDGERSORTER_H
+#define LEDGERSORTER_H
+
+#include "Ledger.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+// Receives the records of one partition in (account, time) order
+class LedgerSink {
+public:
+    virtual ~LedgerSink() = default;
+    virtual void consume(const LedgerEntry& record) = 0;
+};
+
+struct LedgerSortConfig {
+    std::string ledgerPath;
+    std::string openingPath; // optional; each balance becomes an OPENING_RECORD
+    std::string tempDir;     // scratch space for partitions and sorted runs
+    int64_t beforeUs = std::numeric_limits<int64_t>::max(); // drop later entries
+    size_t memoryBudget = size_t(256) << 20;
+    unsigned threads = 0;    // 0: hardware concurrency
+};
+
+// External sort of the ledger by account, in bounded memory.
+//
+// scatter() streams the inputs once, in parallel, and appends every record
+// to one of several partition files chosen by account hash. Each partition
+// can then be sorted independently (and concurrently): in memory when it
+// fits its share of the budget, otherwise as sorted runs merged through a
+// heap. A quarter of the budget goes to scatter buffers and half to the
+// sort runs, one per thread.
+class LedgerSorter {
+public:
+    // Not a LedgerType; carries an opening balance and sorts first
+    static const uint8_t OPENING_RECORD = 0;
+    static const size_t MAX_PARTITIONS = 256;
+
+    explicit LedgerSorter(const LedgerSortConfig& config);
+    ~LedgerSorter();
+
+    LedgerSorter(const LedgerSorter&) = delete;
+    LedgerSorter& operator=(const LedgerSorter&) = delete;
+
+    bool scatter();
+
+    // Feed one partition to the sink in order; the partition file is
+    // removed afterwards
+    bool sortPartition(size_t partition, LedgerSink& sink);
+
+    size_t getPartitions() const;
+    unsigned getThreads() const;
+    uint64_t getSpilledRuns() const;
+
+    static size_t partitionOf(uint64_t accountKey, size_t partitions);
+
+    // A total order on record contents, so results never depend on the
+    // order in which threads scattered the records
+    static bool recordBefore(const LedgerEntry& a, const LedgerEntry& b);
+
+private:
+    LedgerSortConfig config;
+    unsigned threads;
+    size_t partitions;
+    size_t runEntries;
+    size_t bufferEntries;
+    std::atomic<uint64_t> spilledRuns;
+
+    std::string partitionPath(size_t partition) const;
+    std::string runPath(size_t partition, uint64_t run) const;
+};
+
+#endif // LEDGERSORTER_H
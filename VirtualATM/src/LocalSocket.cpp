@@ -0,0 +1,130 @@
+#include "LocalSocket.h"
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+    bool socketAddress(const std::string& path, sockaddr_un& address, std::string& error) {
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+            error = "socket path must be 1-" + std::to_string(sizeof(address.sun_path) - 1) + " characters";
+            return false;
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.size());
+        return true;
+    }
+}
+
+int LocalSocket::listen(const std::string& path, int backlog, std::string& error) {
+    sockaddr_un address;
+    if (!socketAddress(path, address, error)) {
+        return -1;
+    }
+    // A socket file left by an earlier process would make bind fail
+    ::unlink(path.c_str());
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(fd, backlog) != 0) {
+        error = "cannot listen on " + path + ": " + std::strerror(errno);
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+int LocalSocket::connect(const std::string& path, std::string& error) {
+    sockaddr_un address;
+    if (!socketAddress(path, address, error)) {
+        return -1;
+    }
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        error = "cannot connect to " + path + ": " + std::strerror(errno);
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+int LocalSocket::accept(int listenFd) {
+    return ::accept(listenFd, nullptr, nullptr);
+}
+
+bool LocalSocket::sendAll(int fd, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t sent = ::send(fd, bytes, size, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return false;
+        }
+        bytes += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+bool LocalSocket::receiveAll(int fd, void* data, size_t size) {
+    char* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t received = ::recv(fd, bytes, size, 0);
+        if (received <= 0) {
+            return false;
+        }
+        bytes += received;
+        size -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+void LocalSocket::shutdown(int fd) {
+    ::shutdown(fd, SHUT_RDWR);
+}
+
+void LocalSocket::shutdownWrite(int fd) {
+    ::shutdown(fd, SHUT_WR);
+}
+
+void LocalSocket::close(int fd) {
+    ::close(fd);
+}
+
+#else
+
+int LocalSocket::listen(const std::string&, int, std::string& error) {
+    error = "Unix domain sockets are not available";
+    return -1;
+}
+
+int LocalSocket::connect(const std::string&, std::string& error) {
+    error = "Unix domain sockets are not available";
+    return -1;
+}
+
+int LocalSocket::accept(int) {
+    return -1;
+}
+
+bool LocalSocket::sendAll(int, const void*, size_t) {
+    return false;
+}
+
+bool LocalSocket::receiveAll(int, void*, size_t) {
+    return false;
+}
+
+void LocalSocket::shutdown(int) {}
+
+void LocalSocket::shutdownWrite(int) {}
+
+void LocalSocket::close(int) {}
+
+#endif
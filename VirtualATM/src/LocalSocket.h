@@ -0,0 +1,26 @@
+#ifndef LOCALSOCKET_H
+#define LOCALSOCKET_H
+
+#include <cstddef>
+#include <string>
+
+// Blocking Unix domain stream sockets for the multi-process modes
+// (replication, sharding). Descriptors are plain ints; -1 on failure with
+// a message in error. Not available on Windows.
+class LocalSocket {
+public:
+    static int listen(const std::string& path, int backlog, std::string& error);
+    static int connect(const std::string& path, std::string& error);
+    static int accept(int listenFd);
+
+    // Whole buffers or nothing; false once the peer is gone
+    static bool sendAll(int fd, const void* data, size_t size);
+    static bool receiveAll(int fd, void* data, size_t size);
+
+    // Stop accepting (wakes a blocked accept) / stop sending
+    static void shutdown(int fd);
+    static void shutdownWrite(int fd);
+    static void close(int fd);
+};
+
+#endif // LOCALSOCKET_H
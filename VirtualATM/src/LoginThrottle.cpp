@@ -0,0 +1,216 @@
+#include "LoginThrottle.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "LoginThrottle requires lock-free 64-bit atomics");
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t),
+              "LoginThrottle maps atomics directly onto file memory");
+
+// Slot layout: [ 24-bit key tag | 40-bit theoretical arrival time in ms ]
+namespace {
+    const int TAT_BITS = 40;
+    const uint64_t TAT_MASK = (uint64_t(1) << TAT_BITS) - 1;
+    const int64_t THROTTLE_EPOCH_MS = 1704067200000LL; // 2024-01-01T00:00:00Z
+    const char* const SHARED_TABLE_PATH = "data/login_throttle.bin";
+
+    uint64_t tagOf(uint64_t keyHash) {
+        uint64_t tag = keyHash >> TAT_BITS;
+        return tag == 0 ? 1 : tag;
+    }
+
+    uint64_t slotTag(uint64_t value) { return value >> TAT_BITS; }
+    int64_t slotTat(uint64_t value) { return static_cast<int64_t>(value & TAT_MASK); }
+
+    uint64_t pack(uint64_t tag, int64_t tat) {
+        return (tag << TAT_BITS) | (static_cast<uint64_t>(tat) & TAT_MASK);
+    }
+
+    bool isFree(uint64_t value, int64_t now) {
+        return value == 0 || slotTat(value) <= now;
+    }
+}
+
+const LoginThrottle::Policy LoginThrottle::ACCOUNT_POLICY = {5, 60 * 1000};
+const LoginThrottle::Policy LoginThrottle::TERMINAL_POLICY = {20, 3 * 1000};
+
+LoginThrottle& LoginThrottle::instance() {
+    static LoginThrottle throttle;
+    static bool opened = throttle.openShared(SHARED_TABLE_PATH);
+    (void)opened;
+    return throttle;
+}
+
+LoginThrottle::LoginThrottle()
+    : slots(nullptr), privateSlots(new std::atomic<uint64_t>[TABLE_SLOTS]),
+      mappedBase(nullptr), mappedSize(0) {
+    for (size_t i = 0; i < TABLE_SLOTS; ++i) {
+        privateSlots[i].store(0, std::memory_order_relaxed);
+    }
+    slots = privateSlots.get();
+}
+
+LoginThrottle::~LoginThrottle() {
+    unmap();
+}
+
+// Map the shared counter table, creating a zeroed file on first use
+bool LoginThrottle::openShared(const std::string& path) {
+#ifndef _WIN32
+    const size_t size = TABLE_SLOTS * sizeof(uint64_t);
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        std::cerr << "Warning: Could not open login throttle table. Using a private table." << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (static_cast<size_t>(st.st_size) != size && ftruncate(fd, size) != 0)) {
+        ::close(fd);
+        std::cerr << "Warning: Could not size login throttle table. Using a private table." << std::endl;
+        return false;
+    }
+
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        std::cerr << "Warning: Could not map login throttle table. Using a private table." << std::endl;
+        return false;
+    }
+
+    unmap();
+    mappedBase = base;
+    mappedSize = size;
+    slots = static_cast<std::atomic<uint64_t>*>(base);
+    return true;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+void LoginThrottle::unmap() {
+#ifndef _WIN32
+    if (mappedBase) {
+        munmap(mappedBase, mappedSize);
+        mappedBase = nullptr;
+        mappedSize = 0;
+        slots = privateSlots.get();
+    }
+#endif
+}
+
+bool LoginThrottle::allowAttempt(const std::string& accountNumber, const std::string& terminalId) {
+    const int64_t now = nowMs();
+    if (!consume(hashKey('T', terminalId), TERMINAL_POLICY, now)) {
+        return false;
+    }
+    return consume(hashKey('A', accountNumber), ACCOUNT_POLICY, now);
+}
+
+void LoginThrottle::recordSuccess(const std::string& accountNumber) {
+    const uint64_t keyHash = hashKey('A', accountNumber);
+    const uint64_t tag = tagOf(keyHash);
+    std::atomic<uint64_t>* freeSlot;
+    uint64_t freeValue;
+    std::atomic<uint64_t>* slot = locate(keyHash, nowMs(), freeSlot, freeValue);
+    if (!slot) {
+        return;
+    }
+    uint64_t current = slot->load(std::memory_order_acquire);
+    while (slotTag(current) == tag) {
+        if (slot->compare_exchange_weak(current, 0, std::memory_order_acq_rel)) {
+            break;
+        }
+    }
+}
+
+// GCRA: an attempt conforms while the arrival time is at most burst-1
+// intervals ahead of now. Rejected attempts leave the slot untouched.
+bool LoginThrottle::consume(uint64_t keyHash, const Policy& policy, int64_t now) {
+    const uint64_t tag = tagOf(keyHash);
+    const int64_t tolerance = (policy.burst - 1) * policy.intervalMs;
+
+    while (true) {
+        std::atomic<uint64_t>* freeSlot;
+        uint64_t freeValue;
+        std::atomic<uint64_t>* slot = locate(keyHash, now, freeSlot, freeValue);
+        if (!slot) {
+            // A new key reserves a free slot with its first arrival. With the
+            // window full of live buckets it is refused: charging another
+            // key's bucket would throttle that key by the wrong policy.
+            if (!freeSlot) {
+                return false;
+            }
+            if (freeSlot->compare_exchange_strong(freeValue, pack(tag, now + policy.intervalMs),
+                                                  std::memory_order_acq_rel)) {
+                return true;
+            }
+            continue; // another key took the slot first
+        }
+
+        uint64_t current = slot->load(std::memory_order_acquire);
+        while (slotTag(current) == tag) {
+            int64_t tat = std::max(slotTat(current), now);
+            if (tat - now > tolerance) {
+                return false;
+            }
+            if (slot->compare_exchange_weak(current, pack(tag, tat + policy.intervalMs),
+                                            std::memory_order_acq_rel)) {
+                return true;
+            }
+        }
+        // The bucket expired and its slot was reused or cleared: look again
+    }
+}
+
+// The slot holding a key, or nullptr with freeSlot set to the first free slot
+// in the probe window (nullptr if none) and freeValue to what it held
+std::atomic<uint64_t>* LoginThrottle::locate(uint64_t keyHash, int64_t now, std::atomic<uint64_t>*& freeSlot,
+                                             uint64_t& freeValue) const {
+    const uint64_t tag = tagOf(keyHash);
+    const size_t home = keyHash & (TABLE_SLOTS - 1);
+    freeSlot = nullptr;
+    freeValue = 0;
+
+    for (size_t probe = 0; probe < PROBE_LIMIT; ++probe) {
+        std::atomic<uint64_t>& slot = slots[(home + probe) & (TABLE_SLOTS - 1)];
+        uint64_t value = slot.load(std::memory_order_acquire);
+        if (slotTag(value) == tag) {
+            return &slot;
+        }
+        if (!freeSlot && isFree(value, now)) {
+            freeSlot = &slot;
+            freeValue = value;
+        }
+    }
+    return nullptr;
+}
+
+// FNV-1a over a namespace byte and the key, finished with a 64-bit mixer
+uint64_t LoginThrottle::hashKey(char ns, const std::string& key) {
+    uint64_t h = 1469598103934665603ULL;
+    h = (h ^ static_cast<unsigned char>(ns)) * 1099511628211ULL;
+    for (unsigned char c : key) {
+        h = (h ^ c) * 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+int64_t LoginThrottle::nowMs() {
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now).count() - THROTTLE_EPOCH_MS;
+}
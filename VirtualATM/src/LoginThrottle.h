@@ -0,0 +1,69 @@
+#ifndef LOGINTHROTTLE_H
+#define LOGINTHROTTLE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Shared failed-login throttling.
+//
+// Every login attempt has to take a token from two buckets: one keyed by the
+// account number and one keyed by the terminal. Buckets use GCRA (a token
+// bucket stored as a single "theoretical arrival time"), so each bucket is one
+// 64-bit word and decays with time without any background work. All buckets
+// live in a fixed-size open-addressed table of atomics, updated with CAS only;
+// a key whose probe window is full of other live buckets is refused.
+// The table is memory-mapped from a file so that every terminal process on the
+// host, and the next restart, sees the same counters.
+class LoginThrottle {
+public:
+    struct Policy {
+        int burst;          // attempts allowed back to back
+        int64_t intervalMs; // one attempt is refunded every interval
+    };
+
+    static const Policy ACCOUNT_POLICY;
+    static const Policy TERMINAL_POLICY;
+
+    // Process-wide throttle backed by the shared table file
+    static LoginThrottle& instance();
+
+    // In-memory table, not shared with other processes
+    LoginThrottle();
+    ~LoginThrottle();
+
+    LoginThrottle(const LoginThrottle&) = delete;
+    LoginThrottle& operator=(const LoginThrottle&) = delete;
+
+    // Map the shared table file; falls back to the private table on failure
+    bool openShared(const std::string& path);
+
+    // Take one token from the terminal and account buckets. Returns false if
+    // either bucket is exhausted; the caller must then skip PIN verification.
+    bool allowAttempt(const std::string& accountNumber, const std::string& terminalId);
+
+    // Forget earlier failures for an account after a successful login
+    void recordSuccess(const std::string& accountNumber);
+
+private:
+    static const size_t TABLE_SLOTS = 1 << 16;
+    static const size_t PROBE_LIMIT = 8;
+
+    std::atomic<uint64_t>* slots;
+    std::unique_ptr<std::atomic<uint64_t>[]> privateSlots;
+    void* mappedBase;
+    size_t mappedSize;
+
+    friend class LoginThrottleTest;
+
+    bool consume(uint64_t keyHash, const Policy& policy, int64_t nowMs);
+    std::atomic<uint64_t>* locate(uint64_t keyHash, int64_t nowMs, std::atomic<uint64_t>*& freeSlot,
+                                  uint64_t& freeValue) const;
+    void unmap();
+
+    static uint64_t hashKey(char ns, const std::string& key);
+    static int64_t nowMs();
+};
+
+#endif // LOGINTHROTTLE_H
@@ -0,0 +1,93 @@
+#include "MappedFile.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : bytes(nullptr), length(0), mappedBase(nullptr) {}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    length = static_cast<size_t>(st.st_size);
+    if (length == 0) {
+        ::close(fd);
+        bytes = "";
+        return true;
+    }
+    void* base = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        length = 0;
+        return false;
+    }
+    madvise(base, length, MADV_SEQUENTIAL);
+    mappedBase = base;
+    bytes = static_cast<const char*>(base);
+    return true;
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    loaded.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    bytes = loaded.data();
+    length = loaded.size();
+    return true;
+#endif
+}
+
+void MappedFile::close() {
+#ifndef _WIN32
+    if (mappedBase) {
+        munmap(mappedBase, length);
+    }
+#endif
+    mappedBase = nullptr;
+    loaded.clear();
+    bytes = nullptr;
+    length = 0;
+}
+
+const char* MappedFile::data() const {
+    return bytes;
+}
+
+size_t MappedFile::size() const {
+    return length;
+}
+
+std::vector<size_t> MappedFile::splitLines(size_t parts) const {
+    parts = parts ? parts : 1;
+    std::vector<size_t> offsets(parts + 1, length);
+    offsets[0] = 0;
+    for (size_t i = 1; i < parts; ++i) {
+        size_t offset = std::max(offsets[i - 1], length / parts * i);
+        if (offset > 0 && offset < length) {
+            const void* newline = std::memchr(bytes + offset - 1, '\n', length - offset + 1);
+            offset = newline ? static_cast<size_t>(static_cast<const char*>(newline) - bytes) + 1 : length;
+        }
+        offsets[i] = offset;
+    }
+    return offsets;
+}
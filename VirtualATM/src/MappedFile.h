@@ -0,0 +1,37 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Read-only view of a whole file, memory-mapped where available.
+//
+// Used by the batch tools to scan large text and binary files in parallel
+// without copying them through streams.
+class MappedFile {
+private:
+    const char* bytes;
+    size_t length;
+    void* mappedBase;
+    std::vector<char> loaded;
+
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    const char* data() const;
+    size_t size() const;
+
+    // Split the contents into `parts` ranges that end on line boundaries;
+    // returns parts + 1 offsets (some ranges may be empty)
+    std::vector<size_t> splitLines(size_t parts) const;
+};
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,343 @@
+#include "Metrics.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    const int FIRST_BUCKET_SHIFT = 8; // first bucket holds values up to 256 ns
+
+    int bucketOf(uint64_t nanoseconds) {
+        if (nanoseconds <= (uint64_t(1) << FIRST_BUCKET_SHIFT)) {
+            return 0;
+        }
+#if defined(__GNUC__) || defined(__clang__)
+        int bits = 64 - __builtin_clzll(nanoseconds - 1);
+#else
+        int bits = 0;
+        for (uint64_t v = nanoseconds - 1; v; v >>= 1) {
+            ++bits;
+        }
+#endif
+        int bucket = bits - FIRST_BUCKET_SHIFT;
+        return bucket < MetricsRegistry::HISTOGRAM_BUCKETS ? bucket : MetricsRegistry::HISTOGRAM_BUCKETS;
+    }
+
+    // Single-writer increment: no lock prefix, still race-free for readers
+    inline void bump(std::atomic<uint64_t>& cell, uint64_t delta) {
+        cell.store(cell.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    std::string series(const std::string& name, const std::string& labels, const std::string& extra = "") {
+        if (labels.empty() && extra.empty()) {
+            return name;
+        }
+        std::string joined = labels;
+        if (!labels.empty() && !extra.empty()) {
+            joined += ",";
+        }
+        return name + "{" + joined + extra + "}";
+    }
+}
+
+const int MetricsRegistry::MAX_COUNTERS;
+const int MetricsRegistry::MAX_GAUGES;
+const int MetricsRegistry::MAX_HISTOGRAMS;
+const int MetricsRegistry::HISTOGRAM_BUCKETS;
+const int AtmMetrics::TRANSACTION_KINDS;
+const unsigned AtmMetrics::TRANSACTION_SAMPLE_INTERVAL;
+
+MetricsRegistry::Shard::Shard() {
+    for (auto& counter : counters) counter.store(0, std::memory_order_relaxed);
+    for (auto& gauge : gauges) gauge.store(0, std::memory_order_relaxed);
+    for (auto& histogram : buckets) {
+        for (auto& bucket : histogram) bucket.store(0, std::memory_order_relaxed);
+    }
+    for (auto& sum : sums) sum.store(0, std::memory_order_relaxed);
+}
+
+MetricsRegistry& MetricsRegistry::instance() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsRegistry::MetricsRegistry()
+    : enabled(true), counterCount(0), gaugeCount(0), histogramCount(0), exporterRunning(false), listenSocket(-1) {}
+
+MetricsRegistry::~MetricsRegistry() {
+    stopExporter();
+}
+
+void MetricsRegistry::setEnabled(bool on) {
+    enabled.store(on, std::memory_order_relaxed);
+}
+
+int MetricsRegistry::registerMetric(Kind kind, int& next, int limit, const std::string& name,
+                                    const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const auto& descriptor : descriptors) {
+        if (descriptor.kind == kind && descriptor.name == name && descriptor.labels == labels) {
+            return descriptor.id;
+        }
+    }
+    if (next >= limit) {
+        return -1;
+    }
+    descriptors.push_back(Descriptor{kind, next, name, help, labels});
+    return next++;
+}
+
+int MetricsRegistry::registerCounter(const std::string& name, const std::string& help, const std::string& labels) {
+    return registerMetric(Kind::Counter, counterCount, MAX_COUNTERS, name, help, labels);
+}
+
+int MetricsRegistry::registerGauge(const std::string& name, const std::string& help, const std::string& labels) {
+    return registerMetric(Kind::Gauge, gaugeCount, MAX_GAUGES, name, help, labels);
+}
+
+int MetricsRegistry::registerHistogram(const std::string& name, const std::string& help, const std::string& labels) {
+    return registerMetric(Kind::Histogram, histogramCount, MAX_HISTOGRAMS, name, help, labels);
+}
+
+// Shards are never freed, so counts from finished threads stay exported
+MetricsRegistry::Shard* MetricsRegistry::attachShard() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    shards.emplace_back(new Shard());
+    return shards.back().get();
+}
+
+void MetricsRegistry::adjust(int gauge, int64_t delta) {
+    if (gauge < 0 || !isEnabled()) {
+        return;
+    }
+    std::atomic<int64_t>& cell = localShard().gauges[gauge];
+    cell.store(cell.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+void MetricsRegistry::observe(int histogram, uint64_t nanoseconds, uint64_t weight) {
+    if (histogram < 0 || !isEnabled()) {
+        return;
+    }
+    Shard& shard = localShard();
+    bump(shard.buckets[histogram][bucketOf(nanoseconds)], weight);
+    bump(shard.sums[histogram], nanoseconds * weight);
+}
+
+std::string MetricsRegistry::exportText() const {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::string out;
+    std::string lastName;
+    char number[64];
+
+    for (const auto& d : descriptors) {
+        if (d.name != lastName) {
+            static const char* const TYPES[] = {"counter", "gauge", "histogram"};
+            out += "# HELP " + d.name + " " + d.help + "\n";
+            out += "# TYPE " + d.name + " " + TYPES[static_cast<int>(d.kind)] + "\n";
+            lastName = d.name;
+        }
+
+        if (d.kind == Kind::Counter) {
+            uint64_t total = 0;
+            for (const auto& shard : shards) total += shard->counters[d.id].load(std::memory_order_relaxed);
+            std::snprintf(number, sizeof(number), " %llu\n", static_cast<unsigned long long>(total));
+            out += series(d.name, d.labels) + number;
+        } else if (d.kind == Kind::Gauge) {
+            int64_t total = 0;
+            for (const auto& shard : shards) total += shard->gauges[d.id].load(std::memory_order_relaxed);
+            std::snprintf(number, sizeof(number), " %lld\n", static_cast<long long>(total));
+            out += series(d.name, d.labels) + number;
+        } else {
+            uint64_t cumulative = 0;
+            uint64_t sumNs = 0;
+            for (int b = 0; b <= HISTOGRAM_BUCKETS; ++b) {
+                for (const auto& shard : shards) cumulative += shard->buckets[d.id][b].load(std::memory_order_relaxed);
+                if (b < HISTOGRAM_BUCKETS) {
+                    double le = static_cast<double>(uint64_t(1) << (FIRST_BUCKET_SHIFT + b)) / 1e9;
+                    std::snprintf(number, sizeof(number), "le=\"%.9g\"", le);
+                } else {
+                    std::snprintf(number, sizeof(number), "le=\"+Inf\"");
+                }
+                out += series(d.name + "_bucket", d.labels, number);
+                std::snprintf(number, sizeof(number), " %llu\n", static_cast<unsigned long long>(cumulative));
+                out += number;
+            }
+            for (const auto& shard : shards) sumNs += shard->sums[d.id].load(std::memory_order_relaxed);
+            std::snprintf(number, sizeof(number), " %.9g\n", static_cast<double>(sumNs) / 1e9);
+            out += series(d.name + "_sum", d.labels) + number;
+            std::snprintf(number, sizeof(number), " %llu\n", static_cast<unsigned long long>(cumulative));
+            out += series(d.name + "_count", d.labels) + number;
+        }
+    }
+    return out;
+}
+
+bool MetricsRegistry::writeScrapeFile(const std::string& path) const {
+    std::string text = exportText();
+    std::string temporary = path + ".tmp";
+    std::FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+    ok = std::fclose(file) == 0 && ok;
+    return ok && std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+bool MetricsRegistry::startExporter(const std::string& path, int intervalMs, int port) {
+    if (exporterRunning.load()) {
+        return false;
+    }
+#ifndef _WIN32
+    if (port > 0) {
+        listenSocket = ::socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(port));
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (listenSocket < 0 || ::bind(listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(listenSocket, 8) != 0) {
+            if (listenSocket >= 0) {
+                ::close(listenSocket);
+            }
+            listenSocket = -1;
+            return false;
+        }
+    }
+#else
+    (void)port;
+#endif
+    exporterRunning.store(true);
+    exporter = std::thread(&MetricsRegistry::exporterLoop, this, path, intervalMs > 0 ? intervalMs : 10000);
+    return true;
+}
+
+void MetricsRegistry::stopExporter() {
+    if (!exporterRunning.exchange(false)) {
+        return;
+    }
+    if (exporter.joinable()) {
+        exporter.join();
+    }
+#ifndef _WIN32
+    if (listenSocket >= 0) {
+        ::close(listenSocket);
+        listenSocket = -1;
+    }
+#endif
+}
+
+// Rewrite the scrape file on schedule, answering scrapes in between
+void MetricsRegistry::exporterLoop(std::string path, int intervalMs) {
+    auto nextWrite = std::chrono::steady_clock::now();
+    while (exporterRunning.load()) {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= nextWrite) {
+            if (!path.empty()) {
+                writeScrapeFile(path);
+            }
+            nextWrite = now + std::chrono::milliseconds(intervalMs);
+        }
+        int waitMs = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(nextWrite - now).count());
+        serveOnce(std::min(std::max(waitMs, 1), 200));
+    }
+    if (!path.empty()) {
+        writeScrapeFile(path);
+    }
+}
+
+void MetricsRegistry::serveOnce(int timeoutMs) {
+#ifndef _WIN32
+    if (listenSocket < 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+        return;
+    }
+    pollfd waiting{listenSocket, POLLIN, 0};
+    if (::poll(&waiting, 1, timeoutMs) <= 0) {
+        return;
+    }
+    int client = ::accept(listenSocket, nullptr, nullptr);
+    if (client < 0) {
+        return;
+    }
+    char request[1024];
+    ssize_t received = ::recv(client, request, sizeof(request) - 1, 0);
+    std::string body = exportText();
+    std::string response;
+    if (received > 0 && std::strncmp(request, "GET /metrics", 12) == 0) {
+        response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                   std::to_string(body.size()) + "\r\n\r\n" + body;
+    } else {
+        response = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+    }
+    const char* data = response.data();
+    size_t remaining = response.size();
+    while (remaining > 0) {
+        ssize_t sent = ::send(client, data, remaining, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            break;
+        }
+        data += sent;
+        remaining -= static_cast<size_t>(sent);
+    }
+    ::close(client);
+#else
+    std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+#endif
+}
+
+// AtmMetrics implementation
+const AtmMetrics& AtmMetrics::get() {
+    static const AtmMetrics metrics;
+    return metrics;
+}
+
+AtmMetrics::AtmMetrics() {
+    MetricsRegistry& r = MetricsRegistry::instance();
+    sessionsStarted = r.registerCounter("atm_sessions_started_total", "ATM sessions started.");
+    sessionsActive = r.registerGauge("atm_sessions_active", "ATM sessions currently running.");
+    loginSucceeded = r.registerCounter("atm_login_attempts_total", "Login attempts by outcome.", "result=\"success\"");
+    loginFailed = r.registerCounter("atm_login_attempts_total", "Login attempts by outcome.", "result=\"failure\"");
+    loginThrottled = r.registerCounter("atm_login_attempts_total", "Login attempts by outcome.", "result=\"throttled\"");
+    loginDuration = r.registerHistogram("atm_login_duration_seconds", "Account lookup plus PIN check.");
+
+    static const char* const KINDS[TRANSACTION_KINDS] = {"WITHDRAWAL", "DEPOSIT", "BALANCE_INQUIRY", "TRANSFER"};
+    for (int kind = 0; kind < TRANSACTION_KINDS; ++kind) {
+        std::string type = std::string("type=\"") + KINDS[kind] + "\"";
+        transactionsSucceeded[kind] = r.registerCounter("atm_transactions_total", "Processed transactions.",
+                                                        type + ",result=\"success\"");
+        transactionsFailed[kind] = r.registerCounter("atm_transactions_total", "Processed transactions.",
+                                                     type + ",result=\"failure\"");
+    }
+    for (int kind = 0; kind < TRANSACTION_KINDS; ++kind) {
+        transactionDuration[kind] = r.registerHistogram("atm_transaction_process_seconds",
+                                                        "Transaction::process under the account lock (sampled).",
+                                                        std::string("type=\"") + KINDS[kind] + "\"");
+    }
+    velocityDeclined = r.registerCounter("atm_velocity_declines_total", "Withdrawals declined by a velocity rule.");
+    dailyLimitDeclined = r.registerCounter("atm_daily_limit_declines_total", "Withdrawals declined by the daily limit.");
+    dispenseRejected = r.registerCounter("atm_dispense_rejections_total", "Withdrawals the cassettes could not pay out.");
+    replicationShipped = r.registerCounter("atm_replication_entries_total", "Ledger entries queued for the standby.");
+    replicationDropped = r.registerCounter("atm_replication_dropped_total", "Ledger entries lost with the standby link.");
+    replicationBacklog = r.registerGauge("atm_replication_backlog_entries", "Entries not yet acknowledged by the standby.");
+    replicationAckDuration = r.registerHistogram("atm_replication_ack_seconds", "Batch sent to standby acknowledgment.");
+
+    fileLoadDuration = r.registerHistogram("atm_file_load_seconds", "FileManager::loadAccounts duration.");
+    fileLoadBytes = r.registerCounter("atm_file_load_bytes_total", "Bytes read by FileManager::loadAccounts.");
+    fileSaveDuration = r.registerHistogram("atm_file_save_seconds", "FileManager::saveAccounts duration.");
+    fileSaveBytes = r.registerCounter("atm_file_save_bytes_total", "Bytes written saving the accounts file.");
+    fileSavesSuperseded = r.registerCounter("atm_file_saves_superseded_total",
+                                            "Background saves replaced by a later one before they were written.");
+    journalBatches = r.registerCounter("atm_journal_batches_total", "Journal batches written and synced in the background.");
+    journalSyncDuration = r.registerHistogram("atm_journal_sync_seconds", "Journal batch submitted to synced.");
+}
@@ -0,0 +1,183 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Counters, gauges and latency histograms with Prometheus text export.
+//
+// Metrics are registered once by name and then addressed by a small
+// integer id. Every thread records into its own shard (plain relaxed
+// stores, no locks and no shared cache lines); exporting sums the shards.
+// Histograms use power-of-two nanosecond buckets, so recording is a
+// bit-scan and two increments.
+class MetricsRegistry {
+public:
+    static const int MAX_COUNTERS = 64;
+    static const int MAX_GAUGES = 16;
+    static const int MAX_HISTOGRAMS = 32;
+    static const int HISTOGRAM_BUCKETS = 28; // le = 2^8 ns .. 2^34 ns, then +Inf
+
+    static MetricsRegistry& instance();
+
+    // Registration (cold path); returns the id, or -1 if the table is full.
+    // labels is the Prometheus label set without braces, e.g. type="DEPOSIT".
+    int registerCounter(const std::string& name, const std::string& help, const std::string& labels = "");
+    int registerGauge(const std::string& name, const std::string& help, const std::string& labels = "");
+    int registerHistogram(const std::string& name, const std::string& help, const std::string& labels = "");
+
+    // Hot path; add is inline since it runs on every posting
+    void add(int counter, uint64_t delta = 1) {
+        if (counter < 0 || !isEnabled()) {
+            return;
+        }
+        std::atomic<uint64_t>& cell = localShard().counters[counter];
+        cell.store(cell.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+    void adjust(int gauge, int64_t delta);
+    void observe(int histogram, uint64_t nanoseconds, uint64_t weight = 1);
+
+    // Recording can be switched off at runtime (timers then skip the clock)
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    // Prometheus text exposition format, version 0.0.4
+    std::string exportText() const;
+
+    // Write the scrape file atomically (temp file + rename)
+    bool writeScrapeFile(const std::string& path) const;
+
+    // Background export: rewrite a scrape file every interval and/or serve
+    // GET /metrics on 127.0.0.1:port (port 0 disables the endpoint)
+    bool startExporter(const std::string& path, int intervalMs, int port);
+    void stopExporter();
+
+private:
+    enum class Kind { Counter, Gauge, Histogram };
+
+    struct Descriptor {
+        Kind kind;
+        int id;
+        std::string name;
+        std::string help;
+        std::string labels;
+    };
+
+    struct Shard {
+        std::atomic<uint64_t> counters[MAX_COUNTERS];
+        std::atomic<int64_t> gauges[MAX_GAUGES];
+        std::atomic<uint64_t> buckets[MAX_HISTOGRAMS][HISTOGRAM_BUCKETS + 1];
+        std::atomic<uint64_t> sums[MAX_HISTOGRAMS];
+        Shard();
+    };
+
+    std::atomic<bool> enabled;
+    mutable std::mutex registryMutex;
+    std::vector<Descriptor> descriptors;
+    std::vector<std::unique_ptr<Shard>> shards;
+    int counterCount;
+    int gaugeCount;
+    int histogramCount;
+
+    std::thread exporter;
+    std::atomic<bool> exporterRunning;
+    int listenSocket;
+
+    MetricsRegistry();
+    ~MetricsRegistry();
+
+    // Constant-initialized, so access compiles to a plain TLS load
+    inline static thread_local Shard* threadShard = nullptr;
+
+    Shard& localShard() {
+        Shard* shard = threadShard;
+        return shard ? *shard : *(threadShard = attachShard());
+    }
+    Shard* attachShard();
+    int registerMetric(Kind kind, int& next, int limit, const std::string& name, const std::string& help,
+                       const std::string& labels);
+    void exporterLoop(std::string path, int intervalMs);
+    void serveOnce(int timeoutMs);
+};
+
+// The metrics the ATM engine records, registered on first use
+struct AtmMetrics {
+    static const int TRANSACTION_KINDS = 4; // indexed by TransactionKind
+
+    // Postings are cheaper than two clock reads, so only one in this many is
+    // timed (and recorded with that weight); counters stay exact
+    static const unsigned TRANSACTION_SAMPLE_INTERVAL = 64;
+
+    int sessionsStarted;
+    int sessionsActive;
+    int loginSucceeded;
+    int loginFailed;
+    int loginThrottled;
+    int loginDuration;
+    int transactionsSucceeded[TRANSACTION_KINDS];
+    int transactionsFailed[TRANSACTION_KINDS];
+    int transactionDuration[TRANSACTION_KINDS];
+    int velocityDeclined;
+    int dailyLimitDeclined;
+    int dispenseRejected;
+    int replicationShipped;
+    int replicationDropped;
+    int replicationBacklog;
+    int replicationAckDuration;
+    int fileLoadDuration;
+    int fileLoadBytes;
+    int fileSaveDuration;
+    int fileSaveBytes;
+    int fileSavesSuperseded;
+    int journalBatches;
+    int journalSyncDuration;
+
+    static const AtmMetrics& get();
+
+private:
+    AtmMetrics();
+};
+
+// Records the lifetime of a scope into a histogram, optionally timing only
+// one scope in sampleInterval per thread
+class ScopedTimer {
+private:
+    int histogram;
+    unsigned weight;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+
+    static bool sampled(unsigned interval) {
+        thread_local unsigned tick = 0;
+        return interval <= 1 || ++tick % interval == 0;
+    }
+
+public:
+    explicit ScopedTimer(int histogram, unsigned sampleInterval = 1)
+        : histogram(histogram), weight(sampleInterval ? sampleInterval : 1),
+          active(MetricsRegistry::instance().isEnabled() && sampled(sampleInterval)) {
+        if (active) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ScopedTimer() {
+        if (active) {
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            MetricsRegistry::instance().observe(
+                histogram, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()),
+                weight);
+        }
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,64 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Small fork-join helpers shared by the batch tools.
+class Parallel {
+public:
+    // 0 means one thread per hardware core
+    static unsigned resolveThreads(unsigned threads) {
+        return threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Run work(item, thread) for items [0, items) on `threads` threads that
+    // claim items one at a time; the calling thread is thread 0
+    template <typename Work>
+    static void forEach(size_t items, unsigned threads, Work work) {
+        std::atomic<size_t> nextItem(0);
+        auto drain = [&](unsigned thread) {
+            for (size_t item = nextItem.fetch_add(1); item < items; item = nextItem.fetch_add(1)) {
+                work(item, thread);
+            }
+        };
+        std::vector<std::thread> workers;
+        unsigned count = static_cast<unsigned>(std::min<size_t>(threads, items));
+        for (unsigned thread = 1; thread < count; ++thread) {
+            workers.emplace_back(drain, thread);
+        }
+        drain(0);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // Run work(chunk, slot) for every chunk in waves of `threads`, then hand
+    // the finished chunks to emit(slot) in order. Keeps ordered output in
+    // bounded memory: one buffer per slot.
+    template <typename Work, typename Emit>
+    static bool inWaves(uint64_t chunks, unsigned threads, Work work, Emit emit) {
+        for (uint64_t first = 0; first < chunks; first += threads) {
+            uint64_t last = std::min<uint64_t>(chunks, first + threads);
+            std::vector<std::thread> workers;
+            for (uint64_t chunk = first + 1; chunk < last; ++chunk) {
+                workers.emplace_back(work, chunk, static_cast<unsigned>(chunk - first));
+            }
+            work(first, 0);
+            for (auto& worker : workers) {
+                worker.join();
+            }
+            for (uint64_t chunk = first; chunk < last; ++chunk) {
+                if (!emit(static_cast<unsigned>(chunk - first))) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+};
+
+#endif // PARALLEL_H
@@ -0,0 +1,481 @@
+#include "Reconciler.h"
+#include "AccountKey.h"
+#include "FastRandom.h"
+#include "FastText.h"
+#include "Ledger.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+
+const size_t ReconcileReport::TYPE_SLOTS;
+const size_t Reconciler::MAX_MISMATCHES;
+const size_t Reconciler::PIECE_BYTES;
+
+namespace {
+    const size_t PIECE_ENTRIES = 1 << 20;
+    const size_t PIECE_SLOTS = 1 << 16;
+    const size_t LOOKUP_BATCH = 32;
+
+    double secondsSince(std::chrono::steady_clock::time_point started) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    }
+
+    void prefetchForWrite(const void* address) {
+#if defined(__GNUC__)
+        __builtin_prefetch(address, 1);
+#else
+        (void)address;
+#endif
+    }
+
+    size_t piecesFor(size_t amount, size_t perPiece, unsigned threads) {
+        return std::max<size_t>(threads, amount / perPiece + 1);
+    }
+
+    // Padded so neighbouring threads never share a cache line
+    struct alignas(64) LedgerPartial {
+        TypeTotals types[ReconcileReport::TYPE_SLOTS];
+        uint64_t unknownAccountEntries = 0;
+    };
+
+    struct ClosingPiece {
+        int64_t liabilitiesCents = 0;
+        uint64_t accounts = 0;
+        uint64_t newAccounts = 0;
+        uint64_t mismatchCount = 0;
+        std::vector<BalanceMismatch> mismatches;
+    };
+
+    bool writeAll(std::FILE* file, const char* data, size_t length) {
+        return std::fwrite(data, 1, length, file) == length;
+    }
+
+    std::FILE* openOutput(const std::string& path) {
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        if (!file) {
+            std::cerr << "Error: Could not open " << path << " for writing." << std::endl;
+        }
+        return file;
+    }
+}
+
+Reconciler::Reconciler(unsigned threads) : threads(Parallel::resolveThreads(threads)) {}
+
+const ReconcileReport& Reconciler::getReport() const {
+    return report;
+}
+
+unsigned Reconciler::getThreads() const {
+    return threads;
+}
+
+int64_t Reconciler::closingOf(uint32_t slot) const {
+    return openingCents[slot] + netCents[slot].load(std::memory_order_relaxed);
+}
+
+// Two passes over the mapped file: count lines per piece to give every
+// piece its slot range, then parse each piece straight into its slots and
+// insert the keys into the shared index.
+bool Reconciler::loadOpening(const std::string& path) {
+    auto started = std::chrono::steady_clock::now();
+    report = ReconcileReport();
+    if (!opening.open(path)) {
+        std::cerr << "Error: Could not open " << path << std::endl;
+        return false;
+    }
+
+    size_t pieces = piecesFor(opening.size(), PIECE_BYTES, threads);
+    pieceOffsets = opening.splitLines(pieces);
+    std::vector<uint64_t> lineCounts(pieces, 0);
+    Parallel::forEach(pieces, threads, [&](size_t piece, unsigned) {
+        const char* begin = opening.data() + pieceOffsets[piece];
+        const char* end = opening.data() + pieceOffsets[piece + 1];
+        lineCounts[piece] = static_cast<uint64_t>(std::count(begin, end, '\n')) +
+                            (end > begin && end[-1] != '\n' ? 1 : 0);
+    });
+
+    pieceSlots.assign(pieces + 1, 0);
+    uint64_t total = 0;
+    for (size_t piece = 0; piece < pieces; ++piece) {
+        pieceSlots[piece] = static_cast<uint32_t>(total);
+        total += lineCounts[piece];
+    }
+    if (total >= AccountIndex::NOT_FOUND) {
+        std::cerr << "Error: " << path << " has too many lines." << std::endl;
+        return false;
+    }
+    pieceSlots[pieces] = static_cast<uint32_t>(total);
+
+    keys.reset(total);
+    openingCents.reset(total);
+    netCents.reset(total);
+    index.reset(new AccountIndex(total));
+
+    std::vector<int64_t> liabilities(pieces, 0);
+    std::vector<uint64_t> accounts(pieces, 0), malformed(pieces, 0), duplicates(pieces, 0);
+    Parallel::forEach(pieces, threads, [&](size_t piece, unsigned) {
+        const char* cursor = opening.data() + pieceOffsets[piece];
+        const char* end = opening.data() + pieceOffsets[piece + 1];
+        AccountLine line;
+        for (uint32_t slot = pieceSlots[piece]; FastText::nextAccountLine(cursor, end, line); ++slot) {
+            if (line.accountKey == 0) {
+                malformed[piece] += line.end > line.begin ? 1 : 0;
+                continue;
+            }
+            keys[slot] = line.accountKey;
+            openingCents[slot] = line.balanceCents;
+            liabilities[piece] += line.balanceCents;
+            accounts[piece]++;
+        }
+
+        // Inserting in a second pass over the dense keys lets the bucket
+        // misses overlap; a duplicate keeps its first slot
+        uint32_t last = pieceSlots[piece + 1];
+        for (uint32_t slot = pieceSlots[piece]; slot < last; ++slot) {
+            if (slot + LOOKUP_BATCH < last) {
+                index->prefetch(keys[slot + LOOKUP_BATCH]);
+            }
+            if (keys[slot] != 0 && !index->insert(keys[slot], slot)) {
+                duplicates[piece]++;
+                accounts[piece]--;
+                liabilities[piece] -= openingCents[slot];
+                keys[slot] = 0;
+            }
+        }
+    });
+
+    for (size_t piece = 0; piece < pieces; ++piece) {
+        report.accounts += accounts[piece];
+        report.malformedLines += malformed[piece];
+        report.duplicateAccounts += duplicates[piece];
+        report.openingLiabilitiesCents += liabilities[piece];
+    }
+    summarizeFlows();
+    report.openingSeconds = secondsSince(started);
+    return true;
+}
+
+bool Reconciler::applyLedger(const std::string& path) {
+    auto started = std::chrono::steady_clock::now();
+    LedgerReader ledger;
+    if (!index || !ledger.open(path)) {
+        std::cerr << "Error: Could not open ledger " << path << std::endl;
+        return false;
+    }
+
+    const LedgerEntry* entries = ledger.data();
+    size_t count = ledger.size();
+    size_t pieces = piecesFor(count, PIECE_ENTRIES, threads);
+    std::vector<LedgerPartial> partials(threads);
+
+    Parallel::forEach(pieces, threads, [&](size_t piece, unsigned thread) {
+        size_t first = count / pieces * piece;
+        size_t last = piece + 1 == pieces ? count : count / pieces * (piece + 1);
+        // Batches overlap the random accesses: index buckets are prefetched
+        // a batch ahead, net balances while the batch is being looked up
+        LedgerPartial local;
+        uint32_t slots[LOOKUP_BATCH];
+        for (size_t batch = first; batch < last; batch += LOOKUP_BATCH) {
+            size_t size = std::min(LOOKUP_BATCH, last - batch);
+            for (size_t ahead = batch + LOOKUP_BATCH; ahead < std::min(last, batch + 2 * LOOKUP_BATCH); ++ahead) {
+                index->prefetch(entries[ahead].accountKey);
+            }
+            for (size_t k = 0; k < size; ++k) {
+                slots[k] = index->find(entries[batch + k].accountKey);
+                if (slots[k] != AccountIndex::NOT_FOUND) {
+                    prefetchForWrite(&netCents[slots[k]]);
+                }
+            }
+            for (size_t k = 0; k < size; ++k) {
+                const LedgerEntry& entry = entries[batch + k];
+                TypeTotals& totals = local.types[entry.type < ReconcileReport::TYPE_SLOTS ? entry.type : 0];
+                totals.count++;
+                if (entry.flags & LEDGER_FLAG_FAILED) {
+                    totals.failed++;
+                    continue;
+                }
+                totals.sumCents += entry.amountCents;
+                int64_t delta = Ledger::balanceDelta(entry);
+                if (delta == 0) {
+                    continue;
+                }
+                if (slots[k] == AccountIndex::NOT_FOUND) {
+                    local.unknownAccountEntries++;
+                    continue;
+                }
+                netCents[slots[k]].fetch_add(delta, std::memory_order_relaxed);
+            }
+        }
+        LedgerPartial& merged = partials[thread];
+        for (size_t type = 0; type < ReconcileReport::TYPE_SLOTS; ++type) {
+            merged.types[type].count += local.types[type].count;
+            merged.types[type].failed += local.types[type].failed;
+            merged.types[type].sumCents += local.types[type].sumCents;
+        }
+        merged.unknownAccountEntries += local.unknownAccountEntries;
+    });
+
+    report.ledgerEntries += count;
+    for (const LedgerPartial& partial : partials) {
+        for (size_t type = 0; type < ReconcileReport::TYPE_SLOTS; ++type) {
+            report.types[type].count += partial.types[type].count;
+            report.types[type].failed += partial.types[type].failed;
+            report.types[type].sumCents += partial.types[type].sumCents;
+        }
+        report.unknownAccountEntries += partial.unknownAccountEntries;
+    }
+    summarizeFlows();
+    report.ledgerSeconds += secondsSince(started);
+    return true;
+}
+
+// Totals over the per-account net flows; until a closing file has been
+// checked, the closing side is the projection opening + net
+void Reconciler::summarizeFlows() {
+    size_t total = keys.size();
+    size_t pieces = piecesFor(total, PIECE_SLOTS, threads);
+    std::vector<int64_t> net(pieces, 0);
+    std::vector<uint64_t> withFlow(pieces, 0);
+    Parallel::forEach(pieces, threads, [&](size_t piece, unsigned) {
+        size_t first = total / pieces * piece;
+        size_t last = piece + 1 == pieces ? total : total / pieces * (piece + 1);
+        for (size_t slot = first; slot < last; ++slot) {
+            int64_t flow = netCents[slot].load(std::memory_order_relaxed);
+            net[piece] += flow;
+            withFlow[piece] += flow != 0 ? 1 : 0;
+        }
+    });
+
+    report.netFlowCents = 0;
+    report.accountsWithFlow = 0;
+    for (size_t piece = 0; piece < pieces; ++piece) {
+        report.netFlowCents += net[piece];
+        report.accountsWithFlow += withFlow[piece];
+    }
+    if (!report.closingChecked) {
+        report.closingAccounts = report.accounts;
+        report.closingLiabilitiesCents = report.openingLiabilitiesCents + report.netFlowCents;
+    }
+}
+
+bool Reconciler::checkClosing(const std::string& path) {
+    auto started = std::chrono::steady_clock::now();
+    MappedFile closing;
+    if (!index || !closing.open(path)) {
+        std::cerr << "Error: Could not open " << path << std::endl;
+        return false;
+    }
+
+    size_t total = keys.size();
+    LargeArray<std::atomic<uint8_t>> seen(total);
+
+    size_t pieces = piecesFor(closing.size(), PIECE_BYTES, threads);
+    std::vector<size_t> offsets = closing.splitLines(pieces);
+    std::vector<ClosingPiece> results(pieces);
+    Parallel::forEach(pieces, threads, [&](size_t piece, unsigned) {
+        const char* cursor = closing.data() + offsets[piece];
+        const char* end = closing.data() + offsets[piece + 1];
+        ClosingPiece& result = results[piece];
+        AccountLine line;
+        // Closing files normally keep the opening order, so the slot after
+        // the previous match is tried before the index
+        uint32_t guess = AccountIndex::NOT_FOUND;
+        while (FastText::nextAccountLine(cursor, end, line)) {
+            if (line.accountKey == 0) {
+                continue;
+            }
+            result.accounts++;
+            result.liabilitiesCents += line.balanceCents;
+            uint32_t slot = guess < total && keys[guess] == line.accountKey ? guess : index->find(line.accountKey);
+            if (slot == AccountIndex::NOT_FOUND) {
+                result.newAccounts++;
+                continue;
+            }
+            guess = slot + 1;
+            seen[slot].store(1, std::memory_order_relaxed);
+            int64_t net = netCents[slot].load(std::memory_order_relaxed);
+            if (openingCents[slot] + net != line.balanceCents) {
+                result.mismatchCount++;
+                if (result.mismatches.size() < MAX_MISMATCHES) {
+                    result.mismatches.push_back({line.accountKey, openingCents[slot], net, line.balanceCents});
+                }
+            }
+        }
+    });
+
+    report.closingChecked = true;
+    report.closingAccounts = 0;
+    report.closingLiabilitiesCents = 0;
+    report.newInClosing = 0;
+    report.mismatchCount = 0;
+    report.mismatches.clear();
+    for (ClosingPiece& result : results) {
+        report.closingAccounts += result.accounts;
+        report.closingLiabilitiesCents += result.liabilitiesCents;
+        report.newInClosing += result.newAccounts;
+        report.mismatchCount += result.mismatchCount;
+        size_t room = MAX_MISMATCHES - report.mismatches.size();
+        size_t take = std::min(room, result.mismatches.size());
+        report.mismatches.insert(report.mismatches.end(), result.mismatches.begin(), result.mismatches.begin() + take);
+    }
+
+    size_t slotPieces = piecesFor(total, PIECE_SLOTS, threads);
+    std::vector<uint64_t> missing(slotPieces, 0);
+    Parallel::forEach(slotPieces, threads, [&](size_t piece, unsigned) {
+        size_t first = total / slotPieces * piece;
+        size_t last = piece + 1 == slotPieces ? total : total / slotPieces * (piece + 1);
+        for (size_t slot = first; slot < last; ++slot) {
+            missing[piece] += keys[slot] != 0 && !seen[slot].load(std::memory_order_relaxed) ? 1 : 0;
+        }
+    });
+    report.missingFromClosing = 0;
+    for (uint64_t count : missing) {
+        report.missingFromClosing += count;
+    }
+    report.closingSeconds = secondsSince(started);
+    return true;
+}
+
+bool Reconciler::writeNetFlows(const std::string& path) const {
+    std::FILE* file = openOutput(path);
+    if (!file) {
+        return false;
+    }
+    const char header[] = "account,opening,net,closing\n";
+    bool ok = writeAll(file, header, sizeof(header) - 1);
+
+    const size_t LINE_BYTES = 4 * FastText::MAX_FIELD;
+    size_t total = keys.size();
+    std::vector<std::vector<char>> buffers(threads, std::vector<char>(PIECE_SLOTS * LINE_BYTES));
+    std::vector<size_t> lengths(threads, 0);
+    uint64_t chunks = (total + PIECE_SLOTS - 1) / PIECE_SLOTS;
+
+    auto work = [&](uint64_t chunk, unsigned slot) {
+        size_t first = static_cast<size_t>(chunk) * PIECE_SLOTS;
+        size_t last = std::min(total, first + PIECE_SLOTS);
+        char* begin = buffers[slot].data();
+        char* out = begin;
+        for (size_t account = first; account < last; ++account) {
+            int64_t net = netCents[account].load(std::memory_order_relaxed);
+            if (keys[account] == 0 || net == 0) {
+                continue;
+            }
+            out = FastText::writeAccount(out, keys[account]);
+            *out++ = ',';
+            out = FastText::writeCents(out, openingCents[account]);
+            *out++ = ',';
+            out = FastText::writeCents(out, net);
+            *out++ = ',';
+            out = FastText::writeCents(out, openingCents[account] + net);
+            *out++ = '\n';
+        }
+        lengths[slot] = static_cast<size_t>(out - begin);
+    };
+    auto emit = [&](unsigned slot) {
+        return writeAll(file, buffers[slot].data(), lengths[slot]);
+    };
+
+    ok = ok && Parallel::inWaves(chunks, threads, work, emit);
+    ok = std::fclose(file) == 0 && ok;
+    return ok;
+}
+
+bool Reconciler::writeMismatches(const std::string& path) const {
+    std::FILE* file = openOutput(path);
+    if (!file) {
+        return false;
+    }
+    const char header[] = "account,opening,net,expected,closing,difference\n";
+    bool ok = writeAll(file, header, sizeof(header) - 1);
+    char line[6 * FastText::MAX_FIELD];
+    for (const BalanceMismatch& mismatch : report.mismatches) {
+        int64_t expected = mismatch.openingCents + mismatch.netCents;
+        char* out = FastText::writeAccount(line, mismatch.accountKey);
+        *out++ = ',';
+        out = FastText::writeCents(out, mismatch.openingCents);
+        *out++ = ',';
+        out = FastText::writeCents(out, mismatch.netCents);
+        *out++ = ',';
+        out = FastText::writeCents(out, expected);
+        *out++ = ',';
+        out = FastText::writeCents(out, mismatch.closingCents);
+        *out++ = ',';
+        out = FastText::writeCents(out, mismatch.closingCents - expected);
+        *out++ = '\n';
+        ok = ok && writeAll(file, line, static_cast<size_t>(out - line));
+    }
+    ok = std::fclose(file) == 0 && ok;
+    return ok;
+}
+
+// Rewrites each opening piece with its balances replaced, keeping account
+// numbers and PINs byte for byte
+bool Reconciler::writeProjectedClosing(const std::string& path, uint64_t errors, uint64_t seed) const {
+    FastRandom random(seed);
+    size_t total = keys.size();
+    errors = std::min<uint64_t>(errors, report.accounts);
+    std::vector<uint32_t> chosen;
+    while (chosen.size() < errors) {
+        while (chosen.size() < errors) {
+            uint32_t slot = static_cast<uint32_t>(random.below(total));
+            if (keys[slot] != 0) {
+                chosen.push_back(slot);
+            }
+        }
+        std::sort(chosen.begin(), chosen.end());
+        chosen.erase(std::unique(chosen.begin(), chosen.end()), chosen.end());
+    }
+    std::vector<std::pair<uint32_t, int64_t>> offsets;
+    offsets.reserve(chosen.size());
+    for (uint32_t slot : chosen) {
+        int64_t offset = static_cast<int64_t>(1 + random.below(100000));
+        offsets.emplace_back(slot, random.below(2) ? offset : -offset);
+    }
+
+    std::FILE* file = openOutput(path);
+    if (!file) {
+        return false;
+    }
+    std::vector<std::vector<char>> buffers(threads);
+    std::vector<size_t> lengths(threads, 0);
+    uint64_t pieces = pieceOffsets.empty() ? 0 : pieceOffsets.size() - 1;
+
+    auto work = [&](uint64_t piece, unsigned slot) {
+        const char* cursor = opening.data() + pieceOffsets[piece];
+        const char* end = opening.data() + pieceOffsets[piece + 1];
+        uint32_t first = pieceSlots[piece];
+        size_t lines = pieceSlots[piece + 1] - first;
+        std::vector<char>& buffer = buffers[slot];
+        buffer.resize(static_cast<size_t>(end - cursor) + lines * (FastText::MAX_FIELD + 1));
+
+        auto pending = std::lower_bound(offsets.begin(), offsets.end(), std::make_pair(first, std::numeric_limits<int64_t>::min()));
+        char* out = buffer.data();
+        AccountLine line;
+        for (uint32_t account = first; FastText::nextAccountLine(cursor, end, line); ++account) {
+            if (keys[account] == 0) {
+                out = std::copy(line.begin, line.end, out);
+            } else {
+                int64_t balance = closingOf(account);
+                if (pending != offsets.end() && pending->first == account) {
+                    balance += pending->second;
+                    ++pending;
+                }
+                out = std::copy(line.begin, line.balance, out);
+                out = FastText::writeCents(out, balance);
+                out = std::copy(line.balanceEnd, line.end, out);
+            }
+            *out++ = '\n';
+        }
+        lengths[slot] = static_cast<size_t>(out - buffer.data());
+    };
+    auto emit = [&](unsigned slot) {
+        return writeAll(file, buffers[slot].data(), lengths[slot]);
+    };
+
+    bool ok = Parallel::inWaves(pieces, threads, work, emit);
+    ok = std::fclose(file) == 0 && ok;
+    return ok;
+}
@@ -0,0 +1,112 @@
+#ifndef RECONCILER_H
+#define RECONCILER_H
+
+#include "AccountIndex.h"
+#include "LargeArray.h"
+#include "MappedFile.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// End-of-day reconciliation of an account table against the ledger.
+//
+// The opening accounts file is parsed once into dense arrays (key, opening
+// balance) behind an AccountIndex. The ledger and the closing file are then
+// scanned in parallel partitions; each thread keeps its own partial totals,
+// which are merged after the scan. Net flow per account is the only shared
+// state and is accumulated with relaxed atomic adds.
+struct TypeTotals {
+    uint64_t count = 0;
+    uint64_t failed = 0;
+    int64_t sumCents = 0; // posted (not failed) amounts only
+};
+
+struct BalanceMismatch {
+    uint64_t accountKey;
+    int64_t openingCents;
+    int64_t netCents;
+    int64_t closingCents; // expected: openingCents + netCents
+};
+
+struct ReconcileReport {
+    static const size_t TYPE_SLOTS = 6; // indexed by LedgerType
+
+    uint64_t accounts = 0;
+    uint64_t malformedLines = 0;
+    uint64_t duplicateAccounts = 0;
+    int64_t openingLiabilitiesCents = 0;
+
+    uint64_t ledgerEntries = 0;
+    uint64_t unknownAccountEntries = 0; // postings for accounts not in the table
+    TypeTotals types[TYPE_SLOTS];
+    int64_t netFlowCents = 0;
+    uint64_t accountsWithFlow = 0;
+
+    // Closing side: from the closing file if one was checked, otherwise
+    // projected as opening + net flow
+    bool closingChecked = false;
+    int64_t closingLiabilitiesCents = 0;
+    uint64_t closingAccounts = 0;
+    uint64_t missingFromClosing = 0;
+    uint64_t newInClosing = 0;
+    uint64_t mismatchCount = 0;
+    std::vector<BalanceMismatch> mismatches; // first MAX_MISMATCHES, file order
+
+    double openingSeconds = 0.0;
+    double ledgerSeconds = 0.0;
+    double closingSeconds = 0.0;
+};
+
+class Reconciler {
+public:
+    static const size_t MAX_MISMATCHES = 100000;
+    static const size_t PIECE_BYTES = 4 << 20;
+
+    explicit Reconciler(unsigned threads = 0);
+
+    Reconciler(const Reconciler&) = delete;
+    Reconciler& operator=(const Reconciler&) = delete;
+
+    // Must be called first; resets everything else
+    bool loadOpening(const std::string& path);
+
+    // Add a ledger's entries to the per-account net flow and type totals
+    bool applyLedger(const std::string& path);
+
+    // Compare a closing accounts file with opening + net flow
+    bool checkClosing(const std::string& path);
+
+    const ReconcileReport& getReport() const;
+    unsigned getThreads() const;
+
+    // account,opening,net,closing for every account with a non-zero flow
+    bool writeNetFlows(const std::string& path) const;
+
+    // account,opening,net,expected,closing,difference
+    bool writeMismatches(const std::string& path) const;
+
+    // The opening file with every balance moved by its net flow; `errors`
+    // randomly chosen accounts get an extra offset so checks have something
+    // to find
+    bool writeProjectedClosing(const std::string& path, uint64_t errors, uint64_t seed) const;
+
+private:
+    unsigned threads;
+    ReconcileReport report;
+
+    MappedFile opening;
+    std::vector<size_t> pieceOffsets; // opening file pieces, on line boundaries
+    std::vector<uint32_t> pieceSlots; // first slot of each piece
+
+    LargeArray<uint64_t> keys;        // 0: blank, malformed or duplicate line
+    LargeArray<int64_t> openingCents;
+    LargeArray<std::atomic<int64_t>> netCents;
+    std::unique_ptr<AccountIndex> index;
+
+    int64_t closingOf(uint32_t slot) const;
+    void summarizeFlows();
+};
+
+#endif // RECONCILER_H
@@ -0,0 +1,166 @@
+#include "Renderer.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <io.h>
+#include <windows.h>
+#else
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+namespace {
+#ifdef _WIN32
+    // A console takes ANSI sequences only once virtual terminal processing
+    // is on; one that refuses it (before Windows 10) gets Plain output
+    bool openTerminal() {
+        if (!_isatty(_fileno(stdout))) {
+            return false;
+        }
+        HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+        DWORD consoleMode = 0;
+        if (console == INVALID_HANDLE_VALUE || !GetConsoleMode(console, &consoleMode)) {
+            return false;
+        }
+        const DWORD virtualTerminal = 0x0004; // ENABLE_VIRTUAL_TERMINAL_PROCESSING
+        return (consoleMode & virtualTerminal) != 0 || SetConsoleMode(console, consoleMode | virtualTerminal);
+    }
+
+    void writeOut(const char* data, size_t size) {
+        std::fwrite(data, 1, size, stdout);
+        std::fflush(stdout);
+    }
+#else
+    bool openTerminal() {
+        return isatty(STDOUT_FILENO) != 0;
+    }
+
+    void writeOut(const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t written = ::write(STDOUT_FILENO, data, size);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+    }
+#endif
+}
+
+// Cursor home, then erase the whole display
+const char* const Renderer::CLEAR_SEQUENCE = "\033[H\033[2J";
+
+Renderer::Renderer(Mode mode) : mode(mode), digest(1469598103934665603ULL) {
+    frame.reserve(4096);
+}
+
+Renderer::~Renderer() {
+    flush();
+}
+
+Renderer::Mode Renderer::detectMode() {
+    if (std::getenv("ATM_PLAIN") || !openTerminal()) {
+        return Mode::Plain;
+    }
+    return Mode::Terminal;
+}
+
+Renderer::Mode Renderer::getMode() const {
+    return mode;
+}
+
+// Anything still pending would be erased by the clear, so drop it
+void Renderer::beginFrame() {
+    if (mode == Mode::Terminal) {
+        frame.clear();
+        frame += CLEAR_SEQUENCE;
+    }
+}
+
+Renderer& Renderer::text(const std::string& str) {
+    frame += str;
+    return *this;
+}
+
+Renderer& Renderer::text(const char* str) {
+    frame += str;
+    return *this;
+}
+
+Renderer& Renderer::style(const std::string& ansiCode) {
+    if (mode == Mode::Terminal) {
+        frame += ansiCode;
+    }
+    return *this;
+}
+
+Renderer& Renderer::money(double amount) {
+    char buffer[64];
+    int length = std::snprintf(buffer, sizeof(buffer), "%.2f", amount);
+    if (length > 0) {
+        frame.append(buffer, static_cast<size_t>(length));
+    }
+    return *this;
+}
+
+Renderer& Renderer::number(long long value) {
+    char buffer[32];
+    int length = std::snprintf(buffer, sizeof(buffer), "%lld", value);
+    frame.append(buffer, static_cast<size_t>(length));
+    return *this;
+}
+
+// Left-aligned field, like std::left << std::setw(width)
+Renderer& Renderer::padded(const std::string& str, size_t width) {
+    frame += str;
+    if (str.size() < width) {
+        frame.append(width - str.size(), ' ');
+    }
+    return *this;
+}
+
+Renderer& Renderer::repeat(char ch, int count) {
+    if (count > 0) {
+        frame.append(static_cast<size_t>(count), ch);
+    }
+    return *this;
+}
+
+Renderer& Renderer::newline() {
+    frame += '\n';
+    return *this;
+}
+
+void Renderer::flush() {
+    if (frame.empty()) {
+        return;
+    }
+    if (mode == Mode::Capture) {
+        for (unsigned char c : frame) {
+            digest = (digest ^ c) * 1099511628211ULL;
+        }
+        frame.clear();
+        return;
+    }
+    // Anything printed through the streams since the last frame goes first
+    std::cout.flush();
+    std::fflush(stdout);
+    writeOut(frame.data(), frame.size());
+    frame.clear();
+}
+
+uint64_t Renderer::getDigest() const {
+    return digest;
+}
@@ -0,0 +1,54 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <cstdint>
+#include <string>
+
+// Frame-buffered console output.
+//
+// A screen is composed into one buffer and written with a single write call
+// when the ATM is about to wait for input. In Terminal mode a new frame
+// starts with an ANSI home+clear sequence instead of forking a shell; in
+// Plain mode (stdout is not a TTY) styles and clears are left out so piped
+// and scripted sessions get clean text. Capture mode renders like Plain but
+// only folds each frame into a digest, for replaying sessions without a
+// console.
+class Renderer {
+public:
+    enum class Mode { Terminal, Plain, Capture };
+
+    explicit Renderer(Mode mode);
+    ~Renderer();
+
+    // Terminal when stdout is a TTY, Plain otherwise or if ATM_PLAIN is set
+    static Mode detectMode();
+    Mode getMode() const;
+
+    // Start a new screen
+    void beginFrame();
+
+    // Compose output
+    Renderer& text(const std::string& str);
+    Renderer& text(const char* str);
+    Renderer& style(const std::string& ansiCode);
+    Renderer& money(double amount);
+    Renderer& number(long long value);
+    Renderer& padded(const std::string& str, size_t width);
+    Renderer& repeat(char ch, int count);
+    Renderer& newline();
+
+    // Write everything composed so far in one go
+    void flush();
+
+    // FNV-1a digest of all captured output (Capture mode)
+    uint64_t getDigest() const;
+
+private:
+    Mode mode;
+    std::string frame;
+    uint64_t digest;
+
+    static const char* const CLEAR_SEQUENCE;
+};
+
+#endif // RENDERER_H
@@ -0,0 +1,349 @@
+#include "Replication.h"
+#include "AccountStore.h"
+#include "LocalSocket.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+const char ReplicationSender::MAGIC[8] = {'A', 'T', 'M', 'R', 'E', 'P', 'L', '1'};
+const size_t ReplicationSender::MAX_PENDING;
+
+namespace {
+    struct Hello {
+        char magic[8];
+        uint64_t firstSequence;
+    };
+
+    struct BatchHeader {
+        uint64_t firstSequence;
+        uint32_t count;
+        uint32_t reserved;
+        int64_t sentNs; // sender's steady clock
+    };
+
+    struct Ack {
+        uint64_t lastSequence;
+        int64_t sentNs; // echoed from the batch
+    };
+
+    static_assert(sizeof(Hello) == 16, "hello is 16 bytes on the wire");
+    static_assert(sizeof(BatchHeader) == 24, "batch header is 24 bytes on the wire");
+    static_assert(sizeof(Ack) == 16, "ack is 16 bytes on the wire");
+
+    // Largest batch the standby accepts; the sender splits bigger queues
+    const uint32_t MAX_BATCH = 4096;
+
+    int64_t steadyNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    int64_t wallUs() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+}
+
+bool ReplicationSender::parseAck(const std::string& name, ReplicaAck& mode) {
+    if (name == "async") {
+        mode = ReplicaAck::Async;
+    } else if (name == "durable") {
+        mode = ReplicaAck::Durable;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* ReplicationSender::ackName(ReplicaAck mode) {
+    return mode == ReplicaAck::Durable ? "durable" : "async";
+}
+
+ReplicationSender::ReplicationSender()
+    : socketFd(-1), mode(ReplicaAck::Async), running(false), connected(false), acknowledged(0), published(0) {}
+
+ReplicationSender::~ReplicationSender() {
+    close();
+}
+
+bool ReplicationSender::connect(const std::string& socketPath, ReplicaAck ackMode, std::string& error) {
+    int fd = LocalSocket::connect(socketPath, error);
+    if (fd < 0) {
+        return false;
+    }
+    Hello hello;
+    std::memcpy(hello.magic, MAGIC, sizeof(MAGIC));
+    hello.firstSequence = 1;
+    if (!LocalSocket::sendAll(fd, &hello, sizeof(hello))) {
+        error = "standby closed the connection";
+        LocalSocket::close(fd);
+        return false;
+    }
+    AtmMetrics::get();
+    socketFd = fd;
+    mode = ackMode;
+    connected.store(true);
+    running.store(true);
+    sender = std::thread(&ReplicationSender::sendLoop, this);
+    ackReader = std::thread(&ReplicationSender::ackLoop, this);
+    return true;
+}
+
+uint64_t ReplicationSender::publish(const LedgerEntry* entries, size_t count) {
+    if (!connected.load(std::memory_order_relaxed)) {
+        MetricsRegistry::instance().add(AtmMetrics::get().replicationDropped, count);
+        return 0;
+    }
+    uint64_t sequence;
+    bool wasEmpty;
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        if (pending.size() >= MAX_PENDING) {
+            queueSpace.wait(lock, [&] { return pending.size() < MAX_PENDING || !connected.load(); });
+        }
+        wasEmpty = pending.empty();
+        pending.insert(pending.end(), entries, entries + count);
+        published += count;
+        sequence = published;
+    }
+    if (wasEmpty) {
+        queueReady.notify_one();
+    }
+    const AtmMetrics& metrics = AtmMetrics::get();
+    MetricsRegistry::instance().add(metrics.replicationShipped, count);
+    MetricsRegistry::instance().adjust(metrics.replicationBacklog, static_cast<int64_t>(count));
+    return sequence;
+}
+
+bool ReplicationSender::waitDurable(uint64_t sequence) {
+    if (acknowledged.load(std::memory_order_acquire) >= sequence) {
+        return true;
+    }
+    std::unique_lock<std::mutex> lock(ackMutex);
+    ackArrived.wait(lock, [&] {
+        return acknowledged.load(std::memory_order_acquire) >= sequence || !connected.load();
+    });
+    return acknowledged.load(std::memory_order_acquire) >= sequence;
+}
+
+void ReplicationSender::close() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    queueReady.notify_all();
+    if (sender.joinable()) {
+        sender.join();
+    }
+    if (ackReader.joinable()) {
+        ackReader.join();
+    }
+    LocalSocket::close(socketFd);
+    socketFd = -1;
+}
+
+ReplicaAck ReplicationSender::getMode() const {
+    return mode;
+}
+
+bool ReplicationSender::isConnected() const {
+    return connected.load();
+}
+
+uint64_t ReplicationSender::getPublished() const {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return published;
+}
+
+uint64_t ReplicationSender::getAcknowledged() const {
+    return acknowledged.load();
+}
+
+void ReplicationSender::disconnect() {
+    {
+        std::lock_guard<std::mutex> lock(ackMutex);
+        connected.store(false);
+    }
+    ackArrived.notify_all();
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+    }
+    queueSpace.notify_all();
+}
+
+// Whatever queued while the last batch was on the wire goes out as the next
+// batch, so batches grow with the load and cost one send each
+void ReplicationSender::sendLoop() {
+    std::vector<LedgerEntry> batch;
+    while (true) {
+        uint64_t lastSequence;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueReady.wait(lock, [&] { return !pending.empty() || !running.load(); });
+            if (pending.empty()) {
+                break;
+            }
+            batch.swap(pending);
+            lastSequence = published;
+        }
+        queueSpace.notify_all();
+        uint64_t firstSequence = lastSequence - batch.size() + 1;
+        for (size_t offset = 0; offset < batch.size() && connected.load(); offset += MAX_BATCH) {
+            BatchHeader header;
+            header.count = static_cast<uint32_t>(std::min<size_t>(MAX_BATCH, batch.size() - offset));
+            header.firstSequence = firstSequence + offset;
+            header.reserved = 0;
+            header.sentNs = steadyNs();
+            if (!LocalSocket::sendAll(socketFd, &header, sizeof(header)) ||
+                !LocalSocket::sendAll(socketFd, batch.data() + offset, header.count * sizeof(LedgerEntry))) {
+                disconnect();
+            }
+        }
+        if (!connected.load()) {
+            MetricsRegistry::instance().add(AtmMetrics::get().replicationDropped, batch.size());
+        }
+        batch.clear();
+    }
+    // No more batches: the standby acknowledges the rest and closes
+    LocalSocket::shutdownWrite(socketFd);
+}
+
+void ReplicationSender::ackLoop() {
+    const AtmMetrics& metrics = AtmMetrics::get();
+    Ack ack;
+    while (LocalSocket::receiveAll(socketFd, &ack, sizeof(ack))) {
+        uint64_t previous = acknowledged.load(std::memory_order_relaxed);
+        MetricsRegistry::instance().observe(metrics.replicationAckDuration,
+                                            static_cast<uint64_t>(steadyNs() - ack.sentNs));
+        MetricsRegistry::instance().adjust(metrics.replicationBacklog, -static_cast<int64_t>(ack.lastSequence - previous));
+        {
+            std::lock_guard<std::mutex> lock(ackMutex);
+            acknowledged.store(ack.lastSequence, std::memory_order_release);
+        }
+        ackArrived.notify_all();
+    }
+    disconnect();
+}
+
+ReplicaStandby::ReplicaStandby(AccountStore& accountStore)
+    : store(accountStore), listenFd(-1), applied(0), lastSequence(0), batches(0), unknown(0), lastLagUs(0),
+      streamSeconds(0.0) {}
+
+ReplicaStandby::~ReplicaStandby() {
+    if (listenFd >= 0) {
+        LocalSocket::close(listenFd);
+        std::remove(socketPath.c_str());
+    }
+}
+
+bool ReplicaStandby::openLedger(const std::string& path, std::string& error) {
+    if (!ledger.open(path)) {
+        error = "cannot open ledger " + path;
+        return false;
+    }
+    return true;
+}
+
+bool ReplicaStandby::listen(const std::string& path, std::string& error) {
+    listenFd = LocalSocket::listen(path, 1, error);
+    socketPath = path;
+    return listenFd >= 0;
+}
+
+bool ReplicaStandby::serve(std::string& error) {
+    int connection = LocalSocket::accept(listenFd);
+    if (connection < 0) {
+        error = "no primary connected";
+        return false;
+    }
+    int64_t begin = steadyNs();
+    bool ok = applyStream(connection, error);
+    streamSeconds = static_cast<double>(steadyNs() - begin) / 1e9;
+    LocalSocket::close(connection);
+    return ok;
+}
+
+// One batch at a time: apply, persist, acknowledge. A clean end of stream
+// between batches is the primary shutting down.
+bool ReplicaStandby::applyStream(int connection, std::string& error) {
+    Hello hello;
+    if (!LocalSocket::receiveAll(connection, &hello, sizeof(hello)) ||
+        std::memcmp(hello.magic, ReplicationSender::MAGIC, sizeof(hello.magic)) != 0) {
+        error = "not a replication stream";
+        return false;
+    }
+    uint64_t expected = hello.firstSequence;
+    std::vector<LedgerEntry> batch;
+    BatchHeader header;
+    while (LocalSocket::receiveAll(connection, &header, sizeof(header))) {
+        if (header.count == 0 || header.count > MAX_BATCH || header.firstSequence != expected) {
+            error = "replication stream out of sequence at " + std::to_string(expected);
+            return false;
+        }
+        batch.resize(header.count);
+        if (!LocalSocket::receiveAll(connection, batch.data(), header.count * sizeof(LedgerEntry))) {
+            error = "replication stream ended inside a batch";
+            return false;
+        }
+        uint64_t missing = 0;
+        for (const LedgerEntry& entry : batch) {
+            missing += !store.applyReplicated(entry);
+        }
+        if (ledger.isOpen()) {
+            ledger.append(batch.data(), batch.size());
+            if (!ledger.sync()) {
+                error = "cannot sync the standby ledger";
+                return false;
+            }
+        }
+        int64_t now = wallUs();
+        for (const LedgerEntry& entry : batch) {
+            lag.record(static_cast<uint64_t>(std::max<int64_t>(0, now - entry.timestampUs)) * 1000);
+        }
+        expected += header.count;
+        lastLagUs.store(now - batch.back().timestampUs, std::memory_order_relaxed);
+        unknown.fetch_add(missing, std::memory_order_relaxed);
+        applied.fetch_add(header.count, std::memory_order_relaxed);
+        batches.fetch_add(1, std::memory_order_relaxed);
+        lastSequence.store(expected - 1, std::memory_order_relaxed);
+
+        Ack ack;
+        ack.lastSequence = expected - 1;
+        ack.sentNs = header.sentNs;
+        if (!LocalSocket::sendAll(connection, &ack, sizeof(ack))) {
+            error = "primary went away before an acknowledgment";
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t ReplicaStandby::getApplied() const {
+    return applied.load();
+}
+
+uint64_t ReplicaStandby::getLastSequence() const {
+    return lastSequence.load();
+}
+
+uint64_t ReplicaStandby::getBatches() const {
+    return batches.load();
+}
+
+uint64_t ReplicaStandby::getUnknown() const {
+    return unknown.load();
+}
+
+int64_t ReplicaStandby::getLastLagUs() const {
+    return lastLagUs.load();
+}
+
+double ReplicaStandby::getStreamSeconds() const {
+    return streamSeconds;
+}
+
+const LatencyHistogram& ReplicaStandby::getLag() const {
+    return lag;
+}
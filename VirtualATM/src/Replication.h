@@ -0,0 +1,132 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include "LatencyHistogram.h"
+#include "Ledger.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class AccountStore;
+
+// When a posting on the primary returns relative to the standby
+enum class ReplicaAck {
+    Async,  // once queued for the standby
+    Durable // once the standby has applied it and synced its ledger
+};
+
+// Journal shipping from a primary AccountStore to a hot standby.
+//
+// The primary numbers every ledger entry it posts and streams them over a
+// Unix domain socket: a 16-byte hello (magic "ATMREPL1", first sequence),
+// then batches of a 24-byte header (first sequence, count, send time)
+// followed by that many 32-byte LedgerEntry records. The standby applies
+// each batch in order, appends it to its own ledger and syncs, then answers
+// with a 16-byte ack (last sequence, the batch's send time echoed back).
+// Entries of one account are published under the account's lock, so the
+// standby sees them in the order they were posted.
+class ReplicationSender {
+public:
+    static const char MAGIC[8];
+    static const size_t MAX_PENDING = 1 << 18;
+
+    static bool parseAck(const std::string& name, ReplicaAck& mode);
+    static const char* ackName(ReplicaAck mode);
+
+    ReplicationSender();
+    ~ReplicationSender();
+
+    ReplicationSender(const ReplicationSender&) = delete;
+    ReplicationSender& operator=(const ReplicationSender&) = delete;
+
+    bool connect(const std::string& socketPath, ReplicaAck mode, std::string& error);
+
+    // Queue entries for the standby; the sequence number of the last one,
+    // or 0 once the standby is gone (the entries are then dropped). Waits
+    // while MAX_PENDING entries are already queued.
+    uint64_t publish(const LedgerEntry* entries, size_t count);
+
+    // Durable mode: wait until the standby has synced `sequence`; false if
+    // the link went down first
+    bool waitDurable(uint64_t sequence);
+
+    // Send what is queued, then wait for the standby to acknowledge it all
+    void close();
+
+    ReplicaAck getMode() const;
+    bool isConnected() const;
+    uint64_t getPublished() const;
+    uint64_t getAcknowledged() const;
+
+private:
+    int socketFd;
+    ReplicaAck mode;
+    std::atomic<bool> running;
+    std::atomic<bool> connected;
+    std::atomic<uint64_t> acknowledged;
+
+    mutable std::mutex queueMutex;
+    std::condition_variable queueReady;
+    std::condition_variable queueSpace;
+    std::vector<LedgerEntry> pending;
+    uint64_t published;
+
+    std::mutex ackMutex;
+    std::condition_variable ackArrived;
+
+    std::thread sender;
+    std::thread ackReader;
+
+    void sendLoop();
+    void ackLoop();
+    void disconnect();
+};
+
+// Receiving end: applies a primary's stream to a local AccountStore
+class ReplicaStandby {
+public:
+    explicit ReplicaStandby(AccountStore& store);
+    ~ReplicaStandby();
+
+    ReplicaStandby(const ReplicaStandby&) = delete;
+    ReplicaStandby& operator=(const ReplicaStandby&) = delete;
+
+    // Append and sync every applied entry here before acknowledging it
+    bool openLedger(const std::string& path, std::string& error);
+
+    bool listen(const std::string& socketPath, std::string& error);
+
+    // Accept one primary and apply its stream until it disconnects
+    bool serve(std::string& error);
+
+    uint64_t getApplied() const;
+    uint64_t getLastSequence() const;
+    uint64_t getBatches() const;
+    uint64_t getUnknown() const;   // entries for accounts this store lacks
+    int64_t getLastLagUs() const;  // posting time to applied, newest batch
+    double getStreamSeconds() const; // primary connected to disconnected
+
+    // Posting time to applied, per entry in nanoseconds (read after serve)
+    const LatencyHistogram& getLag() const;
+
+private:
+    AccountStore& store;
+    LedgerWriter ledger;
+    std::string socketPath;
+    int listenFd;
+    std::atomic<uint64_t> applied;
+    std::atomic<uint64_t> lastSequence;
+    std::atomic<uint64_t> batches;
+    std::atomic<uint64_t> unknown;
+    std::atomic<int64_t> lastLagUs;
+    double streamSeconds;
+    LatencyHistogram lag;
+
+    bool applyStream(int connection, std::string& error);
+};
+
+#endif // REPLICATION_H
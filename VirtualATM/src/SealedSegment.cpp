@@ -0,0 +1,449 @@
+#include "SealedSegment.h"
+#include "AccountKey.h"
+#include "BlockCompressor.h"
+#include "LedgerSorter.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <mutex>
+
+const char SealedSegment::MAGIC[8] = {'A', 'T', 'M', 'S', 'E', 'A', 'L', '1'};
+const size_t SealedSegment::BLOCK_ENTRIES;
+
+static_assert(sizeof(SealedSegment::BlockIndex) == 56, "BlockIndex is a fixed 56-byte record");
+
+namespace {
+    // File layout: this header, the blocks, the index, then the directory
+    struct FileHeader {
+        char magic[8];
+        uint32_t blockEntries;
+        uint32_t partitions;
+        uint64_t entries;
+        uint64_t blocks;
+        uint64_t indexOffset;
+        uint64_t directoryOffset;
+        uint64_t checksum;
+        uint64_t reserved;
+    };
+
+    static_assert(sizeof(FileHeader) == 64, "FileHeader is a fixed 64-byte record");
+
+    // Longest varint of a 64-bit value
+    const size_t MAX_VARINT = 10;
+
+    uint64_t zigzag(int64_t value) {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    int64_t unzigzag(uint64_t value) {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    uint8_t* putVarint(uint8_t* out, uint64_t value) {
+        while (value >= 0x80) {
+            *out++ = static_cast<uint8_t>(value | 0x80);
+            value >>= 7;
+        }
+        *out++ = static_cast<uint8_t>(value);
+        return out;
+    }
+
+    bool getVarint(const uint8_t*& in, const uint8_t* end, uint64_t& value) {
+        value = 0;
+        for (unsigned shift = 0; shift < 64 && in < end; shift += 7) {
+            uint8_t byte = *in++;
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Column layout of one block; returns the encoded size
+    size_t encodeBlock(const LedgerEntry* entries, size_t count, std::vector<uint8_t>& out) {
+        out.resize(count * (4 * MAX_VARINT + 2) + 16);
+        uint8_t* p = out.data();
+        uint64_t key = 0;
+        for (size_t i = 0; i < count; ++i) {
+            p = putVarint(p, entries[i].accountKey - key);
+            key = entries[i].accountKey;
+        }
+        int64_t time = 0;
+        for (size_t i = 0; i < count; ++i) {
+            p = putVarint(p, zigzag(entries[i].timestampUs - time));
+            time = entries[i].timestampUs;
+        }
+        int64_t cents = 0;
+        for (size_t i = 0; i < count; ++i) {
+            p = putVarint(p, zigzag(entries[i].amountCents - cents));
+            cents = entries[i].amountCents;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            *p++ = entries[i].type;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            *p++ = entries[i].flags;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            p = putVarint(p, entries[i].reserved);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            p = putVarint(p, entries[i].terminal);
+        }
+        size_t size = static_cast<size_t>(p - out.data());
+        out.resize(size);
+        return size;
+    }
+
+    bool decodeColumns(const uint8_t* in, size_t size, size_t count, LedgerEntry* entries) {
+        const uint8_t* end = in + size;
+        uint64_t value;
+        uint64_t key = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (!getVarint(in, end, value)) return false;
+            key += value;
+            entries[i].accountKey = key;
+        }
+        int64_t time = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (!getVarint(in, end, value)) return false;
+            time += unzigzag(value);
+            entries[i].timestampUs = time;
+        }
+        int64_t cents = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (!getVarint(in, end, value)) return false;
+            cents += unzigzag(value);
+            entries[i].amountCents = cents;
+        }
+        if (static_cast<size_t>(end - in) < 2 * count) {
+            return false;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            entries[i].type = *in++;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            entries[i].flags = *in++;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (!getVarint(in, end, value)) return false;
+            entries[i].reserved = static_cast<uint16_t>(value);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (!getVarint(in, end, value)) return false;
+            entries[i].terminal = static_cast<uint32_t>(value);
+        }
+        return in == end;
+    }
+
+    // Shared output file; partitions append whole blocks under the lock
+    struct SegmentOutput {
+        std::FILE* file;
+        uint64_t offset;
+        std::mutex mutex;
+        std::vector<SealedSegment::BlockIndex> index;
+        bool failed;
+    };
+
+    // Cuts one partition's sorted records into encoded, compressed blocks
+    class BlockWriter : public LedgerSink {
+    private:
+        SegmentOutput& output;
+        uint16_t partition;
+        std::vector<LedgerEntry> pending;
+        std::vector<uint8_t> encoded;
+        std::vector<uint8_t> compressed;
+
+    public:
+        uint64_t entries;
+        uint64_t encodedBytes;
+        uint64_t checksum;
+
+        BlockWriter(SegmentOutput& output, size_t partition)
+            : output(output), partition(static_cast<uint16_t>(partition)), entries(0), encodedBytes(0), checksum(0) {
+            pending.reserve(SealedSegment::BLOCK_ENTRIES);
+        }
+
+        void consume(const LedgerEntry& record) override {
+            if (record.type == LedgerSorter::OPENING_RECORD) {
+                return;
+            }
+            pending.push_back(record);
+            checksum += SealedSegment::checksumOf(record);
+            if (pending.size() == SealedSegment::BLOCK_ENTRIES) {
+                flush();
+            }
+        }
+
+        void flush() {
+            if (pending.empty()) {
+                return;
+            }
+            SealedSegment::BlockIndex block = {};
+            block.firstKey = pending.front().accountKey;
+            block.lastKey = pending.back().accountKey;
+            block.minTimeUs = std::numeric_limits<int64_t>::max();
+            block.maxTimeUs = std::numeric_limits<int64_t>::min();
+            for (const LedgerEntry& entry : pending) {
+                block.minTimeUs = std::min(block.minTimeUs, entry.timestampUs);
+                block.maxTimeUs = std::max(block.maxTimeUs, entry.timestampUs);
+            }
+            block.count = static_cast<uint16_t>(pending.size());
+            block.partition = partition;
+            size_t size = encodeBlock(pending.data(), pending.size(), encoded);
+            compressed.clear();
+            size_t packed = BlockCompressor::compress(encoded.data(), size, compressed);
+            const std::vector<uint8_t>& stored = packed < size ? compressed : encoded;
+            block.encodedBytes = static_cast<uint32_t>(size);
+            block.storedBytes = static_cast<uint32_t>(stored.size());
+            {
+                std::lock_guard<std::mutex> lock(output.mutex);
+                block.offset = output.offset;
+                if (!output.failed && std::fwrite(stored.data(), 1, stored.size(), output.file) != stored.size()) {
+                    output.failed = true;
+                }
+                output.offset += stored.size();
+                output.index.push_back(block);
+            }
+            entries += pending.size();
+            encodedBytes += size;
+            pending.clear();
+        }
+    };
+}
+
+SealedSegment::SealedSegment()
+    : index(nullptr), directory(nullptr), entries(0), blocks(0), partitions(0), checksum(0) {}
+
+SealedSegment::~SealedSegment() {
+    close();
+}
+
+uint64_t SealedSegment::checksumOf(const LedgerEntry& entry) {
+    uint64_t words[4];
+    std::memcpy(words, &entry, sizeof(words));
+    uint64_t hash = 0x9e3779b97f4a7c15ULL;
+    for (uint64_t word : words) {
+        hash = (hash ^ word) * 0xbf58476d1ce4e5b9ULL;
+        hash ^= hash >> 31;
+    }
+    return hash;
+}
+
+// Partitions are sorted and encoded in parallel; their blocks reach the
+// file interleaved, and the index is put back in partition order at the end
+bool SealedSegment::seal(const SealConfig& config, SealStats& stats) {
+    auto started = std::chrono::steady_clock::now();
+    stats = SealStats();
+    LedgerSortConfig sortConfig;
+    sortConfig.ledgerPath = config.ledgerPath;
+    sortConfig.tempDir = config.tempDir.empty() ? config.outputPath + ".tmp" : config.tempDir;
+    sortConfig.memoryBudget = config.memoryBudget;
+    sortConfig.threads = config.threads;
+    LedgerSorter sorter(sortConfig);
+    size_t partitionCount = sorter.getPartitions();
+    stats.partitions = partitionCount;
+    if (!sorter.scatter()) {
+        return false;
+    }
+
+    SegmentOutput output;
+    output.file = std::fopen(config.outputPath.c_str(), "wb");
+    if (!output.file) {
+        std::cerr << "Error: Could not open " << config.outputPath << std::endl;
+        return false;
+    }
+    FileHeader header = {};
+    output.failed = std::fwrite(&header, sizeof(header), 1, output.file) != 1;
+    output.offset = sizeof(header);
+
+    std::vector<uint64_t> checksums(partitionCount, 0);
+    std::vector<uint64_t> entryCounts(partitionCount, 0);
+    std::vector<uint64_t> encodedCounts(partitionCount, 0);
+    std::vector<char> sorted(partitionCount, 0);
+    Parallel::forEach(partitionCount, sorter.getThreads(), [&](size_t partition, unsigned) {
+        BlockWriter writer(output, partition);
+        sorted[partition] = sorter.sortPartition(partition, writer) ? 1 : 0;
+        writer.flush();
+        checksums[partition] = writer.checksum;
+        entryCounts[partition] = writer.entries;
+        encodedCounts[partition] = writer.encodedBytes;
+    });
+    std::error_code error;
+    std::filesystem::remove_all(sortConfig.tempDir, error);
+
+    // Blocks of one partition were appended in order, so a stable sort
+    // keeps them in key order
+    std::stable_sort(output.index.begin(), output.index.end(),
+                     [](const BlockIndex& a, const BlockIndex& b) { return a.partition < b.partition; });
+    std::vector<uint64_t> firstBlocks(partitionCount + 1, 0);
+    for (const BlockIndex& block : output.index) {
+        firstBlocks[block.partition + 1]++;
+    }
+    for (size_t partition = 0; partition < partitionCount; ++partition) {
+        firstBlocks[partition + 1] += firstBlocks[partition];
+    }
+
+    std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+    header.blockEntries = static_cast<uint32_t>(BLOCK_ENTRIES);
+    header.partitions = static_cast<uint32_t>(partitionCount);
+    for (size_t partition = 0; partition < partitionCount; ++partition) {
+        header.entries += entryCounts[partition];
+        header.checksum += checksums[partition];
+        stats.encodedBytes += encodedCounts[partition];
+    }
+    header.blocks = output.index.size();
+    header.indexOffset = output.offset;
+    header.directoryOffset = header.indexOffset + output.index.size() * sizeof(BlockIndex);
+    bool failed = output.failed ||
+                  std::fwrite(output.index.data(), sizeof(BlockIndex), output.index.size(), output.file) !=
+                      output.index.size() ||
+                  std::fwrite(firstBlocks.data(), sizeof(uint64_t), firstBlocks.size(), output.file) !=
+                      firstBlocks.size() ||
+                  std::fseek(output.file, 0, SEEK_SET) != 0 ||
+                  std::fwrite(&header, sizeof(header), 1, output.file) != 1;
+    failed = std::fclose(output.file) != 0 || failed;
+
+    stats.entries = header.entries;
+    stats.blocks = header.blocks;
+    stats.sealedBytes = header.directoryOffset + firstBlocks.size() * sizeof(uint64_t);
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return !failed && std::all_of(sorted.begin(), sorted.end(), [](char ok) { return ok != 0; });
+}
+
+bool SealedSegment::open(const std::string& path) {
+    close();
+    std::unique_ptr<MappedFile> mapped(new MappedFile());
+    FileHeader header;
+    if (!mapped->open(path) || mapped->size() < sizeof(header)) {
+        std::cerr << "Error: Could not open " << path << std::endl;
+        return false;
+    }
+    std::memcpy(&header, mapped->data(), sizeof(header));
+    uint64_t directoryBytes = (static_cast<uint64_t>(header.partitions) + 1) * sizeof(uint64_t);
+    if (std::memcmp(header.magic, MAGIC, sizeof(header.magic)) != 0 || header.blockEntries != BLOCK_ENTRIES ||
+        header.directoryOffset != header.indexOffset + header.blocks * sizeof(BlockIndex) ||
+        header.directoryOffset + directoryBytes != mapped->size()) {
+        std::cerr << "Error: " << path << " is not a sealed ledger segment" << std::endl;
+        return false;
+    }
+    index = reinterpret_cast<const BlockIndex*>(mapped->data() + header.indexOffset);
+    directory = reinterpret_cast<const uint64_t*>(mapped->data() + header.directoryOffset);
+    entries = header.entries;
+    blocks = header.blocks;
+    partitions = header.partitions;
+    checksum = header.checksum;
+    file = std::move(mapped);
+    return true;
+}
+
+void SealedSegment::close() {
+    file.reset();
+    index = nullptr;
+    directory = nullptr;
+    entries = 0;
+    blocks = 0;
+    partitions = 0;
+    checksum = 0;
+}
+
+bool SealedSegment::decodeBlock(size_t block, std::vector<LedgerEntry>& out) const {
+    if (!file || block >= blocks) {
+        return false;
+    }
+    const BlockIndex& entry = index[block];
+    if (entry.offset + entry.storedBytes > file->size()) {
+        return false;
+    }
+    const uint8_t* stored = reinterpret_cast<const uint8_t*>(file->data() + entry.offset);
+    out.resize(entry.count);
+    if (entry.storedBytes == entry.encodedBytes) {
+        return decodeColumns(stored, entry.storedBytes, entry.count, out.data());
+    }
+    thread_local std::vector<uint8_t> encoded;
+    encoded.resize(entry.encodedBytes);
+    return BlockCompressor::decompress(stored, entry.storedBytes, encoded.data(), encoded.size()) &&
+           decodeColumns(encoded.data(), encoded.size(), entry.count, out.data());
+}
+
+bool SealedSegment::query(const std::string& accountNumber, std::vector<LedgerEntry>& out,
+                          SegmentReadStats* stats) const {
+    return query(AccountKey::ledgerKey(accountNumber), std::numeric_limits<int64_t>::min(),
+                 std::numeric_limits<int64_t>::max(), out, stats);
+}
+
+bool SealedSegment::query(uint64_t accountKey, int64_t fromUs, int64_t toUs, std::vector<LedgerEntry>& out,
+                          SegmentReadStats* stats) const {
+    if (!file || partitions == 0) {
+        return false;
+    }
+    size_t partition = LedgerSorter::partitionOf(accountKey, partitions);
+    const BlockIndex* begin = index + directory[partition];
+    const BlockIndex* end = index + directory[partition + 1];
+    // The account's blocks are the run whose key range covers it
+    begin = std::partition_point(begin, end, [&](const BlockIndex& block) { return block.lastKey < accountKey; });
+    end = std::partition_point(begin, end, [&](const BlockIndex& block) { return block.firstKey <= accountKey; });
+
+    bool found = false;
+    thread_local std::vector<LedgerEntry> decoded;
+    for (const BlockIndex* block = begin; block != end; ++block) {
+        if (block->maxTimeUs < fromUs || block->minTimeUs >= toUs) {
+            found = true; // the account is here, just not in this time range
+            continue;
+        }
+        if (!decodeBlock(static_cast<size_t>(block - index), decoded)) {
+            return false;
+        }
+        if (stats) {
+            stats->blocksDecoded++;
+            stats->entriesDecoded += decoded.size();
+            stats->bytesRead += block->storedBytes;
+        }
+        for (const LedgerEntry& entry : decoded) {
+            if (entry.accountKey == accountKey) {
+                found = true;
+                if (entry.timestampUs >= fromUs && entry.timestampUs < toUs) {
+                    out.push_back(entry);
+                }
+            }
+        }
+    }
+    return found;
+}
+
+bool SealedSegment::verify(SegmentReadStats& stats) const {
+    uint64_t sum = 0;
+    uint64_t count = 0;
+    std::vector<LedgerEntry> decoded;
+    for (size_t block = 0; block < blocks; ++block) {
+        if (!decodeBlock(block, decoded)) {
+            return false;
+        }
+        for (const LedgerEntry& entry : decoded) {
+            sum += checksumOf(entry);
+        }
+        count += decoded.size();
+        stats.blocksDecoded++;
+        stats.bytesRead += index[block].storedBytes;
+    }
+    stats.entriesDecoded += count;
+    return count == entries && sum == checksum;
+}
+
+uint64_t SealedSegment::getEntries() const {
+    return entries;
+}
+
+uint64_t SealedSegment::getBlocks() const {
+    return blocks;
+}
+
+uint64_t SealedSegment::getFileBytes() const {
+    return file ? file->size() : 0;
+}
@@ -0,0 +1,108 @@
+#ifndef SEALEDSEGMENT_H
+#define SEALEDSEGMENT_H
+
+#include "Ledger.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class MappedFile;
+
+struct SealConfig {
+    std::string ledgerPath;
+    std::string outputPath;
+    std::string tempDir;       // empty: <outputPath>.tmp
+    size_t memoryBudget = size_t(256) << 20;
+    unsigned threads = 0;      // 0: hardware concurrency
+};
+
+struct SealStats {
+    uint64_t entries = 0;
+    uint64_t blocks = 0;
+    size_t partitions = 0;
+    uint64_t encodedBytes = 0; // after column encoding, before compression
+    uint64_t sealedBytes = 0;  // the whole segment file
+    double seconds = 0.0;
+};
+
+struct SegmentReadStats {
+    uint64_t blocksDecoded = 0;
+    uint64_t entriesDecoded = 0;
+    uint64_t bytesRead = 0;
+};
+
+// A closed ledger segment rewritten for cold storage.
+//
+// seal() sorts the segment by account and time (LedgerSorter) and cuts
+// each partition into blocks of up to BLOCK_ENTRIES entries. A block is
+// stored column by column: account keys as deltas, timestamps and amounts
+// as zigzag deltas, all as varints, and the type, flags and terminal
+// columns after them. The columns are then compressed with BlockCompressor
+// (kept as they are if that does not help). A sparse index holds each
+// block's key and time range and file offset, and a directory gives each
+// partition's first block. A query for one account binary-searches its
+// partition's blocks and decodes only the blocks its entries are in.
+class SealedSegment {
+public:
+    static const char MAGIC[8];
+    static const size_t BLOCK_ENTRIES = 1024;
+
+    // On-disk index record, one per block
+    struct BlockIndex {
+        uint64_t firstKey;
+        uint64_t lastKey;
+        int64_t minTimeUs;
+        int64_t maxTimeUs;
+        uint64_t offset;
+        uint32_t storedBytes;
+        uint32_t encodedBytes; // equal to storedBytes: stored uncompressed
+        uint16_t count;
+        uint16_t partition;
+        uint32_t reserved;
+    };
+
+    SealedSegment();
+    ~SealedSegment();
+
+    SealedSegment(const SealedSegment&) = delete;
+    SealedSegment& operator=(const SealedSegment&) = delete;
+
+    static bool seal(const SealConfig& config, SealStats& stats);
+
+    bool open(const std::string& path);
+    void close();
+
+    // Append one account's entries in [fromUs, toUs) to out, in time order;
+    // false if the segment has none for it
+    bool query(uint64_t accountKey, int64_t fromUs, int64_t toUs, std::vector<LedgerEntry>& out,
+               SegmentReadStats* stats = nullptr) const;
+    bool query(const std::string& accountNumber, std::vector<LedgerEntry>& out,
+               SegmentReadStats* stats = nullptr) const;
+
+    // Replace out with the entries of one block
+    bool decodeBlock(size_t block, std::vector<LedgerEntry>& out) const;
+
+    // Decode every block and compare the count and checksum recorded when
+    // sealing
+    bool verify(SegmentReadStats& stats) const;
+
+    uint64_t getEntries() const;
+    uint64_t getBlocks() const;
+    uint64_t getFileBytes() const;
+
+    // Order-independent checksum term of one entry; seal() sums them
+    static uint64_t checksumOf(const LedgerEntry& entry);
+
+private:
+    std::unique_ptr<MappedFile> file;
+    const BlockIndex* index;
+    const uint64_t* directory; // first block of each partition, plus an end sentinel
+    uint64_t entries;
+    uint64_t blocks;
+    uint32_t partitions;
+    uint64_t checksum;
+};
+
+#endif // SEALEDSEGMENT_H
@@ -0,0 +1,48 @@
+#ifndef SESSIONHISTORY_H
+#define SESSIONHISTORY_H
+
+#include "Transaction.h"
+#include <utility>
+#include <variant>
+#include <vector>
+
+// Transactions performed in one ATM session, stored by value.
+//
+// Each entry holds the concrete transaction in a variant inside capacity
+// reserved up front, so recording a posting does not allocate; entries are
+// still read back through the Transaction interface.
+class SessionHistory {
+public:
+    using Entry = std::variant<Withdrawal, Deposit, BalanceInquiry>;
+
+    static const size_t RESERVED_ENTRIES = 64;
+
+    SessionHistory() {
+        entries.reserve(RESERVED_ENTRIES);
+    }
+
+    // Construct a transaction in place and return it for processing
+    template <typename T, typename... Args>
+    T& record(Args&&... args) {
+        entries.emplace_back(std::in_place_type<T>, std::forward<Args>(args)...);
+        return std::get<T>(entries.back());
+    }
+
+    const Transaction& operator[](size_t index) const {
+        return std::visit([](const auto& transaction) -> const Transaction& { return transaction; }, entries[index]);
+    }
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+
+    // Drop the latest entry, for a posting that never reached the account
+    void discardLast() { entries.pop_back(); }
+
+    // Forget the entries but keep the capacity for the next session
+    void clear() { entries.clear(); }
+
+private:
+    std::vector<Entry> entries;
+};
+
+#endif // SESSIONHISTORY_H
@@ -0,0 +1,241 @@
+#include "SessionTrace.h"
+#include <cstring>
+#include <iterator>
+#include <thread>
+
+const char SessionTrace::MAGIC[8] = {'A', 'T', 'M', 'T', 'R', 'C', '0', '1'};
+
+namespace {
+    void putVarint(std::string& out, uint64_t value) {
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    bool getVarint(const std::string& in, size_t& pos, uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64 && pos < in.size(); shift += 7) {
+            uint8_t byte = static_cast<uint8_t>(in[pos++]);
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint64_t zigzag(int64_t value) {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    int64_t unzigzag(uint64_t value) {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+}
+
+// Read a whole trace file into memory
+bool SessionTrace::load(const std::string& path, std::vector<Event>& events) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(MAGIC) || std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        return false;
+    }
+
+    size_t pos = sizeof(MAGIC);
+    while (pos < data.size()) {
+        Event event{static_cast<EventKind>(data[pos++]), 0, std::string(), 0, 0.0};
+        if (!getVarint(data, pos, event.delayUs)) {
+            return false;
+        }
+
+        uint64_t raw = 0;
+        switch (event.kind) {
+            case EventKind::Text:
+                if (!getVarint(data, pos, raw) || raw > data.size() - pos) {
+                    return false;
+                }
+                event.text.assign(data, pos, raw);
+                pos += raw;
+                break;
+            case EventKind::Menu:
+                if (!getVarint(data, pos, raw)) {
+                    return false;
+                }
+                event.number = unzigzag(raw);
+                break;
+            case EventKind::Amount:
+                if (data.size() - pos < sizeof(double)) {
+                    return false;
+                }
+                std::memcpy(&event.amount, data.data() + pos, sizeof(double));
+                pos += sizeof(double);
+                break;
+            case EventKind::Invalid:
+            case EventKind::Pause:
+                break;
+            default:
+                return false;
+        }
+        events.push_back(std::move(event));
+    }
+    return true;
+}
+
+// SessionRecorder implementation
+SessionRecorder::~SessionRecorder() {
+    close();
+}
+
+bool SessionRecorder::open(const std::string& path) {
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.write(SessionTrace::MAGIC, sizeof(SessionTrace::MAGIC));
+    return static_cast<bool>(file);
+}
+
+bool SessionRecorder::isOpen() const {
+    return file.is_open();
+}
+
+void SessionRecorder::close() {
+    if (file.is_open()) {
+        file.close();
+    }
+}
+
+void SessionRecorder::writeEvent(SessionTrace::EventKind kind, uint64_t delayUs) {
+    buffer.clear();
+    buffer += static_cast<char>(kind);
+    putVarint(buffer, delayUs);
+}
+
+// Each event reaches the file as it is recorded (input arrives at typing
+// speed), so a session that crashes or is killed can still be replayed
+void SessionRecorder::flushEvent() {
+    file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    file.flush();
+}
+
+void SessionRecorder::recordText(const std::string& text, uint64_t delayUs) {
+    writeEvent(SessionTrace::EventKind::Text, delayUs);
+    putVarint(buffer, text.size());
+    buffer += text;
+    flushEvent();
+}
+
+void SessionRecorder::recordMenu(int choice, uint64_t delayUs) {
+    writeEvent(SessionTrace::EventKind::Menu, delayUs);
+    putVarint(buffer, zigzag(choice));
+    flushEvent();
+}
+
+void SessionRecorder::recordAmount(double amount, uint64_t delayUs) {
+    writeEvent(SessionTrace::EventKind::Amount, delayUs);
+    char raw[sizeof(double)];
+    std::memcpy(raw, &amount, sizeof(double));
+    buffer.append(raw, sizeof(double));
+    flushEvent();
+}
+
+void SessionRecorder::recordInvalid(uint64_t delayUs) {
+    writeEvent(SessionTrace::EventKind::Invalid, delayUs);
+    flushEvent();
+}
+
+void SessionRecorder::recordPause(uint64_t delayUs) {
+    writeEvent(SessionTrace::EventKind::Pause, delayUs);
+    flushEvent();
+}
+
+// TraceReplay implementation
+const SessionTrace::Event TraceReplay::END_EVENT = {SessionTrace::EventKind::End, 0, std::string(), 0, 0.0};
+
+const char* TraceReplay::operationName(int operation) {
+    static const char* const NAMES[OPERATION_COUNT] = {
+        "exit", "inquiry", "withdrawal", "deposit", "history", "logout", "login"
+    };
+    return (operation >= 0 && operation < OPERATION_COUNT) ? NAMES[operation] : "unknown";
+}
+
+TraceReplay::TraceReplay(const std::vector<SessionTrace::Event>& events, Pace pace)
+    : events(events), cursor(0), pace(pace), desynchronized(false),
+      currentOperation(LOGIN_OPERATION), pendingNs(0), lastReturn(std::chrono::steady_clock::now()) {}
+
+void TraceReplay::resetClock() {
+    currentOperation = LOGIN_OPERATION;
+    pendingNs = 0;
+    lastReturn = std::chrono::steady_clock::now();
+}
+
+// Time spent outside next() is session work; a new menu prompt ends the
+// operation the previous menu choice started
+const SessionTrace::Event& TraceReplay::next(SessionTrace::EventKind expected) {
+    auto now = std::chrono::steady_clock::now();
+    pendingNs += static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastReturn).count());
+    if (expected == SessionTrace::EventKind::Menu) {
+        closeOperation();
+    }
+
+    if (cursor >= events.size()) {
+        lastReturn = now;
+        return END_EVENT;
+    }
+
+    const SessionTrace::Event& event = events[cursor];
+    bool isNumberPrompt = expected == SessionTrace::EventKind::Menu ||
+                          expected == SessionTrace::EventKind::Amount;
+    if (event.kind != expected && !(isNumberPrompt && event.kind == SessionTrace::EventKind::Invalid)) {
+        desynchronized = true;
+        cursor = events.size();
+        lastReturn = now;
+        return END_EVENT;
+    }
+    cursor++;
+
+    if (pace == Pace::Original && event.delayUs > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(event.delayUs));
+    }
+    if (event.kind == SessionTrace::EventKind::Menu) {
+        bool known = event.number >= 0 && event.number < LOGIN_OPERATION;
+        currentOperation = known ? static_cast<int>(event.number) : -1;
+    }
+
+    lastReturn = std::chrono::steady_clock::now();
+    return event;
+}
+
+void TraceReplay::finish() {
+    auto now = std::chrono::steady_clock::now();
+    pendingNs += static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastReturn).count());
+    lastReturn = now;
+    closeOperation();
+}
+
+void TraceReplay::closeOperation() {
+    if (currentOperation >= 0) {
+        latencies[currentOperation].push_back(pendingNs);
+    }
+    currentOperation = -1;
+    pendingNs = 0;
+}
+
+size_t TraceReplay::getConsumed() const {
+    return cursor;
+}
+
+bool TraceReplay::wasDesynchronized() const {
+    return desynchronized;
+}
+
+const std::vector<uint64_t>& TraceReplay::getLatencies(int operation) const {
+    return latencies[operation];
+}
@@ -0,0 +1,107 @@
+#ifndef SESSIONTRACE_H
+#define SESSIONTRACE_H
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Recorded console input for one ATM session.
+//
+// File layout: the 8-byte magic "ATMTRC01" followed by one record per input
+// value: a kind byte, the user's think time in microseconds as a varint, and
+// the payload (varint length + bytes for text, zigzag varint for menu
+// choices, 8 raw bytes for amounts).
+class SessionTrace {
+public:
+    enum class EventKind : uint8_t {
+        End = 0,     // no more input
+        Text = 1,    // getStringInput
+        Menu = 2,    // getMenuChoice
+        Amount = 3,  // getAmountInput
+        Invalid = 4, // a number prompt that could not be parsed
+        Pause = 5    // "Press Enter to continue"
+    };
+
+    struct Event {
+        EventKind kind;
+        uint64_t delayUs;
+        std::string text;
+        int64_t number;
+        double amount;
+    };
+
+    static const char MAGIC[8];
+
+    // Read a whole trace file
+    static bool load(const std::string& path, std::vector<Event>& events);
+};
+
+// Captures input values as the console session reads them
+class SessionRecorder {
+private:
+    std::ofstream file;
+    std::string buffer; // the event being recorded
+
+    void writeEvent(SessionTrace::EventKind kind, uint64_t delayUs);
+    void flushEvent();
+
+public:
+    SessionRecorder() = default;
+    ~SessionRecorder();
+
+    bool open(const std::string& path);
+    bool isOpen() const;
+    void close();
+
+    void recordText(const std::string& text, uint64_t delayUs);
+    void recordMenu(int choice, uint64_t delayUs);
+    void recordAmount(double amount, uint64_t delayUs);
+    void recordInvalid(uint64_t delayUs);
+    void recordPause(uint64_t delayUs);
+};
+
+// Feeds a recorded trace back into a session and measures how long the
+// session spends on each operation between two inputs
+class TraceReplay {
+public:
+    enum class Pace { Original, AsFastAsPossible };
+
+    // Operations are labelled by the menu choice that started them
+    static const int OPERATION_COUNT = 7;
+    static const int LOGIN_OPERATION = 6;
+    static const char* operationName(int operation);
+
+    TraceReplay(const std::vector<SessionTrace::Event>& events, Pace pace);
+
+    // Next recorded input; an End event once the trace is exhausted or the
+    // session asks for a different kind of input than was recorded
+    const SessionTrace::Event& next(SessionTrace::EventKind expected);
+
+    // Start timing from now (call right before the session starts)
+    void resetClock();
+
+    // Close the last operation once the session has returned
+    void finish();
+
+    size_t getConsumed() const;
+    bool wasDesynchronized() const;
+    const std::vector<uint64_t>& getLatencies(int operation) const;
+
+private:
+    const std::vector<SessionTrace::Event>& events;
+    size_t cursor;
+    Pace pace;
+    bool desynchronized;
+    int currentOperation;
+    uint64_t pendingNs;
+    std::chrono::steady_clock::time_point lastReturn;
+    std::vector<uint64_t> latencies[OPERATION_COUNT];
+
+    static const SessionTrace::Event END_EVENT;
+
+    void closeOperation();
+};
+
+#endif // SESSIONTRACE_H
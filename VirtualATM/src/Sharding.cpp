@@ -0,0 +1,500 @@
+#include "Sharding.h"
+#include "AccountKey.h"
+#include "AccountStore.h"
+#include "FileManager.h"
+#include "LocalSocket.h"
+#include "Transaction.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // Longest a request waits for a rebalance to switch the ring
+    const std::chrono::seconds RING_WAIT(5);
+
+    ShardRequest makeRequest(ShardOp op, uint64_t accountKey, int64_t cents, uint64_t extra, uint32_t terminal) {
+        ShardRequest request = {};
+        request.op = static_cast<uint8_t>(op);
+        request.terminal = terminal;
+        request.accountKey = accountKey;
+        request.cents = cents;
+        request.extra = extra;
+        return request;
+    }
+
+    double seconds(Clock::time_point since) {
+        return std::chrono::duration<double>(Clock::now() - since).count();
+    }
+}
+
+ShardServer::ShardServer(AccountStore& accountStore)
+    : store(accountStore), listenFd(-1), moved(accountStore.size(), 0), running(false) {}
+
+ShardServer::~ShardServer() {
+    if (listenFd >= 0) {
+        LocalSocket::close(listenFd);
+        std::remove(socketPath.c_str());
+    }
+}
+
+void ShardServer::filterOwned(AccountStore& store, uint32_t shard, uint32_t shards) {
+    HashRing ring(shards);
+    std::vector<Account> owned;
+    for (size_t i = 0; i < store.size(); ++i) {
+        const Account& account = store.at(i);
+        if (ring.shardOf(AccountKey::encode(account.getAccountNumber())) == shard) {
+            owned.push_back(account);
+        }
+    }
+    store.adopt(std::move(owned), store.getDataFilePath());
+}
+
+bool ShardServer::listen(const std::string& path, std::string& error) {
+    listenFd = LocalSocket::listen(path, 64, error);
+    socketPath = path;
+    return listenFd >= 0;
+}
+
+void ShardServer::serve() {
+    running.store(true);
+    std::vector<std::thread> workers;
+    while (running.load()) {
+        int connection = LocalSocket::accept(listenFd);
+        if (connection < 0) {
+            break;
+        }
+        std::lock_guard<std::mutex> lock(connectionMutex);
+        if (!running.load()) {
+            LocalSocket::close(connection);
+            break;
+        }
+        connections.push_back(connection);
+        workers.emplace_back(&ShardServer::handle, this, connection);
+    }
+    // Wake connections still waiting for requests so their threads finish
+    {
+        std::lock_guard<std::mutex> lock(connectionMutex);
+        for (int connection : connections) {
+            LocalSocket::shutdown(connection);
+        }
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (int connection : connections) {
+        LocalSocket::close(connection);
+    }
+    connections.clear();
+}
+
+void ShardServer::handle(int connection) {
+    ShardRequest request;
+    while (LocalSocket::receiveAll(connection, &request, sizeof(request))) {
+        ShardOp op = static_cast<ShardOp>(request.op);
+        if (op == ShardOp::Export || op == ShardOp::Import) {
+            bool ok = op == ShardOp::Export ? exportAccounts(connection, request.extra)
+                                            : importAccounts(connection, request.extra);
+            if (!ok) {
+                break;
+            }
+            continue;
+        }
+        ShardReply reply = {};
+        if (op == ShardOp::Shutdown) {
+            {
+                std::lock_guard<std::mutex> lock(connectionMutex);
+                running.store(false);
+            }
+            LocalSocket::shutdown(listenFd);
+            reply.status = static_cast<uint8_t>(ShardStatus::Ok);
+            LocalSocket::sendAll(connection, &reply, sizeof(reply));
+            break;
+        }
+        reply.status = static_cast<uint8_t>(apply(request, reply));
+        if (!LocalSocket::sendAll(connection, &reply, sizeof(reply))) {
+            break;
+        }
+    }
+}
+
+Account* ShardServer::find(uint64_t accountKey) {
+    char digits[AccountKey::MAX_DIGITS];
+    size_t length = AccountKey::decodeTo(accountKey, digits);
+    return store.find(std::string(digits, length));
+}
+
+ShardStatus ShardServer::apply(const ShardRequest& request, ShardReply& reply) {
+    std::shared_lock<std::shared_mutex> lock(migration);
+    Account* account = find(request.accountKey);
+    if (!account) {
+        return ShardStatus::Unknown;
+    }
+    if (moved[store.positionOf(*account)]) {
+        return ShardStatus::Moved;
+    }
+    double amount = static_cast<double>(request.cents) / 100.0;
+    bool ok;
+    switch (static_cast<ShardOp>(request.op)) {
+        case ShardOp::Inquiry: {
+            BalanceInquiry inquiry;
+            ok = store.apply(inquiry, *account, request.terminal);
+            break;
+        }
+        case ShardOp::Withdraw: {
+            Withdrawal withdrawal(amount);
+            ok = store.apply(withdrawal, *account, request.terminal);
+            if (withdrawal.wasOverDailyLimit()) {
+                reply.decline = static_cast<uint8_t>(ShardDecline::DailyLimit);
+            } else if (withdrawal.getDeclinedRule() != 0) {
+                reply.decline = static_cast<uint8_t>(ShardDecline::Rule);
+                reply.rule = withdrawal.getDeclinedRule();
+            } else if (!ok) {
+                reply.decline = static_cast<uint8_t>(ShardDecline::Funds);
+            }
+            break;
+        }
+        case ShardOp::Deposit: {
+            Deposit deposit(amount);
+            ok = store.apply(deposit, *account, request.terminal);
+            break;
+        }
+        case ShardOp::Transfer: {
+            Account* target = find(request.extra);
+            if (!target) {
+                return ShardStatus::Unknown;
+            }
+            if (moved[store.positionOf(*target)]) {
+                return ShardStatus::Moved;
+            }
+            Transfer transfer(amount, *target);
+            ok = store.transfer(transfer, *account, request.terminal);
+            break;
+        }
+        case ShardOp::Login:
+            ok = request.extra != 0 && account->validatePin(AccountKey::decode(request.extra));
+            break;
+        default:
+            return ShardStatus::Failed;
+    }
+    reply.balanceCents = Ledger::toCents(account->getBalance());
+    return ok ? ShardStatus::Ok : ShardStatus::Declined;
+}
+
+// Retire the accounts in the requested ranges and send them as account
+// lines. Postings are held back only while the accounts are copied.
+bool ShardServer::exportAccounts(int connection, uint64_t payloadBytes) {
+    std::vector<HashRing::Range> ranges(payloadBytes / sizeof(HashRing::Range));
+    if (payloadBytes % sizeof(HashRing::Range) != 0 ||
+        !LocalSocket::receiveAll(connection, ranges.data(), payloadBytes)) {
+        return false;
+    }
+    std::string lines;
+    {
+        std::unique_lock<std::shared_mutex> lock(migration);
+        for (size_t i = 0; i < store.size(); ++i) {
+            const Account& account = store.at(i);
+            if (moved[i] || !HashRing::inRanges(HashRing::hashKey(AccountKey::encode(account.getAccountNumber())),
+                                                ranges)) {
+                continue;
+            }
+            moved[i] = 1;
+            lines += account.toString();
+            lines += '\n';
+        }
+    }
+    ShardReply reply = {};
+    reply.status = static_cast<uint8_t>(ShardStatus::Ok);
+    reply.payloadBytes = static_cast<uint32_t>(lines.size());
+    return LocalSocket::sendAll(connection, &reply, sizeof(reply)) &&
+           LocalSocket::sendAll(connection, lines.data(), lines.size());
+}
+
+// Add account lines to this shard's store. Only a shard that is not yet
+// in the ring imports, so no posting can hold an Account meanwhile.
+bool ShardServer::importAccounts(int connection, uint64_t payloadBytes) {
+    std::string lines(payloadBytes, '\0');
+    if (!LocalSocket::receiveAll(connection, &lines[0], payloadBytes)) {
+        return false;
+    }
+    int64_t imported = 0;
+    {
+        std::unique_lock<std::shared_mutex> lock(migration);
+        std::vector<Account> accounts;
+        for (size_t i = 0; i < store.size(); ++i) {
+            if (!moved[i]) {
+                accounts.push_back(store.at(i));
+            }
+        }
+        std::istringstream input(lines);
+        std::string line;
+        while (std::getline(input, line)) {
+            if (!line.empty()) {
+                accounts.push_back(Account::fromString(line));
+                ++imported;
+            }
+        }
+        store.adopt(std::move(accounts), store.getDataFilePath());
+        moved.assign(store.size(), 0);
+    }
+    ShardReply reply = {};
+    reply.status = static_cast<uint8_t>(ShardStatus::Ok);
+    reply.balanceCents = imported;
+    return LocalSocket::sendAll(connection, &reply, sizeof(reply));
+}
+
+bool ShardServer::saveOwned(const std::string& path) {
+    std::vector<Account> owned;
+    {
+        std::shared_lock<std::shared_mutex> lock(migration);
+        for (size_t i = 0; i < store.size(); ++i) {
+            if (!moved[i]) {
+                owned.push_back(store.at(i));
+            }
+        }
+    }
+    return FileManager::saveAccounts(owned, path);
+}
+
+size_t ShardServer::getOwnedCount() const {
+    std::shared_lock<std::shared_mutex> lock(migration);
+    return static_cast<size_t>(std::count(moved.begin(), moved.end(), 0));
+}
+
+ShardRouter::ShardRouter() : ringVersion(0) {}
+
+ShardRouter::~ShardRouter() {
+    for (auto& backend : backends) {
+        for (int fd : backend->idle) {
+            LocalSocket::close(fd);
+        }
+    }
+}
+
+bool ShardRouter::connect(const std::vector<std::string>& socketPaths, std::string& error) {
+    std::vector<std::unique_ptr<Backend>> connected;
+    for (const std::string& path : socketPaths) {
+        std::unique_ptr<Backend> backend(new Backend());
+        backend->socketPath = path;
+        int fd = LocalSocket::connect(path, error);
+        if (fd < 0) {
+            return false;
+        }
+        backend->idle.push_back(fd);
+        connected.push_back(std::move(backend));
+    }
+    std::unique_lock<std::shared_mutex> lock(ringMutex);
+    backends = std::move(connected);
+    ring = HashRing(static_cast<uint32_t>(backends.size()));
+    ++ringVersion;
+    return !backends.empty();
+}
+
+// Export the new shard's ranges from every running shard, import them,
+// then switch the ring. Only the exporting shard holds postings back, and
+// only while it copies; requests for accounts in flight wait for the switch.
+bool ShardRouter::addShard(const std::string& socketPath, RebalanceStats& stats, std::string& error) {
+    std::lock_guard<std::mutex> rebalancing(rebalanceMutex);
+    Clock::time_point begin = Clock::now();
+    std::unique_ptr<Backend> added(new Backend());
+    added->socketPath = socketPath;
+    int fd = LocalSocket::connect(socketPath, error);
+    if (fd < 0) {
+        return false;
+    }
+    added->idle.push_back(fd);
+
+    HashRing next;
+    size_t running;
+    {
+        std::shared_lock<std::shared_mutex> lock(ringMutex);
+        next = ring;
+        running = backends.size();
+    }
+    uint32_t id = static_cast<uint32_t>(running);
+    next.addShard(id);
+    std::vector<HashRing::Range> ranges = next.rangesOf(id);
+    std::string rangeBytes(reinterpret_cast<const char*>(ranges.data()), ranges.size() * sizeof(HashRing::Range));
+
+    std::string exported;
+    for (size_t shard = 0; shard < running; ++shard) {
+        ShardRequest request = makeRequest(ShardOp::Export, 0, 0, rangeBytes.size(), 0);
+        ShardReply reply;
+        std::string lines;
+        Clock::time_point exportBegin = Clock::now();
+        if (!exchange(*backends[shard], request, reply, &rangeBytes, &lines) ||
+            reply.status != static_cast<uint8_t>(ShardStatus::Ok)) {
+            error = "export from shard " + std::to_string(shard) + " failed";
+            return false;
+        }
+        stats.exportSeconds = std::max(stats.exportSeconds, seconds(exportBegin));
+        exported += lines;
+    }
+    ShardRequest request = makeRequest(ShardOp::Import, 0, 0, exported.size(), 0);
+    ShardReply reply;
+    if (!exchange(*added, request, reply, &exported) || reply.status != static_cast<uint8_t>(ShardStatus::Ok)) {
+        error = "import into " + socketPath + " failed";
+        return false;
+    }
+    stats.movedAccounts = static_cast<uint64_t>(reply.balanceCents);
+    {
+        std::unique_lock<std::shared_mutex> lock(ringMutex);
+        backends.push_back(std::move(added));
+        ring = next;
+        ++ringVersion;
+    }
+    ringChanged.notify_all();
+    stats.totalSeconds = seconds(begin);
+    return true;
+}
+
+ShardRouter::Backend& ShardRouter::route(uint64_t accountKey, uint64_t& version) const {
+    std::shared_lock<std::shared_mutex> lock(ringMutex);
+    version = ringVersion;
+    return *backends[ring.shardOf(accountKey)];
+}
+
+bool ShardRouter::awaitRing(uint64_t version) {
+    std::shared_lock<std::shared_mutex> lock(ringMutex);
+    return ringChanged.wait_for(lock, RING_WAIT, [&] { return ringVersion != version; });
+}
+
+ShardStatus ShardRouter::call(uint64_t accountKey, const ShardRequest& request, ShardReply& reply) {
+    while (true) {
+        uint64_t version;
+        Backend& backend = route(accountKey, version);
+        if (!exchange(backend, request, reply)) {
+            return ShardStatus::Failed;
+        }
+        ShardStatus status = static_cast<ShardStatus>(reply.status);
+        if (status != ShardStatus::Moved) {
+            return status;
+        }
+        if (!awaitRing(version)) {
+            return ShardStatus::Failed;
+        }
+    }
+}
+
+bool ShardRouter::exchange(Backend& backend, const ShardRequest& request, ShardReply& reply,
+                           const std::string* payload, std::string* replyPayload) {
+    int fd = borrow(backend);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = LocalSocket::sendAll(fd, &request, sizeof(request)) &&
+              (!payload || LocalSocket::sendAll(fd, payload->data(), payload->size())) &&
+              LocalSocket::receiveAll(fd, &reply, sizeof(reply));
+    if (ok && reply.payloadBytes > 0) {
+        std::string received(reply.payloadBytes, '\0');
+        ok = LocalSocket::receiveAll(fd, &received[0], received.size());
+        if (replyPayload) {
+            replyPayload->swap(received);
+        }
+    }
+    if (!ok) {
+        LocalSocket::close(fd);
+        return false;
+    }
+    giveBack(backend, fd);
+    return true;
+}
+
+int ShardRouter::borrow(Backend& backend) {
+    {
+        std::lock_guard<std::mutex> lock(backend.poolMutex);
+        if (!backend.idle.empty()) {
+            int fd = backend.idle.back();
+            backend.idle.pop_back();
+            return fd;
+        }
+    }
+    std::string error;
+    return LocalSocket::connect(backend.socketPath, error);
+}
+
+void ShardRouter::giveBack(Backend& backend, int fd) {
+    std::lock_guard<std::mutex> lock(backend.poolMutex);
+    backend.idle.push_back(fd);
+}
+
+bool ShardRouter::login(const std::string& accountNumber, const std::string& pin) {
+    uint64_t key = AccountKey::encode(accountNumber);
+    uint64_t pinKey = AccountKey::encode(pin);
+    if (key == 0 || pinKey == 0) {
+        return false;
+    }
+    ShardReply reply;
+    return call(key, makeRequest(ShardOp::Login, key, 0, pinKey, 0), reply) == ShardStatus::Ok;
+}
+
+ShardStatus ShardRouter::post(ShardOp op, const std::string& accountNumber, int64_t cents, ShardOutcome& outcome,
+                              uint32_t terminal) {
+    uint64_t key = AccountKey::encode(accountNumber);
+    if (key == 0) {
+        return ShardStatus::Unknown;
+    }
+    ShardReply reply = {};
+    ShardStatus status = call(key, makeRequest(op, key, cents, 0, terminal), reply);
+    outcome.balanceCents = reply.balanceCents;
+    outcome.decline = static_cast<ShardDecline>(reply.decline);
+    outcome.rule = reply.rule;
+    return status;
+}
+
+ShardStatus ShardRouter::transfer(const std::string& from, const std::string& to, int64_t cents, uint32_t terminal) {
+    uint64_t fromKey = AccountKey::encode(from);
+    uint64_t toKey = AccountKey::encode(to);
+    if (fromKey == 0 || toKey == 0) {
+        return ShardStatus::Unknown;
+    }
+    while (true) {
+        uint64_t version, targetVersion;
+        Backend& source = route(fromKey, version);
+        Backend& target = route(toKey, targetVersion);
+        if (&source != &target || version != targetVersion) {
+            break;
+        }
+        ShardReply reply;
+        if (!exchange(source, makeRequest(ShardOp::Transfer, fromKey, cents, toKey, terminal), reply)) {
+            return ShardStatus::Failed;
+        }
+        ShardStatus status = static_cast<ShardStatus>(reply.status);
+        if (status != ShardStatus::Moved) {
+            return status;
+        }
+        if (!awaitRing(version)) {
+            return ShardStatus::Failed;
+        }
+    }
+    ShardOutcome outcome;
+    ShardStatus debit = post(ShardOp::Withdraw, from, cents, outcome, terminal);
+    if (debit != ShardStatus::Ok) {
+        return debit;
+    }
+    ShardStatus credit = post(ShardOp::Deposit, to, cents, outcome, terminal);
+    if (credit != ShardStatus::Ok) {
+        post(ShardOp::Deposit, from, cents, outcome, terminal);
+    }
+    return credit;
+}
+
+uint32_t ShardRouter::shardOf(const std::string& accountNumber) const {
+    std::shared_lock<std::shared_mutex> lock(ringMutex);
+    return ring.shardOf(AccountKey::encode(accountNumber));
+}
+
+size_t ShardRouter::getShardCount() const {
+    std::shared_lock<std::shared_mutex> lock(ringMutex);
+    return backends.size();
+}
+
+void ShardRouter::shutdownShards() {
+    std::shared_lock<std::shared_mutex> lock(ringMutex);
+    for (auto& backend : backends) {
+        ShardReply reply;
+        exchange(*backend, makeRequest(ShardOp::Shutdown, 0, 0, 0, 0), reply);
+    }
+}
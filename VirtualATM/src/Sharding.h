@@ -0,0 +1,188 @@
+#ifndef SHARDING_H
+#define SHARDING_H
+
+#include "HashRing.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Account;
+class AccountStore;
+
+enum class ShardOp : uint8_t {
+    Inquiry = 1,
+    Withdraw = 2,
+    Deposit = 3,
+    Transfer = 4,  // both accounts on the same shard
+    Login = 5,     // PIN check; the PIN travels as an AccountKey
+    Export = 6,    // hand over the accounts in some hash ranges
+    Import = 7,    // take over exported accounts
+    Shutdown = 8
+};
+
+enum class ShardStatus : uint8_t {
+    Ok = 0,
+    Declined = 1, // insufficient funds, a limit or a wrong PIN
+    Unknown = 2,  // no such account
+    Moved = 3,    // the account has been handed to another shard
+    Failed = 4    // the shard is unreachable or rejected the request
+};
+
+// Why a shard declined a withdrawal
+enum class ShardDecline : uint8_t {
+    None = 0,       // not declined, or not a withdrawal
+    Funds = 1,      // insufficient funds
+    DailyLimit = 2, // over the account's daily withdrawal limit
+    Rule = 3        // refused by a velocity rule
+};
+
+// Wire records, little-endian as laid out
+struct ShardRequest {
+    uint8_t op;         // ShardOp
+    uint8_t reserved[3];
+    uint32_t terminal;
+    uint64_t accountKey;
+    int64_t cents;
+    uint64_t extra;     // Transfer: target key; Login: PIN key; Export/Import: payload bytes
+};
+
+struct ShardReply {
+    uint8_t status;     // ShardStatus
+    uint8_t decline;    // ShardDecline
+    uint16_t rule;      // ShardDecline::Rule: the velocity rule's id
+    uint32_t payloadBytes;
+    int64_t balanceCents; // Import: accounts taken over
+};
+
+static_assert(sizeof(ShardRequest) == 32, "ShardRequest is a fixed 32-byte record");
+static_assert(sizeof(ShardReply) == 16, "ShardReply is a fixed 16-byte record");
+
+// One backend process's share of the accounts, served over a Unix domain
+// socket with a thread per connection.
+//
+// Requests and replies are fixed 32- and 16-byte records; Export and Import
+// carry a payload after them. Postings run through the AccountStore as
+// usual under a shared migration lock; Export takes it exclusively while
+// it copies out and retires the accounts in the requested hash ranges,
+// which from then on answer Moved. Construct it once the store holds the
+// shard's accounts.
+class ShardServer {
+public:
+    explicit ShardServer(AccountStore& store);
+    ~ShardServer();
+
+    ShardServer(const ShardServer&) = delete;
+    ShardServer& operator=(const ShardServer&) = delete;
+
+    // Keep only the accounts `shard` owns in a ring of `shards` shards
+    static void filterOwned(AccountStore& store, uint32_t shard, uint32_t shards);
+
+    bool listen(const std::string& socketPath, std::string& error);
+
+    // Accept and serve connections until a Shutdown request
+    void serve();
+
+    // The accounts this shard still owns (call after serve returns)
+    bool saveOwned(const std::string& path);
+
+    size_t getOwnedCount() const;
+
+private:
+    AccountStore& store;
+    std::string socketPath;
+    int listenFd;
+    mutable std::shared_mutex migration;
+    std::vector<uint8_t> moved; // by store position
+    std::atomic<bool> running;
+    std::mutex connectionMutex;
+    std::vector<int> connections;
+
+    void handle(int connection);
+    Account* find(uint64_t accountKey);
+    ShardStatus apply(const ShardRequest& request, ShardReply& reply);
+    bool exportAccounts(int connection, uint64_t payloadBytes);
+    bool importAccounts(int connection, uint64_t payloadBytes);
+};
+
+// What a shard reported for a posting
+struct ShardOutcome {
+    int64_t balanceCents = 0; // the balance afterwards
+    ShardDecline decline = ShardDecline::None;
+    uint16_t rule = 0;
+};
+
+struct RebalanceStats {
+    uint64_t movedAccounts = 0;
+    double exportSeconds = 0.0; // longest time a shard held postings back
+    double totalSeconds = 0.0;
+};
+
+// Routes account operations to the shard owning each account.
+//
+// Thread-safe; every calling thread borrows a pooled connection to the
+// shard it needs. addShard rebalances online: the new shard's ranges are
+// exported from the running shards, imported, and the ring is switched;
+// requests that hit an account in flight (Moved) wait for the switch and
+// are retried against the new owner.
+class ShardRouter {
+public:
+    ShardRouter();
+    ~ShardRouter();
+
+    ShardRouter(const ShardRouter&) = delete;
+    ShardRouter& operator=(const ShardRouter&) = delete;
+
+    // Shard i listens on socketPaths[i]
+    bool connect(const std::vector<std::string>& socketPaths, std::string& error);
+
+    bool addShard(const std::string& socketPath, RebalanceStats& stats, std::string& error);
+
+    bool login(const std::string& accountNumber, const std::string& pin);
+
+    // Inquiry, Withdraw or Deposit
+    ShardStatus post(ShardOp op, const std::string& accountNumber, int64_t cents, ShardOutcome& outcome,
+                     uint32_t terminal = 0);
+
+    // Atomic on one shard. Across shards it is NOT atomic: a withdrawal on
+    // the source, then a deposit on the target, with a compensating deposit
+    // back to the source if the credit cannot be made. In between, and for
+    // good if the compensation fails too, the money is in neither account,
+    // and a concurrent reader can see the debit without the credit.
+    ShardStatus transfer(const std::string& from, const std::string& to, int64_t cents, uint32_t terminal = 0);
+
+    uint32_t shardOf(const std::string& accountNumber) const;
+    size_t getShardCount() const;
+
+    // Ask every shard to stop serving
+    void shutdownShards();
+
+private:
+    struct Backend {
+        std::string socketPath;
+        std::mutex poolMutex;
+        std::vector<int> idle;
+    };
+
+    mutable std::shared_mutex ringMutex;
+    HashRing ring;
+    uint64_t ringVersion;
+    std::vector<std::unique_ptr<Backend>> backends;
+    std::condition_variable_any ringChanged;
+    std::mutex rebalanceMutex;
+
+    Backend& route(uint64_t accountKey, uint64_t& version) const;
+    bool awaitRing(uint64_t version);
+    ShardStatus call(uint64_t accountKey, const ShardRequest& request, ShardReply& reply);
+    bool exchange(Backend& backend, const ShardRequest& request, ShardReply& reply, const std::string* payload = nullptr,
+                  std::string* replyPayload = nullptr);
+    int borrow(Backend& backend);
+    void giveBack(Backend& backend, int fd);
+};
+
+#endif // SHARDING_H
@@ -0,0 +1,147 @@
+#include "Snapshot.h"
+#include "AccountStore.h"
+
+SnapshotManager::SnapshotManager() : epoch(1), newestPinned(0), oldestPinned(0), liveVersions(0) {}
+
+// The epoch is read before the pins: a snapshot publishes its pin before
+// it starts the next epoch, so a posting that sees the new epoch also sees
+// the pin and keeps the old state
+uint64_t SnapshotManager::currentEpoch() const {
+    return epoch.load();
+}
+
+void SnapshotManager::beforeWrite(Account& account, uint64_t current) {
+    AccountSnapshot state = account.getState();
+    if (state.epoch == current) {
+        return; // the state before this epoch is already kept if needed
+    }
+    account.setWriteEpoch(current);
+    AccountVersion* head = account.getVersions();
+    uint64_t newest = newestPinned.load();
+    if (newest != 0 && newest >= state.epoch) {
+        head = new AccountVersion{state, head};
+        liveVersions.fetch_add(1, std::memory_order_relaxed);
+        account.setVersions(head);
+    }
+    if (!head) {
+        return;
+    }
+    // Every pinned snapshot stops at or before the first version the oldest
+    // one reads, so nothing past it can be in use
+    uint64_t oldest = oldestPinned.load();
+    if (oldest == 0) {
+        account.setVersions(nullptr);
+        freeChain(head);
+        return;
+    }
+    AccountVersion* keep = head;
+    while (keep && keep->values.epoch > oldest) {
+        keep = keep->older;
+    }
+    if (keep && keep->older) {
+        freeChain(keep->older);
+        keep->older = nullptr;
+    }
+}
+
+uint64_t SnapshotManager::pin() {
+    std::lock_guard<std::mutex> lock(pinMutex);
+    uint64_t pinnedEpoch = epoch.load();
+    pinned.insert(pinnedEpoch);
+    newestPinned.store(pinnedEpoch);
+    oldestPinned.store(*pinned.begin());
+    epoch.store(pinnedEpoch + 1);
+    return pinnedEpoch;
+}
+
+void SnapshotManager::unpin(uint64_t pinnedEpoch) {
+    std::lock_guard<std::mutex> lock(pinMutex);
+    auto it = pinned.find(pinnedEpoch);
+    if (it != pinned.end()) {
+        pinned.erase(it);
+    }
+    newestPinned.store(pinned.empty() ? 0 : *pinned.rbegin());
+    oldestPinned.store(pinned.empty() ? 0 : *pinned.begin());
+}
+
+AccountSnapshot SnapshotManager::read(const Account& account, uint64_t pinnedEpoch) {
+    AccountSnapshot live = account.snapshot();
+    if (live.epoch <= pinnedEpoch) {
+        return live;
+    }
+    for (const AccountVersion* version = account.getVersions(); version; version = version->older) {
+        if (version->values.epoch <= pinnedEpoch) {
+            return version->values;
+        }
+    }
+    return live; // not reached while the epoch is pinned
+}
+
+void SnapshotManager::release(Account& account) {
+    AccountVersion* chain = account.getVersions();
+    account.setVersions(nullptr);
+    freeChain(chain);
+}
+
+uint64_t SnapshotManager::getLiveVersions() const {
+    return liveVersions.load(std::memory_order_relaxed);
+}
+
+void SnapshotManager::freeChain(AccountVersion* version) {
+    uint64_t freed = 0;
+    while (version) {
+        AccountVersion* older = version->older;
+        delete version;
+        version = older;
+        ++freed;
+    }
+    liveVersions.fetch_sub(freed, std::memory_order_relaxed);
+}
+
+StoreSnapshot::StoreSnapshot(AccountStore& accountStore, SnapshotManager& snapshotManager, uint64_t pinnedEpoch)
+    : store(&accountStore), manager(&snapshotManager), epoch(pinnedEpoch) {}
+
+StoreSnapshot::StoreSnapshot(StoreSnapshot&& other) noexcept
+    : store(other.store), manager(other.manager), epoch(other.epoch) {
+    other.manager = nullptr;
+}
+
+StoreSnapshot& StoreSnapshot::operator=(StoreSnapshot&& other) noexcept {
+    if (this != &other) {
+        close();
+        store = other.store;
+        manager = other.manager;
+        epoch = other.epoch;
+        other.manager = nullptr;
+    }
+    return *this;
+}
+
+StoreSnapshot::~StoreSnapshot() {
+    close();
+}
+
+AccountSnapshot StoreSnapshot::read(size_t position) const {
+    return SnapshotManager::read(store->at(position), epoch);
+}
+
+Account StoreSnapshot::copy(size_t position) const {
+    Account account(store->at(position));
+    account.restore(read(position));
+    return account;
+}
+
+size_t StoreSnapshot::size() const {
+    return store->size();
+}
+
+uint64_t StoreSnapshot::getEpoch() const {
+    return epoch;
+}
+
+void StoreSnapshot::close() {
+    if (manager) {
+        manager->unpin(epoch);
+        manager = nullptr;
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "Account.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <vector>
+
+class AccountStore;
+
+// An account's state as the posting that wrote it in values.epoch left it
+struct AccountVersion {
+    AccountSnapshot values;
+    AccountVersion* older;
+};
+
+// Multi-version balances for point-in-time snapshots.
+//
+// Postings run in the current epoch and stamp each account they write
+// with it. Opening a snapshot pins the current epoch S and moves postings
+// on to S+1; the first posting to touch an account after that pushes the
+// account's old state onto a short per-account chain before writing, so a
+// snapshot reads the live fields when they are from epoch <= S and the
+// chain otherwise. Postings never wait for snapshots. Versions are
+// reclaimed by the postings themselves: a chain keeps nodes only down to
+// the first one the oldest pinned snapshot would read, and is dropped
+// entirely once nothing is pinned.
+class SnapshotManager {
+public:
+    SnapshotManager();
+
+    SnapshotManager(const SnapshotManager&) = delete;
+    SnapshotManager& operator=(const SnapshotManager&) = delete;
+
+    // The epoch a posting runs in; read once per posting, under its locks,
+    // so every account it changes lands in the same epoch
+    uint64_t currentEpoch() const;
+
+    // In a write section under the account's lock, before the posting
+    // changes anything
+    void beforeWrite(Account& account, uint64_t current);
+
+    // Pin the current epoch and start the next one; returns the pinned epoch
+    uint64_t pin();
+    void unpin(uint64_t epoch);
+
+    // The account as of the end of the given epoch
+    static AccountSnapshot read(const Account& account, uint64_t epoch);
+
+    // Free an account's chain (no snapshot may be reading it)
+    void release(Account& account);
+
+    // Versions allocated and not yet freed
+    uint64_t getLiveVersions() const;
+
+private:
+    std::atomic<uint64_t> epoch;
+    std::atomic<uint64_t> newestPinned; // 0: nothing pinned
+    std::atomic<uint64_t> oldestPinned;
+    std::atomic<uint64_t> liveVersions;
+    std::mutex pinMutex;
+    std::multiset<uint64_t> pinned;
+
+    void freeChain(AccountVersion* version);
+};
+
+// A consistent view of every account's balance and daily total as of one
+// moment, readable while postings continue. Opening costs one epoch bump
+// and a pass over the store's lock stripes (not its accounts); close it,
+// or let it go out of scope, promptly so versions can be reclaimed.
+class StoreSnapshot {
+public:
+    StoreSnapshot(StoreSnapshot&& other) noexcept;
+    StoreSnapshot& operator=(StoreSnapshot&& other) noexcept;
+    StoreSnapshot(const StoreSnapshot&) = delete;
+    StoreSnapshot& operator=(const StoreSnapshot&) = delete;
+    ~StoreSnapshot();
+
+    AccountSnapshot read(size_t position) const;
+
+    // Copy of the account with its balance and daily total as of the snapshot
+    Account copy(size_t position) const;
+
+    size_t size() const;
+    uint64_t getEpoch() const;
+
+    void close();
+
+private:
+    friend class AccountStore;
+
+    StoreSnapshot(AccountStore& store, SnapshotManager& manager, uint64_t epoch);
+
+    AccountStore* store;
+    SnapshotManager* manager;
+    uint64_t epoch;
+};
+
+#endif // SNAPSHOT_H
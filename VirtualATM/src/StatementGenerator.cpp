@@ -0,0 +1,300 @@
+#include "StatementGenerator.h"
+#include "FastText.h"
+#include "Ledger.h"
+#include "LedgerSorter.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+namespace {
+    const size_t OUTPUT_BUFFER_BYTES = 1 << 20;
+    const size_t LINE_WIDTH = 69;
+    const size_t MAX_LINE = 128;
+
+    double secondsSince(std::chrono::steady_clock::time_point started) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    }
+
+    const char* describe(uint8_t type) {
+        switch (static_cast<LedgerType>(type)) {
+            case LedgerType::Withdrawal: return "Withdrawal";
+            case LedgerType::Deposit: return "Deposit";
+            case LedgerType::TransferOut: return "Transfer out";
+            case LedgerType::TransferIn: return "Transfer in";
+            default: return "Other";
+        }
+    }
+
+    // Renders sorted records as statements into a buffered output file
+    class StatementWriter : public LedgerSink {
+    private:
+        const StatementConfig& config;
+        std::FILE* file;
+        std::vector<char> buffer;
+        size_t used;
+
+        uint64_t account;
+        bool active;
+        bool headerWritten;
+        int64_t balanceCents;
+        uint64_t debits, credits;
+        int64_t debitCents, creditCents;
+
+    public:
+        uint64_t statements;
+        uint64_t entries;
+        uint64_t bytes;
+        bool failed;
+
+        StatementWriter(const StatementConfig& config, std::FILE* file)
+            : config(config), file(file), buffer(OUTPUT_BUFFER_BYTES), used(0), account(0), active(false),
+              headerWritten(false), balanceCents(0), debits(0), credits(0), debitCents(0), creditCents(0),
+              statements(0), entries(0), bytes(0), failed(false) {}
+
+        void consume(const LedgerEntry& record) override {
+            if (!active || record.accountKey != account) {
+                finish();
+                begin(record.accountKey);
+            }
+            if (record.type == LedgerSorter::OPENING_RECORD) {
+                balanceCents += record.amountCents;
+                return;
+            }
+            int64_t delta = Ledger::balanceDelta(record);
+            if (delta == 0) {
+                return; // inquiries and failed postings are not statement lines
+            }
+            if (record.timestampUs < config.periodStartUs) {
+                balanceCents += delta;
+                return;
+            }
+            writeHeader();
+            balanceCents += delta;
+            if (delta < 0) {
+                debits++;
+                debitCents -= delta;
+            } else {
+                credits++;
+                creditCents += delta;
+            }
+            entries++;
+
+            char* out = reserve();
+            out = FastText::writeDateTime(out, record.timestampUs);
+            out = text(out, "  ");
+            const char* name = describe(record.type);
+            out = FastText::writeLeft(out, name, std::strlen(name), 18);
+            out = money(out, delta, 14);
+            out = money(out, balanceCents, 16);
+            *out++ = '\n';
+            commit(out);
+        }
+
+        // Close the current statement, if any
+        void finish() {
+            if (!active) {
+                return;
+            }
+            writeHeader();
+            char* out = reserve();
+            out = rule(out, '-');
+            out = FastText::writeLeft(out, "", 0, 21);
+            out = FastText::writeLeft(out, "Closing balance", 15, 32);
+            out = money(out, balanceCents, 16);
+            *out++ = '\n';
+            commit(out);
+
+            out = reserve();
+            out = text(out, "Debits: ");
+            out = FastText::writeUnsigned(out, debits);
+            out = text(out, " totalling ");
+            out = FastText::writeCents(out, debitCents);
+            out = text(out, "   Credits: ");
+            out = FastText::writeUnsigned(out, credits);
+            out = text(out, " totalling ");
+            out = FastText::writeCents(out, creditCents);
+            out = text(out, "\n\n");
+            commit(out);
+            statements++;
+            active = false;
+        }
+
+        bool flush() {
+            if (used > 0 && std::fwrite(buffer.data(), 1, used, file) != used) {
+                failed = true;
+            }
+            bytes += used;
+            used = 0;
+            return !failed;
+        }
+
+    private:
+        void begin(uint64_t accountKey) {
+            account = accountKey;
+            active = true;
+            headerWritten = false;
+            balanceCents = 0;
+            debits = credits = 0;
+            debitCents = creditCents = 0;
+        }
+
+        // Written before the first line of the period, once the balance
+        // brought forward is known
+        void writeHeader() {
+            if (headerWritten) {
+                return;
+            }
+            headerWritten = true;
+            char* out = reserve();
+            out = rule(out, '=');
+            out = text(out, "Statement ");
+            out = FastText::writeLeft(out, config.periodLabel.data(), config.periodLabel.size(), 41);
+            out = text(out, "Account ");
+            out = FastText::writeAccount(out, account);
+            out = text(out, "\nPeriod ");
+            out = FastText::writeDate(out, config.periodStartUs);
+            out = text(out, " to ");
+            out = FastText::writeDate(out, config.periodEndUs - 1);
+            *out++ = '\n';
+            commit(out);
+
+            out = reserve();
+            out = rule(out, '-');
+            out = FastText::writeLeft(out, "Date", 4, 21);
+            out = FastText::writeLeft(out, "Description", 11, 18);
+            out = FastText::writeRight(out, "Amount", 6, 14);
+            out = FastText::writeRight(out, "Balance", 7, 16);
+            *out++ = '\n';
+            out = FastText::writeLeft(out, "", 0, 21);
+            out = FastText::writeLeft(out, "Opening balance", 15, 32);
+            out = money(out, balanceCents, 16);
+            *out++ = '\n';
+            commit(out);
+        }
+
+        // Room for one more MAX_LINE * 2 bytes
+        char* reserve() {
+            if (buffer.size() - used < 2 * MAX_LINE) {
+                flush();
+            }
+            return buffer.data() + used;
+        }
+
+        void commit(char* end) {
+            used = static_cast<size_t>(end - buffer.data());
+        }
+
+        static char* text(char* out, const char* literal) {
+            size_t length = std::strlen(literal);
+            std::memcpy(out, literal, length);
+            return out + length;
+        }
+
+        static char* money(char* out, int64_t cents, size_t width) {
+            char field[FastText::MAX_FIELD];
+            char* end = FastText::writeCents(field, cents);
+            return FastText::writeRight(out, field, static_cast<size_t>(end - field), width);
+        }
+
+        static char* rule(char* out, char fill) {
+            std::memset(out, fill, LINE_WIDTH);
+            out[LINE_WIDTH] = '\n';
+            return out + LINE_WIDTH + 1;
+        }
+    };
+
+}
+
+StatementGenerator::StatementGenerator(const StatementConfig& config)
+    : config(config), threads(Parallel::resolveThreads(config.threads)) {
+    if (this->config.tempDir.empty()) {
+        this->config.tempDir = this->config.outputDir + "/tmp";
+    }
+}
+
+const StatementStats& StatementGenerator::getStats() const {
+    return stats;
+}
+
+unsigned StatementGenerator::getThreads() const {
+    return threads;
+}
+
+bool StatementGenerator::parseMonth(const std::string& text, int64_t& startUs, int64_t& endUs) {
+    int year = 0, month = 0;
+    char extra = 0;
+    if (std::sscanf(text.c_str(), "%d-%d%c", &year, &month, &extra) != 2 || month < 1 || month > 12) {
+        return false;
+    }
+    const int64_t DAY_US = 86400LL * 1000000LL;
+    startUs = FastText::daysFromCivil(year, static_cast<unsigned>(month), 1) * DAY_US;
+    endUs = (month == 12 ? FastText::daysFromCivil(year + 1, 1, 1)
+                         : FastText::daysFromCivil(year, static_cast<unsigned>(month + 1), 1)) * DAY_US;
+    return true;
+}
+
+std::string StatementGenerator::outputPath(size_t partition) const {
+    char suffix[16];
+    std::snprintf(suffix, sizeof(suffix), "-%04zu.txt", partition);
+    return config.outputDir + "/statements-" + config.periodLabel + suffix;
+}
+
+bool StatementGenerator::run() {
+    stats = StatementStats();
+    std::error_code error;
+    std::filesystem::create_directories(config.outputDir, error);
+
+    LedgerSortConfig sortConfig;
+    sortConfig.ledgerPath = config.ledgerPath;
+    sortConfig.openingPath = config.openingPath;
+    sortConfig.tempDir = config.tempDir;
+    sortConfig.beforeUs = config.periodEndUs;
+    sortConfig.memoryBudget = config.memoryBudget;
+    sortConfig.threads = threads;
+    LedgerSorter sorter(sortConfig);
+    size_t partitions = sorter.getPartitions();
+    stats.partitions = partitions;
+
+    auto started = std::chrono::steady_clock::now();
+    if (!sorter.scatter()) {
+        return false;
+    }
+    stats.scatterSeconds = secondsSince(started);
+
+    started = std::chrono::steady_clock::now();
+    std::vector<StatementStats> partials(partitions);
+    std::vector<char> rendered(partitions, 0);
+    Parallel::forEach(partitions, threads, [&](size_t partition, unsigned) {
+        rendered[partition] = render(sorter, partition, partials[partition]) ? 1 : 0;
+    });
+    for (const StatementStats& partial : partials) {
+        stats.statements += partial.statements;
+        stats.entries += partial.entries;
+        stats.bytesWritten += partial.bytesWritten;
+    }
+    stats.spilledRuns = sorter.getSpilledRuns();
+    stats.renderSeconds = secondsSince(started);
+    std::filesystem::remove_all(config.tempDir, error);
+    return std::all_of(rendered.begin(), rendered.end(), [](char ok) { return ok != 0; });
+}
+
+bool StatementGenerator::render(LedgerSorter& sorter, size_t partition, StatementStats& partial) {
+    std::FILE* output = std::fopen(outputPath(partition).c_str(), "wb");
+    if (!output) {
+        std::cerr << "Error: Could not open " << outputPath(partition) << std::endl;
+        return false;
+    }
+    StatementWriter writer(config, output);
+    bool sorted = sorter.sortPartition(partition, writer);
+    writer.finish();
+    writer.flush();
+    partial.statements = writer.statements;
+    partial.entries = writer.entries;
+    partial.bytesWritten = writer.bytes;
+    return std::fclose(output) == 0 && sorted && !writer.failed;
+}
@@ -0,0 +1,60 @@
+#ifndef STATEMENTGENERATOR_H
+#define STATEMENTGENERATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class LedgerSorter;
+
+// Periodic account statements from the binary ledger.
+//
+// The ledger (and the opening accounts file, if any) is sorted by account
+// and time with LedgerSorter, and each of its partitions is rendered into
+// its own output file. Memory stays within the configured budget no matter how
+// many accounts or entries there are, and both phases run on all threads.
+struct StatementConfig {
+    std::string ledgerPath;
+    std::string openingPath;   // balances at the start of the ledger; empty: all 0.00
+    std::string outputDir = "statements";
+    std::string tempDir;       // empty: <outputDir>/tmp
+    std::string periodLabel;   // e.g. "2025-10", used in headers and file names
+    int64_t periodStartUs = 0; // [start, end) in microseconds since the epoch
+    int64_t periodEndUs = 0;
+    size_t memoryBudget = size_t(256) << 20;
+    unsigned threads = 0;      // 0: hardware concurrency
+};
+
+struct StatementStats {
+    uint64_t statements = 0;
+    uint64_t entries = 0;       // posted entries printed on statements
+    uint64_t bytesWritten = 0;
+    size_t partitions = 0;
+    uint64_t spilledRuns = 0;   // sorted runs written by oversized partitions
+    double scatterSeconds = 0.0;
+    double renderSeconds = 0.0;
+};
+
+class StatementGenerator {
+public:
+    explicit StatementGenerator(const StatementConfig& config);
+
+    bool run();
+
+    const StatementStats& getStats() const;
+    unsigned getThreads() const;
+
+    // "YYYY-MM" to the month's [start, end) in UTC
+    static bool parseMonth(const std::string& text, int64_t& startUs, int64_t& endUs);
+
+private:
+    StatementConfig config;
+    unsigned threads;
+    StatementStats stats;
+
+    std::string outputPath(size_t partition) const;
+
+    bool render(LedgerSorter& sorter, size_t partition, StatementStats& partial);
+};
+
+#endif // STATEMENTGENERATOR_H
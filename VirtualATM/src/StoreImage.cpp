@@ -0,0 +1,386 @@
+#include "StoreImage.h"
+#include "FileManager.h"
+#include "MappedFile.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+const char StoreImage::MAGIC[8] = {'A', 'T', 'M', 'I', 'M', 'A', 'G', 'E'};
+const uint32_t StoreImage::VERSION;
+const size_t StoreImage::MAX_NUMBER;
+const size_t StoreImage::MAX_PIN;
+const size_t StoreImage::RECORD_BYTES;
+
+struct StoreImage::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordBytes;
+    uint64_t accounts;
+    uint64_t sourceBytes;   // size of the accounts file it was written with
+    int64_t sourceModified; // and its modification time
+    uint64_t indexOffset;
+    uint64_t indexCapacity;
+    uint64_t filterOffset;
+    uint64_t filterBlocks;
+    uint64_t filterKeys;
+    uint64_t checksum;      // of every byte after the header
+    uint64_t dirty;         // nonzero: records rewritten in place since the checksum
+    uint64_t reserved[4];
+};
+
+namespace {
+    struct Record {
+        char number[StoreImage::MAX_NUMBER];
+        char pin[StoreImage::MAX_PIN];
+        double balance;
+        int32_t usageDay;
+        uint8_t numberLength;
+        uint8_t pinLength;
+        uint16_t reserved;
+        int64_t withdrawnTodayCents;
+    };
+
+    static_assert(sizeof(Record) == StoreImage::RECORD_BYTES, "Record is a fixed 64-byte record");
+
+    const size_t CHUNK_RECORDS = 4096;
+
+    // Four independent multiply-xorshift lanes over 32-byte strides, so the
+    // multiplies overlap; every section is a multiple of 32 bytes
+    class Checksum {
+    public:
+        Checksum() : lanes{1, 2, 3, 4} {}
+
+        void update(const void* data, size_t bytes) {
+            const char* p = static_cast<const char*>(data);
+            for (size_t offset = 0; offset + 32 <= bytes; offset += 32) {
+                uint64_t words[4];
+                std::memcpy(words, p + offset, sizeof(words));
+                for (int i = 0; i < 4; ++i) {
+                    lanes[i] = (lanes[i] ^ words[i]) * 0x9e3779b97f4a7c15ULL;
+                    lanes[i] ^= lanes[i] >> 29;
+                }
+            }
+        }
+
+        uint64_t value() const {
+            uint64_t value = 0;
+            for (uint64_t lane : lanes) {
+                value = (value ^ lane) * 0xbf58476d1ce4e5b9ULL;
+                value ^= value >> 31;
+            }
+            return value;
+        }
+
+    private:
+        uint64_t lanes[4];
+    };
+
+    bool toRecord(const Account& account, Record& record) {
+        std::string number = account.getAccountNumber();
+        const std::string& pin = account.getPin();
+        if (number.size() > StoreImage::MAX_NUMBER || pin.size() > StoreImage::MAX_PIN) {
+            return false;
+        }
+        std::memset(&record, 0, sizeof(record));
+        std::memcpy(record.number, number.data(), number.size());
+        std::memcpy(record.pin, pin.data(), pin.size());
+        record.numberLength = static_cast<uint8_t>(number.size());
+        record.pinLength = static_cast<uint8_t>(pin.size());
+        AccountSnapshot state = account.getState();
+        record.balance = state.balance;
+        record.usageDay = state.usageDay;
+        record.withdrawnTodayCents = state.withdrawnTodayCents;
+        return true;
+    }
+}
+
+StoreImage::StoreImage() : header(nullptr) {}
+
+uint64_t StoreImage::recordOffset(size_t position) {
+    return sizeof(Header) + static_cast<uint64_t>(position) * sizeof(Record);
+}
+
+bool StoreImage::encodeRecord(const Account& account, void* record) {
+    return toRecord(account, *static_cast<Record*>(record));
+}
+
+Account StoreImage::decodeRecord(const void* data) {
+    Record record;
+    std::memcpy(&record, data, sizeof(record));
+    Account account(std::string(record.number, std::min<size_t>(record.numberLength, MAX_NUMBER)),
+                    std::string(record.pin, std::min<size_t>(record.pinLength, MAX_PIN)), record.balance);
+    AccountSnapshot state = {record.balance, record.usageDay, record.withdrawnTodayCents, 0};
+    account.restore(state);
+    return account;
+}
+
+StoreImage::~StoreImage() {
+    close();
+}
+
+std::string StoreImage::pathFor(const std::string& accountsPath) {
+    return accountsPath + ".image";
+}
+
+// Sections are streamed and checksummed as they go into <image>.tmp, the
+// header with the checksum last; the file is synced and renamed over the
+// image, so readers and a crash see the old image or the whole new one
+bool StoreImage::write(const std::string& accountsPath, const std::vector<Account>& accounts,
+                       const AccountIndex& index, const AccountFilter& filter) {
+    static_assert(sizeof(Header) == 128, "Header is a fixed 128-byte record");
+    ATM_TRACE_SPAN("StoreImage::write");
+    Header fileHeader = {};
+    std::memcpy(fileHeader.magic, MAGIC, sizeof(fileHeader.magic));
+    fileHeader.version = VERSION;
+    fileHeader.recordBytes = sizeof(Record);
+    fileHeader.accounts = accounts.size();
+    fileHeader.indexOffset = sizeof(Header) + accounts.size() * sizeof(Record);
+    fileHeader.indexCapacity = index.getCapacity();
+    fileHeader.filterOffset = fileHeader.indexOffset + index.getCapacity() * AccountIndex::BUCKET_BYTES;
+    fileHeader.filterBlocks = filter.getBlocks();
+    fileHeader.filterKeys = filter.getKeys();
+    if (!FileManager::stampOf(accountsPath, fileHeader.sourceBytes, fileHeader.sourceModified)) {
+        return false;
+    }
+
+    std::string path = pathFor(accountsPath);
+    std::string temporary = path + ".tmp";
+    std::FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    Checksum checksum;
+    Header empty = {};
+    bool ok = std::fwrite(&empty, sizeof(empty), 1, file) == 1;
+    std::vector<Record> chunk(CHUNK_RECORDS);
+    for (size_t first = 0; ok && first < accounts.size(); first += CHUNK_RECORDS) {
+        size_t count = std::min(CHUNK_RECORDS, accounts.size() - first);
+        for (size_t i = 0; ok && i < count; ++i) {
+            ok = toRecord(accounts[first + i], chunk[i]);
+        }
+        checksum.update(chunk.data(), count * sizeof(Record));
+        ok = ok && std::fwrite(chunk.data(), sizeof(Record), count, file) == count;
+    }
+    size_t indexBytes = index.getCapacity() * AccountIndex::BUCKET_BYTES;
+    checksum.update(index.getTable(), indexBytes);
+    ok = ok && std::fwrite(index.getTable(), 1, indexBytes, file) == indexBytes;
+    std::vector<uint64_t> words(filter.getBlocks() * 8);
+    filter.exportWords(words.data());
+    checksum.update(words.data(), words.size() * sizeof(uint64_t));
+    ok = ok && std::fwrite(words.data(), sizeof(uint64_t), words.size(), file) == words.size();
+    fileHeader.checksum = checksum.value();
+    ok = ok && std::fseek(file, 0, SEEK_SET) == 0 && std::fwrite(&fileHeader, sizeof(fileHeader), 1, file) == 1;
+    ok = ok && std::fflush(file) == 0;
+#ifndef _WIN32
+    ok = ok && ::fsync(fileno(file)) == 0;
+#endif
+    ok = std::fclose(file) == 0 && ok;
+    ok = ok && std::rename(temporary.c_str(), path.c_str()) == 0;
+    if (!ok) {
+        std::remove(temporary.c_str());
+    }
+    return ok;
+}
+
+bool StoreImage::reseal(const std::string& accountsPath) {
+    ATM_TRACE_SPAN("StoreImage::reseal");
+    Header fileHeader;
+    std::string path = pathFor(accountsPath);
+    std::FILE* file = std::fopen(path.c_str(), "r+b");
+    if (!file) {
+        return false;
+    }
+    bool ok = std::fread(&fileHeader, sizeof(fileHeader), 1, file) == 1 &&
+              std::memcmp(fileHeader.magic, MAGIC, sizeof(fileHeader.magic)) == 0 && fileHeader.version == VERSION &&
+              FileManager::stampOf(accountsPath, fileHeader.sourceBytes, fileHeader.sourceModified);
+    Checksum checksum;
+    std::vector<char> chunk(CHUNK_RECORDS * sizeof(Record));
+    while (ok) {
+        size_t read = std::fread(chunk.data(), 1, chunk.size(), file);
+        checksum.update(chunk.data(), read);
+        if (read < chunk.size()) {
+            ok = std::ferror(file) == 0;
+            break;
+        }
+    }
+    fileHeader.checksum = checksum.value();
+    fileHeader.dirty = 0;
+    ok = ok && std::fseek(file, 0, SEEK_SET) == 0 && std::fwrite(&fileHeader, sizeof(fileHeader), 1, file) == 1;
+    ok = ok && std::fflush(file) == 0;
+#ifndef _WIN32
+    ok = ok && ::fsync(fileno(file)) == 0;
+#endif
+    return std::fclose(file) == 0 && ok;
+}
+
+// Synced before the caller rewrites any record, so a crash afterwards
+// always finds the flag
+bool StoreImage::markDirty(const std::string& accountsPath) {
+    Header fileHeader;
+    std::FILE* file = std::fopen(pathFor(accountsPath).c_str(), "r+b");
+    if (!file) {
+        return false;
+    }
+    bool ok = std::fread(&fileHeader, sizeof(fileHeader), 1, file) == 1 &&
+              std::memcmp(fileHeader.magic, MAGIC, sizeof(fileHeader.magic)) == 0 && fileHeader.version == VERSION;
+    fileHeader.dirty = 1;
+    ok = ok && std::fseek(file, 0, SEEK_SET) == 0 && std::fwrite(&fileHeader, sizeof(fileHeader), 1, file) == 1;
+    ok = ok && std::fflush(file) == 0;
+#ifndef _WIN32
+    ok = ok && ::fsync(fileno(file)) == 0;
+#endif
+    return std::fclose(file) == 0 && ok;
+}
+
+// Records are streamed into <accounts file>.tmp, which is synced and
+// renamed over the accounts file
+bool StoreImage::exportText(const std::string& accountsPath) {
+    ATM_TRACE_SPAN("StoreImage::exportText");
+    Header fileHeader;
+    std::FILE* image = std::fopen(pathFor(accountsPath).c_str(), "rb");
+    if (!image) {
+        return false;
+    }
+    bool ok = std::fread(&fileHeader, sizeof(fileHeader), 1, image) == 1 &&
+              std::memcmp(fileHeader.magic, MAGIC, sizeof(fileHeader.magic)) == 0 && fileHeader.version == VERSION &&
+              fileHeader.recordBytes == sizeof(Record);
+    std::string temporary = accountsPath + ".tmp";
+    std::FILE* out = ok ? std::fopen(temporary.c_str(), "w") : nullptr;
+    ok = ok && out;
+    std::vector<Record> chunk(CHUNK_RECORDS);
+    char line[128];
+    for (uint64_t first = 0; ok && first < fileHeader.accounts; first += CHUNK_RECORDS) {
+        size_t count = static_cast<size_t>(std::min<uint64_t>(CHUNK_RECORDS, fileHeader.accounts - first));
+        ok = std::fread(chunk.data(), sizeof(Record), count, image) == count;
+        for (size_t i = 0; ok && i < count; ++i) {
+            size_t length = decodeRecord(&chunk[i]).formatTo(line, sizeof(line) - 1);
+            ok = length > 0;
+            line[length++] = '\n';
+            ok = ok && std::fwrite(line, 1, length, out) == length;
+        }
+    }
+    std::fclose(image);
+    if (out) {
+        ok = ok && std::fflush(out) == 0;
+#ifndef _WIN32
+        ok = ok && ::fsync(fileno(out)) == 0;
+#endif
+        ok = std::fclose(out) == 0 && ok;
+        ok = ok && std::rename(temporary.c_str(), accountsPath.c_str()) == 0;
+        if (!ok) {
+            std::remove(temporary.c_str());
+        }
+    }
+    return ok;
+}
+
+// An accounts file changed since the image was stamped was exported after
+// the write-backs (a checkpoint stopped before its reseal) and is kept
+bool StoreImage::recover(const std::string& accountsPath) {
+    Header fileHeader;
+    std::FILE* file = std::fopen(pathFor(accountsPath).c_str(), "rb");
+    if (!file) {
+        return true;
+    }
+    bool dirty = std::fread(&fileHeader, sizeof(fileHeader), 1, file) == 1 &&
+                 std::memcmp(fileHeader.magic, MAGIC, sizeof(fileHeader.magic)) == 0 &&
+                 fileHeader.version == VERSION && fileHeader.dirty != 0;
+    std::fclose(file);
+    uint64_t bytes;
+    int64_t modified;
+    if (!dirty || !FileManager::stampOf(accountsPath, bytes, modified) || bytes != fileHeader.sourceBytes ||
+        modified != fileHeader.sourceModified) {
+        return true;
+    }
+    std::cerr << "Recovering " << accountsPath << " from the accounts written back to " << pathFor(accountsPath)
+              << std::endl;
+    return exportText(accountsPath) && reseal(accountsPath);
+}
+
+bool StoreImage::open(const std::string& accountsPath) {
+    ATM_TRACE_SPAN("StoreImage::open");
+    close();
+    uint64_t bytes;
+    int64_t modified;
+    std::unique_ptr<MappedFile> mapped(new MappedFile());
+    if (!FileManager::stampOf(accountsPath, bytes, modified) || !mapped->open(pathFor(accountsPath)) ||
+        mapped->size() < sizeof(Header)) {
+        return false;
+    }
+    const Header* candidate = reinterpret_cast<const Header*>(mapped->data());
+    uint64_t filterBytes = candidate->filterBlocks * 8 * sizeof(uint64_t);
+    if (std::memcmp(candidate->magic, MAGIC, sizeof(candidate->magic)) != 0 || candidate->version != VERSION ||
+        candidate->recordBytes != sizeof(Record) || candidate->sourceBytes != bytes ||
+        candidate->sourceModified != modified ||
+        candidate->indexOffset != sizeof(Header) + candidate->accounts * sizeof(Record) ||
+        candidate->filterOffset != candidate->indexOffset + candidate->indexCapacity * AccountIndex::BUCKET_BYTES ||
+        candidate->filterOffset + filterBytes != mapped->size() || candidate->dirty != 0) {
+        return false;
+    }
+    Checksum checksum;
+    checksum.update(mapped->data() + sizeof(Header), mapped->size() - sizeof(Header));
+    if (checksum.value() != candidate->checksum) {
+        std::cerr << "Warning: " << pathFor(accountsPath) << " is corrupt; loading the text file" << std::endl;
+        return false;
+    }
+    file = std::move(mapped);
+    header = candidate;
+    return true;
+}
+
+void StoreImage::close() {
+    file.reset();
+    header = nullptr;
+}
+
+std::vector<Account> StoreImage::loadAccounts() const {
+    ATM_TRACE_SPAN("StoreImage::loadAccounts");
+    std::vector<Account> accounts;
+    if (!header) {
+        return accounts;
+    }
+    const Record* records = reinterpret_cast<const Record*>(file->data() + sizeof(Header));
+    accounts.reserve(header->accounts);
+    for (uint64_t i = 0; i < header->accounts; ++i) {
+        const Record& record = records[i];
+        accounts.emplace_back(std::string(record.number, record.numberLength),
+                              std::string(record.pin, record.pinLength), record.balance);
+        AccountSnapshot state = {record.balance, record.usageDay, record.withdrawnTodayCents, 0};
+        accounts.back().restore(state);
+    }
+    return accounts;
+}
+
+std::unique_ptr<AccountIndex> StoreImage::loadIndex() const {
+    if (!header) {
+        return nullptr;
+    }
+    return std::unique_ptr<AccountIndex>(
+        new AccountIndex(file->data() + header->indexOffset, static_cast<size_t>(header->indexCapacity)));
+}
+
+std::unique_ptr<AccountFilter> StoreImage::loadFilter() const {
+    if (!header) {
+        return nullptr;
+    }
+    return AccountFilter::importWords(reinterpret_cast<const uint64_t*>(file->data() + header->filterOffset),
+                                      static_cast<size_t>(header->filterBlocks), header->filterKeys);
+}
+
+uint64_t StoreImage::getAccounts() const {
+    return header ? header->accounts : 0;
+}
+
+const void* StoreImage::getIndexTable() const {
+    return header ? file->data() + header->indexOffset : nullptr;
+}
+
+size_t StoreImage::getIndexCapacity() const {
+    return header ? static_cast<size_t>(header->indexCapacity) : 0;
+}
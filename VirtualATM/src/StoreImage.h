@@ -0,0 +1,94 @@
+#ifndef STOREIMAGE_H
+#define STOREIMAGE_H
+
+#include "Account.h"
+#include "AccountFilter.h"
+#include "AccountIndex.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class MappedFile;
+
+// Binary warm-start image of an AccountStore, next to its accounts file.
+//
+// The image (<accounts file>.image) holds a versioned header, one fixed
+// 64-byte record per account, the AccountIndex table and the AccountFilter
+// words, located by file offsets only, so it can be mapped anywhere. The
+// header records the accounts file's size and modification time, as the
+// Bloom filter file does, and a checksum of everything after it. open()
+// maps the image and accepts it only if all of these match; the store then
+// copies the tables out instead of parsing the text file. A tiered store
+// flags the image dirty before rewriting records in place, and recover()
+// turns an image left dirty back into an accounts file.
+class StoreImage {
+public:
+    static const char MAGIC[8];
+    static const uint32_t VERSION = 1;
+
+    // Longest account number and PIN a record holds; stores with longer
+    // ones are not imaged
+    static const size_t MAX_NUMBER = 24;
+    static const size_t MAX_PIN = 16;
+
+    // Accounts are fixed-size records at fixed offsets, so a tiered store
+    // can read and write them one at a time
+    static const size_t RECORD_BYTES = 64;
+    static uint64_t recordOffset(size_t position);
+    static bool encodeRecord(const Account& account, void* record);
+    static Account decodeRecord(const void* record);
+
+    StoreImage();
+    ~StoreImage();
+
+    StoreImage(const StoreImage&) = delete;
+    StoreImage& operator=(const StoreImage&) = delete;
+
+    static std::string pathFor(const std::string& accountsPath);
+
+    // Write the image for accountsPath, which must already hold exactly
+    // these accounts
+    static bool write(const std::string& accountsPath, const std::vector<Account>& accounts,
+                      const AccountIndex& index, const AccountFilter& filter);
+
+    // Make an image whose records were rewritten in place current again:
+    // checksum it afresh, stamp it with the accounts file as it is now and
+    // clear the dirty flag
+    static bool reseal(const std::string& accountsPath);
+
+    // Flag the image as being rewritten in place (synced); open() rejects
+    // it until it is resealed
+    static bool markDirty(const std::string& accountsPath);
+
+    // Rewrite the accounts file from the image's records
+    static bool exportText(const std::string& accountsPath);
+
+    // If the image was left dirty over the accounts file it is stamped
+    // with, its records are the newer state: export and reseal them. False
+    // only if that was needed and failed.
+    static bool recover(const std::string& accountsPath);
+
+    // Map the image for accountsPath; false if it is missing, from another
+    // version, older than the accounts file, dirty or corrupt
+    bool open(const std::string& accountsPath);
+    void close();
+
+    std::vector<Account> loadAccounts() const;
+    std::unique_ptr<AccountIndex> loadIndex() const;
+    std::unique_ptr<AccountFilter> loadFilter() const;
+
+    uint64_t getAccounts() const;
+
+    // The mapped index table, for AccountIndex::findIn
+    const void* getIndexTable() const;
+    size_t getIndexCapacity() const;
+
+private:
+    struct Header;
+
+    std::unique_ptr<MappedFile> file;
+    const Header* header;
+};
+
+#endif // STOREIMAGE_H
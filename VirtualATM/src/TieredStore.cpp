@@ -0,0 +1,581 @@
+#include "TieredStore.h"
+#include "AccountIndex.h"
+#include "AccountKey.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+const size_t TieredStore::SHARDS;
+const size_t TieredStore::WRITEBACK_BATCH;
+const size_t TieredStore::MIN_SHARD_ACCOUNTS;
+
+namespace {
+    const uint32_t NO_ENTRY = UINT32_MAX;
+    const uint8_t MAX_FREQUENCY = 3;
+
+    // FIFO of entry numbers: pushed at the new end, popped at the old end
+    class EntryQueue {
+    public:
+        EntryQueue() : head(0), count(0) {}
+
+        void reset(size_t capacity) {
+            items.assign(capacity, 0);
+            head = 0;
+            count = 0;
+        }
+
+        bool empty() const { return count == 0; }
+        size_t size() const { return count; }
+
+        void push(uint32_t entry) {
+            items[(head + count) % items.size()] = entry;
+            count++;
+        }
+
+        uint32_t pop() {
+            uint32_t entry = items[head];
+            head = (head + 1) % items.size();
+            count--;
+            return entry;
+        }
+
+    private:
+        std::vector<uint32_t> items;
+        size_t head;
+        size_t count;
+    };
+
+    struct PendingRecord {
+        uint32_t slot;
+        uint32_t order; // queue position, so the newest copy sorts last
+        char record[StoreImage::RECORD_BYTES];
+    };
+
+    uint32_t mix32(uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7feb352dU;
+        x ^= x >> 15;
+        x *= 0x846ca68bU;
+        x ^= x >> 16;
+        return x;
+    }
+
+    size_t powerOfTwoAtLeast(size_t n) {
+        size_t power = 1;
+        while (power < n) {
+            power <<= 1;
+        }
+        return power;
+    }
+
+    int64_t steadyNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+// One shard's memory tier: entries, the S3-FIFO queues, a position-to-entry
+// map (linear probing, backward-shift deletion) and the ghost table, a
+// direct-mapped array of (position + 1) << 32 | insertion clock
+struct TieredStore::Shard {
+    struct Entry {
+        Account account;
+        uint32_t slot; // position in the image; NO_ENTRY while free
+        uint16_t pins;
+        uint8_t frequency;
+        bool dirty;
+
+        Entry() : account("", "", 0.0), slot(NO_ENTRY), pins(0), frequency(0), dirty(false) {}
+    };
+
+    std::mutex mutex;
+    size_t capacity;
+    size_t smallCapacity;
+    std::vector<Entry> entries;
+    std::vector<uint32_t> freeEntries;
+    EntryQueue small;
+    EntryQueue main;
+    std::vector<uint32_t> mapSlots;
+    std::vector<uint32_t> mapEntries;
+    size_t mapMask;
+    std::vector<uint64_t> ghost;
+    size_t ghostMask;
+    uint32_t ghostClock;
+    std::vector<PendingRecord> pending;
+    bool writebackFailed;
+    uint64_t hits;
+    uint64_t faults;
+    uint64_t evictions;
+    uint64_t writtenBack;
+    uint64_t writebackBatches;
+    uint64_t writebackRuns;
+    LatencyHistogram faultLatency;
+
+    explicit Shard(size_t accounts)
+        : capacity(accounts), smallCapacity(std::max<size_t>(1, accounts / 10)), entries(accounts),
+          mapSlots(powerOfTwoAtLeast(accounts * 2), 0), mapEntries(mapSlots.size(), 0), mapMask(mapSlots.size() - 1),
+          ghost(powerOfTwoAtLeast(accounts), 0), ghostMask(ghost.size() - 1), ghostClock(0), writebackFailed(false),
+          hits(0), faults(0), evictions(0), writtenBack(0), writebackBatches(0), writebackRuns(0) {
+        freeEntries.reserve(accounts);
+        for (size_t i = accounts; i-- > 0;) {
+            freeEntries.push_back(static_cast<uint32_t>(i));
+        }
+        small.reset(accounts);
+        main.reset(accounts);
+        pending.reserve(WRITEBACK_BATCH);
+    }
+
+    static size_t memoryFor(size_t accounts) {
+        return accounts * (sizeof(Entry) + 3 * sizeof(uint32_t)) +
+               powerOfTwoAtLeast(accounts * 2) * 2 * sizeof(uint32_t) + powerOfTwoAtLeast(accounts) * sizeof(uint64_t);
+    }
+
+    uint32_t find(uint32_t slot) const {
+        for (size_t i = mix32(slot) & mapMask; mapSlots[i] != 0; i = (i + 1) & mapMask) {
+            if (mapSlots[i] == slot + 1) {
+                return mapEntries[i];
+            }
+        }
+        return NO_ENTRY;
+    }
+
+    void insert(uint32_t slot, uint32_t entry) {
+        size_t i = mix32(slot) & mapMask;
+        while (mapSlots[i] != 0) {
+            i = (i + 1) & mapMask;
+        }
+        mapSlots[i] = slot + 1;
+        mapEntries[i] = entry;
+    }
+
+    // Later entries of the probe run move back into the hole unless their
+    // home bucket lies cyclically after it
+    void erase(uint32_t slot) {
+        size_t i = mix32(slot) & mapMask;
+        while (mapSlots[i] != slot + 1) {
+            i = (i + 1) & mapMask;
+        }
+        for (size_t j = (i + 1) & mapMask; mapSlots[j] != 0; j = (j + 1) & mapMask) {
+            size_t home = mix32(mapSlots[j] - 1) & mapMask;
+            if (((j - home) & mapMask) >= ((j - i) & mapMask)) {
+                mapSlots[i] = mapSlots[j];
+                mapEntries[i] = mapEntries[j];
+                i = j;
+            }
+        }
+        mapSlots[i] = 0;
+    }
+
+    // A ghost counts while fewer than a main queue's worth of accounts have
+    // been dropped since
+    bool inGhost(uint32_t slot) const {
+        uint64_t value = ghost[mix32(slot) & ghostMask];
+        return (value >> 32) == slot + 1 &&
+               static_cast<uint32_t>(ghostClock - static_cast<uint32_t>(value)) <= capacity - smallCapacity;
+    }
+
+    void addGhost(uint32_t slot) {
+        ghost[mix32(slot) & ghostMask] = static_cast<uint64_t>(slot + 1) << 32 | ghostClock++;
+    }
+};
+
+double TieredStore::Stats::hitRate() const {
+    return hits + faults ? static_cast<double>(hits) / static_cast<double>(hits + faults) : 0.0;
+}
+
+TieredStore::TieredStore() : fd(-1), accounts(0), capacity(0), imageDirty(false) {}
+
+TieredStore::~TieredStore() {
+    close();
+}
+
+size_t TieredStore::bytesPerAccount() {
+    return Shard::memoryFor(1024) / 1024;
+}
+
+// The budget is split evenly over the shards, then trimmed until the
+// power-of-two tables fit as well
+bool TieredStore::open(const std::string& accountsPath, size_t budgetBytes, std::string& error) {
+    ATM_TRACE_SPAN("TieredStore::open");
+    close();
+#ifndef _WIN32
+    if (!StoreImage::recover(accountsPath)) {
+        error = "could not recover " + accountsPath + " from its image";
+        return false;
+    }
+    if (!image.open(accountsPath)) {
+        error = "no current image for " + accountsPath + "; run atm_image write first";
+        return false;
+    }
+    fd = ::open(StoreImage::pathFor(accountsPath).c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        error = "could not open " + StoreImage::pathFor(accountsPath) + " for writing";
+        image.close();
+        return false;
+    }
+    dataFilePath = accountsPath;
+    accounts = static_cast<size_t>(image.getAccounts());
+    size_t perShard = std::max(MIN_SHARD_ACCOUNTS, budgetBytes / bytesPerAccount() / SHARDS);
+    while (perShard > MIN_SHARD_ACCOUNTS && Shard::memoryFor(perShard) * SHARDS > budgetBytes) {
+        perShard -= std::max<size_t>(1, perShard / 16);
+    }
+    perShard = std::max(MIN_SHARD_ACCOUNTS, std::min(perShard, accounts / SHARDS * 2 + MIN_SHARD_ACCOUNTS));
+    for (size_t i = 0; i < SHARDS; ++i) {
+        shards.emplace_back(new Shard(perShard));
+    }
+    capacity = perShard * SHARDS;
+    return true;
+#else
+    (void)accountsPath;
+    (void)budgetBytes;
+    error = "the tiered store needs a POSIX system";
+    return false;
+#endif
+}
+
+void TieredStore::close() {
+    shards.clear();
+    image.close();
+#ifndef _WIN32
+    if (fd >= 0) {
+        ::close(fd);
+    }
+#endif
+    fd = -1;
+    accounts = 0;
+    capacity = 0;
+    imageDirty = false;
+}
+
+// Contiguous ranges, so that neighbouring records are written back by the
+// same shard and can share a pwrite
+size_t TieredStore::shardOf(size_t position) const {
+    return accounts > 0 ? position * SHARDS / accounts : 0;
+}
+
+TieredStore::Handle TieredStore::acquire(const std::string& accountNumber) {
+    uint64_t key = AccountKey::encode(accountNumber);
+    if (key == 0 || fd < 0) {
+        return Handle();
+    }
+    uint32_t slot = AccountIndex::findIn(image.getIndexTable(), image.getIndexCapacity(), key);
+    return slot == AccountIndex::NOT_FOUND ? Handle() : acquireAt(slot);
+}
+
+TieredStore::Handle TieredStore::acquireAt(size_t position) {
+    Handle handle;
+    if (fd < 0 || position >= accounts) {
+        return handle;
+    }
+    uint32_t shardIndex = static_cast<uint32_t>(shardOf(position));
+    Shard& shard = *shards[shardIndex];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    uint32_t entry;
+    if (lookup(shard, static_cast<uint32_t>(position), entry)) {
+        shard.entries[entry].pins++;
+        handle.account = &shard.entries[entry].account;
+        handle.shard = shardIndex;
+        handle.entry = entry;
+    }
+    return handle;
+}
+
+void TieredStore::release(Handle& handle) {
+    if (handle) {
+        Shard& shard = *shards[handle.shard];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.entries[handle.entry].pins--;
+    }
+    handle = Handle();
+}
+
+bool TieredStore::apply(Transaction& transaction, Handle& handle) {
+    Shard& shard = *shards[handle.shard];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    bool succeeded = transaction.process(*handle.account);
+    if (transaction.getKind() != TransactionKind::BalanceInquiry) {
+        shard.entries[handle.entry].dirty = true;
+    }
+    return succeeded;
+}
+
+// The record goes to the image now, and any queued copy of it is brought
+// up to date so that a later flush cannot write the older state over it
+bool TieredStore::persist(Handle& handle) {
+    Shard& shard = *shards[handle.shard];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Shard::Entry& cached = shard.entries[handle.entry];
+    char record[StoreImage::RECORD_BYTES];
+    if (!StoreImage::encodeRecord(cached.account, record) || !markDirty()) {
+        return false;
+    }
+    for (PendingRecord& queued : shard.pending) {
+        if (queued.slot == cached.slot) {
+            std::memcpy(queued.record, record, sizeof(record));
+        }
+    }
+#ifndef _WIN32
+    if (::pwrite(fd, record, sizeof(record), static_cast<off_t>(StoreImage::recordOffset(cached.slot))) !=
+        static_cast<ssize_t>(sizeof(record))) {
+        return false;
+    }
+#endif
+    cached.dirty = false;
+    return true;
+}
+
+// Once per seal, before the first record is rewritten in place
+bool TieredStore::markDirty() {
+    std::lock_guard<std::mutex> lock(dirtyMutex);
+    if (!imageDirty) {
+        imageDirty = StoreImage::markDirty(dataFilePath);
+    }
+    return imageDirty;
+}
+
+// Lock both shards in a fixed order so opposite transfers cannot deadlock
+bool TieredStore::transfer(Transfer& transfer, Handle& from, Handle& to) {
+    Shard& first = *shards[std::min(from.shard, to.shard)];
+    Shard& second = *shards[std::max(from.shard, to.shard)];
+    std::unique_lock<std::mutex> firstLock(first.mutex);
+    std::unique_lock<std::mutex> secondLock;
+    if (&second != &first) {
+        secondLock = std::unique_lock<std::mutex>(second.mutex);
+    }
+    bool succeeded = transfer.process(*from.account);
+    shards[from.shard]->entries[from.entry].dirty = true;
+    shards[to.shard]->entries[to.entry].dirty = true;
+    return succeeded;
+}
+
+// Called with the shard locked
+bool TieredStore::lookup(Shard& shard, uint32_t slot, uint32_t& entry) {
+    entry = shard.find(slot);
+    if (entry == NO_ENTRY) {
+        return fault(shard, slot, entry);
+    }
+    Shard::Entry& cached = shard.entries[entry];
+    cached.frequency = static_cast<uint8_t>(std::min<int>(cached.frequency + 1, MAX_FREQUENCY));
+    shard.hits++;
+    return true;
+}
+
+// A queued write-back of the account is newer than its record on disk
+bool TieredStore::fault(Shard& shard, uint32_t slot, uint32_t& entry) {
+    int64_t started = steadyNs();
+    if (shard.freeEntries.empty() && !evict(shard)) {
+        return false;
+    }
+    char record[StoreImage::RECORD_BYTES];
+    const char* source = nullptr;
+    for (size_t i = shard.pending.size(); i-- > 0;) {
+        if (shard.pending[i].slot == slot) {
+            source = shard.pending[i].record;
+            break;
+        }
+    }
+#ifndef _WIN32
+    if (!source) {
+        if (::pread(fd, record, sizeof(record), static_cast<off_t>(StoreImage::recordOffset(slot))) !=
+            static_cast<ssize_t>(sizeof(record))) {
+            return false;
+        }
+        source = record;
+    }
+#endif
+    if (!source) {
+        return false;
+    }
+    entry = shard.freeEntries.back();
+    shard.freeEntries.pop_back();
+    Shard::Entry& cached = shard.entries[entry];
+    cached.account = StoreImage::decodeRecord(source);
+    cached.slot = slot;
+    cached.pins = 0;
+    cached.frequency = 0;
+    cached.dirty = false;
+    shard.insert(slot, entry);
+    if (shard.inGhost(slot)) {
+        shard.main.push(entry);
+    } else {
+        shard.small.push(entry);
+    }
+    shard.faults++;
+    shard.faultLatency.record(static_cast<uint64_t>(steadyNs() - started));
+    return true;
+}
+
+// S3-FIFO: take from the small queue while it holds its share (or the main
+// queue is empty), else from the main queue. Touched small entries move to
+// the main queue; touched main entries go round again, one touch less.
+// Pinned entries are passed over; false if every entry is pinned.
+bool TieredStore::evict(Shard& shard) {
+    for (size_t attempts = 0; attempts < 2 * MAX_FREQUENCY * shard.capacity + 2; ++attempts) {
+        if (!shard.small.empty() && (shard.small.size() >= shard.smallCapacity || shard.main.empty())) {
+            uint32_t entry = shard.small.pop();
+            Shard::Entry& candidate = shard.entries[entry];
+            if (candidate.pins > 0 || candidate.frequency > 0) {
+                candidate.frequency = 0;
+                shard.main.push(entry);
+                continue;
+            }
+            shard.addGhost(candidate.slot);
+            drop(shard, entry);
+            return true;
+        }
+        if (shard.main.empty()) {
+            return false;
+        }
+        uint32_t entry = shard.main.pop();
+        Shard::Entry& candidate = shard.entries[entry];
+        if (candidate.pins > 0 || candidate.frequency > 0) {
+            if (candidate.pins == 0) {
+                candidate.frequency--;
+            }
+            shard.main.push(entry);
+            continue;
+        }
+        drop(shard, entry);
+        return true;
+    }
+    return false;
+}
+
+void TieredStore::drop(Shard& shard, uint32_t entry) {
+    Shard::Entry& victim = shard.entries[entry];
+    shard.erase(victim.slot);
+    if (victim.dirty) {
+        queueWriteback(shard, victim.account, victim.slot);
+    }
+    victim.slot = NO_ENTRY;
+    victim.dirty = false;
+    shard.freeEntries.push_back(entry);
+    shard.evictions++;
+}
+
+void TieredStore::queueWriteback(Shard& shard, const Account& account, uint32_t slot) {
+    PendingRecord queued;
+    queued.slot = slot;
+    queued.order = static_cast<uint32_t>(shard.pending.size());
+    if (!StoreImage::encodeRecord(account, queued.record)) {
+        shard.writebackFailed = true;
+        return;
+    }
+    shard.pending.push_back(queued);
+    if (shard.pending.size() >= WRITEBACK_BATCH) {
+        flushWriteback(shard);
+    }
+}
+
+// Sorted by position, the newest copy of an account last; runs of
+// neighbouring records go out in one pwrite each
+bool TieredStore::flushWriteback(Shard& shard) {
+    if (shard.pending.empty()) {
+        return !shard.writebackFailed;
+    }
+    if (!markDirty()) {
+        shard.writebackFailed = true;
+    }
+    std::sort(shard.pending.begin(), shard.pending.end(), [](const PendingRecord& a, const PendingRecord& b) {
+        return a.slot != b.slot ? a.slot < b.slot : a.order < b.order;
+    });
+    char run[WRITEBACK_BATCH * StoreImage::RECORD_BYTES];
+    size_t written = 0;
+    for (size_t i = 0; i < shard.pending.size();) {
+        uint32_t first = shard.pending[i].slot;
+        size_t length = 0;
+        for (; i < shard.pending.size() && shard.pending[i].slot <= first + length; ++i) {
+            if (i + 1 < shard.pending.size() && shard.pending[i + 1].slot == shard.pending[i].slot) {
+                continue; // a newer copy follows
+            }
+            std::memcpy(run + length * StoreImage::RECORD_BYTES, shard.pending[i].record, StoreImage::RECORD_BYTES);
+            length++;
+        }
+#ifndef _WIN32
+        size_t bytes = length * StoreImage::RECORD_BYTES;
+        if (::pwrite(fd, run, bytes, static_cast<off_t>(StoreImage::recordOffset(first))) !=
+            static_cast<ssize_t>(bytes)) {
+            shard.writebackFailed = true;
+        }
+#endif
+        written += length;
+        shard.writebackRuns++;
+    }
+    if (shard.writebackFailed) {
+        std::cerr << "Error: Could not write accounts back to " << StoreImage::pathFor(dataFilePath) << std::endl;
+    }
+    shard.writtenBack += written;
+    shard.writebackBatches++;
+    shard.pending.clear();
+    return !shard.writebackFailed;
+}
+
+bool TieredStore::checkpoint() {
+    ATM_TRACE_SPAN("TieredStore::checkpoint");
+    if (fd < 0) {
+        return false;
+    }
+    std::vector<std::unique_lock<std::mutex>> locks;
+    for (auto& shard : shards) {
+        locks.emplace_back(shard->mutex);
+    }
+    bool ok = true;
+    for (auto& shard : shards) {
+        for (Shard::Entry& cached : shard->entries) {
+            if (cached.slot != NO_ENTRY && cached.dirty) {
+                queueWriteback(*shard, cached.account, cached.slot);
+                cached.dirty = false;
+            }
+        }
+        ok = flushWriteback(*shard) && ok;
+    }
+#ifndef _WIN32
+    ok = ok && ::fdatasync(fd) == 0;
+#endif
+    ok = ok && StoreImage::exportText(dataFilePath) && StoreImage::reseal(dataFilePath);
+    if (ok) {
+        std::lock_guard<std::mutex> lock(dirtyMutex);
+        imageDirty = false;
+    }
+    return ok;
+}
+
+// The accounts file, rebuilt from the image's records in position order,
+// written beside it and renamed into place
+
+size_t TieredStore::size() const {
+    return accounts;
+}
+
+size_t TieredStore::getCapacity() const {
+    return capacity;
+}
+
+size_t TieredStore::getMemoryBytes() const {
+    return shards.empty() ? 0 : Shard::memoryFor(capacity / SHARDS) * SHARDS;
+}
+
+TieredStore::Stats TieredStore::getStats() const {
+    Stats stats;
+    for (const auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        stats.hits += shard->hits;
+        stats.faults += shard->faults;
+        stats.evictions += shard->evictions;
+        stats.writtenBack += shard->writtenBack;
+        stats.writebackBatches += shard->writebackBatches;
+        stats.writebackRuns += shard->writebackRuns;
+        stats.cached += shard->capacity - shard->freeEntries.size();
+        stats.faultLatency.merge(shard->faultLatency);
+    }
+    return stats;
+}
@@ -0,0 +1,134 @@
+#ifndef TIEREDSTORE_H
+#define TIEREDSTORE_H
+
+#include "Account.h"
+#include "LatencyHistogram.h"
+#include "StoreImage.h"
+#include "Transaction.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Account table with a bounded in-memory tier over the on-disk image.
+//
+// The cold tier is the accounts file's warm-start image (StoreImage):
+// every account is a fixed 64-byte record, found through the image's
+// index probed in place in the mapping. Only as many accounts as the
+// memory budget holds are kept in memory, spread over SHARDS shards by
+// contiguous ranges of positions, each with its own lock and an S3-FIFO
+// cache. A faulted-in
+// account (read with pread) enters a small FIFO of a tenth of the shard
+// and moves to the main FIFO only if it is touched again before it
+// reaches the end, so a scan over dormant accounts passes through the
+// small queue without flushing the hot ones. Main entries get one more
+// round per touch (up to 3), and accounts dropped from the small queue are
+// remembered in a ghost table, so one that comes back soon goes straight
+// to the main queue. Evicted accounts with postings are queued and written
+// back in batches of WRITEBACK_BATCH, sorted by position, one pwrite per
+// run of neighbouring records; a fault on a queued account reads the
+// queued copy.
+//
+// Records are rewritten in place, so the image is flagged dirty (synced)
+// before the first write-back and its checksum no longer matches until
+// checkpoint() writes everything back, rewrites the accounts file from the
+// image and reseals the image for it. open() first recovers an image a
+// crash left dirty (StoreImage::recover), so write-backs and persisted
+// postings survive it. Only digit account
+// numbers (AccountKey) can be looked up, and postings run without the
+// AccountStore extras: velocity rules, daily limits, journal, replication
+// and snapshots.
+class TieredStore {
+public:
+    static const size_t SHARDS = 16;
+    static const size_t WRITEBACK_BATCH = 256;
+
+    // Fewest accounts a shard holds, whatever the budget
+    static const size_t MIN_SHARD_ACCOUNTS = 8;
+
+    // A cached account, pinned (never evicted) until released
+    struct Handle {
+        Account* account = nullptr;
+        uint32_t shard = 0;
+        uint32_t entry = 0;
+
+        explicit operator bool() const { return account != nullptr; }
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t faults = 0;
+        uint64_t evictions = 0;
+        uint64_t writtenBack = 0; // records
+        uint64_t writebackBatches = 0;
+        uint64_t writebackRuns = 0; // pwrites
+        size_t cached = 0;
+        LatencyHistogram faultLatency; // ns from the miss to the account being cached
+
+        double hitRate() const;
+    };
+
+    TieredStore();
+    ~TieredStore();
+
+    TieredStore(const TieredStore&) = delete;
+    TieredStore& operator=(const TieredStore&) = delete;
+
+    // Open over the current image of accountsPath (see atm_image), keeping
+    // as many accounts in memory as budgetBytes holds; false with a message
+    bool open(const std::string& accountsPath, size_t budgetBytes, std::string& error);
+
+    // Write every changed account back, rewrite the accounts file from the
+    // image and reseal the image; holds every shard while it runs
+    bool checkpoint();
+
+    // Drop the memory tier without writing anything (checkpoint first)
+    void close();
+
+    // Pin an account, faulting it in if it is cold; an empty handle if it
+    // does not exist (or every account in its shard is pinned)
+    Handle acquire(const std::string& accountNumber);
+    Handle acquireAt(size_t position);
+    void release(Handle& handle);
+
+    // Post to pinned accounts under their shards' locks
+    bool apply(Transaction& transaction, Handle& handle);
+    bool transfer(Transfer& transfer, Handle& from, Handle& to);
+
+    // Write a pinned account's record to the image now rather than on
+    // eviction, as a session does after each posting
+    bool persist(Handle& handle);
+
+    size_t size() const;
+    size_t getCapacity() const;
+
+    // Memory the tier takes for its capacity, and per cached account
+    size_t getMemoryBytes() const;
+    static size_t bytesPerAccount();
+
+    Stats getStats() const;
+
+private:
+    struct Shard;
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    StoreImage image;
+    std::string dataFilePath;
+    int fd;
+    size_t accounts;
+    size_t capacity;
+    std::mutex dirtyMutex;
+    bool imageDirty; // flagged in the image since the last seal
+
+    size_t shardOf(size_t position) const;
+    bool lookup(Shard& shard, uint32_t slot, uint32_t& entry);
+    bool fault(Shard& shard, uint32_t slot, uint32_t& entry);
+    bool evict(Shard& shard);
+    void drop(Shard& shard, uint32_t entry);
+    void queueWriteback(Shard& shard, const Account& account, uint32_t slot);
+    bool flushWriteback(Shard& shard);
+    bool markDirty();
+};
+
+#endif // TIEREDSTORE_H
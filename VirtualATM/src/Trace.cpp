@@ -0,0 +1,175 @@
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define ATM_TRACE_HAS_TSC 1
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define ATM_TRACE_HAS_TSC 1
+#endif
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+std::atomic<bool> Tracer::enabledFlag(false);
+const size_t Tracer::RING_CAPACITY;
+
+namespace {
+    struct TraceEvent {
+        const char* name;
+        uint64_t start;
+        uint64_t end;
+    };
+
+    // One writer (the owning thread); head counts every span ever written
+    struct ThreadRing {
+        uint32_t threadId;
+        std::atomic<uint64_t> head;
+        TraceEvent events[Tracer::RING_CAPACITY];
+
+        explicit ThreadRing(uint32_t id) : threadId(id), head(0) {}
+    };
+
+    std::mutex ringsMutex;
+    std::vector<ThreadRing*> rings; // never freed: spans outlive their threads
+
+    thread_local ThreadRing* threadRing = nullptr;
+
+    // Clock pair taken when tracing was first enabled, for TSC calibration
+    std::atomic<uint64_t> calibrationTicks(0);
+    std::atomic<int64_t> calibrationNs(0);
+
+    int64_t steadyNanoseconds() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    ThreadRing* attachRing() {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        rings.push_back(new ThreadRing(static_cast<uint32_t>(rings.size() + 1)));
+        return rings.back();
+    }
+
+    double ticksPerNanosecond() {
+#ifdef ATM_TRACE_HAS_TSC
+        int64_t elapsedNs = steadyNanoseconds() - calibrationNs.load();
+        if (elapsedNs < 10000000) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(10000000 - elapsedNs));
+        }
+        uint64_t ticks = Tracer::now() - calibrationTicks.load();
+        elapsedNs = steadyNanoseconds() - calibrationNs.load();
+        return elapsedNs > 0 ? static_cast<double>(ticks) / static_cast<double>(elapsedNs) : 1.0;
+#else
+        return 1.0;
+#endif
+    }
+}
+
+void Tracer::setEnabled(bool enabled) {
+    if (enabled && calibrationTicks.load() == 0) {
+        calibrationNs.store(steadyNanoseconds());
+        calibrationTicks.store(now());
+    }
+    enabledFlag.store(enabled, std::memory_order_relaxed);
+}
+
+uint64_t Tracer::now() {
+#ifdef ATM_TRACE_HAS_TSC
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(steadyNanoseconds());
+#endif
+}
+
+void Tracer::record(const char* name, uint64_t start, uint64_t end) {
+    ThreadRing* ring = threadRing;
+    if (!ring) {
+        ring = threadRing = attachRing();
+    }
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    ring->events[head % RING_CAPACITY] = TraceEvent{name, start, end};
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void Tracer::clear() {
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    for (ThreadRing* ring : rings) {
+        ring->head.store(0, std::memory_order_release);
+    }
+}
+
+bool Tracer::dump(const std::string& path) {
+    struct Span {
+        uint32_t threadId;
+        TraceEvent event;
+    };
+
+    std::vector<Span> spans;
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        for (const ThreadRing* ring : rings) {
+            uint64_t head = ring->head.load(std::memory_order_acquire);
+            uint64_t count = std::min<uint64_t>(head, RING_CAPACITY);
+            for (uint64_t i = head - count; i < head; ++i) {
+                spans.push_back(Span{ring->threadId, ring->events[i % RING_CAPACITY]});
+            }
+        }
+    }
+
+    std::FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+
+    double rate = ticksPerNanosecond();
+    uint64_t origin = UINT64_MAX;
+    for (const auto& span : spans) {
+        origin = std::min(origin, span.event.start);
+    }
+
+    std::fprintf(file, "{\"traceEvents\": [\n");
+    for (size_t i = 0; i < spans.size(); ++i) {
+        const TraceEvent& event = spans[i].event;
+        double startUs = static_cast<double>(event.start - origin) / rate / 1000.0;
+        double durationUs = static_cast<double>(event.end - event.start) / rate / 1000.0;
+        std::fprintf(file,
+                     "  {\"name\": \"%s\", \"cat\": \"atm\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, "
+                     "\"pid\": 1, \"tid\": %u}%s\n",
+                     event.name, startUs, durationUs, spans[i].threadId, i + 1 < spans.size() ? "," : "");
+    }
+    std::fprintf(file, "], \"displayTimeUnit\": \"ns\"}\n");
+    return std::fclose(file) == 0;
+}
+
+bool Tracer::dumpOnSignal(const std::string& path) {
+#ifndef _WIN32
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    if (pthread_sigmask(SIG_BLOCK, &signals, nullptr) != 0) {
+        return false;
+    }
+    // A dedicated thread takes the signal, so dumping is not limited to
+    // async-signal-safe calls
+    std::thread([signals, path]() {
+        while (true) {
+            int received = 0;
+            if (sigwait(&signals, &received) == 0 && received == SIGUSR1) {
+                dump(path);
+            }
+        }
+    }).detach();
+    return true;
+#else
+    (void)path;
+    return false;
+#endif
+}
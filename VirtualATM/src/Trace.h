@@ -0,0 +1,69 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Lightweight tracing spans, dumped as Chrome trace-event JSON.
+//
+// Each thread records completed spans (name, start, end in TSC ticks) into
+// its own ring buffer; the newest RING_CAPACITY spans per thread are kept.
+// Span names must be string literals. When tracing is off at runtime a span
+// costs one relaxed load; building without ATM_ENABLE_TRACING removes the
+// ATM_TRACE_SPAN macro entirely.
+class Tracer {
+public:
+    static const size_t RING_CAPACITY = 16384;
+
+    static void setEnabled(bool enabled);
+    static bool isEnabled() { return enabledFlag.load(std::memory_order_relaxed); }
+
+    // Timestamp in TSC ticks (steady clock nanoseconds where no TSC exists)
+    static uint64_t now();
+
+    static void record(const char* name, uint64_t start, uint64_t end);
+
+    // Write every buffered span as {"traceEvents": [...]}; safe while other
+    // threads keep tracing (spans overwritten during the dump may be torn)
+    static bool dump(const std::string& path);
+
+    // Dump to path whenever the process receives SIGUSR1 (POSIX only). Call
+    // before starting other threads so they inherit the blocked signal.
+    static bool dumpOnSignal(const std::string& path);
+
+    static void clear();
+
+private:
+    static std::atomic<bool> enabledFlag;
+};
+
+// Records the lifetime of a scope as one span
+class TraceSpan {
+private:
+    const char* name;
+    uint64_t start;
+
+public:
+    explicit TraceSpan(const char* name) : name(name), start(Tracer::isEnabled() ? Tracer::now() : 0) {}
+
+    ~TraceSpan() {
+        if (start) {
+            Tracer::record(name, start, Tracer::now());
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+};
+
+#define ATM_TRACE_CONCAT_(a, b) a##b
+#define ATM_TRACE_CONCAT(a, b) ATM_TRACE_CONCAT_(a, b)
+
+#ifdef ATM_ENABLE_TRACING
+#define ATM_TRACE_SPAN(name) TraceSpan ATM_TRACE_CONCAT(traceSpan_, __LINE__)(name)
+#else
+#define ATM_TRACE_SPAN(name) ((void)0)
+#endif
+
+#endif // TRACE_H
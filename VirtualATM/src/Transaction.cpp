@@ -1,43 +1,49 @@
 
 // Display result for BalanceInquiry
 #include "Transaction.h"
-#include <chrono>
+#include "Trace.h"
+#include <cstdio>
 #include <iomanip>
-#include <sstream>
 #include <random>
 #include <iostream>
 
-// Transaction base class implementation
+// Transaction base class implementation; ID and timestamp are kept as
+// numbers so constructing a transaction never touches the heap
 Transaction::Transaction(double amt) : amount(amt) {
-    transactionId = generateTransactionId();
-    timestamp = generateTimestamp();
+    ATM_TRACE_SPAN("Transaction::Transaction");
+    transactionNumber = generateTransactionNumber();
+    timestamp = std::time(nullptr);
 }
 
 std::string Transaction::getTimestamp() const {
-    return timestamp;
+    std::tm local{};
+#ifdef _WIN32
+    localtime_s(&local, &timestamp);
+#else
+    localtime_r(&timestamp, &local);
+#endif
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &local);
+    return buffer;
+}
+
+double Transaction::getAmount() const {
+    return amount;
 }
 
 std::string Transaction::getTransactionId() const {
-    return transactionId;
-}
-
-std::string Transaction::generateTransactionId() {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(100000, 999999);
-    return "TXN" + std::to_string(dis(gen));
+    return "TXN" + std::to_string(transactionNumber);
 }
 
-std::string Transaction::generateTimestamp() {
-    auto now = std::chrono::system_clock::now();
-    auto time_t = std::chrono::system_clock::to_time_t(now);
-    std::stringstream ss;
-    ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
-    return ss.str();
+// One generator per thread: sessions run concurrently in replay and load tests
+uint32_t Transaction::generateTransactionNumber() {
+    thread_local std::mt19937 gen(std::random_device{}());
+    std::uniform_int_distribution<uint32_t> dis(100000, 999999);
+    return dis(gen);
 }
 
 // Withdrawal class implementation
-Withdrawal::Withdrawal(double amt) : Transaction(amt), successful(false) {}
+Withdrawal::Withdrawal(double amt) : Transaction(amt), successful(false), overDailyLimit(false), declinedBy(0) {}
 
 bool Withdrawal::process(Account& account) {
     successful = account.withdraw(amount);
@@ -45,18 +51,27 @@ bool Withdrawal::process(Account& account) {
 }
 
 std::string Withdrawal::getDescription() const {
-    std::stringstream ss;
-    ss << "Withdrawal: $" << std::fixed << std::setprecision(2) << amount;
-    if (!successful) {
-        ss << " (FAILED - Insufficient funds)";
+    char buffer[96];
+    if (declinedBy != 0) {
+        std::snprintf(buffer, sizeof(buffer), "Withdrawal: $%.2f (DECLINED - Velocity rule %u)", amount,
+                      static_cast<unsigned>(declinedBy));
+    } else if (overDailyLimit) {
+        std::snprintf(buffer, sizeof(buffer), "Withdrawal: $%.2f (DECLINED - Daily limit)", amount);
+    } else {
+        std::snprintf(buffer, sizeof(buffer), "Withdrawal: $%.2f%s", amount,
+                      successful ? "" : " (FAILED - Insufficient funds)");
     }
-    return ss.str();
+    return buffer;
 }
 
 std::string Withdrawal::getTransactionType() const {
     return "WITHDRAWAL";
 }
 
+TransactionKind Withdrawal::getKind() const {
+    return TransactionKind::Withdrawal;
+}
+
 double Withdrawal::getAmount() const {
     return amount;
 }
@@ -65,6 +80,24 @@ bool Withdrawal::wasSuccessful() const {
     return successful;
 }
 
+void Withdrawal::decline(uint16_t ruleId) {
+    successful = false;
+    declinedBy = ruleId;
+}
+
+uint16_t Withdrawal::getDeclinedRule() const {
+    return declinedBy;
+}
+
+void Withdrawal::declineOverDailyLimit() {
+    successful = false;
+    overDailyLimit = true;
+}
+
+bool Withdrawal::wasOverDailyLimit() const {
+    return overDailyLimit;
+}
+
 // Deposit class implementation
 Deposit::Deposit(double amt) : Transaction(amt) {}
 
@@ -77,19 +110,62 @@ bool Deposit::process(Account& account) {
 }
 
 std::string Deposit::getDescription() const {
-    std::stringstream ss;
-    ss << "Deposit: $" << std::fixed << std::setprecision(2) << amount;
-    return ss.str();
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "Deposit: $%.2f", amount);
+    return buffer;
 }
 
 std::string Deposit::getTransactionType() const {
     return "DEPOSIT";
 }
 
+TransactionKind Deposit::getKind() const {
+    return TransactionKind::Deposit;
+}
+
 double Deposit::getAmount() const {
     return amount;
 }
 
+// Transfer class implementation
+Transfer::Transfer(double amt, Account& target) : Transaction(amt), target(target), successful(false) {}
+
+// Debit the source first; the credit cannot fail once the debit succeeded
+bool Transfer::process(Account& account) {
+    if (&account == &target) {
+        successful = false;
+        return false;
+    }
+    successful = account.withdraw(amount);
+    if (successful) {
+        target.deposit(amount);
+    }
+    return successful;
+}
+
+std::string Transfer::getDescription() const {
+    char buffer[96];
+    std::snprintf(buffer, sizeof(buffer), "Transfer to %s: $%.2f%s", target.getAccountNumber().c_str(), amount,
+                  successful ? "" : " (FAILED)");
+    return buffer;
+}
+
+std::string Transfer::getTransactionType() const {
+    return "TRANSFER";
+}
+
+TransactionKind Transfer::getKind() const {
+    return TransactionKind::Transfer;
+}
+
+Account& Transfer::getTarget() const {
+    return target;
+}
+
+bool Transfer::wasSuccessful() const {
+    return successful;
+}
+
 // Balance Inquiry class implementation
 BalanceInquiry::BalanceInquiry() : Transaction(0.0), balanceAtTime(0.0) {}
 
@@ -99,15 +175,19 @@ bool BalanceInquiry::process(Account& account) {
 }
 
 std::string BalanceInquiry::getDescription() const {
-    std::stringstream ss;
-    ss << "Balance Inquiry: $" << std::fixed << std::setprecision(2) << balanceAtTime;
-    return ss.str();
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "Balance Inquiry: $%.2f", balanceAtTime);
+    return buffer;
 }
 
 std::string BalanceInquiry::getTransactionType() const {
     return "BALANCE_INQUIRY";
 }
 
+TransactionKind BalanceInquiry::getKind() const {
+    return TransactionKind::BalanceInquiry;
+}
+
 double BalanceInquiry::getBalance() const {
     return balanceAtTime;
 }
@@ -117,6 +197,10 @@ void Withdrawal::displayResult(bool success) const {
     if (success) {
         std::cout << "Withdrawal of $" << std::fixed << std::setprecision(2) 
                   << amount << " completed successfully." << std::endl;
+    } else if (declinedBy != 0) {
+        std::cout << "Withdrawal declined by velocity rule " << declinedBy << "." << std::endl;
+    } else if (overDailyLimit) {
+        std::cout << "Withdrawal declined: daily limit reached." << std::endl;
     } else {
         std::cout << "Withdrawal failed: Insufficient funds." << std::endl;
     }
@@ -131,6 +215,15 @@ void Deposit::displayResult(bool success) const {
     }
 }
 
+void Transfer::displayResult(bool success) const {
+    if (success) {
+        std::cout << "Transfer of $" << std::fixed << std::setprecision(2) 
+                  << amount << " completed successfully." << std::endl;
+    } else {
+        std::cout << "Transfer failed." << std::endl;
+    }
+}
+
 void BalanceInquiry::displayResult(bool success) const {
     if (success) {
         std::cout << "Balance inquiry completed successfully." << std::endl;
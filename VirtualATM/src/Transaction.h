@@ -2,41 +2,55 @@
 #define TRANSACTION_H
 
 #include "Account.h"
+#include <cstdint>
+#include <ctime>
 #include <string>
 #include <memory>
 
+// Concrete transaction types, usable as a small array index
+enum class TransactionKind { Withdrawal = 0, Deposit = 1, BalanceInquiry = 2, Transfer = 3 };
+
 // Abstract base class demonstrating abstraction and polymorphism
 class Transaction {
 protected:
     double amount;
-    std::string transactionId;
-    std::string timestamp;
+    uint32_t transactionNumber; // formatted as TXNnnnnnn on demand
+    std::time_t timestamp;      // formatted as local time on demand
 public:
     Transaction(double amt);
     virtual ~Transaction() = default;
     virtual bool process(Account& account) = 0;
     virtual std::string getTransactionType() const = 0;
+    virtual TransactionKind getKind() const = 0;
     virtual void displayResult(bool success) const = 0;
     virtual std::string getDescription() const { return "No details available."; }
     double getAmount() const;
     std::string getTransactionId() const;
     std::string getTimestamp() const;
 protected:
-    static std::string generateTransactionId();
-    static std::string generateTimestamp();
+    static uint32_t generateTransactionNumber();
 };
 
 // Derived classes demonstrating inheritance
 class Withdrawal : public Transaction {
     bool successful;
+    bool overDailyLimit;
+    uint16_t declinedBy; // velocity rule id, 0 if not declined
 public:
     Withdrawal(double amt);
     bool process(Account& account) override;
     std::string getTransactionType() const override;
+    TransactionKind getKind() const override;
     void displayResult(bool success) const override;
     std::string getDescription() const;
     double getAmount() const;
     bool wasSuccessful() const;
+    // Refused by a velocity rule before touching the balance
+    void decline(uint16_t ruleId);
+    uint16_t getDeclinedRule() const;
+    // Refused because it would exceed the account's daily limit
+    void declineOverDailyLimit();
+    bool wasOverDailyLimit() const;
 };
 
 class Deposit : public Transaction {
@@ -44,17 +58,33 @@ public:
     Deposit(double amt);
     bool process(Account& account) override;
     std::string getTransactionType() const override;
+    TransactionKind getKind() const override;
     void displayResult(bool success) const override;
     std::string getDescription() const;
     double getAmount() const;
 };
 
+class Transfer : public Transaction {
+    Account& target;
+    bool successful;
+public:
+    Transfer(double amt, Account& target);
+    bool process(Account& account) override;
+    std::string getTransactionType() const override;
+    TransactionKind getKind() const override;
+    void displayResult(bool success) const override;
+    std::string getDescription() const;
+    Account& getTarget() const;
+    bool wasSuccessful() const;
+};
+
 class BalanceInquiry : public Transaction {
     double balanceAtTime;
 public:
     BalanceInquiry();
     bool process(Account& account) override;
     std::string getTransactionType() const override;
+    TransactionKind getKind() const override;
     void displayResult(bool success) const override;
     std::string getDescription() const;
     double getBalance() const;
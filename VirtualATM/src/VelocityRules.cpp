@@ -0,0 +1,241 @@
+#include "VelocityRules.h"
+#include "FastText.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+const size_t VelocityEngine::MAX_WINDOWS;
+const size_t VelocityEngine::MAX_RULES;
+const size_t VelocityEngine::BUCKETS;
+
+namespace {
+    // "90s", "10m", "24h", "30d"
+    bool parseWindow(const std::string& text, uint32_t& seconds) {
+        if (text.size() < 2) {
+            return false;
+        }
+        uint64_t unit;
+        switch (text.back()) {
+            case 's': unit = 1; break;
+            case 'm': unit = 60; break;
+            case 'h': unit = 3600; break;
+            case 'd': unit = 86400; break;
+            default: return false;
+        }
+        uint64_t value = 0;
+        for (size_t i = 0; i + 1 < text.size(); ++i) {
+            if (text[i] < '0' || text[i] > '9' || value > 0xFFFFFFFFull) {
+                return false;
+            }
+            value = value * 10 + static_cast<uint64_t>(text[i] - '0');
+        }
+        value *= unit;
+        if (value == 0 || value > 0xFFFFFFFFull) {
+            return false;
+        }
+        seconds = static_cast<uint32_t>(value);
+        return true;
+    }
+
+    // "5x" or "2.5x" as a percentage
+    bool parseFactor(const std::string& text, int64_t& percent) {
+        if (text.size() < 2 || text.back() != 'x') {
+            return false;
+        }
+        return FastText::parseCents(text.data(), text.data() + text.size() - 1, percent) && percent > 0;
+    }
+}
+
+VelocityEngine::VelocityEngine() : stepCount(0), windowCount(0), accountCount(0) {
+    static_assert(sizeof(Ring) == 64, "a ring is one cache line");
+}
+
+bool VelocityEngine::parseRules(const std::string& text, std::vector<VelocityRule>& rules, std::string& error) {
+    std::istringstream input(text);
+    std::string line;
+    int number = 0;
+    while (std::getline(input, line)) {
+        number++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string id, kind, window, limit, minHistory, extra;
+        if (!(fields >> id)) {
+            continue;
+        }
+        fields >> kind >> window >> limit >> minHistory >> extra;
+
+        VelocityRule rule;
+        unsigned long parsedId = 0;
+        try {
+            parsedId = std::stoul(id);
+        } catch (const std::exception&) {
+        }
+        bool ok = parsedId > 0 && parsedId <= 0xFFFF && parseWindow(window, rule.windowSeconds) && extra.empty();
+        rule.id = static_cast<uint16_t>(parsedId);
+        if (ok && kind == "count") {
+            rule.kind = VelocityKind::Count;
+            ok = minHistory.empty() && limit.find_first_not_of("0123456789") == std::string::npos &&
+                 !limit.empty() && limit.size() < 10;
+            rule.limit = ok ? std::stoll(limit) : 0;
+        } else if (ok && kind == "amount") {
+            rule.kind = VelocityKind::Amount;
+            ok = minHistory.empty() && FastText::parseCents(limit.data(), limit.data() + limit.size(), rule.limit) &&
+                 rule.limit >= 0;
+        } else if (ok && kind == "spike") {
+            rule.kind = VelocityKind::Spike;
+            ok = parseFactor(limit, rule.limit) &&
+                 (minHistory.empty() || minHistory.find_first_not_of("0123456789") == std::string::npos);
+            rule.minHistory = ok && !minHistory.empty() ? static_cast<uint32_t>(std::stoul(minHistory)) : 1;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            error = "line " + std::to_string(number) + ": expected \"id count|amount|spike window limit [min-history]\"";
+            return false;
+        }
+        rules.push_back(rule);
+    }
+    return true;
+}
+
+bool VelocityEngine::loadRules(const std::string& path, std::vector<VelocityRule>& rules, std::string& error) {
+    std::ifstream file(path);
+    if (!file) {
+        error = "could not open " + path;
+        return false;
+    }
+    std::ostringstream text;
+    text << file.rdbuf();
+    return parseRules(text.str(), rules, error);
+}
+
+bool VelocityEngine::compile(const std::vector<VelocityRule>& rules, std::string& error) {
+    if (rules.size() > MAX_RULES) {
+        error = "at most " + std::to_string(MAX_RULES) + " rules";
+        return false;
+    }
+    uint32_t windows[MAX_WINDOWS];
+    size_t distinct = 0;
+    for (size_t i = 0; i < rules.size(); ++i) {
+        const VelocityRule& rule = rules[i];
+        size_t window = std::find(windows, windows + distinct, rule.windowSeconds) - windows;
+        if (window == distinct) {
+            if (distinct == MAX_WINDOWS) {
+                error = "at most " + std::to_string(MAX_WINDOWS) + " distinct windows";
+                return false;
+            }
+            windows[distinct++] = rule.windowSeconds;
+        }
+        steps[i].kind = rule.kind;
+        steps[i].window = static_cast<uint8_t>(window);
+        steps[i].id = rule.id;
+        steps[i].minHistory = std::max<uint32_t>(rule.minHistory, 1);
+        steps[i].limit = rule.limit;
+    }
+    for (size_t window = 0; window < distinct; ++window) {
+        bucketSeconds[window] = (windows[window] + BUCKETS - 2) / (BUCKETS - 1);
+        bucketReciprocals[window] = UINT64_MAX / bucketSeconds[window] + 1;
+    }
+    stepCount = rules.size();
+    windowCount = distinct;
+    attach(accountCount);
+    return true;
+}
+
+void VelocityEngine::attach(size_t accounts) {
+    accountCount = accounts;
+    rings.reset(accounts * windowCount);
+}
+
+size_t VelocityEngine::getRuleCount() const {
+    return stepCount;
+}
+
+size_t VelocityEngine::getWindowCount() const {
+    return windowCount;
+}
+
+// Exact 32-bit division by a precomputed reciprocal (Lemire's fastdiv),
+// several times cheaper than a hardware divide
+uint32_t VelocityEngine::bucketOf(uint32_t seconds, size_t window) const {
+#if defined(__SIZEOF_INT128__)
+    return static_cast<uint32_t>((static_cast<unsigned __int128>(bucketReciprocals[window]) * seconds) >> 64);
+#else
+    return seconds / bucketSeconds[window];
+#endif
+}
+
+// Expire the buckets that slid out of each window since the last touch
+VelocityEngine::Ring* VelocityEngine::ringsOf(size_t account, int64_t nowSeconds) {
+    Ring* ring = &rings[account * windowCount];
+    for (size_t window = 0; window < windowCount; ++window) {
+        Ring& r = ring[window];
+        uint32_t now = bucketOf(static_cast<uint32_t>(nowSeconds), window);
+        uint32_t elapsed = now - r.epoch;
+        if (elapsed == 0) {
+            continue;
+        }
+        if (elapsed >= BUCKETS) {
+            r = Ring();
+        } else {
+            for (uint32_t step = 1; step <= elapsed; ++step) {
+                size_t slot = (r.epoch + step) % BUCKETS;
+                r.count -= r.counts[slot];
+                r.cents -= r.amounts[slot];
+                r.counts[slot] = 0;
+                r.amounts[slot] = 0;
+            }
+        }
+        r.epoch = now;
+    }
+    return ring;
+}
+
+uint16_t VelocityEngine::check(size_t account, int64_t cents, int64_t nowSeconds) {
+    if (stepCount == 0) {
+        return 0;
+    }
+    const Ring* ring = ringsOf(account, nowSeconds);
+    uint64_t amount = static_cast<uint64_t>(std::max<int64_t>(cents, 0));
+    for (size_t i = 0; i < stepCount; ++i) {
+        const PlanStep& step = steps[i];
+        const Ring& r = ring[step.window];
+        bool broken;
+        switch (step.kind) {
+            case VelocityKind::Count:
+                broken = static_cast<int64_t>(r.count) + 1 > step.limit;
+                break;
+            case VelocityKind::Amount:
+                broken = static_cast<int64_t>(r.cents + amount) > step.limit;
+                break;
+            default:
+                // amount above limit% of the window average: amount * count vs total
+                broken = r.count >= step.minHistory &&
+                         static_cast<double>(amount) * 100.0 * r.count > static_cast<double>(step.limit) * r.cents;
+                break;
+        }
+        if (broken) {
+            return step.id;
+        }
+    }
+    return 0;
+}
+
+void VelocityEngine::record(size_t account, int64_t cents) {
+    if (stepCount == 0) {
+        return;
+    }
+    Ring* ring = &rings[account * windowCount];
+    uint32_t amount = static_cast<uint32_t>(std::min<int64_t>(std::max<int64_t>(cents, 0), 0xFFFFFFFFll));
+    for (size_t window = 0; window < windowCount; ++window) {
+        Ring& r = ring[window];
+        size_t slot = r.epoch % BUCKETS;
+        if (r.counts[slot] == 0xFFFF || r.amounts[slot] > 0xFFFFFFFFu - amount) {
+            continue; // saturated bucket; the window totals stay consistent with it
+        }
+        r.counts[slot]++;
+        r.amounts[slot] += amount;
+        r.count++;
+        r.cents += amount;
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef VELOCITYRULES_H
+#define VELOCITYRULES_H
+
+#include "LargeArray.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class VelocityKind : uint8_t {
+    Count = 1,  // at most `limit` withdrawals in the window
+    Amount = 2, // at most `limit` cents withdrawn in the window
+    Spike = 3   // no withdrawal above `limit` percent of the window's average
+};
+
+struct VelocityRule {
+    uint16_t id;             // reported with declines; never 0
+    VelocityKind kind;
+    uint32_t windowSeconds;
+    int64_t limit;
+    uint32_t minHistory = 0; // Spike: withdrawals in the window before it applies
+};
+
+// Per-account velocity rules evaluated inline on the withdrawal path.
+//
+// compile() turns the rules into a flat plan: the distinct windows (at most
+// MAX_WINDOWS) and one fixed-size record per rule. Every account keeps one
+// ring of BUCKETS counters per window, a 64-byte cache line holding the
+// bucket counts and amounts plus running totals, so both checking and
+// recording are O(1): advancing a ring expires at most BUCKETS buckets.
+// Buckets are window / (BUCKETS - 1) wide, so a window is never shorter
+// than configured and at most one bucket longer. The state array is a
+// LargeArray, zero-filled as it is first touched.
+//
+// Not thread-safe per account: callers hold the account's lock.
+class VelocityEngine {
+public:
+    static const size_t MAX_WINDOWS = 4;
+    static const size_t MAX_RULES = 16;
+    static const size_t BUCKETS = 8;
+
+    VelocityEngine();
+
+    // "id kind window limit [min-history]" per line, '#' comments, e.g.
+    //   101 count 10m 3 / 102 amount 24h 1000.00 / 103 spike 30d 5x 4
+    static bool parseRules(const std::string& text, std::vector<VelocityRule>& rules, std::string& error);
+    static bool loadRules(const std::string& path, std::vector<VelocityRule>& rules, std::string& error);
+
+    bool compile(const std::vector<VelocityRule>& rules, std::string& error);
+
+    // Size the per-account state; clears it
+    void attach(size_t accounts);
+
+    // 0 if a withdrawal of `cents` may proceed at `nowSeconds` (seconds
+    // since the epoch), otherwise the id of the first rule it breaks
+    uint16_t check(size_t account, int64_t cents, int64_t nowSeconds);
+
+    // Start loading an account's rings, e.g. before taking its lock
+    void prefetch(size_t account) const {
+        const char* line = reinterpret_cast<const char*>(rings.data() + account * windowCount);
+        for (size_t window = 0; window < windowCount; ++window) {
+            __builtin_prefetch(line + window * sizeof(Ring), 1);
+        }
+    }
+
+    // Count a completed withdrawal into the buckets check() just brought
+    // up to date (same account, same lock hold)
+    void record(size_t account, int64_t cents);
+
+    size_t getRuleCount() const;
+    size_t getWindowCount() const;
+
+private:
+    struct Ring {
+        uint32_t epoch;           // bucket number of the newest bucket
+        uint32_t count;
+        uint64_t cents;
+        uint16_t counts[BUCKETS]; // saturating
+        uint32_t amounts[BUCKETS];
+    };
+
+    struct PlanStep {
+        VelocityKind kind;
+        uint8_t window;
+        uint16_t id;
+        uint32_t minHistory;
+        int64_t limit;
+    };
+
+    PlanStep steps[MAX_RULES];
+    uint32_t bucketSeconds[MAX_WINDOWS];
+    uint64_t bucketReciprocals[MAX_WINDOWS];
+    size_t stepCount;
+    size_t windowCount;
+    size_t accountCount;
+    LargeArray<Ring> rings; // windowCount per account
+
+    uint32_t bucketOf(uint32_t seconds, size_t window) const;
+    Ring* ringsOf(size_t account, int64_t nowSeconds);
+};
+
+#endif // VELOCITYRULES_H
@@ -0,0 +1,50 @@
+#include "ZipfDistribution.h"
+#include <cmath>
+
+namespace {
+    // log1p(x) / x, stable near zero
+    double helper1(double x) {
+        return std::fabs(x) > 1e-8 ? std::log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+
+    // expm1(x) / x, stable near zero
+    double helper2(double x) {
+        return std::fabs(x) > 1e-8 ? std::expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+    }
+}
+
+ZipfDistribution::ZipfDistribution(uint64_t n, double exponent)
+    : n(n < 1 ? 1 : n), exponent(exponent) {
+    hIntegralX1 = hIntegral(1.5) - 1.0;
+    hIntegralN = hIntegral(static_cast<double>(this->n) + 0.5);
+    squeeze = 2.0 - hIntegralInverse(hIntegral(2.5) - h(2.0));
+}
+
+double ZipfDistribution::h(double x) const {
+    return std::exp(-exponent * std::log(x));
+}
+
+double ZipfDistribution::hIntegral(double x) const {
+    double logX = std::log(x);
+    return helper2((1.0 - exponent) * logX) * logX;
+}
+
+double ZipfDistribution::hIntegralInverse(double x) const {
+    double t = x * (1.0 - exponent);
+    if (t < -1.0) {
+        t = -1.0;
+    }
+    return std::exp(helper1(t) * x);
+}
+
+uint64_t ZipfDistribution::sample(FastRandom& random) const {
+    while (true) {
+        double u = hIntegralN + random.uniform() * (hIntegralX1 - hIntegralN);
+        double x = hIntegralInverse(u);
+        double rounded = std::floor(x + 0.5);
+        uint64_t k = rounded < 1.0 ? 1 : (rounded > static_cast<double>(n) ? n : static_cast<uint64_t>(rounded));
+        if (static_cast<double>(k) - x <= squeeze || u >= hIntegral(static_cast<double>(k) + 0.5) - h(static_cast<double>(k))) {
+            return k;
+        }
+    }
+}
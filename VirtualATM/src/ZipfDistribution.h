@@ -0,0 +1,28 @@
+#ifndef ZIPFDISTRIBUTION_H
+#define ZIPFDISTRIBUTION_H
+
+#include "FastRandom.h"
+#include <cstdint>
+
+// Zipf-distributed ranks in [1, n] using rejection-inversion sampling
+// (Hormann & Derflinger), so sampling is O(1) with no tables even for
+// hundreds of millions of elements. Rank 1 is the most popular.
+class ZipfDistribution {
+private:
+    uint64_t n;
+    double exponent;
+    double hIntegralX1;
+    double hIntegralN;
+    double squeeze;
+
+    double h(double x) const;
+    double hIntegral(double x) const;
+    double hIntegralInverse(double x) const;
+
+public:
+    ZipfDistribution(uint64_t n, double exponent);
+
+    uint64_t sample(FastRandom& random) const;
+};
+
+#endif // ZIPFDISTRIBUTION_H
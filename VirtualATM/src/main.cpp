@@ -14,15 +14,176 @@
 
 #include "ATM.h"
 #include "FileManager.h"
+#include "Metrics.h"
+#include "SessionTrace.h"
+#include "Sharding.h"
+#include "StoreImage.h"
+#include "Trace.h"
+#include <cstdlib>
 #include <iostream>
 #include <exception>
+#include <sstream>
+#include <string>
+#include <vector>
 
-int main() {
+int main(int argc, char* argv[]) {
     try {
+        SessionConfig config;
+        SessionRecorder recorder;
+        
+        // Optional: --record <trace file> captures this session's input;
+        // --shards <socket,...> posts to atm_shard processes instead of
+        // loading the accounts file; --memory-budget <MiB> keeps only that
+        // much of it in memory, over its warm-start image
+        std::vector<std::string> shardSockets;
+        double budgetMb = 0.0;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--record" && i + 1 < argc) {
+                if (!recorder.open(argv[++i])) {
+                    std::cerr << "Error: Could not open trace file " << argv[i] << std::endl;
+                    return 1;
+                }
+                config.recorder = &recorder;
+            } else if (arg == "--shards" && i + 1 < argc) {
+                std::stringstream sockets(argv[++i]);
+                std::string socket;
+                while (std::getline(sockets, socket, ',')) {
+                    shardSockets.push_back(socket);
+                }
+            } else if (arg == "--memory-budget" && i + 1 < argc && std::atof(argv[i + 1]) > 0) {
+                budgetMb = std::atof(argv[++i]);
+            } else {
+                std::cerr << "Usage: " << argv[0]
+                          << " [--record <trace file>] [--shards <socket,...> | --memory-budget <MiB>]" << std::endl;
+                return 1;
+            }
+        }
+        
+        ShardRouter router;
+        if (!shardSockets.empty()) {
+            std::string error;
+            if (!router.connect(shardSockets, error)) {
+                std::cerr << "Error: " << error << std::endl;
+                return 1;
+            }
+            config.router = &router;
+        }
+        
+        // Optional journal: ATM_LEDGER appends every posting to a binary
+        // ledger for atm_reconcile
+        if (const char* ledgerPath = std::getenv("ATM_LEDGER")) {
+            config.ledgerPath = ledgerPath;
+        }
+        
+        // Optional velocity rules: ATM_VELOCITY_RULES names a rules file
+        // checked on every withdrawal (see data/velocity_rules.txt)
+        if (const char* rulesPath = std::getenv("ATM_VELOCITY_RULES")) {
+            config.velocityRulesPath = rulesPath;
+        }
+        
+        // Optional daily withdrawal limit per account, e.g. ATM_DAILY_LIMIT=1000
+        if (const char* dailyLimit = std::getenv("ATM_DAILY_LIMIT")) {
+            config.dailyLimit = std::atof(dailyLimit);
+        }
+        
+        // Optional hot standby: ATM_REPLICA_SOCKET names the socket atm_standby
+        // listens on; ATM_REPLICA_ACK=durable waits for it on every posting
+        if (const char* replicaSocket = std::getenv("ATM_REPLICA_SOCKET")) {
+            config.replicaSocket = replicaSocket;
+            const char* ack = std::getenv("ATM_REPLICA_ACK");
+            if (ack && !ReplicationSender::parseAck(ack, config.replicaAck)) {
+                std::cerr << "Warning: ATM_REPLICA_ACK must be async or durable" << std::endl;
+            }
+        }
+        
+        // Optional background persistence: ATM_IO=uring|threads|auto writes
+        // the journal and account saves without stalling the session;
+        // ATM_IO_ACK=durable waits for each posting's journal sync
+        if (const char* backend = std::getenv("ATM_IO")) {
+            config.ioBackend = backend;
+            const char* ack = std::getenv("ATM_IO_ACK");
+            if (ack && !AsyncJournal::parseAck(ack, config.journalAck)) {
+                std::cerr << "Warning: ATM_IO_ACK must be async or durable" << std::endl;
+            }
+        }
+        
+        // Optional note inventory, e.g. ATM_CASSETTES=20:2000,50:1000,100:500;
+        // withdrawals must then be payable in the notes loaded
+        if (const char* cassettes = std::getenv("ATM_CASSETTES")) {
+            config.cassettes = cassettes;
+        }
+        
+        // Optional tracing: ATM_TRACE names the Chrome trace file, written
+        // on SIGUSR1 and at exit
+        const char* tracePath = std::getenv("ATM_TRACE");
+        if (tracePath) {
+            Tracer::setEnabled(true);
+            Tracer::dumpOnSignal(tracePath);
+        }
+        
+        // Optional metrics export: ATM_METRICS_FILE is rewritten every
+        // ATM_METRICS_INTERVAL_MS, ATM_METRICS_PORT serves GET /metrics
+        const char* metricsFile = std::getenv("ATM_METRICS_FILE");
+        const char* metricsPort = std::getenv("ATM_METRICS_PORT");
+        const char* metricsInterval = std::getenv("ATM_METRICS_INTERVAL_MS");
+        if (metricsFile || metricsPort) {
+            AtmMetrics::get();
+            if (!MetricsRegistry::instance().startExporter(metricsFile ? metricsFile : "",
+                                                            metricsInterval ? std::atoi(metricsInterval) : 10000,
+                                                            metricsPort ? std::atoi(metricsPort) : 0)) {
+                std::cerr << "Warning: Could not start metrics exporter" << std::endl;
+            }
+        }
+        
+        // The shards keep their own journal, limits and saves
+        if (config.router && (!config.ledgerPath.empty() || !config.velocityRulesPath.empty() ||
+                              config.dailyLimit > 0 || !config.replicaSocket.empty() || !config.ioBackend.empty())) {
+            std::cerr << "Warning: ATM_LEDGER, ATM_VELOCITY_RULES, ATM_DAILY_LIMIT, ATM_REPLICA_SOCKET and ATM_IO "
+                      << "are ignored with --shards" << std::endl;
+        }
+        
+        // A tiered session posts without the store's extras; it writes the
+        // image first if the accounts file has none
+        TieredStore tier;
+        if (budgetMb > 0 && config.router) {
+            std::cerr << "Warning: --memory-budget is ignored with --shards" << std::endl;
+        } else if (budgetMb > 0 && (!config.ledgerPath.empty() || !config.velocityRulesPath.empty() ||
+                                    config.dailyLimit > 0 || !config.replicaSocket.empty() ||
+                                    !config.ioBackend.empty())) {
+            std::cerr << "Warning: ATM_LEDGER, ATM_VELOCITY_RULES, ATM_DAILY_LIMIT, ATM_REPLICA_SOCKET and ATM_IO "
+                      << "need the whole account table; --memory-budget is ignored" << std::endl;
+        } else if (budgetMb > 0) {
+            std::string dataFilePath = FileManager::defaultDataFilePath();
+            StoreImage image;
+            if (!StoreImage::recover(dataFilePath) || !image.open(dataFilePath)) {
+                AccountStore store;
+                store.load(dataFilePath, false);
+                store.checkpoint();
+            }
+            image.close();
+            std::string error;
+            if (tier.open(dataFilePath, static_cast<size_t>(budgetMb * 1024.0 * 1024.0), error)) {
+                config.tier = &tier;
+            } else {
+                std::cerr << "Warning: Loading every account: " << error << std::endl;
+            }
+        }
+        
         // Create ATM instance and start the application
-        ATM atmMachine;
+        ATM atmMachine(config);
         atmMachine.start();
         
+        // Clean shutdown: the next start maps the binary image instead of
+        // parsing the accounts file
+        if (!atmMachine.checkpoint()) {
+            std::cerr << "Warning: Could not write the warm-start image" << std::endl;
+        }
+        MetricsRegistry::instance().stopExporter();
+        if (tracePath && !Tracer::dump(tracePath)) {
+            std::cerr << "Warning: Could not write trace file " << tracePath << std::endl;
+        }
+        
     } catch (const std::exception& e) {
         std::cerr << "Fatal Error: " << e.what() << std::endl;
         std::cerr << "Application terminated unexpectedly." << std::endl;
@@ -0,0 +1,111 @@
+/*
+ * ATM Simulator - Login throttle tests
+ *
+ * Drives LoginThrottle's buckets directly with crafted key hashes, so that
+ * several keys share one probe window, and checks that a key never spends
+ * another key's tokens.
+ */
+
+#include "LoginThrottle.h"
+#include <cstdio>
+#include <thread>
+
+class LoginThrottleTest {
+public:
+    // Key hash with the given tag whose probe window starts at `home`
+    static uint64_t key(uint64_t tag, size_t home) {
+        return (tag << 40) | home;
+    }
+
+    static size_t probeLimit() { return LoginThrottle::PROBE_LIMIT; }
+
+    static bool consume(LoginThrottle& throttle, uint64_t keyHash, const LoginThrottle::Policy& policy,
+                        int64_t now) {
+        return throttle.consume(keyHash, policy, now);
+    }
+};
+
+namespace {
+    const int64_t NOW = 1000000;
+    int failures = 0;
+
+    void check(bool condition, const char* what) {
+        if (!condition) {
+            std::fprintf(stderr, "FAIL: %s\n", what);
+            ++failures;
+        }
+    }
+
+    // Attempts the key is still allowed at `now`, taking them all
+    int drain(LoginThrottle& throttle, uint64_t keyHash, const LoginThrottle::Policy& policy, int64_t now) {
+        int allowed = 0;
+        while (allowed < 100 && LoginThrottleTest::consume(throttle, keyHash, policy, now)) {
+            ++allowed;
+        }
+        return allowed;
+    }
+
+    // Terminal and account buckets fill one window; a further key is refused
+    // and every bucket keeps its own count
+    void testFullWindow() {
+        const LoginThrottle::Policy& account = LoginThrottle::ACCOUNT_POLICY;
+        const LoginThrottle::Policy& terminal = LoginThrottle::TERMINAL_POLICY;
+        const size_t home = 100;
+        const size_t keys = LoginThrottleTest::probeLimit();
+        LoginThrottle throttle;
+
+        for (size_t i = 0; i < keys; ++i) {
+            const LoginThrottle::Policy& policy = i % 2 ? account : terminal;
+            check(LoginThrottleTest::consume(throttle, LoginThrottleTest::key(i + 1, home), policy, NOW),
+                  "first attempt of a key in a window with room");
+        }
+
+        uint64_t stranger = LoginThrottleTest::key(keys + 1, home);
+        check(!LoginThrottleTest::consume(throttle, stranger, account, NOW), "new key refused in a full window");
+        check(!LoginThrottleTest::consume(throttle, stranger, terminal, NOW), "refused again, not charged elsewhere");
+
+        for (size_t i = 0; i < keys; ++i) {
+            const LoginThrottle::Policy& policy = i % 2 ? account : terminal;
+            check(drain(throttle, LoginThrottleTest::key(i + 1, home), policy, NOW) == policy.burst - 1,
+                  "each key keeps the rest of its own burst");
+        }
+
+        // Once one bucket has refilled its slot is free for the new key
+        const int64_t later = NOW + terminal.burst * terminal.intervalMs;
+        check(LoginThrottleTest::consume(throttle, stranger, account, later), "new key admitted once a slot frees");
+        check(drain(throttle, stranger, account, later) == account.burst - 1, "new key gets a fresh bucket");
+    }
+
+    // Two new keys racing for the last free slot: exactly one gets it
+    void testLastSlotRace() {
+        const LoginThrottle::Policy& account = LoginThrottle::ACCOUNT_POLICY;
+        const size_t keys = LoginThrottleTest::probeLimit();
+        LoginThrottle throttle;
+
+        for (size_t round = 0; round < 200; ++round) {
+            const size_t home = 1000 + round * 16;
+            for (size_t i = 0; i + 1 < keys; ++i) {
+                LoginThrottleTest::consume(throttle, LoginThrottleTest::key(i + 1, home), account, NOW);
+            }
+            bool first = false;
+            bool second = false;
+            std::thread other([&] {
+                first = LoginThrottleTest::consume(throttle, LoginThrottleTest::key(keys, home), account, NOW);
+            });
+            second = LoginThrottleTest::consume(throttle, LoginThrottleTest::key(keys + 1, home), account, NOW);
+            other.join();
+            check(first != second, "one of two racing keys takes the last slot");
+        }
+    }
+}
+
+int main() {
+    testFullWindow();
+    testLastSlotRace();
+    if (failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("LoginThrottle: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,166 @@
+/*
+ * ATM Simulator - Synthetic Dataset Generator
+ *
+ * Writes accounts in the accounts.txt format and, optionally, a binary
+ * transaction ledger with Zipf-skewed account activity. Output depends only
+ * on the options and the seed, never on the number of threads.
+ */
+
+#include "DatasetGenerator.h"
+#include "FastText.h"
+#include "Reconciler.h"
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+#include <string>
+
+namespace {
+    struct GenOptions {
+        DatasetConfig config;
+        std::string accountsPath = "data/accounts.txt";
+        std::string ledgerPath = "data/ledger.bin";
+        std::string closingPath;
+        uint64_t closingErrors = 0;
+    };
+
+    void printUsage(const char* program) {
+        std::cerr << "Usage: " << program << " --accounts N [options]\n"
+                  << "  --seed S                 RNG seed (default 42)\n"
+                  << "  --balance MODEL          uniform | lognormal | pareto (default lognormal)\n"
+                  << "  --balance-scale X        uniform max, lognormal median, pareto minimum\n"
+                  << "  --balance-shape Y        lognormal sigma or pareto alpha\n"
+                  << "  --branches B             branch codes to spread accounts over\n"
+                  << "  --history N              ledger entries to generate (default 0)\n"
+                  << "  --zipf S                 activity skew exponent (default 1.0)\n"
+                  << "  --start YYYY-MM-DD       first day of the history (UTC)\n"
+                  << "  --days D                 length of the history in days (default 30)\n"
+                  << "  --threads T              generator threads (default: all cores)\n"
+                  << "  --out PATH               accounts file (default data/accounts.txt)\n"
+                  << "  --ledger PATH            ledger file (default data/ledger.bin)\n"
+                  << "  --closing PATH           also write the accounts after the history is posted\n"
+                  << "  --closing-errors N       accounts to give a wrong closing balance (default 0)" << std::endl;
+    }
+
+    bool parseDate(const std::string& text, int64_t& microseconds) {
+        int year = 0, month = 0, day = 0;
+        if (std::sscanf(text.c_str(), "%d-%d-%d", &year, &month, &day) != 3 || month < 1 || month > 12 || day < 1) {
+            return false;
+        }
+        int64_t days = FastText::daysFromCivil(year, static_cast<unsigned>(month), static_cast<unsigned>(day));
+        microseconds = days * 86400LL * 1000000LL;
+        return true;
+    }
+
+    bool parseOptions(int argc, char* argv[], GenOptions& options) {
+        DatasetConfig& config = options.config;
+        bool haveAccounts = false;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            std::string value = argv[++i];
+            if (arg == "--accounts") {
+                config.accounts = std::stoull(value);
+                haveAccounts = true;
+            } else if (arg == "--seed") {
+                config.seed = std::stoull(value);
+            } else if (arg == "--balance") {
+                if (value == "uniform") {
+                    config.balanceModel = BalanceModel::Uniform;
+                } else if (value == "lognormal") {
+                    config.balanceModel = BalanceModel::LogNormal;
+                } else if (value == "pareto") {
+                    config.balanceModel = BalanceModel::Pareto;
+                    config.balanceScale = 100.0;
+                    config.balanceShape = 1.2;
+                } else {
+                    return false;
+                }
+            } else if (arg == "--balance-scale") {
+                config.balanceScale = std::stod(value);
+            } else if (arg == "--balance-shape") {
+                config.balanceShape = std::stod(value);
+            } else if (arg == "--branches") {
+                config.branches = static_cast<unsigned>(std::stoul(value));
+            } else if (arg == "--history") {
+                config.historyEntries = std::stoull(value);
+            } else if (arg == "--zipf") {
+                config.zipfExponent = std::stod(value);
+            } else if (arg == "--start") {
+                if (!parseDate(value, config.historyStartUs)) {
+                    return false;
+                }
+            } else if (arg == "--days") {
+                config.historyDays = static_cast<unsigned>(std::stoul(value));
+            } else if (arg == "--threads") {
+                config.threads = static_cast<unsigned>(std::stoul(value));
+            } else if (arg == "--out") {
+                options.accountsPath = value;
+            } else if (arg == "--ledger") {
+                options.ledgerPath = value;
+            } else if (arg == "--closing") {
+                options.closingPath = value;
+            } else if (arg == "--closing-errors") {
+                options.closingErrors = std::stoull(value);
+            } else {
+                return false;
+            }
+        }
+        return haveAccounts && config.accounts > 0 && config.accounts <= DatasetGenerator::MAX_ACCOUNTS &&
+               config.balanceScale >= 0 && config.balanceShape > 0 && config.zipfExponent > 0 &&
+               config.historyDays > 0 && (options.closingPath.empty() || config.historyEntries > 0);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    GenOptions options;
+    try {
+        if (!parseOptions(argc, argv, options)) {
+            printUsage(argv[0]);
+            return 1;
+        }
+    } catch (const std::exception&) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    DatasetGenerator generator(options.config);
+    std::cout << "Generating " << options.config.accounts << " accounts over " << generator.getBranches()
+              << " branches with " << generator.getThreads() << " threads..." << std::endl;
+
+    auto started = std::chrono::steady_clock::now();
+    if (!generator.writeAccounts(options.accountsPath)) {
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::printf("  %s: %.2f s (%.1f M accounts/s)\n", options.accountsPath.c_str(), seconds,
+                static_cast<double>(options.config.accounts) / seconds / 1e6);
+
+    if (options.config.historyEntries > 0) {
+        started = std::chrono::steady_clock::now();
+        if (!generator.writeLedger(options.ledgerPath)) {
+            return 1;
+        }
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        std::printf("  %s: %llu entries, %.2f s (%.1f M entries/s)\n", options.ledgerPath.c_str(),
+                    static_cast<unsigned long long>(options.config.historyEntries), seconds,
+                    static_cast<double>(options.config.historyEntries) / seconds / 1e6);
+    }
+
+    // The closing file is the opening file with the ledger posted, built by
+    // the reconciliation engine itself
+    if (!options.closingPath.empty()) {
+        started = std::chrono::steady_clock::now();
+        Reconciler reconciler(generator.getThreads());
+        if (!reconciler.loadOpening(options.accountsPath) || !reconciler.applyLedger(options.ledgerPath) ||
+            !reconciler.writeProjectedClosing(options.closingPath, options.closingErrors, options.config.seed)) {
+            return 1;
+        }
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        std::printf("  %s: %llu wrong balances, %.2f s\n", options.closingPath.c_str(),
+                    static_cast<unsigned long long>(options.closingErrors), seconds);
+    }
+    return 0;
+}
@@ -0,0 +1,206 @@
+/*
+ * ATM Simulator - Transaction History
+ *
+ * "build" indexes the binary ledger into per-account history files;
+ * "query" answers filtered history requests for one account, such as
+ * withdrawals over 500.00 in the last week or all deposits in a month.
+ */
+
+#include "FastText.h"
+#include "HistoryStore.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+namespace {
+    const int64_t DAY_US = 86400LL * 1000000LL;
+
+    struct QueryOptions {
+        std::string directory = "history";
+        std::string account;
+        HistoryFilter filter;
+    };
+
+    void printUsage(const char* program) {
+        std::cerr << "Usage: " << program << " build --ledger PATH [options]\n"
+                  << "  --out DIR                history directory (default history)\n"
+                  << "  --tmp DIR                scratch directory (default <out>/tmp)\n"
+                  << "  --memory-mb M            memory budget in MiB (default 256)\n"
+                  << "  --threads T              worker threads (default: all cores)\n"
+                  << "       " << program << " query --account NUMBER [options]\n"
+                  << "  --dir DIR                history directory (default history)\n"
+                  << "  --type NAME              WITHDRAWAL, DEPOSIT, TRANSFER, BALANCE_INQUIRY, ... (repeatable)\n"
+                  << "  --from YYYY-MM-DD        first day (UTC)\n"
+                  << "  --to YYYY-MM-DD          last day, inclusive\n"
+                  << "  --last-days N            the last N days up to now\n"
+                  << "  --min AMOUNT             smallest amount, e.g. 500.00\n"
+                  << "  --max AMOUNT             largest amount\n"
+                  << "  --limit N                at most N entries\n"
+                  << "  --newest-first           newest entries first\n"
+                  << "  --include-failed         include declined postings" << std::endl;
+    }
+
+    bool parseDay(const std::string& text, int64_t& microseconds) {
+        int year = 0, month = 0, day = 0;
+        if (std::sscanf(text.c_str(), "%d-%d-%d", &year, &month, &day) != 3 || month < 1 || month > 12 || day < 1) {
+            return false;
+        }
+        microseconds = FastText::daysFromCivil(year, static_cast<unsigned>(month), static_cast<unsigned>(day)) * DAY_US;
+        return true;
+    }
+
+    bool parseAmount(const std::string& text, int64_t& cents) {
+        return FastText::parseCents(text.data(), text.data() + text.size(), cents) && cents >= 0;
+    }
+
+    bool parseBuildOptions(int argc, char* argv[], HistoryBuildConfig& config) {
+        for (int i = 2; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            std::string value = argv[++i];
+            if (arg == "--ledger") {
+                config.ledgerPath = value;
+            } else if (arg == "--out") {
+                config.outputDir = value;
+            } else if (arg == "--tmp") {
+                config.tempDir = value;
+            } else if (arg == "--memory-mb") {
+                config.memoryBudget = static_cast<size_t>(std::stoull(value)) << 20;
+            } else if (arg == "--threads") {
+                config.threads = static_cast<unsigned>(std::stoul(value));
+            } else {
+                return false;
+            }
+        }
+        return !config.ledgerPath.empty() && config.memoryBudget > 0;
+    }
+
+    bool parseQueryOptions(int argc, char* argv[], QueryOptions& options) {
+        HistoryFilter& filter = options.filter;
+        uint32_t types = 0;
+        for (int i = 2; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--newest-first") {
+                filter.newestFirst = true;
+                continue;
+            }
+            if (arg == "--include-failed") {
+                filter.includeFailed = true;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                return false;
+            }
+            std::string value = argv[++i];
+            if (arg == "--dir") {
+                options.directory = value;
+            } else if (arg == "--account") {
+                options.account = value;
+            } else if (arg == "--type") {
+                uint32_t mask = HistoryFilter::typeMaskFor(value);
+                if (mask == 0) {
+                    return false;
+                }
+                types |= mask;
+            } else if (arg == "--from") {
+                if (!parseDay(value, filter.fromUs)) {
+                    return false;
+                }
+            } else if (arg == "--to") {
+                if (!parseDay(value, filter.toUs)) {
+                    return false;
+                }
+                filter.toUs += DAY_US;
+            } else if (arg == "--last-days") {
+                int64_t now = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+                filter.fromUs = now - static_cast<int64_t>(std::stoull(value)) * DAY_US;
+                filter.toUs = now + 1;
+            } else if (arg == "--min") {
+                if (!parseAmount(value, filter.minCents)) {
+                    return false;
+                }
+            } else if (arg == "--max") {
+                if (!parseAmount(value, filter.maxCents)) {
+                    return false;
+                }
+            } else if (arg == "--limit") {
+                filter.limit = static_cast<size_t>(std::stoull(value));
+            } else {
+                return false;
+            }
+        }
+        if (types != 0) {
+            filter.typeMask = types;
+        }
+        return !options.account.empty();
+    }
+
+    int runBuild(const HistoryBuildConfig& config) {
+        HistoryBuildStats stats;
+        bool ok = HistoryStore::build(config, stats);
+        std::printf("History:    %llu accounts, %llu entries in %llu blocks, %zu files under %s\n",
+                    static_cast<unsigned long long>(stats.accounts), static_cast<unsigned long long>(stats.entries),
+                    static_cast<unsigned long long>(stats.blocks), stats.partitions, config.outputDir.c_str());
+        std::printf("Built in:   %.2f s\n", stats.seconds);
+        return ok ? 0 : 1;
+    }
+
+    int runQuery(const QueryOptions& options) {
+        HistoryStore store;
+        if (!store.open(options.directory)) {
+            return 1;
+        }
+        std::vector<LedgerEntry> entries;
+        HistoryQueryStats stats;
+        auto started = std::chrono::steady_clock::now();
+        bool known = store.query(options.account, options.filter, entries, &stats);
+        double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - started).count();
+        if (!known) {
+            std::cerr << "No history for account " << options.account << std::endl;
+            return 2;
+        }
+
+        std::string text;
+        char line[160];
+        for (const LedgerEntry& entry : entries) {
+            char* out = FastText::writeDateTime(line, entry.timestampUs);
+            out += std::snprintf(out, 32, "  %-16s", Ledger::typeName(entry.type));
+            char amount[FastText::MAX_FIELD];
+            char* amountEnd = FastText::writeCents(amount, entry.amountCents);
+            out = FastText::writeRight(out, amount, static_cast<size_t>(amountEnd - amount), 14);
+            out += std::snprintf(out, 48, "  terminal %08x%s\n", entry.terminal,
+                                 (entry.flags & LEDGER_FLAG_FAILED) ? "  FAILED" : "");
+            text.append(line, out);
+        }
+        std::fwrite(text.data(), 1, text.size(), stdout);
+        std::printf("%zu entries; %llu blocks read, %llu skipped, %llu entries scanned in %.1f us\n",
+                    entries.size(), static_cast<unsigned long long>(stats.blocksScanned),
+                    static_cast<unsigned long long>(stats.blocksSkipped),
+                    static_cast<unsigned long long>(stats.entriesScanned), micros);
+        return 0;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string command = argc > 1 ? argv[1] : "";
+    try {
+        if (command == "build") {
+            HistoryBuildConfig config;
+            if (parseBuildOptions(argc, argv, config)) {
+                return runBuild(config);
+            }
+        } else if (command == "query") {
+            QueryOptions options;
+            if (parseQueryOptions(argc, argv, options)) {
+                return runQuery(options);
+            }
+        }
+    } catch (const std::exception&) {
+    }
+    printUsage(argv[0]);
+    return 1;
+}
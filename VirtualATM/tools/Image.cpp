@@ -0,0 +1,109 @@
+/*
+ * ATM Simulator - Warm-Start Images
+ *
+ * "write" loads an accounts file and checkpoints it, leaving the binary
+ * image the next start maps; "time" starts a store both ways, from the
+ * text file and from the image, and checks that they hold the same
+ * accounts.
+ */
+
+#include "AccountStore.h"
+#include "StoreImage.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+namespace {
+    void printUsage(const char* program) {
+        std::cerr << "Usage: " << program << " write --data PATH\n"
+                  << "       " << program << " time --data PATH" << std::endl;
+    }
+
+    double secondsSince(std::chrono::steady_clock::time_point started) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    }
+
+    int runWrite(const std::string& path) {
+        AccountStore store;
+        auto started = std::chrono::steady_clock::now();
+        store.load(path);
+        double loaded = secondsSince(started);
+        started = std::chrono::steady_clock::now();
+        if (!store.checkpoint()) {
+            std::cerr << "Error: Could not write " << StoreImage::pathFor(path) << std::endl;
+            return 1;
+        }
+        std::error_code error;
+        uintmax_t bytes = std::filesystem::file_size(StoreImage::pathFor(path), error);
+        std::printf("Loaded:     %zu accounts in %.2f s\n", store.size(), loaded);
+        std::printf("Image:      %s, %llu bytes, written with the accounts file in %.2f s\n",
+                    StoreImage::pathFor(path).c_str(), static_cast<unsigned long long>(bytes),
+                    secondsSince(started));
+        return 0;
+    }
+
+    // Every account has the same state and is found at the same position
+    bool sameAccounts(AccountStore& a, AccountStore& b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); ++i) {
+            AccountSnapshot left = a.at(i).getState();
+            AccountSnapshot right = b.at(i).getState();
+            std::string number = a.at(i).getAccountNumber();
+            if (number != b.at(i).getAccountNumber() || a.at(i).getPin() != b.at(i).getPin() ||
+                left.balance != right.balance || left.usageDay != right.usageDay ||
+                left.withdrawnTodayCents != right.withdrawnTodayCents || a.find(number) != &a.at(i) ||
+                b.find(number) != &b.at(i)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int runTime(const std::string& path) {
+        StoreImage image;
+        if (!image.open(path)) {
+            std::cerr << "Error: No current image for " << path << "; run write first" << std::endl;
+            return 1;
+        }
+        image.close();
+
+        double fromText;
+        double fromImage;
+        AccountStore text;
+        {
+            auto started = std::chrono::steady_clock::now();
+            text.load(path, false);
+            fromText = secondsSince(started);
+        }
+        AccountStore warm;
+        {
+            auto started = std::chrono::steady_clock::now();
+            warm.load(path);
+            fromImage = secondsSince(started);
+        }
+        bool same = sameAccounts(text, warm);
+        std::printf("Accounts:   %zu\n", text.size());
+        std::printf("Text start:  %.3f s\n", fromText);
+        std::printf("Image start: %.3f s (%.1fx faster)\n", fromImage, fromImage > 0 ? fromText / fromImage : 0.0);
+        std::printf("Compare:    %s\n", same ? "same accounts, same positions" : "MISMATCH");
+        return same ? 0 : 1;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string command = argc > 1 ? argv[1] : "";
+    if (argc == 4 && std::string(argv[2]) == "--data") {
+        if (command == "write") {
+            return runWrite(argv[3]);
+        }
+        if (command == "time") {
+            return runTime(argv[3]);
+        }
+    }
+    printUsage(argv[0]);
+    return 1;
+}
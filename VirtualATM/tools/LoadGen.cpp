@@ -0,0 +1,471 @@
+/*
+ * ATM Simulator - Load Generator
+ *
+ * Runs operation mixes directly against the AccountStore engine that backs
+ * ATM sessions, to size hardware:
+ *   closed loop: a fixed number of virtual terminals, each issuing its next
+ *                operation when the previous one finishes (optionally paced)
+ *   open loop:   a fixed arrival rate; latency is measured from the time an
+ *                operation was scheduled, so queueing delay is included
+ * Each worker records into its own latency histograms, merged at the end,
+ * with coordinated-omission correction for paced closed-loop runs.
+ * With --io, the journal and account saves go through a background I/O
+ * backend; --save-every makes terminals save like ATM sessions do.
+ */
+
+#include "AccountStore.h"
+#include "DatasetGenerator.h"
+#include "FastRandom.h"
+#include "LatencyHistogram.h"
+#include "Metrics.h"
+#include "Transaction.h"
+#include "ZipfDistribution.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    enum Operation { INQUIRY = 0, WITHDRAWAL, DEPOSIT, TRANSFER, OPERATION_COUNT };
+    const char* const OPERATION_NAMES[OPERATION_COUNT] = {"BALANCE_INQUIRY", "WITHDRAWAL", "DEPOSIT", "TRANSFER"};
+
+    using Clock = std::chrono::steady_clock;
+
+    struct LoadOptions {
+        std::string dataFile;
+        uint64_t generatedAccounts = 100000;
+        std::string mixName = "inquiry-heavy";
+        double mix[OPERATION_COUNT] = {80, 10, 10, 0};
+        bool openLoop = false;
+        unsigned terminals = 8;
+        double rate = 10000.0;
+        unsigned threads = 0;
+        double seconds = 10.0;
+        uint64_t paceUs = 0;
+        double zipfExponent = 0.99;
+        size_t hotAccounts = 0;
+        double hotFraction = 0.0;
+        uint64_t seed = 1;
+        std::string metricsFile;
+        std::string ledgerFile;
+        std::string closingFile;
+        std::string velocityRules;
+        double dailyLimit = 0.0;
+        std::string replicaSocket;
+        ReplicaAck replicaAck = ReplicaAck::Async;
+        std::string ioBackend;
+        JournalAck journalAck = JournalAck::Async;
+        uint64_t saveEvery = 0;
+    };
+
+    struct WorkerStats {
+        LatencyHistogram latency[OPERATION_COUNT];
+        uint64_t failed[OPERATION_COUNT] = {0, 0, 0, 0};
+    };
+
+    void printUsage(const char* program) {
+        std::cerr << "Usage: " << program << " [options]\n"
+                  << "  --data FILE              accounts file to load (default: generate --accounts)\n"
+                  << "  --accounts N             generated accounts when no --data (default 100000)\n"
+                  << "  --mix NAME|SPEC          inquiry-heavy | withdrawal-heavy | transfer-storm |\n"
+                  << "                           inquiry=70,withdrawal=20,deposit=10,transfer=0\n"
+                  << "  --closed N               closed loop with N virtual terminals (default 8)\n"
+                  << "  --open RATE              open loop at RATE operations per second\n"
+                  << "  --threads N              open-loop worker threads (default: all cores)\n"
+                  << "  --pace-us US             closed loop: intended interval between a terminal's ops\n"
+                  << "  --duration SEC           run time (default 10)\n"
+                  << "  --zipf S                 account popularity skew (default 0.99)\n"
+                  << "  --hot N --hot-fraction F send fraction F of operations to N hot accounts\n"
+                  << "  --seed S                 workload seed\n"
+                  << "  --metrics-file FILE      write engine metrics (Prometheus text) every second\n"
+                  << "  --ledger FILE            journal every posting to a binary ledger\n"
+                  << "  --closing FILE           write the final balances here after the run\n"
+                  << "  --velocity-rules FILE    check withdrawals against these velocity rules\n"
+                  << "  --daily-limit AMOUNT     per-account daily withdrawal limit\n"
+                  << "  --replica-socket PATH    ship postings to the atm_standby listening here\n"
+                  << "  --replica-ack MODE       async (default) | durable: wait for the standby's sync\n"
+                  << "  --io BACKEND             uring | threads | auto: journal and save in the background\n"
+                  << "  --io-ack MODE            async (default) | durable: wait for the journal sync\n"
+                  << "  --save-every N           save the accounts file after every N operations of a terminal"
+                  << std::endl;
+    }
+
+    bool applyMix(const std::string& spec, LoadOptions& options) {
+        options.mixName = spec;
+        if (spec == "inquiry-heavy") {
+            double mix[] = {80, 10, 10, 0};
+            std::copy(mix, mix + OPERATION_COUNT, options.mix);
+        } else if (spec == "withdrawal-heavy") {
+            double mix[] = {20, 60, 20, 0};
+            std::copy(mix, mix + OPERATION_COUNT, options.mix);
+        } else if (spec == "transfer-storm") {
+            double mix[] = {20, 10, 0, 70};
+            std::copy(mix, mix + OPERATION_COUNT, options.mix);
+            if (options.hotAccounts == 0) {
+                options.hotAccounts = 16;
+                options.hotFraction = 0.9;
+            }
+        } else {
+            std::fill(options.mix, options.mix + OPERATION_COUNT, 0.0);
+            std::stringstream ss(spec);
+            std::string part;
+            while (std::getline(ss, part, ',')) {
+                size_t eq = part.find('=');
+                if (eq == std::string::npos) {
+                    return false;
+                }
+                std::string name = part.substr(0, eq);
+                double weight = std::stod(part.substr(eq + 1));
+                if (name == "inquiry") options.mix[INQUIRY] = weight;
+                else if (name == "withdrawal") options.mix[WITHDRAWAL] = weight;
+                else if (name == "deposit") options.mix[DEPOSIT] = weight;
+                else if (name == "transfer") options.mix[TRANSFER] = weight;
+                else return false;
+            }
+        }
+        double total = 0;
+        for (double weight : options.mix) {
+            total += weight;
+        }
+        return total > 0;
+    }
+
+    bool parseOptions(int argc, char* argv[], LoadOptions& options) {
+        std::string mixSpec = options.mixName;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            std::string value = argv[++i];
+            if (arg == "--data") options.dataFile = value;
+            else if (arg == "--accounts") options.generatedAccounts = std::stoull(value);
+            else if (arg == "--mix") mixSpec = value;
+            else if (arg == "--closed") { options.openLoop = false; options.terminals = std::stoul(value); }
+            else if (arg == "--open") { options.openLoop = true; options.rate = std::stod(value); }
+            else if (arg == "--threads") options.threads = std::stoul(value);
+            else if (arg == "--pace-us") options.paceUs = std::stoull(value);
+            else if (arg == "--duration") options.seconds = std::stod(value);
+            else if (arg == "--zipf") options.zipfExponent = std::stod(value);
+            else if (arg == "--hot") options.hotAccounts = std::stoul(value);
+            else if (arg == "--hot-fraction") options.hotFraction = std::stod(value);
+            else if (arg == "--seed") options.seed = std::stoull(value);
+            else if (arg == "--metrics-file") options.metricsFile = value;
+            else if (arg == "--ledger") options.ledgerFile = value;
+            else if (arg == "--closing") options.closingFile = value;
+            else if (arg == "--velocity-rules") options.velocityRules = value;
+            else if (arg == "--daily-limit") options.dailyLimit = std::stod(value);
+            else if (arg == "--replica-socket") options.replicaSocket = value;
+            else if (arg == "--replica-ack") {
+                if (!ReplicationSender::parseAck(value, options.replicaAck)) return false;
+            }
+            else if (arg == "--io") options.ioBackend = value;
+            else if (arg == "--io-ack") {
+                if (!AsyncJournal::parseAck(value, options.journalAck)) return false;
+            }
+            else if (arg == "--save-every") options.saveEvery = std::stoull(value);
+            else return false;
+        }
+        return applyMix(mixSpec, options) && options.seconds > 0 && options.terminals > 0 && options.rate > 0;
+    }
+
+    // Picks operations and accounts for one worker
+    class Workload {
+    private:
+        const LoadOptions& options;
+        AccountStore& store;
+        const ZipfDistribution& popularity;
+        FastRandom random;
+        double cumulative[OPERATION_COUNT];
+        uint64_t sinceSave;
+
+    public:
+        Workload(const LoadOptions& options, AccountStore& store, const ZipfDistribution& popularity, uint64_t seed)
+            : options(options), store(store), popularity(popularity), random(seed), sinceSave(0) {
+            double total = 0;
+            for (int op = 0; op < OPERATION_COUNT; ++op) {
+                total += options.mix[op];
+            }
+            double running = 0;
+            for (int op = 0; op < OPERATION_COUNT; ++op) {
+                running += options.mix[op] / total;
+                cumulative[op] = running;
+            }
+        }
+
+        int nextOperation() {
+            double u = random.uniform();
+            for (int op = 0; op < OPERATION_COUNT - 1; ++op) {
+                if (u < cumulative[op]) {
+                    return op;
+                }
+            }
+            return OPERATION_COUNT - 1;
+        }
+
+        // Zipf rank scattered over the table, or one of the hot accounts
+        Account& nextAccount() {
+            size_t n = store.size();
+            if (options.hotAccounts > 0 && random.uniform() < options.hotFraction) {
+                return store.at(random.below(std::min(options.hotAccounts, n)));
+            }
+            uint64_t rank = popularity.sample(random) - 1;
+            return store.at(static_cast<size_t>((rank * 0x9E3779B97F4A7C15ULL) % n));
+        }
+
+        // Run one operation, then save if it is due (within the measured
+        // time, as a session saves before answering); returns whether the
+        // operation succeeded
+        bool execute(int op) {
+            bool succeeded = post(op);
+            if (options.saveEvery > 0 && ++sinceSave >= options.saveEvery) {
+                store.save();
+                sinceSave = 0;
+            }
+            return succeeded;
+        }
+
+    private:
+        bool post(int op) {
+            Account& account = nextAccount();
+            switch (op) {
+                case INQUIRY: {
+                    BalanceInquiry inquiry;
+                    return store.apply(inquiry, account);
+                }
+                case WITHDRAWAL: {
+                    Withdrawal withdrawal(static_cast<double>(20 * (1 + random.below(10))));
+                    return store.apply(withdrawal, account);
+                }
+                case DEPOSIT: {
+                    Deposit deposit(static_cast<double>(10 + random.below(500)));
+                    return store.apply(deposit, account);
+                }
+                default: {
+                    Transfer transfer(static_cast<double>(1 + random.below(100)), nextAccount());
+                    return store.transfer(transfer, account);
+                }
+            }
+        }
+    };
+
+    void closedLoopWorker(const LoadOptions& options, AccountStore& store, const ZipfDistribution& popularity,
+                          unsigned id, Clock::time_point deadline, WorkerStats& stats) {
+        Workload workload(options, store, popularity, options.seed * 1000003 + id);
+        const auto pace = std::chrono::microseconds(options.paceUs);
+        const uint64_t paceNs = options.paceUs * 1000;
+        auto nextStart = Clock::now();
+        while (true) {
+            auto start = Clock::now();
+            if (start >= deadline) {
+                break;
+            }
+            int op = workload.nextOperation();
+            bool ok = workload.execute(op);
+            uint64_t latency = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+            stats.latency[op].recordCorrected(latency, paceNs);
+            stats.failed[op] += ok ? 0 : 1;
+
+            if (options.paceUs > 0) {
+                nextStart += pace;
+                std::this_thread::sleep_until(nextStart);
+            }
+        }
+    }
+
+    // Each worker owns an equal share of the arrival schedule; latency runs
+    // from the scheduled time, so a backlog shows up as latency
+    void openLoopWorker(const LoadOptions& options, AccountStore& store, const ZipfDistribution& popularity,
+                        unsigned id, unsigned workers, Clock::time_point begin, Clock::time_point deadline,
+                        WorkerStats& stats) {
+        Workload workload(options, store, popularity, options.seed * 1000003 + id);
+        const double intervalNs = 1e9 * workers / options.rate;
+        const double offsetNs = intervalNs * id / workers;
+        for (uint64_t i = 0;; ++i) {
+            auto scheduled = begin + std::chrono::nanoseconds(static_cast<int64_t>(offsetNs + intervalNs * i));
+            if (scheduled >= deadline) {
+                break;
+            }
+            std::this_thread::sleep_until(scheduled);
+            int op = workload.nextOperation();
+            bool ok = workload.execute(op);
+            uint64_t latency = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - scheduled).count());
+            stats.latency[op].record(latency);
+            stats.failed[op] += ok ? 0 : 1;
+        }
+    }
+
+    bool prepareStore(const LoadOptions& options, AccountStore& store) {
+        std::string path = options.dataFile;
+        if (path.empty()) {
+            std::filesystem::create_directories("bench_data");
+            path = "bench_data/loadgen-" + std::to_string(options.generatedAccounts) + ".txt";
+            DatasetConfig config;
+            config.accounts = options.generatedAccounts;
+            config.seed = options.seed;
+            if (!DatasetGenerator(config).writeAccounts(path)) {
+                return false;
+            }
+        }
+        store.load(path);
+        return store.size() > 0;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    LoadOptions options;
+    try {
+        if (!parseOptions(argc, argv, options)) {
+            printUsage(argv[0]);
+            return 1;
+        }
+    } catch (const std::exception&) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    AccountStore store;
+    if (!prepareStore(options, store)) {
+        std::cerr << "Error: No accounts to run against." << std::endl;
+        return 1;
+    }
+    std::string error;
+    if (!options.ioBackend.empty() && !store.persistAsync(options.ioBackend, options.journalAck, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+    if (!options.ledgerFile.empty() && !store.openJournal(options.ledgerFile)) {
+        std::cerr << "Error: Could not open ledger " << options.ledgerFile << std::endl;
+        return 1;
+    }
+    store.setDailyLimit(Ledger::toCents(options.dailyLimit));
+    if (!options.velocityRules.empty() && !store.loadVelocityRules(options.velocityRules, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+    if (!options.replicaSocket.empty() && !store.replicateTo(options.replicaSocket, options.replicaAck, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+    ZipfDistribution popularity(store.size(), options.zipfExponent);
+    if (!options.metricsFile.empty()) {
+        AtmMetrics::get();
+        MetricsRegistry::instance().startExporter(options.metricsFile, 1000, 0);
+    }
+
+    unsigned workers = options.openLoop
+        ? (options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency()))
+        : options.terminals;
+    std::vector<WorkerStats> stats(workers);
+    std::vector<std::thread> threads;
+
+    auto begin = Clock::now();
+    auto deadline = begin + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.seconds));
+    for (unsigned id = 0; id < workers; ++id) {
+        if (options.openLoop) {
+            threads.emplace_back(openLoopWorker, std::cref(options), std::ref(store), std::cref(popularity), id,
+                                 workers, begin, deadline, std::ref(stats[id]));
+        } else {
+            threads.emplace_back(closedLoopWorker, std::cref(options), std::ref(store), std::cref(popularity), id,
+                                 deadline, std::ref(stats[id]));
+        }
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+    ReplicationSender* replica = store.getReplica();
+    auto drainBegin = Clock::now();
+    if (replica) {
+        replica->close();
+    }
+    double drain = std::chrono::duration<double>(Clock::now() - drainBegin).count();
+    auto persistBegin = Clock::now();
+    bool persisted = true;
+    if (store.getSaver()) {
+        persisted = store.getSaver()->wait();
+    }
+    if (store.getAsyncJournal()) {
+        persisted = store.getAsyncJournal()->flush() && persisted;
+    }
+    double persist = std::chrono::duration<double>(Clock::now() - persistBegin).count();
+    MetricsRegistry::instance().stopExporter();
+    if (!options.closingFile.empty() && !store.saveTo(options.closingFile)) {
+        std::cerr << "Error: Could not write " << options.closingFile << std::endl;
+        return 1;
+    }
+
+    LatencyHistogram merged[OPERATION_COUNT];
+    LatencyHistogram all;
+    uint64_t failed[OPERATION_COUNT] = {0, 0, 0, 0};
+    for (const auto& worker : stats) {
+        for (int op = 0; op < OPERATION_COUNT; ++op) {
+            merged[op].merge(worker.latency[op]);
+            all.merge(worker.latency[op]);
+            failed[op] += worker.failed[op];
+        }
+    }
+
+    std::printf("Accounts:   %zu\n", store.size());
+    std::printf("Mix:        %s\n", options.mixName.c_str());
+    if (options.openLoop) {
+        std::printf("Mode:       open loop, %.0f ops/s target on %u threads\n", options.rate, workers);
+    } else {
+        std::printf("Mode:       closed loop, %u terminals%s\n", workers, options.paceUs ? " (paced)" : "");
+    }
+    std::printf("Duration:   %.2f s\n\n", elapsed);
+
+    std::printf("%-16s %12s %12s %10s %10s %10s %10s %10s\n", "Operation", "Count", "Ops/s", "Failed",
+                "p50(us)", "p99(us)", "p99.9(us)", "Max(us)");
+    auto row = [&](const char* name, const LatencyHistogram& h, uint64_t failures) {
+        std::printf("%-16s %12llu %12.0f %10llu %10.2f %10.2f %10.2f %10.2f\n", name,
+                    static_cast<unsigned long long>(h.getCount()), static_cast<double>(h.getCount()) / elapsed,
+                    static_cast<unsigned long long>(failures), h.percentile(50) / 1000.0,
+                    h.percentile(99) / 1000.0, h.percentile(99.9) / 1000.0, h.getMax() / 1000.0);
+    };
+    uint64_t totalFailed = 0;
+    for (int op = 0; op < OPERATION_COUNT; ++op) {
+        if (merged[op].getCount() > 0) {
+            row(OPERATION_NAMES[op], merged[op], failed[op]);
+        }
+        totalFailed += failed[op];
+    }
+    row("ALL", all, totalFailed);
+    if (replica) {
+        std::printf("\nReplication (%s): %llu entries shipped, %llu acknowledged, %.0f entries/s; "
+                    "%.1f ms to drain at the end%s\n",
+                    ReplicationSender::ackName(replica->getMode()),
+                    static_cast<unsigned long long>(replica->getPublished()),
+                    static_cast<unsigned long long>(replica->getAcknowledged()),
+                    static_cast<double>(replica->getPublished()) / elapsed, drain * 1000.0,
+                    replica->getAcknowledged() == replica->getPublished() ? "" : " (standby lost)");
+    }
+    if (const AsyncIO* io = store.getIo()) {
+        const AsyncJournal* journal = store.getAsyncJournal();
+        const AsyncSaver* saver = store.getSaver();
+        uint64_t batches = journal ? journal->getBatches() : 0;
+        std::printf("\nPersistence (%s, %s): %llu journal entries in %llu synced batches (%.1f per batch), "
+                    "%llu saves written, %llu superseded, %llu submissions; %.1f ms to drain at the end%s\n",
+                    io->getName(), AsyncJournal::ackName(options.journalAck),
+                    static_cast<unsigned long long>(journal ? journal->getDurable() : 0),
+                    static_cast<unsigned long long>(batches),
+                    batches ? static_cast<double>(journal->getDurable()) / batches : 0.0,
+                    static_cast<unsigned long long>(saver->getSaved()),
+                    static_cast<unsigned long long>(saver->getSuperseded()),
+                    static_cast<unsigned long long>(io->getSubmissions()), persist * 1000.0,
+                    persisted ? "" : " (write failed)");
+    }
+    if (options.paceUs > 0 && !options.openLoop) {
+        std::printf("\nCounts include coordinated-omission corrections for the %llu us pacing interval.\n",
+                    static_cast<unsigned long long>(options.paceUs));
+    }
+    return 0;
+}
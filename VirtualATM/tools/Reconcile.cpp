@@ -0,0 +1,142 @@
+/*
+ * ATM Simulator - End-of-Day Reconciliation
+ *
+ * Checks an accounts table against the transaction ledger: total
+ * liabilities, per-type counts and sums, net flow per account, and every
+ * account whose closing balance is not its opening balance plus postings.
+ * Exits 0 when everything reconciles, 3 when mismatches were found.
+ */
+
+#include "FastText.h"
+#include "Ledger.h"
+#include "Reconciler.h"
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+namespace {
+    struct ReconcileOptions {
+        std::string openingPath;
+        std::string closingPath;
+        std::string ledgerPath;
+        std::string mismatchesPath;
+        std::string netPath;
+        unsigned threads = 0;
+    };
+
+    void printUsage(const char* program) {
+        std::cerr << "Usage: " << program << " --opening PATH --ledger PATH [options]\n"
+                  << "  --closing PATH           accounts file to check (default: report the projection)\n"
+                  << "  --threads T              scan threads (default: all cores)\n"
+                  << "  --mismatches-out PATH    write mismatching accounts as CSV\n"
+                  << "  --net-out PATH           write per-account net flow as CSV" << std::endl;
+    }
+
+    bool parseOptions(int argc, char* argv[], ReconcileOptions& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            std::string value = argv[++i];
+            if (arg == "--opening") {
+                options.openingPath = value;
+            } else if (arg == "--closing") {
+                options.closingPath = value;
+            } else if (arg == "--ledger") {
+                options.ledgerPath = value;
+            } else if (arg == "--threads") {
+                options.threads = static_cast<unsigned>(std::stoul(value));
+            } else if (arg == "--mismatches-out") {
+                options.mismatchesPath = value;
+            } else if (arg == "--net-out") {
+                options.netPath = value;
+            } else {
+                return false;
+            }
+        }
+        return !options.openingPath.empty() && !options.ledgerPath.empty();
+    }
+
+    std::string money(int64_t cents) {
+        char text[FastText::MAX_FIELD];
+        return std::string(text, FastText::writeCents(text, cents));
+    }
+
+    void printReport(const ReconcileReport& report) {
+        std::printf("Accounts:             %llu", static_cast<unsigned long long>(report.accounts));
+        if (report.malformedLines || report.duplicateAccounts) {
+            std::printf(" (%llu malformed lines, %llu duplicates skipped)",
+                        static_cast<unsigned long long>(report.malformedLines),
+                        static_cast<unsigned long long>(report.duplicateAccounts));
+        }
+        std::printf("\nOpening liabilities:  %s\n", money(report.openingLiabilitiesCents).c_str());
+        std::printf("Ledger entries:       %llu\n\n", static_cast<unsigned long long>(report.ledgerEntries));
+
+        std::printf("%-16s %14s %10s %20s\n", "Type", "Count", "Failed", "Posted");
+        for (size_t type = 0; type < ReconcileReport::TYPE_SLOTS; ++type) {
+            const TypeTotals& totals = report.types[type];
+            if (totals.count == 0) {
+                continue;
+            }
+            std::printf("%-16s %14llu %10llu %20s\n", Ledger::typeName(static_cast<uint8_t>(type)),
+                        static_cast<unsigned long long>(totals.count), static_cast<unsigned long long>(totals.failed),
+                        money(totals.sumCents).c_str());
+        }
+
+        std::printf("\nNet flow:             %s over %llu accounts\n", money(report.netFlowCents).c_str(),
+                    static_cast<unsigned long long>(report.accountsWithFlow));
+        if (report.unknownAccountEntries) {
+            std::printf("Unknown accounts:     %llu postings skipped\n",
+                        static_cast<unsigned long long>(report.unknownAccountEntries));
+        }
+        std::printf("Closing liabilities:  %s%s\n", money(report.closingLiabilitiesCents).c_str(),
+                    report.closingChecked ? "" : " (projected)");
+        if (report.closingChecked) {
+            int64_t expected = report.openingLiabilitiesCents + report.netFlowCents;
+            std::printf("Expected closing:     %s (difference %s)\n", money(expected).c_str(),
+                        money(report.closingLiabilitiesCents - expected).c_str());
+            std::printf("Closing accounts:     %llu (%llu missing, %llu new)\n",
+                        static_cast<unsigned long long>(report.closingAccounts),
+                        static_cast<unsigned long long>(report.missingFromClosing),
+                        static_cast<unsigned long long>(report.newInClosing));
+            std::printf("Mismatches:           %llu\n", static_cast<unsigned long long>(report.mismatchCount));
+        }
+        std::printf("\nTimings: opening %.2f s, ledger %.2f s, closing %.2f s\n", report.openingSeconds,
+                    report.ledgerSeconds, report.closingSeconds);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    ReconcileOptions options;
+    try {
+        if (!parseOptions(argc, argv, options)) {
+            printUsage(argv[0]);
+            return 1;
+        }
+    } catch (const std::exception&) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    Reconciler reconciler(options.threads);
+    std::cout << "Reconciling with " << reconciler.getThreads() << " threads..." << std::endl;
+    if (!reconciler.loadOpening(options.openingPath) || !reconciler.applyLedger(options.ledgerPath)) {
+        return 1;
+    }
+    if (!options.closingPath.empty() && !reconciler.checkClosing(options.closingPath)) {
+        return 1;
+    }
+
+    const ReconcileReport& report = reconciler.getReport();
+    printReport(report);
+
+    if (!options.netPath.empty() && !reconciler.writeNetFlows(options.netPath)) {
+        return 1;
+    }
+    if (!options.mismatchesPath.empty() && !reconciler.writeMismatches(options.mismatchesPath)) {
+        return 1;
+    }
+    bool reconciled = report.mismatchCount == 0 && report.missingFromClosing == 0 && report.newInClosing == 0;
+    return reconciled ? 0 : 3;
+}
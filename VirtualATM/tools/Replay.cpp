@@ -0,0 +1,210 @@
+/*
+ * ATM Simulator - Session Replayer
+ *
+ * Drives N ATM sessions in parallel from recorded input traces (see
+ * atm_app --record) and reports throughput and per-operation latency.
+ * Every session runs against its own copy of the account file, so a replay
+ * is deterministic: the same traces always produce the same outcome digest,
+ * which makes numbers from different builds comparable.
+ */
+
+#include "ATM.h"
+#include "FileManager.h"
+#include "LoginThrottle.h"
+#include "SessionTrace.h"
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    struct ReplayOptions {
+        size_t sessions = 1;
+        size_t threads = 0;
+        TraceReplay::Pace pace = TraceReplay::Pace::AsFastAsPossible;
+        std::string dataFile = FileManager::defaultDataFilePath();
+        std::string scratchDir = "replay_data";
+        std::string traceOutput;
+        std::vector<std::string> traceFiles;
+    };
+
+    struct SessionResult {
+        uint64_t digest = 0;
+        size_t inputs = 0;
+        bool desynchronized = false;
+        std::vector<uint64_t> latencies[TraceReplay::OPERATION_COUNT];
+    };
+
+    void printUsage(const char* program) {
+        std::cerr << "Usage: " << program << " [--sessions N] [--threads N] [--pace original|max]\n"
+                  << "       [--data accounts.txt] [--scratch DIR] [--trace-out spans.json]\n"
+                  << "       trace.bin [trace.bin ...]" << std::endl;
+    }
+
+    bool parseOptions(int argc, char* argv[], ReplayOptions& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--sessions" && hasValue) {
+                options.sessions = std::stoul(argv[++i]);
+            } else if (arg == "--threads" && hasValue) {
+                options.threads = std::stoul(argv[++i]);
+            } else if (arg == "--pace" && hasValue) {
+                std::string pace = argv[++i];
+                if (pace == "original") {
+                    options.pace = TraceReplay::Pace::Original;
+                } else if (pace == "max") {
+                    options.pace = TraceReplay::Pace::AsFastAsPossible;
+                } else {
+                    return false;
+                }
+            } else if (arg == "--data" && hasValue) {
+                options.dataFile = argv[++i];
+            } else if (arg == "--scratch" && hasValue) {
+                options.scratchDir = argv[++i];
+            } else if (arg == "--trace-out" && hasValue) {
+                options.traceOutput = argv[++i];
+            } else if (!arg.empty() && arg[0] != '-') {
+                options.traceFiles.push_back(arg);
+            } else {
+                return false;
+            }
+        }
+        return !options.traceFiles.empty() && options.sessions > 0;
+    }
+
+    // One session: private account file, private throttle, captured output
+    void runSession(size_t index, const ReplayOptions& options,
+                    const std::vector<SessionTrace::Event>& trace, SessionResult& result) {
+        std::string sessionFile = options.scratchDir + "/session-" + std::to_string(index) + ".txt";
+        if (!FileManager::copyDataFile(options.dataFile, sessionFile)) {
+            std::cerr << "Error: Could not prepare " << sessionFile << std::endl;
+            return;
+        }
+
+        LoginThrottle throttle;
+        TraceReplay replay(trace, options.pace);
+        SessionConfig config;
+        config.dataFilePath = sessionFile;
+        config.terminalId = "replay-" + std::to_string(index);
+        config.throttle = &throttle;
+        config.replay = &replay;
+
+        ATM session(config);
+        replay.resetClock();
+        session.start();
+        replay.finish();
+
+        result.digest = session.getOutputDigest();
+        result.inputs = replay.getConsumed();
+        result.desynchronized = replay.wasDesynchronized();
+        for (int op = 0; op < TraceReplay::OPERATION_COUNT; ++op) {
+            result.latencies[op] = replay.getLatencies(op);
+        }
+    }
+
+    double percentileUs(const std::vector<uint64_t>& sorted, double fraction) {
+        size_t rank = static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1) + 0.5);
+        return static_cast<double>(sorted[std::min(rank, sorted.size() - 1)]) / 1000.0;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    ReplayOptions options;
+    try {
+        if (!parseOptions(argc, argv, options)) {
+            printUsage(argv[0]);
+            return 1;
+        }
+    } catch (const std::exception&) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<std::vector<SessionTrace::Event>> traces(options.traceFiles.size());
+    for (size_t i = 0; i < traces.size(); ++i) {
+        if (!SessionTrace::load(options.traceFiles[i], traces[i])) {
+            std::cerr << "Error: Could not read trace " << options.traceFiles[i] << std::endl;
+            return 1;
+        }
+    }
+    std::filesystem::create_directories(options.scratchDir);
+
+    // Sleeping sessions only overlap with one thread each; busy ones need cores
+    size_t threads = options.threads;
+    if (threads == 0) {
+        threads = options.pace == TraceReplay::Pace::Original
+            ? options.sessions
+            : std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    threads = std::min(threads, options.sessions);
+
+    Tracer::setEnabled(!options.traceOutput.empty());
+    std::vector<SessionResult> results(options.sessions);
+    std::atomic<size_t> nextSession(0);
+    auto started = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&]() {
+            for (size_t i = nextSession++; i < options.sessions; i = nextSession++) {
+                runSession(i, options, traces[i % traces.size()], results[i]);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    if (!options.traceOutput.empty() && !Tracer::dump(options.traceOutput)) {
+        std::cerr << "Warning: Could not write " << options.traceOutput << std::endl;
+    }
+
+    // Merge per-session results in session order so the digest is stable
+    uint64_t digest = 1469598103934665603ULL;
+    size_t inputs = 0;
+    size_t desynchronized = 0;
+    std::vector<uint64_t> merged[TraceReplay::OPERATION_COUNT];
+    for (const auto& result : results) {
+        digest = (digest ^ result.digest) * 1099511628211ULL;
+        inputs += result.inputs;
+        desynchronized += result.desynchronized ? 1 : 0;
+        for (int op = 0; op < TraceReplay::OPERATION_COUNT; ++op) {
+            merged[op].insert(merged[op].end(), result.latencies[op].begin(), result.latencies[op].end());
+        }
+    }
+
+    std::printf("Sessions:        %zu on %zu threads (%s pace)\n", options.sessions, threads,
+                options.pace == TraceReplay::Pace::Original ? "original" : "max");
+    std::printf("Inputs replayed: %zu\n", inputs);
+    std::printf("Wall time:       %.3f s\n", seconds);
+    std::printf("Throughput:      %.1f sessions/s, %.1f inputs/s\n",
+                static_cast<double>(options.sessions) / seconds, static_cast<double>(inputs) / seconds);
+    std::printf("Desynchronized:  %zu\n", desynchronized);
+    std::printf("Outcome digest:  %016llx\n\n", static_cast<unsigned long long>(digest));
+
+    std::printf("%-12s %10s %12s %12s %12s %12s\n", "Operation", "Count", "Mean(us)", "p50(us)", "p99(us)", "Max(us)");
+    for (int op = 0; op < TraceReplay::OPERATION_COUNT; ++op) {
+        std::vector<uint64_t>& samples = merged[op];
+        if (samples.empty()) {
+            continue;
+        }
+        std::sort(samples.begin(), samples.end());
+        double total = 0;
+        for (uint64_t sample : samples) {
+            total += static_cast<double>(sample);
+        }
+        std::printf("%-12s %10zu %12.1f %12.1f %12.1f %12.1f\n", TraceReplay::operationName(op), samples.size(),
+                    total / static_cast<double>(samples.size()) / 1000.0, percentileUs(samples, 0.50),
+                    percentileUs(samples, 0.99), static_cast<double>(samples.back()) / 1000.0);
+    }
+
+    return desynchronized == 0 ? 0 : 2;
+}
@@ -0,0 +1,204 @@
+/*
+ * ATM Simulator - Ledger Sealing
+ *
+ * "seal" rewrites a closed ledger segment as a block-compressed, indexed
+ * cold segment; "query" reads one account's entries back out of it, and
+ * "stat" decodes every block to check it and time the decoder.
+ */
+
+#include "AccountKey.h"
+#include "FastText.h"
+#include "SealedSegment.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <string>
+
+namespace {
+    const int64_t DAY_US = 86400LL * 1000000LL;
+
+    struct QueryOptions {
+        std::string segment;
+        std::string account;
+        int64_t fromUs = std::numeric_limits<int64_t>::min();
+        int64_t toUs = std::numeric_limits<int64_t>::max();
+    };
+
+    void printUsage(const char* program) {
+        std::cerr << "Usage: " << program << " seal --ledger PATH --out PATH [options]\n"
+                  << "  --tmp DIR                scratch directory (default <out>.tmp)\n"
+                  << "  --memory-mb M            memory budget in MiB (default 256)\n"
+                  << "  --threads T              worker threads (default: all cores)\n"
+                  << "       " << program << " query --segment PATH --account NUMBER [options]\n"
+                  << "  --from YYYY-MM-DD        first day (UTC)\n"
+                  << "  --to YYYY-MM-DD          last day, inclusive\n"
+                  << "       " << program << " stat --segment PATH" << std::endl;
+    }
+
+    bool parseDay(const std::string& text, int64_t& microseconds) {
+        int year = 0, month = 0, day = 0;
+        if (std::sscanf(text.c_str(), "%d-%d-%d", &year, &month, &day) != 3 || month < 1 || month > 12 || day < 1) {
+            return false;
+        }
+        microseconds = FastText::daysFromCivil(year, static_cast<unsigned>(month), static_cast<unsigned>(day)) * DAY_US;
+        return true;
+    }
+
+    bool parseSealOptions(int argc, char* argv[], SealConfig& config) {
+        for (int i = 2; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            std::string value = argv[++i];
+            if (arg == "--ledger") {
+                config.ledgerPath = value;
+            } else if (arg == "--out") {
+                config.outputPath = value;
+            } else if (arg == "--tmp") {
+                config.tempDir = value;
+            } else if (arg == "--memory-mb") {
+                config.memoryBudget = static_cast<size_t>(std::stoull(value)) << 20;
+            } else if (arg == "--threads") {
+                config.threads = static_cast<unsigned>(std::stoul(value));
+            } else {
+                return false;
+            }
+        }
+        return !config.ledgerPath.empty() && !config.outputPath.empty() && config.memoryBudget > 0;
+    }
+
+    bool parseQueryOptions(int argc, char* argv[], QueryOptions& options) {
+        for (int i = 2; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            std::string value = argv[++i];
+            if (arg == "--segment") {
+                options.segment = value;
+            } else if (arg == "--account") {
+                options.account = value;
+            } else if (arg == "--from") {
+                if (!parseDay(value, options.fromUs)) {
+                    return false;
+                }
+            } else if (arg == "--to") {
+                if (!parseDay(value, options.toUs)) {
+                    return false;
+                }
+                options.toUs += DAY_US;
+            } else {
+                return false;
+            }
+        }
+        return !options.segment.empty() && !options.account.empty();
+    }
+
+    // Decode the whole segment and report the decoder's throughput
+    bool reportVerify(const SealedSegment& segment) {
+        SegmentReadStats stats;
+        auto started = std::chrono::steady_clock::now();
+        bool ok = segment.verify(stats);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        double rawMB = static_cast<double>(stats.entriesDecoded * sizeof(LedgerEntry)) / 1e6;
+        std::printf("Decoded:    %llu blocks, %llu entries in %.3f s (%.0f MB/s of entries, %.1f M entries/s)\n",
+                    static_cast<unsigned long long>(stats.blocksDecoded),
+                    static_cast<unsigned long long>(stats.entriesDecoded), seconds,
+                    seconds > 0 ? rawMB / seconds : 0.0,
+                    seconds > 0 ? static_cast<double>(stats.entriesDecoded) / seconds / 1e6 : 0.0);
+        std::printf("Verify:     %s\n", ok ? "count and checksum match" : "FAILED");
+        return ok;
+    }
+
+    int runSeal(const SealConfig& config) {
+        SealStats stats;
+        if (!SealedSegment::seal(config, stats)) {
+            return 1;
+        }
+        uint64_t rawBytes = stats.entries * sizeof(LedgerEntry);
+        std::printf("Sealed:     %llu entries in %llu blocks from %zu partitions into %s\n",
+                    static_cast<unsigned long long>(stats.entries), static_cast<unsigned long long>(stats.blocks),
+                    stats.partitions, config.outputPath.c_str());
+        std::printf("Size:       %llu raw, %llu column-encoded, %llu sealed bytes (ratio %.2fx)\n",
+                    static_cast<unsigned long long>(rawBytes), static_cast<unsigned long long>(stats.encodedBytes),
+                    static_cast<unsigned long long>(stats.sealedBytes),
+                    stats.sealedBytes ? static_cast<double>(rawBytes) / static_cast<double>(stats.sealedBytes) : 0.0);
+        std::printf("Sealed in:  %.2f s\n", stats.seconds);
+        SealedSegment segment;
+        return segment.open(config.outputPath) && reportVerify(segment) ? 0 : 1;
+    }
+
+    int runQuery(const QueryOptions& options) {
+        SealedSegment segment;
+        if (!segment.open(options.segment)) {
+            return 1;
+        }
+        uint64_t key = AccountKey::ledgerKey(options.account);
+        std::vector<LedgerEntry> entries;
+        SegmentReadStats stats;
+        auto started = std::chrono::steady_clock::now();
+        bool known = key != 0 && segment.query(key, options.fromUs, options.toUs, entries, &stats);
+        double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - started).count();
+        if (!known) {
+            std::cerr << "No entries for account " << options.account << std::endl;
+            return 2;
+        }
+
+        std::string text;
+        char line[160];
+        for (const LedgerEntry& entry : entries) {
+            char* out = FastText::writeDateTime(line, entry.timestampUs);
+            out += std::snprintf(out, 32, "  %-16s", Ledger::typeName(entry.type));
+            char amount[FastText::MAX_FIELD];
+            char* amountEnd = FastText::writeCents(amount, entry.amountCents);
+            out = FastText::writeRight(out, amount, static_cast<size_t>(amountEnd - amount), 14);
+            out += std::snprintf(out, 48, "  terminal %08x%s\n", entry.terminal,
+                                 (entry.flags & LEDGER_FLAG_FAILED) ? "  FAILED" : "");
+            text.append(line, out);
+        }
+        std::fwrite(text.data(), 1, text.size(), stdout);
+        std::printf("%zu entries; %llu of %llu blocks decoded (%llu bytes) in %.1f us\n", entries.size(),
+                    static_cast<unsigned long long>(stats.blocksDecoded),
+                    static_cast<unsigned long long>(segment.getBlocks()),
+                    static_cast<unsigned long long>(stats.bytesRead), micros);
+        return 0;
+    }
+
+    int runStat(const std::string& path) {
+        SealedSegment segment;
+        if (!segment.open(path)) {
+            return 1;
+        }
+        uint64_t rawBytes = segment.getEntries() * sizeof(LedgerEntry);
+        std::printf("Segment:    %llu entries in %llu blocks, %llu bytes (ratio %.2fx)\n",
+                    static_cast<unsigned long long>(segment.getEntries()),
+                    static_cast<unsigned long long>(segment.getBlocks()),
+                    static_cast<unsigned long long>(segment.getFileBytes()),
+                    segment.getFileBytes() ? static_cast<double>(rawBytes) / segment.getFileBytes() : 0.0);
+        return reportVerify(segment) ? 0 : 1;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string command = argc > 1 ? argv[1] : "";
+    try {
+        if (command == "seal") {
+            SealConfig config;
+            if (parseSealOptions(argc, argv, config)) {
+                return runSeal(config);
+            }
+        } else if (command == "query") {
+            QueryOptions options;
+            if (parseQueryOptions(argc, argv, options)) {
+                return runQuery(options);
+            }
+        } else if (command == "stat" && argc == 4 && std::string(argv[2]) == "--segment") {
+            return runStat(argv[3]);
+        }
+    } catch (const std::exception&) {
+    }
+    printUsage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,101 @@
+/*
+ * ATM Simulator - Account Shard
+ *
+ * One backend process of a sharded deployment. It loads the accounts file,
+ * keeps the accounts that consistent hashing assigns to its shard id and
+ * serves routed requests on a Unix domain socket until the router shuts it
+ * down. A shard started without --data begins empty and is filled by the
+ * router's rebalancing when it is added to a running deployment.
+ */
+
+#include "AccountStore.h"
+#include "Ledger.h"
+#include "Sharding.h"
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+namespace {
+    struct ShardOptions {
+        std::string socketPath;
+        std::string dataFile;
+        std::string saveFile;
+        std::string velocityRules;
+        double dailyLimit = 0.0;
+        uint32_t shard = 0;
+        uint32_t shards = 1;
+    };
+
+    void printUsage(const char* program) {
+        std::cerr << "Usage: " << program << " --socket PATH [options]\n"
+                  << "  --data FILE              accounts file shared by all shards\n"
+                  << "  --shard I --shards N     keep the accounts shard I of N owns (default 0 of 1)\n"
+                  << "  --save FILE              write the accounts this shard owns at shutdown\n"
+                  << "  --daily-limit AMOUNT     per-account daily withdrawal limit\n"
+                  << "  --velocity-rules FILE    check withdrawals against these velocity rules" << std::endl;
+    }
+
+    bool parseOptions(int argc, char* argv[], ShardOptions& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            std::string value = argv[++i];
+            if (arg == "--socket") options.socketPath = value;
+            else if (arg == "--data") options.dataFile = value;
+            else if (arg == "--save") options.saveFile = value;
+            else if (arg == "--shard") options.shard = static_cast<uint32_t>(std::stoul(value));
+            else if (arg == "--shards") options.shards = static_cast<uint32_t>(std::stoul(value));
+            else if (arg == "--daily-limit") options.dailyLimit = std::stod(value);
+            else if (arg == "--velocity-rules") options.velocityRules = value;
+            else return false;
+        }
+        return !options.socketPath.empty() && options.shards > 0 && options.shard < options.shards;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    ShardOptions options;
+    try {
+        if (!parseOptions(argc, argv, options)) {
+            printUsage(argv[0]);
+            return 1;
+        }
+    } catch (const std::exception&) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    AccountStore store;
+    if (options.dataFile.empty()) {
+        store.adopt(std::vector<Account>(), options.saveFile);
+    } else {
+        store.load(options.dataFile);
+        ShardServer::filterOwned(store, options.shard, options.shards);
+    }
+    std::string error;
+    store.setDailyLimit(Ledger::toCents(options.dailyLimit));
+    if (!options.velocityRules.empty() && !store.loadVelocityRules(options.velocityRules, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+    ShardServer server(store);
+    if (!server.listen(options.socketPath, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+    if (options.dataFile.empty()) {
+        std::fprintf(stderr, "Shard waiting for accounts on %s\n", options.socketPath.c_str());
+    } else {
+        std::fprintf(stderr, "Shard %u of %u: %zu accounts on %s\n", options.shard, options.shards, store.size(),
+                     options.socketPath.c_str());
+    }
+    server.serve();
+
+    if (!options.saveFile.empty() && !server.saveOwned(options.saveFile)) {
+        std::cerr << "Error: Could not write " << options.saveFile << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,305 @@
+/*
+ * ATM Simulator - Shard Scaling Benchmark
+ *
+ * Starts 1, 2, 4 ... atm_shard processes over the same accounts file and
+ * drives withdrawals and deposits through a ShardRouter from a fixed number
+ * of client threads, reporting posting throughput and the speedup over one
+ * shard. With --rebalance the largest run also adds one more shard halfway
+ * through and reports how many accounts moved and how long postings were
+ * held back. Shards are separate processes, so scaling is bounded by the
+ * cores available to them.
+ */
+
+#include "DatasetGenerator.h"
+#include "FastRandom.h"
+#include "LatencyHistogram.h"
+#include "Sharding.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct BenchOptions {
+        uint64_t accounts = 100000;
+        unsigned maxShards = 4;
+        unsigned clients = 16;
+        double seconds = 3.0;
+        bool rebalance = false;
+        std::string shardBinary;
+        uint64_t seed = 1;
+    };
+
+    struct RunResult {
+        uint64_t posted = 0;
+        uint64_t failed = 0;
+        double seconds = 0.0;
+        LatencyHistogram latency;
+        bool rebalanced = false;
+        RebalanceStats rebalance;
+    };
+
+    void printUsage(const char* program) {
+        std::cerr << "Usage: " << program << " [options]\n"
+                  << "  --accounts N             generated accounts (default 100000)\n"
+                  << "  --max-shards N           run 1, 2, 4 ... N shards (default 4)\n"
+                  << "  --clients N              router client threads (default 16)\n"
+                  << "  --duration SEC           run time per shard count (default 3)\n"
+                  << "  --rebalance              add a shard halfway through the largest run\n"
+                  << "  --shard-binary PATH      atm_shard to start (default: next to this program)\n"
+                  << "  --seed S                 workload seed" << std::endl;
+    }
+
+    bool parseOptions(int argc, char* argv[], BenchOptions& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--rebalance") {
+                options.rebalance = true;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                return false;
+            }
+            std::string value = argv[++i];
+            if (arg == "--accounts") options.accounts = std::stoull(value);
+            else if (arg == "--max-shards") options.maxShards = static_cast<unsigned>(std::stoul(value));
+            else if (arg == "--clients") options.clients = static_cast<unsigned>(std::stoul(value));
+            else if (arg == "--duration") options.seconds = std::stod(value);
+            else if (arg == "--shard-binary") options.shardBinary = value;
+            else if (arg == "--seed") options.seed = std::stoull(value);
+            else return false;
+        }
+        return options.accounts > 0 && options.maxShards > 0 && options.clients > 0 && options.seconds > 0.0;
+    }
+
+#ifndef _WIN32
+    struct ShardProcess {
+        pid_t pid;
+        std::string socketPath;
+    };
+
+    std::string socketPathFor(unsigned shard) {
+        return (std::filesystem::temp_directory_path() /
+                ("atm-shard-" + std::to_string(getpid()) + "-" + std::to_string(shard) + ".sock")).string();
+    }
+
+    // Start one atm_shard; an empty dataFile starts it with no accounts
+    bool startShard(const BenchOptions& options, const std::string& dataFile, unsigned shard, unsigned shards,
+                    ShardProcess& process) {
+        process.socketPath = socketPathFor(shard);
+        std::vector<std::string> args = {options.shardBinary, "--socket", process.socketPath};
+        if (!dataFile.empty()) {
+            args.insert(args.end(), {"--data", dataFile, "--shard", std::to_string(shard),
+                                     "--shards", std::to_string(shards)});
+        }
+        std::vector<char*> argv;
+        for (std::string& arg : args) {
+            argv.push_back(&arg[0]);
+        }
+        argv.push_back(nullptr);
+        process.pid = fork();
+        if (process.pid == 0) {
+            execv(argv[0], argv.data());
+            _exit(127);
+        }
+        return process.pid > 0;
+    }
+
+    // A shard is ready once its socket accepts connections
+    bool awaitShard(const ShardProcess& process) {
+        auto deadline = Clock::now() + std::chrono::seconds(30);
+        while (Clock::now() < deadline) {
+            ShardRouter probe;
+            std::string error;
+            if (probe.connect({process.socketPath}, error)) {
+                return true;
+            }
+            if (waitpid(process.pid, nullptr, WNOHANG) == process.pid) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        return false;
+    }
+
+    // Shards the router reaches stop on request; the rest are killed
+    void stopShards(ShardRouter& router, std::vector<ShardProcess>& processes, bool connected) {
+        if (connected) {
+            router.shutdownShards();
+        }
+        for (const ShardProcess& process : processes) {
+            if (!connected) {
+                kill(process.pid, SIGTERM);
+            }
+            waitpid(process.pid, nullptr, 0);
+            std::remove(process.socketPath.c_str());
+        }
+        processes.clear();
+    }
+
+    // Alternating withdrawals and deposits of the same amount on uniformly
+    // chosen accounts, so balances stay put over a long run
+    void client(ShardRouter& router, const std::vector<std::string>& accounts, uint64_t seed, uint32_t terminal,
+                Clock::time_point deadline, RunResult& result) {
+        FastRandom random(seed);
+        bool withdraw = true;
+        while (Clock::now() < deadline) {
+            const std::string& account = accounts[random.next() % accounts.size()];
+            ShardOutcome outcome;
+            auto begin = Clock::now();
+            ShardStatus status = router.post(withdraw ? ShardOp::Withdraw : ShardOp::Deposit, account, 2000, outcome,
+                                             terminal);
+            result.latency.record(
+                static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count()));
+            if (status == ShardStatus::Ok || status == ShardStatus::Declined) {
+                ++result.posted;
+            } else {
+                ++result.failed;
+            }
+            withdraw = !withdraw;
+        }
+    }
+
+    bool runShards(const BenchOptions& options, const std::string& dataFile, const std::vector<std::string>& accounts,
+                   unsigned shards, bool rebalance, RunResult& result) {
+        std::vector<ShardProcess> processes(shards);
+        std::vector<std::string> socketPaths;
+        for (unsigned shard = 0; shard < shards; ++shard) {
+            if (!startShard(options, dataFile, shard, shards, processes[shard])) {
+                return false;
+            }
+            socketPaths.push_back(processes[shard].socketPath);
+        }
+        ShardRouter router;
+        std::string error;
+        for (const ShardProcess& process : processes) {
+            if (!awaitShard(process)) {
+                std::cerr << "Error: shard on " << process.socketPath << " did not start" << std::endl;
+                stopShards(router, processes, false);
+                return false;
+            }
+        }
+        if (!router.connect(socketPaths, error)) {
+            std::cerr << "Error: " << error << std::endl;
+            stopShards(router, processes, false);
+            return false;
+        }
+
+        std::vector<RunResult> perClient(options.clients);
+        std::vector<std::thread> threads;
+        auto begin = Clock::now();
+        auto deadline = begin + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.seconds));
+        for (unsigned id = 0; id < options.clients; ++id) {
+            threads.emplace_back(client, std::ref(router), std::cref(accounts), options.seed * 1000003 + id, id + 1,
+                                 deadline, std::ref(perClient[id]));
+        }
+        if (rebalance) {
+            std::this_thread::sleep_until(begin + (deadline - begin) / 2);
+            ShardProcess added;
+            if (startShard(options, "", shards, shards + 1, added)) {
+                std::vector<ShardProcess> starting = {added};
+                result.rebalanced = awaitShard(added) && router.addShard(added.socketPath, result.rebalance, error);
+                if (result.rebalanced) {
+                    processes.push_back(added);
+                } else {
+                    stopShards(router, starting, false);
+                }
+            }
+            if (!result.rebalanced) {
+                std::cerr << "Error: rebalance failed: " << error << std::endl;
+            }
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        result.seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+        for (const RunResult& part : perClient) {
+            result.posted += part.posted;
+            result.failed += part.failed;
+            result.latency.merge(part.latency);
+        }
+        stopShards(router, processes, true);
+        return true;
+    }
+#endif
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    try {
+        if (!parseOptions(argc, argv, options)) {
+            printUsage(argv[0]);
+            return 1;
+        }
+    } catch (const std::exception&) {
+        printUsage(argv[0]);
+        return 1;
+    }
+#ifdef _WIN32
+    std::cerr << "Error: shard processes need Unix domain sockets" << std::endl;
+    return 1;
+#else
+    if (options.shardBinary.empty()) {
+        std::error_code ignored;
+        options.shardBinary = (std::filesystem::read_symlink("/proc/self/exe", ignored).parent_path() / "atm_shard").string();
+    }
+
+    std::filesystem::create_directories("bench_data");
+    std::string dataFile = "bench_data/shardbench-" + std::to_string(options.accounts) + ".txt";
+    DatasetConfig config;
+    config.accounts = options.accounts;
+    config.seed = options.seed;
+    DatasetGenerator generator(config);
+    if (!generator.writeAccounts(dataFile)) {
+        std::cerr << "Error: Could not write " << dataFile << std::endl;
+        return 1;
+    }
+    std::vector<std::string> accounts;
+    accounts.reserve(options.accounts);
+    for (uint64_t i = 0; i < options.accounts; ++i) {
+        accounts.push_back(generator.accountNumber(i));
+    }
+
+    std::printf("Accounts:   %llu\n", static_cast<unsigned long long>(options.accounts));
+    std::printf("Clients:    %u\n", options.clients);
+    std::printf("Duration:   %.2f s per run\n", options.seconds);
+    std::printf("Cores:      %u\n\n", std::thread::hardware_concurrency());
+    std::printf("%-8s %12s %12s %10s %10s %10s %10s\n", "Shards", "Postings", "Ops/s", "Speedup", "Failed",
+                "p50 us", "p99 us");
+
+    double baseline = 0.0;
+    for (unsigned shards = 1; shards <= options.maxShards; shards *= 2) {
+        bool rebalance = options.rebalance && shards * 2 > options.maxShards;
+        RunResult result;
+        if (!runShards(options, dataFile, accounts, shards, rebalance, result)) {
+            return 1;
+        }
+        double rate = result.posted / result.seconds;
+        if (baseline == 0.0) {
+            baseline = rate;
+        }
+        std::printf("%-8u %12llu %12.0f %9.2fx %10llu %10.2f %10.2f\n", shards,
+                    static_cast<unsigned long long>(result.posted), rate, rate / baseline,
+                    static_cast<unsigned long long>(result.failed), result.latency.percentile(50.0) / 1000.0,
+                    result.latency.percentile(99.0) / 1000.0);
+        if (result.rebalanced) {
+            std::printf("\nRebalance to %u shards: %llu accounts moved in %.1f ms; "
+                        "postings held back at most %.1f ms\n",
+                        shards + 1, static_cast<unsigned long long>(result.rebalance.movedAccounts),
+                        result.rebalance.totalSeconds * 1000.0, result.rebalance.exportSeconds * 1000.0);
+        }
+    }
+    return 0;
+#endif
+}
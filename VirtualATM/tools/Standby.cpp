@@ -0,0 +1,148 @@
+/*
+ * ATM Simulator - Hot Standby
+ *
+ * Listens on a Unix domain socket for a primary (atm_app with
+ * ATM_REPLICA_SOCKET, or atm_loadgen --replica-socket), applies the postings
+ * it ships to a copy of the accounts and answers read-only balance
+ * inquiries: each account number read from stdin is answered with its
+ * balance as the standby currently sees it. When the primary disconnects
+ * the accounts are written out, ready to be served from.
+ */
+
+#include "AccountStore.h"
+#include "Replication.h"
+#include "Transaction.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+    struct StandbyOptions {
+        std::string dataFile = "data/accounts.txt";
+        std::string socketPath;
+        std::string ledgerFile;
+        std::string closingFile;
+        double dailyLimit = 0.0;
+        int reportMs = 1000;
+    };
+
+    void printUsage(const char* program) {
+        std::cerr << "Usage: " << program << " --socket PATH [options]\n"
+                  << "  --data FILE              copy of the primary's accounts (default data/accounts.txt)\n"
+                  << "  --ledger FILE            append and sync every entry here before acknowledging it\n"
+                  << "  --closing FILE           write the accounts here instead of --data at the end\n"
+                  << "  --daily-limit AMOUNT     the primary's daily limit, to carry daily totals\n"
+                  << "  --report-ms N            status line interval on stderr, 0 for none (default 1000)\n"
+                  << "Reads account numbers from stdin and prints their balances." << std::endl;
+    }
+
+    bool parseOptions(int argc, char* argv[], StandbyOptions& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            std::string value = argv[++i];
+            if (arg == "--socket") options.socketPath = value;
+            else if (arg == "--data") options.dataFile = value;
+            else if (arg == "--ledger") options.ledgerFile = value;
+            else if (arg == "--closing") options.closingFile = value;
+            else if (arg == "--daily-limit") options.dailyLimit = std::stod(value);
+            else if (arg == "--report-ms") options.reportMs = std::stoi(value);
+            else return false;
+        }
+        return !options.socketPath.empty();
+    }
+
+    // Inquiries go through the store like any other, under the account's lock
+    void serveInquiries(AccountStore& store) {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            if (line.empty()) {
+                continue;
+            }
+            Account* account = store.find(line);
+            if (!account) {
+                std::printf("%s unknown\n", line.c_str());
+            } else {
+                BalanceInquiry inquiry;
+                store.apply(inquiry, *account);
+                std::printf("%s %.2f\n", line.c_str(), inquiry.getBalance());
+            }
+            std::fflush(stdout);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    StandbyOptions options;
+    try {
+        if (!parseOptions(argc, argv, options)) {
+            printUsage(argv[0]);
+            return 1;
+        }
+    } catch (const std::exception&) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    AccountStore store;
+    store.load(options.dataFile);
+    store.setDailyLimit(Ledger::toCents(options.dailyLimit));
+    ReplicaStandby standby(store);
+    std::string error;
+    if ((!options.ledgerFile.empty() && !standby.openLedger(options.ledgerFile, error)) ||
+        !standby.listen(options.socketPath, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+    std::fprintf(stderr, "Standby for %zu accounts listening on %s\n", store.size(), options.socketPath.c_str());
+
+    // Blocked reading stdin until it closes; not joined
+    std::thread(serveInquiries, std::ref(store)).detach();
+
+    std::atomic<bool> serving(true);
+    std::thread reporter([&] {
+        if (options.reportMs <= 0) {
+            return;
+        }
+        uint64_t previous = 0;
+        while (serving.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(options.reportMs));
+            uint64_t applied = standby.getApplied();
+            std::fprintf(stderr, "applied %llu entries (%.0f/s), sequence %llu, lag %lld us\n",
+                         static_cast<unsigned long long>(applied),
+                         static_cast<double>(applied - previous) * 1000.0 / options.reportMs,
+                         static_cast<unsigned long long>(standby.getLastSequence()),
+                         static_cast<long long>(standby.getLastLagUs()));
+            previous = applied;
+        }
+    });
+
+    bool served = standby.serve(error);
+    serving.store(false);
+    reporter.join();
+    if (!served) {
+        std::cerr << "Error: " << error << std::endl;
+    }
+
+    const std::string& closing = options.closingFile.empty() ? options.dataFile : options.closingFile;
+    if (!store.saveTo(closing)) {
+        std::cerr << "Error: Could not write " << closing << std::endl;
+        return 1;
+    }
+    const LatencyHistogram& lag = standby.getLag();
+    std::fprintf(stderr,
+                 "Primary disconnected after %llu entries in %llu batches (%.0f entries/s), %llu for unknown "
+                 "accounts\nLag posting to applied: p50 %.1f us, p99 %.1f us, max %.1f us\nAccounts written to %s\n",
+                 static_cast<unsigned long long>(standby.getApplied()),
+                 static_cast<unsigned long long>(standby.getBatches()),
+                 static_cast<double>(standby.getApplied()) / std::max(standby.getStreamSeconds(), 1e-9),
+                 static_cast<unsigned long long>(standby.getUnknown()), lag.percentile(50) / 1000.0,
+                 lag.percentile(99) / 1000.0, lag.getMax() / 1000.0, closing.c_str());
+    return served ? 0 : 1;
+}
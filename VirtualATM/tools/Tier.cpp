@@ -0,0 +1,219 @@
+/*
+ * ATM Simulator - Tiered Store
+ *
+ * Serves an accounts file from a TieredStore: the warm-start image on disk
+ * as the cold tier and a memory tier bounded by --budget-mb. Terminals post
+ * inquiries, withdrawals and deposits to Zipf-popular accounts (scattered
+ * over the table like atm_loadgen's), optionally with a sequential scan
+ * over the whole table mixed in, then the store is checkpointed. Reports
+ * the hit rate, the fault latency percentiles and the write-back activity.
+ * The image is written first if the accounts file has none.
+ */
+
+#include "AccountStore.h"
+#include "FastRandom.h"
+#include "LatencyHistogram.h"
+#include "StoreImage.h"
+#include "TieredStore.h"
+#include "Transaction.h"
+#include "ZipfDistribution.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct TierOptions {
+        std::string dataFile;
+        double budgetMb = 16.0;
+        double zipfExponent = 0.99;
+        double seconds = 10.0;
+        unsigned terminals = 4;
+        uint64_t scanEvery = 0;
+        uint64_t seed = 1;
+    };
+
+    struct WorkerStats {
+        LatencyHistogram latency;
+        uint64_t operations = 0;
+        uint64_t failed = 0;
+    };
+
+    void printUsage(const char* program) {
+        std::cerr << "Usage: " << program << " --data PATH [options]\n"
+                  << "  --budget-mb M     memory tier budget in MiB (default 16)\n"
+                  << "  --zipf S          account popularity skew (default 0.99)\n"
+                  << "  --duration SEC    run time (default 10)\n"
+                  << "  --terminals N     posting threads (default 4)\n"
+                  << "  --scan-every K    every K-th operation of a terminal is an inquiry on the\n"
+                  << "                    next account of a sequential scan (default: no scan)\n"
+                  << "  --seed S          workload seed" << std::endl;
+    }
+
+    bool parseOptions(int argc, char* argv[], TierOptions& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            std::string value = argv[++i];
+            if (arg == "--data") options.dataFile = value;
+            else if (arg == "--budget-mb") options.budgetMb = std::stod(value);
+            else if (arg == "--zipf") options.zipfExponent = std::stod(value);
+            else if (arg == "--duration") options.seconds = std::stod(value);
+            else if (arg == "--terminals") options.terminals = std::stoul(value);
+            else if (arg == "--scan-every") options.scanEvery = std::stoull(value);
+            else if (arg == "--seed") options.seed = std::stoull(value);
+            else return false;
+        }
+        return !options.dataFile.empty() && options.budgetMb > 0 && options.seconds > 0 && options.terminals > 0;
+    }
+
+    double secondsSince(Clock::time_point started) {
+        return std::chrono::duration<double>(Clock::now() - started).count();
+    }
+
+    bool ensureImage(const std::string& path) {
+        StoreImage image;
+        if (StoreImage::recover(path) && image.open(path)) {
+            return true;
+        }
+        std::printf("Image:       none current for %s, writing one\n", path.c_str());
+        AccountStore store;
+        store.load(path, false);
+        return store.size() > 0 && store.checkpoint();
+    }
+
+    // False if the account could not be brought into memory
+    bool post(TieredStore& store, size_t position, int operation) {
+        TieredStore::Handle handle = store.acquireAt(position);
+        if (!handle) {
+            return false;
+        }
+        if (operation == 1) {
+            Withdrawal withdrawal(20.0);
+            store.apply(withdrawal, handle);
+        } else if (operation == 2) {
+            Deposit deposit(20.0);
+            store.apply(deposit, handle);
+        } else {
+            BalanceInquiry inquiry;
+            store.apply(inquiry, handle);
+        }
+        store.release(handle);
+        return true;
+    }
+
+    // 70% inquiries, 15% withdrawals, 15% deposits on Zipf ranks scattered
+    // over the table; every scanEvery-th operation is the scan's next inquiry
+    void runTerminal(TieredStore& store, const TierOptions& options, const ZipfDistribution& popularity,
+                     unsigned terminal, const std::atomic<bool>& stop, WorkerStats& stats) {
+        FastRandom random(options.seed * 1000003ULL + terminal);
+        size_t n = store.size();
+        size_t scanPosition = n / options.terminals * terminal;
+        while (!stop.load(std::memory_order_relaxed)) {
+            size_t position;
+            int operation = 0;
+            if (options.scanEvery > 0 && stats.operations % options.scanEvery == options.scanEvery - 1) {
+                position = scanPosition;
+                scanPosition = (scanPosition + 1) % n;
+            } else {
+                uint64_t rank = popularity.sample(random) - 1;
+                position = static_cast<size_t>((rank * 0x9E3779B97F4A7C15ULL) % n);
+                double pick = random.uniform();
+                operation = pick < 0.70 ? 0 : pick < 0.85 ? 1 : 2;
+            }
+            auto started = Clock::now();
+            if (!post(store, position, operation)) {
+                stats.failed++;
+            }
+            stats.latency.record(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - started).count()));
+            stats.operations++;
+        }
+    }
+
+    double us(uint64_t ns) {
+        return static_cast<double>(ns) / 1000.0;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    TierOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (!ensureImage(options.dataFile)) {
+        std::cerr << "Error: Could not write an image for " << options.dataFile << std::endl;
+        return 1;
+    }
+
+    TieredStore store;
+    std::string error;
+    size_t budget = static_cast<size_t>(options.budgetMb * 1024.0 * 1024.0);
+    if (!store.open(options.dataFile, budget, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+    size_t n = store.size();
+    std::printf("Accounts:    %zu in %s\n", n, StoreImage::pathFor(options.dataFile).c_str());
+    std::printf("Memory tier: %zu accounts (%.1f%% of the table), %.1f of %.1f MiB, %zu B per account\n",
+                store.getCapacity(), n ? 100.0 * store.getCapacity() / n : 0.0,
+                store.getMemoryBytes() / (1024.0 * 1024.0), options.budgetMb, TieredStore::bytesPerAccount());
+
+    ZipfDistribution popularity(n, options.zipfExponent);
+    std::vector<WorkerStats> stats(options.terminals);
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> terminals;
+    auto started = Clock::now();
+    for (unsigned t = 0; t < options.terminals; ++t) {
+        terminals.emplace_back(runTerminal, std::ref(store), std::cref(options), std::cref(popularity), t,
+                               std::cref(stop), std::ref(stats[t]));
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.seconds));
+    stop = true;
+    for (auto& terminal : terminals) {
+        terminal.join();
+    }
+    double elapsed = secondsSince(started);
+
+    WorkerStats total;
+    for (const WorkerStats& worker : stats) {
+        total.latency.merge(worker.latency);
+        total.operations += worker.operations;
+        total.failed += worker.failed;
+    }
+    TieredStore::Stats tier = store.getStats();
+
+    started = Clock::now();
+    bool checkpointed = store.checkpoint();
+    double checkpointSeconds = secondsSince(started);
+
+    std::printf("Workload:    Zipf %.2f, %u terminals, %.1f s", options.zipfExponent, options.terminals, elapsed);
+    if (options.scanEvery > 0) {
+        std::printf(", scan every %llu operations", static_cast<unsigned long long>(options.scanEvery));
+    }
+    std::printf("\n");
+    std::printf("Operations:  %llu (%.0f/s), %llu failed; p50 %.2f us, p99 %.2f us\n",
+                static_cast<unsigned long long>(total.operations), total.operations / elapsed,
+                static_cast<unsigned long long>(total.failed), us(total.latency.percentile(50)),
+                us(total.latency.percentile(99)));
+    std::printf("Hit rate:    %.2f%% (%llu hits, %llu faults)\n", 100.0 * tier.hitRate(),
+                static_cast<unsigned long long>(tier.hits), static_cast<unsigned long long>(tier.faults));
+    std::printf("Faults:      p50 %.2f us, p99 %.2f us, p99.9 %.2f us, max %.2f us\n",
+                us(tier.faultLatency.percentile(50)), us(tier.faultLatency.percentile(99)),
+                us(tier.faultLatency.percentile(99.9)), us(tier.faultLatency.getMax()));
+    std::printf("Write-back:  %llu evictions, %llu records in %llu batches, %llu writes\n",
+                static_cast<unsigned long long>(tier.evictions), static_cast<unsigned long long>(tier.writtenBack),
+                static_cast<unsigned long long>(tier.writebackBatches),
+                static_cast<unsigned long long>(tier.writebackRuns));
+    std::printf("Checkpoint:  %s in %.2f s\n", checkpointed ? "written" : "FAILED", checkpointSeconds);
+    return checkpointed ? 0 : 1;
+}
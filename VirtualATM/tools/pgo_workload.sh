@@ -0,0 +1,46 @@
+#!/bin/bash
+# Representative training run for profile-guided builds.
+#
+# Usage: tools/pgo_workload.sh <build dir> <work dir>
+#
+# Generates a large dataset, drives scripted console sessions through atm_app
+# (failed and successful logins, inquiries, withdrawals, deposits, history,
+# logout with a full save), replays a recorded session in parallel, runs the
+# load generator mixes and a short benchmark pass.
+
+set -euo pipefail
+
+BIN="$(cd "$1" && pwd)"
+mkdir -p "$2"
+cd "$2"
+ACCOUNTS="${PGO_ACCOUNTS:-200000}"
+
+mkdir -p data
+rm -f data/login_throttle.bin
+"$BIN/atm_datagen" --accounts "$ACCOUNTS" --history $((ACCOUNTS * 5)) --seed 11 \
+    --out data/accounts.txt --ledger data/ledger.bin > /dev/null
+
+# One console session: a wrong PIN, then every menu option and exit
+session_input() {
+    local account="$1" pin="$2"
+    printf '%s\n0000\n%s\n%s\n' "$account" "$account" "$pin"
+    printf '1\n\n2\n20\n\n2\n999999999\n\n3\n35.50\n\n2\n-5\n\n9\n\n4\n\n1\n\n0\n'
+}
+
+session=0
+head -n 12 data/accounts.txt | while IFS=, read -r account pin _; do
+    session=$((session + 1))
+    session_input "$account" "$pin" | ATM_PLAIN=1 ATM_TERMINAL_ID="pgo-$session" "$BIN/atm_app" > /dev/null
+done
+
+IFS=, read -r account pin _ < <(sed -n '100p' data/accounts.txt)
+session_input "$account" "$pin" | ATM_PLAIN=1 ATM_TERMINAL_ID=pgo-record \
+    "$BIN/atm_app" --record session.bin > /dev/null
+"$BIN/atm_replay" --sessions 16 --pace max --data data/accounts.txt session.bin > /dev/null
+
+for mix in inquiry-heavy withdrawal-heavy transfer-storm; do
+    "$BIN/atm_loadgen" --data data/accounts.txt --mix "$mix" --closed 4 --duration 2 > /dev/null
+done
+"$BIN/atm_loadgen" --data data/accounts.txt --open 20000 --threads 2 --duration 2 > /dev/null
+
+"$BIN/atm_bench" --min-exp 3 --max-exp 5 --min-time 0.02 --scratch bench_data > /dev/null